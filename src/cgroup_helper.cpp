@@ -1,9 +1,14 @@
 #include "cgroup_helper.h"
+#include "cpu_topology.h"
 
 #include <filesystem>
 #include <fstream>
 #include <string>
 #include <system_error>
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <fcntl.h>
 #include <unistd.h>
 
 #include "NanoLogCpp17.h"
@@ -19,7 +24,22 @@ static bool write_value(const fs::path &file, const std::string &value) {
     return ofs.good();
 }
 
-std::string create_cgroup_for_job(int job_id, int cpu_cores, std::size_t mem_mb, const CgroupConfig &cfg) {
+std::string cgroup_io_max_line(const std::string &device, std::int64_t mbps) {
+    auto limit = mbps > 0 ? std::to_string(mbps * 1024 * 1024) : std::string("max");
+    return device + " rbps=" + limit + " wbps=" + limit;
+}
+
+std::string create_cgroup_for_job(int job_id, int cpu_cores, std::size_t mem_mb, const CgroupConfig &cfg,
+                                  const CpuPlacement &placement) {
+    JobSpec spec;
+    spec.cpu_cores = cpu_cores;
+    spec.memory_mb = mem_mb;
+    return create_cgroup_for_job(job_id, spec, cfg, placement);
+}
+
+std::string create_cgroup_for_job(int job_id, const JobSpec &spec, const CgroupConfig &cfg, const CpuPlacement &placement) {
+    const int cpu_cores = spec.cpu_cores;
+    const std::size_t mem_mb = spec.memory_mb;
     fs::path base(cfg.base_path);
     fs::path cg_dir = base / ("job_" + std::to_string(job_id));
     std::error_code ec;
@@ -42,10 +62,31 @@ std::string create_cgroup_for_job(int job_id, int cpu_cores, std::size_t mem_mb,
         NANO_LOG(WARNING, "%s", "Failed to write memory.max");
     }
 
+    // pids/io 控制器未启用时写入失败，只记录不影响任务
+    if (spec.pids > 0 && !write_value(cg_dir / "pids.max", std::to_string(spec.pids))) {
+        NANO_LOG(WARNING, "%s", "Failed to write pids.max");
+    }
+    if (spec.io_mbps > 0 && !cfg.io_device.empty() && !write_value(cg_dir / "io.max", cgroup_io_max_line(cfg.io_device, spec.io_mbps))) {
+        NANO_LOG(WARNING, "%s", "Failed to write io.max");
+    }
+
+    // cpuset 控制器未启用时没有这两个文件，任务仍由亲和性绑定
+    if (!placement.empty() && (!write_value(cg_dir / "cpuset.cpus", format_cpu_list(placement.cpus)) ||
+                               !write_value(cg_dir / "cpuset.mems", format_cpu_list(placement.nodes)))) {
+        NANO_LOG(DEBUG, "cpuset not applied path=%s", cg_dir.string().c_str());
+    }
+
     NANO_LOG(DEBUG, "cgroup created path=%s quota_us=%ld period_us=%d mem_bytes=%zu", cg_dir.string().c_str(), quota, cfg.cpu_period_us, bytes);
     return cg_dir.string();
 }
 
+bool enable_cgroup_controller(const std::string &base_path, std::string_view controller) {
+    std::error_code ec;
+    fs::create_directories(base_path, ec);
+    if (ec) return false;
+    return write_value(fs::path(base_path) / "cgroup.subtree_control", "+" + std::string(controller));
+}
+
 bool attach_pid_to_cgroup(pid_t pid, const std::string &cg_path) {
     if (cg_path.empty()) return false;
     std::ofstream ofs(std::filesystem::path(cg_path) / "cgroup.procs");
@@ -58,14 +99,128 @@ bool attach_pid_to_cgroup(pid_t pid, const std::string &cg_path) {
     return ok;
 }
 
+int open_cgroup_dir(const std::string &cg_path) {
+    if (cg_path.empty()) return -1;
+    int fd = ::open(cg_path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+        NANO_LOG(WARNING, "open cgroup dir=%s failed", cg_path.c_str());
+    }
+    return fd;
+}
+
+int open_cgroup_procs(const std::string &cg_path) {
+    if (cg_path.empty()) return -1;
+    auto procs = (fs::path(cg_path) / "cgroup.procs").string();
+    int fd = ::open(procs.c_str(), O_WRONLY | O_CLOEXEC);
+    if (fd < 0) {
+        NANO_LOG(WARNING, "open cgroup.procs for cgroup=%s failed", cg_path.c_str());
+    }
+    return fd;
+}
+
 void cleanup_cgroup(const std::string &cg_path) {
     if (cg_path.empty()) return;
-    std::error_code ec;
-    std::filesystem::remove_all(cg_path, ec);
-    if (ec) {
-        auto msg = "Failed to cleanup cgroup: " + ec.message();
+    // cgroupfs 的控制文件不能 unlink，目录只能直接 rmdir（remove_all 会在第一个文件上失败）；
+    // 非 cgroupfs 的目录（如测试用的临时目录）rmdir 报 ENOTEMPTY，再整体删除
+    std::string err;
+    if (::rmdir(cg_path.c_str()) != 0) {
+        err = std::strerror(errno);
+        if (errno == ENOTEMPTY) {
+            std::error_code ec;
+            std::filesystem::remove_all(cg_path, ec);
+            err = ec ? ec.message() : std::string();
+        }
+    }
+    if (!err.empty()) {
+        auto msg = "Failed to cleanup cgroup " + cg_path + ": " + err;
         NANO_LOG(WARNING, "%s", msg.c_str());
     } else {
         NANO_LOG(DEBUG, "cgroup cleaned path=%s", cg_path.c_str());
     }
 }
+
+namespace {
+// 整数形式的控制文件（memory.peak、pids.peak）；"max" 等非数字内容返回 0
+std::uint64_t parse_u64(std::string_view text) {
+    std::uint64_t v = 0;
+    std::from_chars(text.data(), text.data() + text.size(), v);
+    return v;
+}
+
+bool pread_text(int fd, std::string &buf) {
+    if (fd < 0) return false;
+    buf.resize(4096);
+    ssize_t n = ::pread(fd, buf.data(), buf.size(), 0);
+    if (n < 0) return false;
+    buf.resize(static_cast<std::size_t>(n));
+    return true;
+}
+
+// 找到 "key" 后紧跟的数字（key 包含分隔符，如 "usage_usec " 或 "rbytes="）
+bool value_after(std::string_view text, std::string_view key, std::size_t from, std::uint64_t &out, std::size_t &end) {
+    auto pos = text.find(key, from);
+    if (pos == std::string_view::npos) return false;
+    auto begin = text.data() + pos + key.size();
+    auto res = std::from_chars(begin, text.data() + text.size(), out);
+    end = static_cast<std::size_t>(res.ptr - text.data());
+    return res.ec == std::errc{};
+}
+}
+
+bool parse_cpu_stat_usage(std::string_view text, std::uint64_t &usage_usec) {
+    std::size_t end = 0;
+    return text.starts_with("usage_usec ") ? value_after(text, "usage_usec ", 0, usage_usec, end)
+                                           : value_after(text, "\nusage_usec ", 0, usage_usec, end);
+}
+
+void parse_io_stat_bytes(std::string_view text, std::uint64_t &rbytes, std::uint64_t &wbytes) {
+    // 每行一个设备：8:0 rbytes=1 wbytes=2 rios=3 wios=4 dbytes=0 dios=0
+    rbytes = wbytes = 0;
+    std::size_t pos = 0;
+    std::uint64_t v = 0;
+    while (value_after(text, "rbytes=", pos, v, pos)) rbytes += v;
+    pos = 0;
+    while (value_after(text, "wbytes=", pos, v, pos)) wbytes += v;
+}
+
+CgroupUsageFds open_cgroup_usage(int dir_fd) {
+    CgroupUsageFds fds;
+    if (dir_fd < 0) return fds;
+    fds.cpu_stat = ::openat(dir_fd, "cpu.stat", O_RDONLY | O_CLOEXEC);
+    fds.io_stat = ::openat(dir_fd, "io.stat", O_RDONLY | O_CLOEXEC);
+    // 读写打开：6.12 起向 memory.peak/pids.peak 写入可重置本 fd 看到的峰值
+    fds.memory_peak = ::openat(dir_fd, "memory.peak", O_RDWR | O_CLOEXEC);
+    if (fds.memory_peak < 0) fds.memory_peak = ::openat(dir_fd, "memory.peak", O_RDONLY | O_CLOEXEC);
+    fds.pids_peak = ::openat(dir_fd, "pids.peak", O_RDWR | O_CLOEXEC);
+    if (fds.pids_peak < 0) fds.pids_peak = ::openat(dir_fd, "pids.peak", O_RDONLY | O_CLOEXEC);
+    return fds;
+}
+
+void close_cgroup_usage(CgroupUsageFds &fds) {
+    for (int *fd : {&fds.cpu_stat, &fds.io_stat, &fds.memory_peak, &fds.pids_peak}) {
+        if (*fd >= 0) ::close(*fd);
+        *fd = -1;
+    }
+}
+
+bool read_cgroup_usage(const CgroupUsageFds &fds, JobUsage &out) {
+    out = JobUsage{};
+    std::string buf;
+    if (!pread_text(fds.cpu_stat, buf) || !parse_cpu_stat_usage(buf, out.cpu_usec)) return false;
+    if (pread_text(fds.io_stat, buf)) parse_io_stat_bytes(buf, out.io_read_bytes, out.io_write_bytes);
+    if (pread_text(fds.memory_peak, buf)) out.memory_peak_bytes = parse_u64(buf);
+    if (pread_text(fds.pids_peak, buf)) out.pids_peak = parse_u64(buf);
+    out.valid = true;
+    return true;
+}
+
+bool read_cgroup_usage(const std::string &cg_path, JobUsage &out) {
+    out = JobUsage{};
+    int dir_fd = open_cgroup_dir(cg_path);
+    if (dir_fd < 0) return false;
+    auto fds = open_cgroup_usage(dir_fd);
+    ::close(dir_fd);
+    bool ok = read_cgroup_usage(fds, out);
+    close_cgroup_usage(fds);
+    return ok;
+}
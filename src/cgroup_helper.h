@@ -1,8 +1,38 @@
 #pragma once
 
 #include "job.h"
+#include <cstdint>
 #include <string>
+#include <string_view>
 
-std::string create_cgroup_for_job(int job_id, int cpu_cores, std::size_t mem_mb, const CgroupConfig &cfg);
+// 按 spec 写入 cpu.max、memory.max，pids > 0 时写 pids.max，cfg.io_device 非空且 io_mbps > 0 时写 io.max；
+// placement 非空时同时写入 cpuset.cpus / cpuset.mems（需在基路径启用 cpuset 控制器）
+std::string create_cgroup_for_job(int job_id, const JobSpec &spec, const CgroupConfig &cfg, const CpuPlacement &placement = {});
+std::string create_cgroup_for_job(int job_id, int cpu_cores, std::size_t mem_mb, const CgroupConfig &cfg,
+                                  const CpuPlacement &placement = {});
+// io.max 的一行："MAJ:MIN rbps=<bytes> wbps=<bytes>"，mbps 为 0 时为 max（不限）
+std::string cgroup_io_max_line(const std::string &device, std::int64_t mbps);
+// 在 base_path 的 cgroup.subtree_control 中启用控制器（如 "cpuset"），必要时先创建目录
+bool enable_cgroup_controller(const std::string &base_path, std::string_view controller);
 bool attach_pid_to_cgroup(pid_t pid, const std::string &cg_path);
+// 打开 cgroup 目录 / cgroup.procs 供子进程在 exec 前加入（O_CLOEXEC），失败返回 -1
+int open_cgroup_dir(const std::string &cg_path);
+int open_cgroup_procs(const std::string &cg_path);
 void cleanup_cgroup(const std::string &cg_path);
+
+// cgroup 用量文件的 fd，缺失的文件（控制器未启用）为 -1
+struct CgroupUsageFds {
+    int cpu_stat{-1};
+    int io_stat{-1};
+    int memory_peak{-1};
+    int pids_peak{-1};
+};
+CgroupUsageFds open_cgroup_usage(int dir_fd);
+void close_cgroup_usage(CgroupUsageFds &fds);
+// 经 pread 读取累计用量（cpu 与 io 为 cgroup 创建以来的累计值，memory/pids 为峰值），cpu.stat 读不到时返回 false
+bool read_cgroup_usage(const CgroupUsageFds &fds, JobUsage &out);
+// 一次性读取路径下 cgroup 的用量（新建的任务 cgroup 在删除前调用）
+bool read_cgroup_usage(const std::string &cg_path, JobUsage &out);
+// 解析 cpu.stat 的 usage_usec 与 io.stat 各设备 rbytes/wbytes 之和
+bool parse_cpu_stat_usage(std::string_view text, std::uint64_t &usage_usec);
+void parse_io_stat_bytes(std::string_view text, std::uint64_t &rbytes, std::uint64_t &wbytes);
@@ -0,0 +1,261 @@
+#include "cgroup_pool.h"
+#include "cpu_topology.h"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <string_view>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "NanoLogCpp17.h"
+
+using namespace NanoLog::LogLevels;
+
+namespace {
+bool write_fd(int fd, const std::string &value) {
+    if (fd < 0) return false;
+    return ::pwrite(fd, value.data(), value.size(), 0) == static_cast<ssize_t>(value.size());
+}
+
+void close_fd(int &fd) {
+    if (fd >= 0) ::close(fd);
+    fd = -1;
+}
+}
+
+CgroupPool::~CgroupPool() {
+    std::lock_guard lk(mu_);
+    for (auto &s : slots_) {
+        close_fd(s.procs_fd);
+        close_fd(s.cpu_max_fd);
+        close_fd(s.mem_max_fd);
+        close_fd(s.pids_max_fd);
+        close_fd(s.io_max_fd);
+        close_fd(s.events_fd);
+        close_fd(s.cpuset_cpus_fd);
+        close_fd(s.cpuset_mems_fd);
+        close_cgroup_usage(s.usage);
+        close_fd(s.dir_fd);
+        // cgroup 目录只能 rmdir；仍有进程时内核返回 EBUSY，留给下次启动复用
+        if (::rmdir(s.path.c_str()) != 0 && errno != ENOENT) {
+            auto msg = "cgroup pool: rmdir " + s.path + " failed: " + std::strerror(errno);
+            NANO_LOG(WARNING, "%s", msg.c_str());
+        }
+    }
+}
+
+int CgroupPool::init(const CgroupConfig &cfg, int prewarm) {
+    std::lock_guard lk(mu_);
+    cfg_ = cfg;
+    if (::mkdir(cfg_.base_path.c_str(), 0755) != 0 && errno != EEXIST) {
+        auto msg = "cgroup pool: mkdir " + cfg_.base_path + " failed: " + std::strerror(errno);
+        NANO_LOG(WARNING, "%s", msg.c_str());
+        return 0;
+    }
+    int created = 0;
+    for (int i = 0; i < prewarm; ++i) {
+        int slot = create_idle_slot_locked();
+        if (slot < 0) break;
+        free_.push_back(slot);
+        ++created;
+    }
+    if (created > 0 && slots_.front().cpu_max_fd < 0) {
+        auto msg = "cgroup pool: cpu.max unavailable under " + cfg_.base_path + " (cpu controller not enabled?)";
+        NANO_LOG(WARNING, "%s", msg.c_str());
+    }
+    NANO_LOG(NOTICE, "cgroup pool ready base=%s slots=%d", cfg_.base_path.c_str(), created);
+    return created;
+}
+
+int CgroupPool::create_slot_locked() {
+    Slot s;
+    s.path = cfg_.base_path + "/pool_" + std::to_string(slots_.size());
+    // 上次运行残留的同名目录直接复用
+    if (::mkdir(s.path.c_str(), 0755) != 0 && errno != EEXIST) {
+        auto msg = "cgroup pool: mkdir " + s.path + " failed: " + std::strerror(errno);
+        NANO_LOG(WARNING, "%s", msg.c_str());
+        return -1;
+    }
+    s.dir_fd = ::open(s.path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (s.dir_fd < 0) {
+        auto msg = "cgroup pool: open " + s.path + " failed: " + std::strerror(errno);
+        NANO_LOG(WARNING, "%s", msg.c_str());
+        ::rmdir(s.path.c_str());
+        return -1;
+    }
+    s.procs_fd = ::openat(s.dir_fd, "cgroup.procs", O_WRONLY | O_CLOEXEC);
+    s.cpu_max_fd = ::openat(s.dir_fd, "cpu.max", O_WRONLY | O_CLOEXEC);
+    s.mem_max_fd = ::openat(s.dir_fd, "memory.max", O_WRONLY | O_CLOEXEC);
+    s.pids_max_fd = ::openat(s.dir_fd, "pids.max", O_WRONLY | O_CLOEXEC);
+    if (!cfg_.io_device.empty()) s.io_max_fd = ::openat(s.dir_fd, "io.max", O_WRONLY | O_CLOEXEC);
+    s.events_fd = ::openat(s.dir_fd, "cgroup.events", O_RDONLY | O_CLOEXEC);
+    s.cpuset_cpus_fd = ::openat(s.dir_fd, "cpuset.cpus", O_WRONLY | O_CLOEXEC);
+    s.cpuset_mems_fd = ::openat(s.dir_fd, "cpuset.mems", O_WRONLY | O_CLOEXEC);
+    s.usage = open_cgroup_usage(s.dir_fd);
+    slots_.push_back(std::move(s));
+    return static_cast<int>(slots_.size()) - 1;
+}
+
+int CgroupPool::create_idle_slot_locked() {
+    for (;;) {
+        int slot = create_slot_locked();
+        if (slot < 0 || !populated(slots_[slot])) return slot;
+        NANO_LOG(WARNING, "cgroup pool: leftover %s still populated, draining", slots_[slot].path.c_str());
+        draining_.push_back(slot);
+    }
+}
+
+bool CgroupPool::populated(const Slot &s) const {
+    if (s.events_fd < 0) return false;
+    char buf[128];
+    ssize_t n = ::pread(s.events_fd, buf, sizeof(buf) - 1, 0);
+    if (n <= 0) return false;
+    std::string_view text(buf, static_cast<std::size_t>(n));
+    return text.find("populated 1") != std::string_view::npos;
+}
+
+void CgroupPool::reap_draining_locked() {
+    for (std::size_t i = 0; i < draining_.size();) {
+        if (!populated(slots_[draining_[i]])) {
+            free_.push_back(draining_[i]);
+            draining_[i] = draining_.back();
+            draining_.pop_back();
+        } else {
+            ++i;
+        }
+    }
+}
+
+int CgroupPool::acquire(int cpu_cores, std::size_t mem_mb, const CpuPlacement &placement) {
+    JobSpec spec;
+    spec.cpu_cores = cpu_cores;
+    spec.memory_mb = mem_mb;
+    return acquire(spec, placement);
+}
+
+int CgroupPool::acquire(const JobSpec &spec, const CpuPlacement &placement) {
+    const int cpu_cores = spec.cpu_cores;
+    const std::size_t mem_mb = spec.memory_mb;
+    std::lock_guard lk(mu_);
+    if (free_.empty() && !draining_.empty()) reap_draining_locked();
+    int slot;
+    if (!free_.empty()) {
+        slot = free_.back();
+        free_.pop_back();
+    } else {
+        slot = create_idle_slot_locked();
+        if (slot < 0) return -1;
+        NANO_LOG(DEBUG, "cgroup pool grew to %zu slots", slots_.size());
+    }
+
+    auto &s = slots_[slot];
+    if (s.cpu_cores != cpu_cores) {
+        // cpu.max = <quota_us> <period_us>
+        long quota = static_cast<long>(cpu_cores * cfg_.cpu_period_us);
+        if (s.cpu_max_fd >= 0 && !write_fd(s.cpu_max_fd, std::to_string(quota) + " " + std::to_string(cfg_.cpu_period_us))) {
+            NANO_LOG(WARNING, "cgroup pool: write cpu.max failed path=%s", s.path.c_str());
+        }
+        s.cpu_cores = cpu_cores;
+    }
+    if (s.mem_max_fd >= 0 && s.mem_mb != mem_mb) {
+        if (!write_fd(s.mem_max_fd, std::to_string(mem_mb * 1024ull * 1024ull))) {
+            NANO_LOG(WARNING, "cgroup pool: write memory.max failed path=%s", s.path.c_str());
+        }
+        s.mem_mb = mem_mb;
+    }
+    if (s.pids_max_fd >= 0 && s.pids != spec.pids) {
+        if (!write_fd(s.pids_max_fd, spec.pids > 0 ? std::to_string(spec.pids) : std::string("max"))) {
+            NANO_LOG(WARNING, "cgroup pool: write pids.max failed path=%s", s.path.c_str());
+        }
+        s.pids = spec.pids;
+    }
+    if (s.io_max_fd >= 0 && s.io_mbps != spec.io_mbps) {
+        if (!write_fd(s.io_max_fd, cgroup_io_max_line(cfg_.io_device, spec.io_mbps))) {
+            NANO_LOG(WARNING, "cgroup pool: write io.max failed path=%s", s.path.c_str());
+        }
+        s.io_mbps = spec.io_mbps;
+    }
+    // 与上次租约相同则跳过；未绑核的任务写空串，恢复继承父 cgroup 的 CPU 与节点
+    if (s.cpuset_cpus_fd >= 0) {
+        auto cpus = format_cpu_list(placement.cpus);
+        auto mems = format_cpu_list(placement.nodes);
+        if (cpus != s.cpuset_cpus) {
+            if (!write_fd(s.cpuset_cpus_fd, cpus.empty() ? "\n" : cpus)) {
+                NANO_LOG(WARNING, "cgroup pool: write cpuset.cpus failed path=%s", s.path.c_str());
+            }
+            s.cpuset_cpus = std::move(cpus);
+        }
+        if (mems != s.cpuset_mems && s.cpuset_mems_fd >= 0) {
+            if (!write_fd(s.cpuset_mems_fd, mems.empty() ? "\n" : mems)) {
+                NANO_LOG(WARNING, "cgroup pool: write cpuset.mems failed path=%s", s.path.c_str());
+            }
+            s.cpuset_mems = std::move(mems);
+        }
+    }
+    // 峰值：首次租用即为本任务的峰值；之后向自己的 fd 写入任意内容可重置该 fd 看到的峰值（6.12+），
+    // 旧内核写入失败则本次租约的峰值未知
+    s.mem_peak_fresh = !s.leased || write_fd(s.usage.memory_peak, "reset");
+    s.pids_peak_fresh = !s.leased || write_fd(s.usage.pids_peak, "reset");
+    if (!read_cgroup_usage(s.usage, s.base)) s.base = JobUsage{};
+    s.leased = true;
+    return slot;
+}
+
+void CgroupPool::release(int slot) {
+    std::lock_guard lk(mu_);
+    if (slot < 0 || slot >= static_cast<int>(slots_.size())) return;
+    if (populated(slots_[slot])) {
+        NANO_LOG(DEBUG, "cgroup pool: %s still populated, draining", slots_[slot].path.c_str());
+        draining_.push_back(slot);
+    } else {
+        free_.push_back(slot);
+    }
+}
+
+bool CgroupPool::collect_usage(int slot, JobUsage &out) const {
+    std::lock_guard lk(mu_);
+    out = JobUsage{};
+    if (slot < 0 || slot >= static_cast<int>(slots_.size())) return false;
+    const auto &s = slots_[slot];
+    JobUsage now;
+    if (!read_cgroup_usage(s.usage, now)) return false;
+    auto delta = [](std::uint64_t cur, std::uint64_t base) { return cur >= base ? cur - base : cur; };
+    out.cpu_usec = delta(now.cpu_usec, s.base.cpu_usec);
+    out.io_read_bytes = delta(now.io_read_bytes, s.base.io_read_bytes);
+    out.io_write_bytes = delta(now.io_write_bytes, s.base.io_write_bytes);
+    out.memory_peak_bytes = s.mem_peak_fresh ? now.memory_peak_bytes : 0;
+    out.pids_peak = s.pids_peak_fresh ? now.pids_peak : 0;
+    out.valid = true;
+    return true;
+}
+
+const std::string &CgroupPool::path(int slot) const {
+    std::lock_guard lk(mu_);
+    return slots_[slot].path;
+}
+
+int CgroupPool::dir_fd(int slot) const {
+    std::lock_guard lk(mu_);
+    return slots_[slot].dir_fd;
+}
+
+int CgroupPool::procs_fd(int slot) const {
+    std::lock_guard lk(mu_);
+    return slots_[slot].procs_fd;
+}
+
+std::size_t CgroupPool::size() const {
+    std::lock_guard lk(mu_);
+    return slots_.size();
+}
+
+std::size_t CgroupPool::idle() const {
+    std::lock_guard lk(mu_);
+    return free_.size();
+}
+
+std::size_t CgroupPool::draining() const {
+    std::lock_guard lk(mu_);
+    return draining_.size();
+}
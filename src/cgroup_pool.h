@@ -0,0 +1,84 @@
+#pragma once
+
+#include "cgroup_helper.h"
+#include "job.h"
+
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+// 预先创建、循环复用的任务 cgroup（<base_path>/pool_<n>）。每个槽位缓存目录、cgroup.procs、
+// cpu.max、memory.max、pids.max、io.max、cpuset.cpus/mems 与 cgroup.events 的 fd，租用时只经缓存的 fd 改写限额，
+// 不再为每个任务 mkdir/rmdir（内核对 cgroup 的创建与删除是串行的）。
+// 归还时 cgroup 里仍有进程（任务遗留的后台子进程）的槽位先搁置，等 populated 归零后再复用。
+// 没有空闲槽位时新建一个加入池中，池只增不减，析构时统一删除。线程安全。
+// 上次运行残留的同名目录直接复用，但其中的限额未知，首次租用总会全部重写；仍有进程的残留目录先搁置。
+// 槽位复用后 cpu.stat/io.stat 是历次租约的累计值，租用时记下基线，collect_usage 返回本次租约的增量。
+class CgroupPool {
+public:
+    CgroupPool() = default;
+    ~CgroupPool();
+    CgroupPool(const CgroupPool &) = delete;
+    CgroupPool &operator=(const CgroupPool &) = delete;
+
+    // 预建 prewarm 个槽位，返回实际建成的数量
+    int init(const CgroupConfig &cfg, int prewarm);
+    // 租用一个槽位并按 spec 写入限额（placement 非空时还有 cpuset），失败返回 -1。
+    // 未申请 pids/io 的任务把上次租约的限额恢复为 max
+    int acquire(const JobSpec &spec, const CpuPlacement &placement = {});
+    int acquire(int cpu_cores, std::size_t mem_mb, const CpuPlacement &placement = {});
+    // 任务结束或启动失败后归还
+    void release(int slot);
+    // 在 release 之前读取本次租约的用量；峰值无法按租约重置时（内核 < 6.12 且非首次租用）记为 0
+    bool collect_usage(int slot, JobUsage &out) const;
+    // 以下访问器只在持有租约期间调用
+    const std::string &path(int slot) const;
+    int dir_fd(int slot) const;
+    int procs_fd(int slot) const;
+
+    std::size_t size() const;
+    std::size_t idle() const;
+    std::size_t draining() const;
+
+private:
+    struct Slot {
+        std::string path;
+        int dir_fd{-1};
+        int procs_fd{-1};
+        int cpu_max_fd{-1};
+        int mem_max_fd{-1};
+        int pids_max_fd{-1};
+        int io_max_fd{-1};
+        int events_fd{-1};
+        int cpuset_cpus_fd{-1};
+        int cpuset_mems_fd{-1};
+        CgroupUsageFds usage;
+        JobUsage base;      // 租用时的累计值
+        bool leased{false}; // 曾经租出过
+        bool mem_peak_fresh{false};
+        bool pids_peak_fresh{false};
+        // 上次写入的限额，相同时跳过写入；初值是不可能的取值，首次租用必然写入
+        int cpu_cores{-1};
+        std::size_t mem_mb{static_cast<std::size_t>(-1)};
+        std::int64_t pids{-1};
+        std::int64_t io_mbps{-1};
+        std::optional<std::string> cpuset_cpus;
+        std::optional<std::string> cpuset_mems;
+    };
+
+    int create_slot_locked();
+    // 新建槽位直到拿到一个没有进程的；残留的仍有进程的目录放进 draining_
+    int create_idle_slot_locked();
+    bool populated(const Slot &s) const;
+    // 把已清空的搁置槽位移回空闲列表
+    void reap_draining_locked();
+
+    CgroupConfig cfg_;
+    mutable std::mutex mu_;
+    std::deque<Slot> slots_; // 扩容不移动已有槽位，path() 返回的引用一直有效
+    std::vector<int> free_;
+    std::vector<int> draining_;
+};
@@ -0,0 +1,104 @@
+#include "child_watcher.h"
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "NanoLogCpp17.h"
+
+using namespace NanoLog::LogLevels;
+
+namespace {
+constexpr std::uint64_t kWakeToken = ~0ull;
+
+int open_pidfd(pid_t pid) {
+#ifdef SYS_pidfd_open
+    return static_cast<int>(::syscall(SYS_pidfd_open, pid, 0));
+#else
+    (void)pid;
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+}
+
+ChildWatcher::ChildWatcher() {
+    epoll_fd_ = ::epoll_create1(EPOLL_CLOEXEC);
+    wake_fd_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epoll_fd_ < 0 || wake_fd_ < 0) {
+        auto msg = std::string("ChildWatcher init failed: ") + std::strerror(errno);
+        NANO_LOG(ERROR, "%s", msg.c_str());
+        return;
+    }
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.u64 = kWakeToken;
+    ::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wake_fd_, &ev);
+}
+
+ChildWatcher::~ChildWatcher() {
+    for (auto &[id, fd] : pidfds_) ::close(fd);
+    if (wake_fd_ >= 0) ::close(wake_fd_);
+    if (epoll_fd_ >= 0) ::close(epoll_fd_);
+}
+
+void ChildWatcher::watch(int job_id, pid_t pid, int pidfd) {
+    if (pidfd < 0) pidfd = open_pidfd(pid);
+    std::lock_guard lk(mu_);
+    if (pidfd >= 0 && epoll_fd_ >= 0) {
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.u64 = static_cast<std::uint32_t>(job_id);
+        if (::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, pidfd, &ev) == 0) {
+            pidfds_[job_id] = pidfd;
+            return;
+        }
+        ::close(pidfd);
+    }
+    NANO_LOG(DEBUG, "pidfd unavailable, polling job id=%d pid=%d", job_id, pid);
+    polled_[job_id] = pid;
+}
+
+void ChildWatcher::unwatch(int job_id) {
+    std::lock_guard lk(mu_);
+    if (auto it = pidfds_.find(job_id); it != pidfds_.end()) {
+        ::epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, it->second, nullptr);
+        ::close(it->second);
+        pidfds_.erase(it);
+    }
+    polled_.erase(job_id);
+}
+
+void ChildWatcher::wait(int timeout_ms, std::vector<int> &ready) {
+    bool has_polled = false;
+    {
+        std::lock_guard lk(mu_);
+        has_polled = !polled_.empty();
+    }
+    if (has_polled && (timeout_ms < 0 || timeout_ms > kFallbackPollMs)) timeout_ms = kFallbackPollMs;
+
+    epoll_event events[64];
+    int n = epoll_fd_ >= 0 ? ::epoll_wait(epoll_fd_, events, 64, timeout_ms) : 0;
+    if (epoll_fd_ < 0 && timeout_ms > 0) ::usleep(static_cast<useconds_t>(timeout_ms) * 1000);
+    for (int i = 0; i < n; ++i) {
+        if (events[i].data.u64 == kWakeToken) {
+            std::uint64_t v = 0;
+            [[maybe_unused]] auto r = ::read(wake_fd_, &v, sizeof(v));
+            continue;
+        }
+        ready.push_back(static_cast<int>(events[i].data.u64));
+    }
+
+    std::lock_guard lk(mu_);
+    for (auto &[id, pid] : polled_) ready.push_back(id);
+}
+
+void ChildWatcher::wake() {
+    std::uint64_t one = 1;
+    [[maybe_unused]] auto r = ::write(wake_fd_, &one, sizeof(one));
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <mutex>
+#include <sys/types.h>
+#include <unordered_map>
+#include <vector>
+
+// 子进程退出通知：每个任务一个 pidfd 注册到 epoll，进程退出即可读。
+// 内核不支持 pidfd_open 时回退为周期性返回全部候选，由调用方 waitpid(WNOHANG) 轮询。
+class ChildWatcher {
+public:
+    static constexpr int kFallbackPollMs = 100;
+
+    ChildWatcher();
+    ~ChildWatcher();
+    ChildWatcher(const ChildWatcher &) = delete;
+    ChildWatcher &operator=(const ChildWatcher &) = delete;
+
+    // pidfd >= 0 时接管该 fd，否则内部调用 pidfd_open
+    void watch(int job_id, pid_t pid, int pidfd = -1);
+    void unwatch(int job_id);
+    // 等待至多 timeout_ms（<0 表示无限），把可能已退出的 job id 追加到 ready
+    void wait(int timeout_ms, std::vector<int> &ready);
+    // 唤醒阻塞中的 wait()
+    void wake();
+
+private:
+    int epoll_fd_{-1};
+    int wake_fd_{-1};
+    std::mutex mu_;
+    std::unordered_map<int, int> pidfds_;   // job id -> pidfd
+    std::unordered_map<int, pid_t> polled_; // 无 pidfd 的回退集合
+};
@@ -0,0 +1,159 @@
+#include "cpu_topology.h"
+
+#include <algorithm>
+#include <charconv>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <sched.h>
+#include <tuple>
+#include <utility>
+
+namespace {
+std::optional<std::string> read_text(const std::string &path) {
+    std::ifstream ifs(path);
+    if (!ifs) return std::nullopt;
+    std::string s;
+    std::getline(ifs, s);
+    return s;
+}
+
+int read_int(const std::string &path, int fallback) {
+    auto s = read_text(path);
+    int v = fallback;
+    if (s && std::from_chars(s->data(), s->data() + s->size(), v).ec != std::errc{}) v = fallback;
+    return v;
+}
+
+std::string_view trim(std::string_view s) {
+    while (!s.empty() && (s.front() == ' ' || s.front() == '\t')) s.remove_prefix(1);
+    while (!s.empty() && (s.back() == ' ' || s.back() == '\n' || s.back() == '\t')) s.remove_suffix(1);
+    return s;
+}
+}
+
+std::vector<int> parse_cpu_list(std::string_view text) {
+    std::vector<int> out;
+    text = trim(text);
+    while (!text.empty()) {
+        auto comma = text.find(',');
+        auto item = text.substr(0, comma);
+        text = comma == std::string_view::npos ? std::string_view{} : text.substr(comma + 1);
+        int lo = 0, hi = 0;
+        auto res = std::from_chars(item.data(), item.data() + item.size(), lo);
+        if (res.ec != std::errc{} || lo < 0) return {};
+        hi = lo;
+        if (res.ptr != item.data() + item.size()) {
+            if (*res.ptr != '-') return {};
+            auto res2 = std::from_chars(res.ptr + 1, item.data() + item.size(), hi);
+            if (res2.ec != std::errc{} || res2.ptr != item.data() + item.size() || hi < lo) return {};
+        }
+        for (int c = lo; c <= hi; ++c) out.push_back(c);
+    }
+    std::sort(out.begin(), out.end());
+    out.erase(std::unique(out.begin(), out.end()), out.end());
+    return out;
+}
+
+std::string format_cpu_list(std::span<const int> cpus) {
+    std::vector<int> sorted(cpus.begin(), cpus.end());
+    std::sort(sorted.begin(), sorted.end());
+    sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+    std::string out;
+    for (std::size_t i = 0; i < sorted.size();) {
+        std::size_t j = i;
+        while (j + 1 < sorted.size() && sorted[j + 1] == sorted[j] + 1) ++j;
+        if (!out.empty()) out += ',';
+        out += std::to_string(sorted[i]);
+        if (j > i) out += '-' + std::to_string(sorted[j]);
+        i = j + 1;
+    }
+    return out;
+}
+
+int CpuTopology::cpu_count() const {
+    int n = 0;
+    for (const auto &node : nodes) n += node.cpu_count;
+    return n;
+}
+
+int CpuTopology::max_cpu_id() const {
+    int m = -1;
+    for (const auto &core : cores) {
+        if (!core.cpus.empty()) m = std::max(m, core.cpus.back());
+    }
+    return m;
+}
+
+std::optional<CpuTopology> CpuTopology::detect(const std::string &root, bool respect_affinity) {
+    auto online_text = read_text(root + "/cpu/online");
+    if (!online_text) return std::nullopt;
+    auto online = parse_cpu_list(*online_text);
+    if (respect_affinity) {
+        cpu_set_t mask;
+        CPU_ZERO(&mask);
+        if (::sched_getaffinity(0, sizeof(mask), &mask) == 0) {
+            std::erase_if(online, [&](int c) { return c >= CPU_SETSIZE || !CPU_ISSET(c, &mask); });
+        }
+    }
+    if (online.empty()) return std::nullopt;
+
+    // CPU → 内核节点号
+    std::map<int, int> node_of;
+    std::error_code ec;
+    for (const auto &entry : std::filesystem::directory_iterator(root + "/node", ec)) {
+        auto name = entry.path().filename().string();
+        int id = 0;
+        if (!name.starts_with("node") || std::from_chars(name.data() + 4, name.data() + name.size(), id).ec != std::errc{}) continue;
+        auto list = read_text(entry.path().string() + "/cpulist");
+        if (!list) continue;
+        for (int c : parse_cpu_list(*list)) node_of[c] = id;
+    }
+
+    // (节点号, 插槽, core_id) → 逻辑 CPU；同一 core_id 在不同插槽上各是一个物理核
+    std::map<int, int> socket_of_node;
+    std::map<std::tuple<int, int, int>, std::vector<int>> core_cpus;
+    for (int c : online) {
+        auto base = root + "/cpu/cpu" + std::to_string(c) + "/topology/";
+        int socket = read_int(base + "physical_package_id", 0);
+        int core_id = read_int(base + "core_id", c);
+        auto it = node_of.find(c);
+        int node = it == node_of.end() ? 0 : it->second;
+        socket_of_node.try_emplace(node, socket);
+        core_cpus[{node, socket, core_id}].push_back(c);
+    }
+
+    CpuTopology topo;
+    std::map<int, int> node_index;
+    for (const auto &[id, socket] : socket_of_node) {
+        node_index[id] = static_cast<int>(topo.nodes.size());
+        topo.nodes.push_back(Node{id, socket, {}, 0});
+    }
+    std::vector<std::pair<int, std::vector<int>>> ordered; // (节点下标, CPU)，按首个 CPU 排序
+    for (auto &[key, cpus] : core_cpus) ordered.emplace_back(node_index[std::get<0>(key)], std::move(cpus));
+    std::sort(ordered.begin(), ordered.end(), [](const auto &a, const auto &b) { return a.second.front() < b.second.front(); });
+    for (auto &[node, cpus] : ordered) {
+        topo.nodes[node].cores.push_back(static_cast<int>(topo.cores.size()));
+        topo.nodes[node].cpu_count += static_cast<int>(cpus.size());
+        topo.cores.push_back(Core{node, std::move(cpus)});
+    }
+    return topo;
+}
+
+CpuTopology CpuTopology::uniform(int sockets, int nodes_per_socket, int cores_per_node, int threads_per_core) {
+    CpuTopology topo;
+    int cpu = 0;
+    for (int s = 0; s < sockets; ++s) {
+        for (int n = 0; n < nodes_per_socket; ++n) {
+            Node node{static_cast<int>(topo.nodes.size()), s, {}, cores_per_node * threads_per_core};
+            for (int c = 0; c < cores_per_node; ++c) {
+                Core core{node.id, {}};
+                for (int t = 0; t < threads_per_core; ++t) core.cpus.push_back(cpu++);
+                node.cores.push_back(static_cast<int>(topo.cores.size()));
+                topo.cores.push_back(std::move(core));
+            }
+            topo.nodes.push_back(std::move(node));
+        }
+    }
+    return topo;
+}
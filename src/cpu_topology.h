@@ -0,0 +1,40 @@
+#pragma once
+
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// 从 sysfs 读出的 CPU 拓扑：插槽 → NUMA 节点 → 物理核 → SMT 兄弟线程。
+// 只包含在线且在本进程亲和性掩码内的逻辑 CPU。
+struct CpuTopology {
+    struct Core {
+        int node{0};           // nodes 下标
+        std::vector<int> cpus; // 逻辑 CPU 编号（SMT 兄弟），升序
+    };
+    struct Node {
+        int id{0};              // 内核节点号，写入 cpuset.mems
+        int socket{0};          // physical_package_id
+        std::vector<int> cores; // cores 下标，按首个 CPU 编号升序
+        int cpu_count{0};
+    };
+
+    std::vector<Core> cores;
+    std::vector<Node> nodes;
+
+    int cpu_count() const;
+    // 最大的逻辑 CPU 编号；无 CPU 时为 -1
+    int max_cpu_id() const;
+
+    // root 通常为 /sys/devices/system；读不到 cpu/online 时返回 nullopt。
+    // 没有 node 目录（未开启 NUMA）时所有 CPU 归入节点 0
+    static std::optional<CpuTopology> detect(const std::string &root = "/sys/devices/system", bool respect_affinity = true);
+    // 规则拓扑（测试与基准用），CPU 编号按插槽、节点、核、线程依次递增
+    static CpuTopology uniform(int sockets, int nodes_per_socket, int cores_per_node, int threads_per_core);
+};
+
+// 内核 cpulist 格式："0-3,8,10-11"；格式错误返回空
+std::vector<int> parse_cpu_list(std::string_view text);
+// 升序去重后压缩为区间
+std::string format_cpu_list(std::span<const int> cpus);
@@ -0,0 +1,230 @@
+#include "cron_expression.h"
+
+#include <array>
+#include <bit>
+#include <vector>
+
+namespace {
+using namespace std::chrono;
+
+constexpr std::array<std::string_view, 12> kMonthNames{"JAN", "FEB", "MAR", "APR", "MAY", "JUN",
+                                                       "JUL", "AUG", "SEP", "OCT", "NOV", "DEC"};
+constexpr std::array<std::string_view, 7> kDayNames{"SUN", "MON", "TUE", "WED", "THU", "FRI", "SAT"};
+
+std::string_view trim(std::string_view s) {
+    while (!s.empty() && (s.front() == ' ' || s.front() == '\t')) s.remove_prefix(1);
+    while (!s.empty() && (s.back() == ' ' || s.back() == '\t')) s.remove_suffix(1);
+    return s;
+}
+
+std::vector<std::string_view> split_fields(std::string_view s) {
+    std::vector<std::string_view> out;
+    std::size_t i = 0;
+    while (i < s.size()) {
+        while (i < s.size() && (s[i] == ' ' || s[i] == '\t')) ++i;
+        std::size_t begin = i;
+        while (i < s.size() && s[i] != ' ' && s[i] != '\t') ++i;
+        if (i > begin) out.push_back(s.substr(begin, i - begin));
+    }
+    return out;
+}
+
+bool parse_number(std::string_view s, int &out) {
+    if (s.empty() || s.size() > 9) return false;
+    out = 0;
+    for (char c : s) {
+        if (c < '0' || c > '9') return false;
+        out = out * 10 + (c - '0');
+    }
+    return true;
+}
+
+// 数字或三字母名称（大小写不敏感），名称按 base 起编号
+template <std::size_t N>
+bool parse_value(std::string_view s, const std::array<std::string_view, N> *names, int base, int &out) {
+    if (parse_number(s, out)) return true;
+    if (!names || s.size() != 3) return false;
+    for (std::size_t i = 0; i < N; ++i) {
+        bool eq = true;
+        for (int k = 0; k < 3; ++k) {
+            char c = s[k];
+            if (c >= 'a' && c <= 'z') c = static_cast<char>(c - 'a' + 'A');
+            if (c != (*names)[i][k]) eq = false;
+        }
+        if (eq) {
+            out = static_cast<int>(i) + base;
+            return true;
+        }
+    }
+    return false;
+}
+
+// 逗号分隔的 *、?、N、N-M 及可选 /步长；取值范围 [lo, hi]
+template <std::size_t N = 1>
+bool parse_field(std::string_view field, int lo, int hi, std::uint64_t &mask,
+                 const std::array<std::string_view, N> *names = nullptr, int name_base = 0) {
+    mask = 0;
+    while (true) {
+        auto comma = field.find(',');
+        std::string_view item = field.substr(0, comma);
+        if (item.empty()) return false;
+        int step = 1;
+        auto slash = item.find('/');
+        if (slash != std::string_view::npos) {
+            if (!parse_number(item.substr(slash + 1), step) || step <= 0) return false;
+            item = item.substr(0, slash);
+        }
+        int a = lo, b = hi;
+        if (item != "*" && item != "?") {
+            auto dash = item.find('-');
+            if (!parse_value(item.substr(0, dash), names, name_base, a)) return false;
+            if (dash != std::string_view::npos) {
+                if (!parse_value(item.substr(dash + 1), names, name_base, b)) return false;
+            } else if (slash == std::string_view::npos) {
+                b = a;
+            }
+        }
+        if (a < lo || b > hi || a > b) return false;
+        for (int v = a; v <= b; v += step) mask |= std::uint64_t{1} << v;
+        if (comma == std::string_view::npos) return true;
+        field.remove_prefix(comma + 1);
+    }
+}
+
+int next_bit(std::uint64_t mask, int from) {
+    if (from >= 64) return -1;
+    std::uint64_t m = mask & (~std::uint64_t{0} << from);
+    return m ? std::countr_zero(m) : -1;
+}
+} // namespace
+
+std::optional<CronExpression> CronExpression::parse(std::string_view expr) {
+    CronExpression ce;
+    ce.raw = std::string(expr);
+    std::string_view s = trim(expr);
+
+    for (std::string_view prefix : {"CRON_TZ=", "TZ="}) {
+        if (s.substr(0, prefix.size()) != prefix) continue;
+        s.remove_prefix(prefix.size());
+        auto end = s.find_first_of(" \t");
+        if (end == std::string_view::npos) return std::nullopt;
+        ce.tz = TimeZone::load(s.substr(0, end));
+        if (!ce.tz) return std::nullopt;
+        s = trim(s.substr(end));
+        break;
+    }
+    if (!ce.tz) ce.tz = TimeZone::load("Local");
+
+    if (s.substr(0, 6) == "@every") {
+        std::string_view arg = trim(s.substr(6));
+        if (arg.empty()) return std::nullopt;
+        int unit = 1;
+        switch (arg.back()) {
+        case 's': unit = 1; break;
+        case 'm': unit = 60; break;
+        case 'h': unit = 3600; break;
+        default: return std::nullopt;
+        }
+        int n = 0;
+        if (!parse_number(arg.substr(0, arg.size() - 1), n) || n <= 0) return std::nullopt;
+        ce.interval = std::chrono::seconds(static_cast<long long>(n) * unit);
+        return ce;
+    }
+    if (!s.empty() && s.front() == '@') {
+        if (s == "@yearly" || s == "@annually") s = "0 0 1 1 *";
+        else if (s == "@monthly") s = "0 0 1 * *";
+        else if (s == "@weekly") s = "0 0 * * 0";
+        else if (s == "@daily" || s == "@midnight") s = "0 0 * * *";
+        else if (s == "@hourly") s = "0 * * * *";
+        else return std::nullopt;
+    }
+
+    auto fields = split_fields(s);
+    if (fields.size() == 5) fields.insert(fields.begin(), "0");
+    if (fields.size() != 6) return std::nullopt;
+
+    std::uint64_t m = 0;
+    if (!parse_field(fields[0], 0, 59, ce.second_mask)) return std::nullopt;
+    if (!parse_field(fields[1], 0, 59, ce.minute_mask)) return std::nullopt;
+    if (!parse_field(fields[2], 0, 23, m)) return std::nullopt;
+    ce.hour_mask = static_cast<std::uint32_t>(m);
+    if (!parse_field(fields[3], 1, 31, m)) return std::nullopt;
+    ce.dom_mask = static_cast<std::uint32_t>(m);
+    if (!parse_field(fields[4], 1, 12, m, &kMonthNames, 1)) return std::nullopt;
+    ce.month_mask = static_cast<std::uint16_t>(m);
+    if (!parse_field(fields[5], 0, 7, m, &kDayNames, 0)) return std::nullopt;
+    if (m & (1u << 7)) m = (m | 1u) & 0x7F; // 7 与 0 都表示周日
+    ce.dow_mask = static_cast<std::uint8_t>(m);
+    // 与 Vixie cron 一致：以 * 或 ? 开头的日/周字段视为不受限
+    ce.dom_restricted = fields[3].front() != '*' && fields[3].front() != '?';
+    ce.dow_restricted = fields[5].front() != '*' && fields[5].front() != '?';
+    return ce;
+}
+
+bool CronExpression::day_matches(year_month_day ymd) const {
+    bool dom = (dom_mask >> static_cast<unsigned>(ymd.day())) & 1u;
+    bool dow = (dow_mask >> weekday{sys_days{ymd}}.c_encoding()) & 1u;
+    if (dom_restricted && dow_restricted) return dom || dow;
+    return dom && dow;
+}
+
+std::optional<int> CronExpression::next_time_of_day(int h, int m, int s) const {
+    for (int H = next_bit(hour_mask, h); H >= 0; H = next_bit(hour_mask, H + 1)) {
+        for (int M = next_bit(minute_mask, H == h ? m : 0); M >= 0; M = next_bit(minute_mask, M + 1)) {
+            int S = next_bit(second_mask, H == h && M == m ? s : 0);
+            if (S >= 0) return H * 3600 + M * 60 + S;
+        }
+    }
+    return std::nullopt;
+}
+
+std::optional<sys_seconds> CronExpression::next_local(sys_seconds after) const {
+    sys_seconds t = after + std::chrono::seconds{1};
+    const sys_seconds limit = t + days{366 * 5};
+    while (t < limit) {
+        sys_days d = floor<days>(t);
+        year_month_day ymd{d};
+        if (!((month_mask >> static_cast<unsigned>(ymd.month())) & 1u)) {
+            // 直接跳到下个月 1 日
+            year_month next = ymd.year() / ymd.month() + std::chrono::months{1};
+            t = sys_days{next / 1};
+            continue;
+        }
+        if (day_matches(ymd)) {
+            auto tod = (t - d).count();
+            if (auto sec = next_time_of_day(static_cast<int>(tod / 3600), static_cast<int>(tod / 60 % 60),
+                                            static_cast<int>(tod % 60))) {
+                return d + std::chrono::seconds{*sec};
+            }
+        }
+        t = d + days{1};
+    }
+    return std::nullopt;
+}
+
+system_clock::time_point CronExpression::next_run(system_clock::time_point from) const {
+    if (interval.count() > 0) return from + interval;
+    const auto &zone = tz ? tz : TimeZone::utc();
+    const sys_seconds from_s = floor<std::chrono::seconds>(from);
+    sys_seconds local = zone->to_local(from_s);
+    // 夏令时拨快跳过的本地时刻不触发；回拨重复的一小时内不重复触发
+    for (int guard = 0; guard < 8; ++guard) {
+        auto cand = next_local(local);
+        if (!cand) break;
+        local = *cand;
+        auto utc = zone->to_utc(local);
+        if (!utc) {
+            // 落在拨快的空档内：从空档结束处继续找
+            local = zone->to_local(local - zone->offset_at(local - days{1})) - std::chrono::seconds{1};
+            continue;
+        }
+        if (*utc <= from_s) {
+            // 回拨后的第二次出现：按当前偏移换算
+            auto later = local - zone->offset_at(from_s);
+            if (later <= from_s || zone->to_local(later) != local) continue;
+            utc = later;
+        }
+        return time_point_cast<system_clock::duration>(*utc);
+    }
+    return system_clock::time_point::max();
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "time_zone.h"
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+
+// cron 表达式，解析时一次性编译为各字段的位图（第 i 位表示取值 i 命中）。支持：
+//   5 字段 "分 时 日 月 周" 与 6 字段 "秒 分 时 日 月 周"；每个字段可为 *、?、N、N-M、*/S、N-M/S、N/S
+//   及其逗号列表，月与周可用 JAN..DEC / SUN..SAT，周的 7 等同 0；
+//   @yearly/@annually/@monthly/@weekly/@daily/@midnight/@hourly 与 @every <n>s|m|h；
+//   前缀 "CRON_TZ=<zone> " 或 "TZ=<zone> " 指定时区（默认本机时区）。
+// 日与周都受限时按 Vixie cron 语义取并集。
+struct CronExpression {
+    std::string raw;
+    std::chrono::seconds interval{0}; // @every 间隔；非零时忽略下面的字段
+    std::uint64_t second_mask{0};
+    std::uint64_t minute_mask{0};
+    std::uint32_t hour_mask{0};
+    std::uint32_t dom_mask{0};   // 第 1..31 位
+    std::uint16_t month_mask{0}; // 第 1..12 位
+    std::uint8_t dow_mask{0};    // 第 0..6 位，0 为周日
+    bool dom_restricted{false};
+    bool dow_restricted{false};
+    std::shared_ptr<const TimeZone> tz;
+
+    static std::optional<CronExpression> parse(std::string_view expr);
+    // 严格晚于 from 的下一次触发时间（秒级）；五年内都不命中（如 2 月 30 日）时返回 time_point::max()
+    std::chrono::system_clock::time_point next_run(std::chrono::system_clock::time_point from) const;
+
+private:
+    bool day_matches(std::chrono::year_month_day ymd) const;
+    // 同一天内 (h, m, s) 及之后第一个命中的时刻（当天秒数）
+    std::optional<int> next_time_of_day(int h, int m, int s) const;
+    // 本地（按 UTC 解读的墙钟）时刻 after 之后第一个命中的本地时刻
+    std::optional<std::chrono::sys_seconds> next_local(std::chrono::sys_seconds after) const;
+};
@@ -1,40 +1,147 @@
 #include "cron_scheduler.h"
 
-#include <chrono>
-#include <regex>
-
-std::optional<CronExpression> CronExpression::parse(std::string_view expr) {
-    if (expr.rfind("@every", 0) == 0) {
-        std::regex re(R"(@every\s+([0-9]+)s)");
-        std::cmatch m;
-        std::string s(expr);
-        if (std::regex_match(s.c_str(), m, re)) {
-            CronExpression ce;
-            ce.raw = std::string(expr);
-            ce.interval = std::chrono::seconds(std::stoll(m[1]));
-            return ce;
-        }
-    }
-    return std::nullopt; // 简化：其他表达式暂未支持
+#include "NanoLogCpp17.h"
+
+#include <algorithm>
+
+using namespace NanoLog::LogLevels;
+
+namespace {
+// 模板的抖动相位：命令的 FNV-1a 与模板编号混合后取 [0, 1)，重启后只要注册顺序不变就保持一致
+double template_phase(const std::string &cmd, int idx) {
+    std::uint64_t h = 1469598103934665603ull;
+    for (unsigned char c : cmd) h = (h ^ c) * 1099511628211ull;
+    std::uint64_t x = h ^ (static_cast<std::uint64_t>(idx) * 0x9E3779B97F4A7C15ull);
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    x ^= x >> 31;
+    return static_cast<double>(x >> 11) * 0x1.0p-53;
+}
+}
+
+CronScheduler::Clock::time_point CronScheduler::fire_time(const CronTemplate &tpl, const State &st,
+                                                          Clock::time_point planned, Clock::time_point following) const {
+    if (planned == Clock::time_point::max()) return planned;
+    Clock::duration window = tpl.jitter;
+    if (tpl.splay && following != Clock::time_point::max()) window = following - planned;
+    if (window <= Clock::duration::zero()) return planned;
+    return planned + std::chrono::duration_cast<Clock::duration>(window * st.phase);
 }
 
-std::chrono::system_clock::time_point CronExpression::next_run(std::chrono::system_clock::time_point from) const {
-    return from + interval;
+void CronScheduler::schedule_locked(int idx, Clock::time_point planned) {
+    auto &tpl = templates_[idx];
+    tpl.next_run = planned;
+    if (!tpl.enabled || planned == Clock::time_point::max()) return;
+    auto following = tpl.splay ? tpl.cron.next_run(planned) : Clock::time_point::max();
+    heap_.push({fire_time(tpl, states_[idx], planned, following), idx});
 }
 
-void CronScheduler::add_template(const CronTemplate &tpl) {
+int CronScheduler::add_template(const CronTemplate &tpl) {
     std::lock_guard lk(mu_);
+    int idx = static_cast<int>(templates_.size());
     templates_.push_back(tpl);
+    states_.push_back(State{template_phase(tpl.spec.cmd, idx), 0});
+    auto planned = tpl.next_run == Clock::time_point{} ? tpl.cron.next_run(Clock::now()) : tpl.next_run;
+    schedule_locked(idx, planned);
+    changed_ = true;
+    cv_.notify_one();
+    return idx;
 }
 
-void CronScheduler::tick(const SubmitCallback &cb) {
-    auto now = std::chrono::system_clock::now();
-    std::lock_guard lk(mu_);
-    for (auto &tpl : templates_) {
-        if (!tpl.enabled) continue;
-        if (now >= tpl.next_run) {
-            cb(tpl.spec);
-            tpl.next_run = tpl.cron.next_run(now);
+CronScheduler::Clock::time_point CronScheduler::tick(Clock::time_point now, const SubmitCallback &cb) {
+    struct Due {
+        int idx;
+        int count;
+        JobSpec spec;
+    };
+    std::vector<Due> due_list;
+    Clock::time_point next = Clock::time_point::max();
+    {
+        std::lock_guard lk(mu_);
+        while (!heap_.empty() && heap_.top().at <= now) {
+            int idx = heap_.top().idx;
+            heap_.pop();
+            auto &tpl = templates_[idx];
+            auto &st = states_[idx];
+
+            // 数出所有实际触发时间已到的计划时间，planned 停在第一个未到期的上
+            auto planned = tpl.next_run;
+            auto following = tpl.cron.next_run(planned);
+            int due = 0;
+            Clock::time_point last_fire = planned;
+            while (due < kMaxCatchUp) {
+                auto at = fire_time(tpl, st, planned, following);
+                if (at > now) break;
+                ++due;
+                last_fire = at;
+                planned = following;
+                if (planned == Clock::time_point::max()) break;
+                following = tpl.cron.next_run(planned);
+            }
+            if (fire_time(tpl, st, planned, following) <= now) planned = tpl.cron.next_run(now);
+
+            int fire = 0;
+            switch (tpl.catch_up) {
+            case CronCatchUp::Skip: fire = now - last_fire <= kMisfireGrace ? 1 : 0; break;
+            case CronCatchUp::FireOnce: fire = due > 0 ? 1 : 0; break;
+            case CronCatchUp::FireAll: fire = due; break;
+            }
+            if (due > fire) {
+                stats_.missed += due - fire;
+                NANO_LOG(WARNING, "cron template %d missed %d run(s), catch_up=%s fired=%d", idx, due, to_string(tpl.catch_up).c_str(), fire);
+            }
+            if (tpl.max_concurrent > 0 && st.active + fire > tpl.max_concurrent) {
+                int allowed = std::max(0, tpl.max_concurrent - st.active);
+                stats_.throttled += fire - allowed;
+                NANO_LOG(NOTICE, "cron template %d throttled %d run(s), active=%d max=%d", idx, fire - allowed, st.active, tpl.max_concurrent);
+                fire = allowed;
+            }
+            st.active += fire;
+            stats_.fired += fire;
+            if (fire > 0) due_list.push_back({idx, fire, tpl.spec});
+            schedule_locked(idx, planned);
         }
+        if (!heap_.empty()) next = heap_.top().at;
+    }
+    for (const auto &d : due_list) {
+        for (int i = 0; i < d.count; ++i) {
+            if (cb(d.idx, d.spec) < 0) instance_finished(d.idx);
+        }
+    }
+    return next;
+}
+
+void CronScheduler::instance_finished(int tpl) {
+    std::lock_guard lk(mu_);
+    if (tpl < 0 || tpl >= static_cast<int>(states_.size())) return;
+    if (states_[tpl].active > 0) --states_[tpl].active;
+}
+
+void CronScheduler::run(const SubmitCallback &cb) {
+    while (true) {
+        auto next = tick(Clock::now(), cb);
+        std::unique_lock lk(mu_);
+        auto wake = [this] { return stopped_ || changed_; };
+        // system_clock 的绝对时间等待：墙钟向前跳变时按新时间醒来
+        if (next == Clock::time_point::max()) cv_.wait(lk, wake);
+        else cv_.wait_until(lk, next, wake);
+        if (stopped_) return;
+        changed_ = false;
     }
 }
+
+void CronScheduler::stop() {
+    std::lock_guard lk(mu_);
+    stopped_ = true;
+    cv_.notify_all();
+}
+
+std::size_t CronScheduler::size() const {
+    std::lock_guard lk(mu_);
+    return templates_.size();
+}
+
+CronScheduler::Stats CronScheduler::stats() const {
+    std::lock_guard lk(mu_);
+    return stats_;
+}
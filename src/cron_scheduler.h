@@ -1,20 +1,68 @@
 #pragma once
 
 #include "job.h"
+#include <condition_variable>
 #include <functional>
 #include <mutex>
 #include <optional>
+#include <queue>
 #include <vector>
 
+// cron 模板按下次触发时间放进最小堆：每轮只弹出到期的模板，代价 O(到期数 · log 模板数)，
+// 与模板总数无关；run() 睡到堆顶时间（或有新模板、stop()）为止，不做周期轮询。
+// 堆里存的是加了抖动后的实际触发时间，模板里的 next_run 仍是计划时间。
 class CronScheduler {
 public:
-    using SubmitCallback = std::function<void(const JobSpec &)>;
+    // 提交一次触发，返回任务 id；<0 表示被拒绝（立即归还并发名额）
+    using SubmitCallback = std::function<int(int tpl, const JobSpec &)>;
+    using Clock = std::chrono::system_clock;
 
-    void add_template(const CronTemplate &tpl);
-    void tick(const SubmitCallback &cb);
+    // 晚于实际触发时间超过该值即视为错过
+    static constexpr std::chrono::milliseconds kMisfireGrace{1000};
+    // FireAll 单次最多补的次数，更早的错过按 Skip 处理
+    static constexpr int kMaxCatchUp = 64;
+
+    struct Stats {
+        long long fired{0};
+        long long missed{0};    // 按补跑策略丢弃的触发
+        long long throttled{0}; // 因 max_concurrent 跳过的触发
+    };
+
+    // 返回模板编号；tpl.next_run 未设置时从当前时间起算下一次触发
+    int add_template(const CronTemplate &tpl);
+    // 触发所有到期的模板（回调在锁外执行），返回下一次最早触发时间；无模板时为 time_point::max()
+    Clock::time_point tick(Clock::time_point now, const SubmitCallback &cb);
+    Clock::time_point tick(const SubmitCallback &cb) { return tick(Clock::now(), cb); }
+    // 模板的一个实例结束（成功、失败或启动失败），归还并发名额
+    void instance_finished(int tpl);
+    // 循环触发并等待，直到 stop()
+    void run(const SubmitCallback &cb);
+    void stop();
+    std::size_t size() const;
+    Stats stats() const;
 
 private:
+    struct Entry {
+        Clock::time_point at;
+        int idx;
+        bool operator>(const Entry &o) const { return at != o.at ? at > o.at : idx > o.idx; }
+    };
+    struct State {
+        double phase{0}; // [0, 1)，由模板编号与命令确定
+        int active{0};   // 已提交且未结束的实例数
+    };
+
+    // 计划时间 planned 的实际触发时间；following 为其后一次计划时间（splay 的窗口）
+    Clock::time_point fire_time(const CronTemplate &tpl, const State &st, Clock::time_point planned,
+                                Clock::time_point following) const;
+    void schedule_locked(int idx, Clock::time_point planned);
+
+    mutable std::mutex mu_;
+    std::condition_variable cv_;
     std::vector<CronTemplate> templates_;
-    std::mutex mu_;
+    std::vector<State> states_;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<>> heap_;
+    Stats stats_;
+    bool changed_{false}; // 有新模板，等待中的 run() 需要重新计算睡眠时间
+    bool stopped_{false};
 };
-
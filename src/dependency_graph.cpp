@@ -0,0 +1,106 @@
+#include "dependency_graph.h"
+
+#include <algorithm>
+#include <charconv>
+
+namespace {
+constexpr std::pair<std::string_view, DependencyCondition> kConditions[] = {
+    {"afterok", DependencyCondition::Success},
+    {"afterany", DependencyCondition::AnyFinish},
+    {"afternotok", DependencyCondition::Failure},
+};
+}
+
+std::optional<std::vector<JobDependency>> parse_dependencies(std::string_view text) {
+    std::vector<JobDependency> out;
+    while (!text.empty()) {
+        auto comma = text.find(',');
+        auto item = text.substr(0, comma);
+        text = comma == std::string_view::npos ? std::string_view{} : text.substr(comma + 1);
+        auto colon = item.find(':');
+        if (colon == std::string_view::npos) return std::nullopt;
+        auto name = item.substr(0, colon);
+        auto num = item.substr(colon + 1);
+        auto cond = std::find_if(std::begin(kConditions), std::end(kConditions), [&](const auto &c) { return c.first == name; });
+        if (cond == std::end(kConditions)) return std::nullopt;
+        int id = 0;
+        auto res = std::from_chars(num.data(), num.data() + num.size(), id);
+        if (res.ec != std::errc{} || res.ptr != num.data() + num.size() || id <= 0) return std::nullopt;
+        out.push_back(JobDependency{id, cond->second});
+    }
+    return out;
+}
+
+std::string format_dependencies(std::span<const JobDependency> deps) {
+    std::string out;
+    for (const auto &d : deps) {
+        if (!out.empty()) out += ',';
+        for (const auto &[name, cond] : kConditions) {
+            if (cond == d.condition) out += name;
+        }
+        out += ':';
+        out += std::to_string(d.job_id);
+    }
+    return out;
+}
+
+bool dependency_satisfied(DependencyCondition cond, JobStatus status) {
+    switch (cond) {
+    case DependencyCondition::Success: return status == JobStatus::Succeeded;
+    case DependencyCondition::AnyFinish: return true;
+    case DependencyCondition::Failure: return status == JobStatus::Failed || status == JobStatus::Timeout;
+    }
+    return false;
+}
+
+void DependencyGraph::set_restored(int watermark, std::vector<std::pair<int, int>> restored) {
+    restore_watermark_ = watermark;
+    restored_ = std::move(restored);
+    std::sort(restored_.begin(), restored_.end());
+}
+
+bool DependencyGraph::finished_before_restart(int id) const {
+    if (id <= 0 || id >= restore_watermark_) return false;
+    // 最后一个 first <= id 的区间
+    auto it = std::upper_bound(restored_.begin(), restored_.end(), id, [](int v, const auto &r) { return v < r.first; });
+    return it == restored_.begin() || std::prev(it)->second < id;
+}
+
+std::optional<JobStatus> DependencyGraph::final_status(int id) const {
+    if (id <= 0 || id >= static_cast<int>(final_.size()) || final_[id] == 0) return std::nullopt;
+    return static_cast<JobStatus>(final_[id] - 1);
+}
+
+void DependencyGraph::hold(Job job, std::span<const JobDependency> parents) {
+    int id = job.id;
+    for (const auto &p : parents) children_[p.job_id].push_back(Edge{id, p.condition});
+    held_.insert_or_assign(id, Held{std::move(job), static_cast<int>(parents.size())});
+}
+
+void DependencyGraph::finish(int id, JobStatus status, std::vector<Job> &ready, std::vector<Job> &cancelled) {
+    work_.clear();
+    work_.emplace_back(id, status);
+    while (!work_.empty()) {
+        auto [parent, st] = work_.back();
+        work_.pop_back();
+        if (parent <= 0) continue;
+        if (parent >= static_cast<int>(final_.size())) final_.resize(static_cast<std::size_t>(parent) + 1, 0);
+        final_[parent] = static_cast<std::uint8_t>(1 + static_cast<int>(st));
+
+        auto node = children_.extract(parent);
+        if (node.empty()) continue;
+        for (const auto &e : node.mapped()) {
+            auto it = held_.find(e.child);
+            if (it == held_.end()) continue; // 已被另一个父任务级联取消
+            if (dependency_satisfied(e.condition, st)) {
+                if (--it->second.unmet > 0) continue;
+                ready.push_back(std::move(it->second.job));
+            } else {
+                it->second.job.status = JobStatus::Cancelled;
+                cancelled.push_back(std::move(it->second.job));
+                work_.emplace_back(e.child, JobStatus::Cancelled);
+            }
+            held_.erase(it);
+        }
+    }
+}
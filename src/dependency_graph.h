@@ -0,0 +1,59 @@
+#pragma once
+
+#include "job.h"
+
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// "afterok:12,afterany:13,afternotok:14"：id 须为正数
+std::optional<std::vector<JobDependency>> parse_dependencies(std::string_view text);
+std::string format_dependencies(std::span<const JobDependency> deps);
+// 父任务以 status 结束时条件是否满足。取消只满足 AnyFinish
+bool dependency_satisfied(DependencyCondition cond, JobStatus status);
+
+// 等待依赖的任务（入度计数）与反向边（父 → 子）。
+// 父任务结束时只遍历它自己的出边：满足的子任务计数减一，减到 0 即可派发；
+// 条件再也无法满足的子任务被取消，并沿出边级联取消其后代。
+// 同时按 id 记录本进程内已结束任务的终态（每个 id 一字节），供之后提交的任务判断父任务是否已结束。
+// 非线程安全，由调用方加锁。
+class DependencyGraph {
+public:
+    // 重启恢复：id < watermark 且不在 restored 的任一闭区间 [first, last] 中的任务在重启前已经结束，
+    // 终态须向持久化查询。数组任务以一个区间覆盖自身与全部下标
+    void set_restored(int watermark, std::vector<std::pair<int, int>> restored);
+    bool finished_before_restart(int id) const;
+    // 本进程内已结束任务的终态；尚未结束（或重启前结束）时返回 nullopt
+    std::optional<JobStatus> final_status(int id) const;
+
+    // 登记等待依赖的任务，parents 为尚未结束的父任务（同一父任务可出现多次，各计一次）
+    void hold(Job job, std::span<const JobDependency> parents);
+    // 任务结束（含取消）：记录终态并沿出边更新子任务，计数减到 0 的移入 ready，被级联取消的移入 cancelled
+    void finish(int id, JobStatus status, std::vector<Job> &ready, std::vector<Job> &cancelled);
+
+    std::size_t held() const { return held_.size(); }
+    bool holding(int id) const { return held_.count(id) > 0; }
+
+private:
+    struct Held {
+        Job job;
+        int unmet{0};
+    };
+    struct Edge {
+        int child;
+        DependencyCondition condition;
+    };
+
+    std::unordered_map<int, Held> held_;
+    // 被级联取消的子任务留下的边不立即删除，父任务结束时跳过
+    std::unordered_map<int, std::vector<Edge>> children_;
+    std::vector<std::uint8_t> final_; // 0 未结束，否则 1 + JobStatus
+    int restore_watermark_{0};
+    std::vector<std::pair<int, int>> restored_; // 按 first 有序，互不重叠
+    std::vector<std::pair<int, JobStatus>> work_; // finish 的级联工作栈，复用
+};
@@ -0,0 +1,115 @@
+#include "fair_share_queue.h"
+
+#include <algorithm>
+#include <charconv>
+
+bool valid_queue_name(std::string_view name) {
+    if (name.empty() || name.size() > 64) return false;
+    return std::all_of(name.begin(), name.end(), [](char c) {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_' || c == '-' || c == '.';
+    });
+}
+
+std::optional<std::vector<std::pair<std::string, double>>> parse_queue_weights(std::string_view text) {
+    std::vector<std::pair<std::string, double>> out;
+    while (!text.empty()) {
+        auto comma = text.find(',');
+        auto item = text.substr(0, comma);
+        text = comma == std::string_view::npos ? std::string_view{} : text.substr(comma + 1);
+        auto eq = item.find('=');
+        if (eq == std::string_view::npos) return std::nullopt;
+        auto name = item.substr(0, eq);
+        auto num = item.substr(eq + 1);
+        double w = 0;
+        auto res = std::from_chars(num.data(), num.data() + num.size(), w);
+        if (res.ec != std::errc{} || res.ptr != num.data() + num.size() || !(w > 0)) return std::nullopt;
+        if (!valid_queue_name(name)) return std::nullopt;
+        if (std::any_of(out.begin(), out.end(), [&](const auto &e) { return e.first == name; })) return std::nullopt;
+        out.emplace_back(std::string(name), w);
+    }
+    return out;
+}
+
+FairShareQueue::FairShareQueue(bool by_priority) : by_priority_(by_priority) { capacity_.v.fill(ResourceVector::kUnlimited); }
+
+void FairShareQueue::set_capacity(const ResourceVector &capacity) { capacity_ = capacity; }
+
+int FairShareQueue::queue_id(std::string_view name) {
+    if (name.empty()) name = kDefaultQueue;
+    auto it = ids_.find(std::string(name));
+    if (it != ids_.end()) return it->second;
+    queues_.emplace_back(std::string(name), by_priority_);
+    int id = static_cast<int>(queues_.size()) - 1;
+    ids_.emplace(std::string(name), id);
+    return id;
+}
+
+void FairShareQueue::set_weight(std::string_view name, double weight) {
+    if (!(weight > 0)) return;
+    int q = queue_id(name);
+    deactivate(q);
+    queues_[q].weight = weight;
+    queues_[q].share = share_of(queues_[q]);
+    activate(q);
+}
+
+double FairShareQueue::share_of(const Queue &q) const {
+    double dominant = 0;
+    for (int d = 0; d < ResourceVector::kDims; ++d) {
+        if (capacity_[d] == ResourceVector::kUnlimited || capacity_[d] <= 0) continue;
+        dominant = std::max(dominant, static_cast<double>(q.used[d]) / static_cast<double>(capacity_[d]));
+    }
+    return dominant / q.weight;
+}
+
+void FairShareQueue::deactivate(int q) {
+    const auto &queue = queues_[q];
+    if (!queue.jobs.empty()) active_.erase(ActiveKey{queue.share, queue.served, q});
+}
+
+void FairShareQueue::activate(int q) {
+    const auto &queue = queues_[q];
+    if (!queue.jobs.empty()) active_.insert(ActiveKey{queue.share, queue.served, q});
+}
+
+int FairShareQueue::push(Job job) {
+    int q = queue_id(job.spec.queue);
+    job.queue = q;
+    auto &queue = queues_[q];
+    bool was_empty = queue.jobs.empty();
+    std::size_t before = queue.jobs.size();
+    queue.jobs.push(std::move(job));
+    size_ += queue.jobs.size() - before; // 同 id 重复入队时覆盖
+    if (was_empty) activate(q);
+    return q;
+}
+
+int FairShareQueue::front() const { return active_.empty() ? -1 : active_.begin()->queue; }
+
+Job FairShareQueue::take(int q, PendingQueue::iterator it) {
+    auto &queue = queues_[q];
+    deactivate(q);
+    Job job = queue.jobs.take(it);
+    --size_;
+    queue.used += job.demand;
+    ++queue.running;
+    queue.share = share_of(queue);
+    queue.served = ++serve_seq_;
+    activate(q);
+    return job;
+}
+
+void FairShareQueue::release(int q, const ResourceVector &demand) {
+    if (q < 0 || q >= static_cast<int>(queues_.size())) return;
+    auto &queue = queues_[q];
+    deactivate(q);
+    queue.used -= demand;
+    if (queue.running > 0) --queue.running;
+    queue.share = share_of(queue);
+    activate(q);
+}
+
+FairShareQueue::QueueStats FairShareQueue::stats(int q) const {
+    const auto &queue = queues_[q];
+    return QueueStats{queue.name, queue.weight, queue.jobs.size(), queue.running, queue.used, queue.share};
+}
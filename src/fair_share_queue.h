@@ -0,0 +1,111 @@
+#pragma once
+
+#include "job.h"
+#include "pending_queue.h"
+#include "resource_vector.h"
+
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <set>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// 提交时最多出现的不同队列名（含 --queue-weights 配置的），每个队列对应一组 Prometheus 序列
+inline constexpr std::size_t kMaxQueues = 256;
+
+// 队列名：1～64 个字母、数字、'_'、'-'、'.'（会原样出现在 Prometheus 标签里）
+bool valid_queue_name(std::string_view name);
+// "a=3,b=1.5"：权重须为正数，名称须合法且不重复
+std::optional<std::vector<std::pair<std::string, double>>> parse_queue_weights(std::string_view text);
+
+// 多队列（租户）的待调度任务。每个队列内部是一个 PendingQueue（优先级或 FIFO），
+// 队列之间按加权主导资源公平（weighted DRF）选择：
+//   份额 = max_d(队列运行中用量_d / 容量_d) / 权重，
+// 取份额最小的非空队列，同份额时取最久未被选中的（轮转）。
+// 非空队列按 (份额, 上次被选中的序号, 编号) 放在有序集合中：取队首 O(1)，
+// 入队使队列变为非空、派发、任务结束时各更新一次 O(log Q)。
+// 队列按名称在首次出现时创建，之后不删除。非线程安全，由调用方加锁。
+class FairShareQueue {
+public:
+    static constexpr const char *kDefaultQueue = "default";
+
+    struct QueueStats {
+        std::string name;
+        double weight{1.0};
+        std::size_t pending{0};
+        int running{0};
+        ResourceVector used; // 运行中任务的需求之和
+        double share{0};     // 加权主导份额
+    };
+
+    explicit FairShareQueue(bool by_priority = false);
+
+    // 各维容量（无上限的维度不参与份额），须在入队前设置
+    void set_capacity(const ResourceVector &capacity);
+    // 设置队列权重（<= 0 时忽略），队列不存在则创建
+    void set_weight(std::string_view name, double weight);
+    // 按名称查找或创建队列，空名为 kDefaultQueue
+    int queue_id(std::string_view name);
+
+    // 按 job.spec.queue 入队并把队列编号写入 job.queue，返回队列编号
+    int push(Job job);
+    // 份额最小的非空队列，全部为空时返回 -1
+    int front() const;
+    PendingQueue &queue(int q) { return queues_[q].jobs; }
+    // 取出任务并把其需求计入队列的运行中用量
+    Job take(int q, PendingQueue::iterator it);
+    // 任务结束（或启动失败）后归还用量
+    void release(int q, const ResourceVector &demand);
+
+    // 按份额从小到大遍历非空队列，fn(q, PendingQueue&) 返回 false 时停止
+    template <class Fn>
+    void for_each_active(Fn &&fn) {
+        for (const auto &e : active_) {
+            if (!fn(e.queue, queues_[e.queue].jobs)) break;
+        }
+    }
+
+    bool empty() const { return size_ == 0; }
+    std::size_t size() const { return size_; }
+    std::size_t queue_count() const { return queues_.size(); }
+    QueueStats stats(int q) const;
+
+private:
+    struct Queue {
+        Queue(std::string n, bool by_priority) : name(std::move(n)), jobs(by_priority) {}
+        std::string name;
+        double weight{1.0};
+        PendingQueue jobs;
+        ResourceVector used;
+        int running{0};
+        double share{0};
+        std::uint64_t served{0}; // 上次被选中的序号
+    };
+    struct ActiveKey {
+        double share;
+        std::uint64_t served;
+        int queue;
+        bool operator<(const ActiveKey &o) const {
+            if (share != o.share) return share < o.share;
+            if (served != o.served) return served < o.served;
+            return queue < o.queue;
+        }
+    };
+
+    double share_of(const Queue &q) const;
+    // 份额或序号变化前后调用：非空队列先移出、再按新键放回
+    void deactivate(int q);
+    void activate(int q);
+
+    bool by_priority_;
+    ResourceVector capacity_;
+    std::deque<Queue> queues_; // 扩容不移动已有队列，queue() 返回的引用一直有效
+    std::unordered_map<std::string, int> ids_;
+    std::set<ActiveKey> active_;
+    std::size_t size_{0};
+    std::uint64_t serve_seq_{0};
+};
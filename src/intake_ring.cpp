@@ -0,0 +1,46 @@
+#include "intake_ring.h"
+
+#include <bit>
+
+IntakeRing::IntakeRing(std::size_t capacity) {
+    std::size_t cap = std::bit_ceil(capacity < 2 ? std::size_t{2} : capacity);
+    slots_ = std::make_unique<Slot[]>(cap);
+    mask_ = cap - 1;
+    for (std::size_t i = 0; i < cap; ++i) slots_[i].seq.store(i, std::memory_order_relaxed);
+}
+
+bool IntakeRing::try_push(Job &job) {
+    std::size_t pos = tail_.load(std::memory_order_relaxed);
+    Slot *slot = nullptr;
+    for (;;) {
+        slot = &slots_[pos & mask_];
+        std::size_t seq = slot->seq.load(std::memory_order_acquire);
+        auto diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos);
+        if (diff == 0) {
+            if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+        } else if (diff < 0) {
+            return false; // 槽位仍被上一圈占用：队列满
+        } else {
+            pos = tail_.load(std::memory_order_relaxed);
+        }
+    }
+    slot->job = std::move(job);
+    slot->seq.store(pos + 1, std::memory_order_release);
+    return true;
+}
+
+bool IntakeRing::try_pop(Job &out) {
+    std::size_t pos = head_.load(std::memory_order_relaxed);
+    Slot &slot = slots_[pos & mask_];
+    if (slot.seq.load(std::memory_order_acquire) != pos + 1) return false;
+    out = std::move(slot.job);
+    slot.seq.store(pos + mask_ + 1, std::memory_order_release);
+    head_.store(pos + 1, std::memory_order_release);
+    return true;
+}
+
+std::size_t IntakeRing::size_approx() const {
+    std::size_t head = head_.load(std::memory_order_acquire);
+    std::size_t tail = tail_.load(std::memory_order_acquire);
+    return tail > head ? tail - head : 0;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "job.h"
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+// 提交入口的有界无锁多生产者单消费者环形队列（Vyukov 序号槽算法）。
+// 生产者 CAS 抢占 tail_ 后写入槽位并以 release 发布序号；唯一的消费者（派发线程）
+// 按 head_ 顺序取出。容量向上取整为 2 的幂；队列满时 try_push 返回 false，由调用方走慢路径。
+class IntakeRing {
+public:
+    explicit IntakeRing(std::size_t capacity);
+    IntakeRing(const IntakeRing &) = delete;
+    IntakeRing &operator=(const IntakeRing &) = delete;
+
+    // 多生产者安全；失败时 job 不被移走
+    bool try_push(Job &job);
+    // 仅消费者线程调用
+    bool try_pop(Job &out);
+    // 任意线程可调用的近似值：包含已抢占槽位但尚未发布的写入
+    std::size_t size_approx() const;
+    bool empty_approx() const { return size_approx() == 0; }
+    std::size_t capacity() const { return mask_ + 1; }
+
+private:
+    struct alignas(64) Slot {
+        std::atomic<std::size_t> seq{0};
+        Job job;
+    };
+
+    std::unique_ptr<Slot[]> slots_;
+    std::size_t mask_{0};
+    alignas(64) std::atomic<std::size_t> tail_{0}; // 生产者竞争
+    alignas(64) std::atomic<std::size_t> head_{0}; // 仅消费者写
+};
@@ -1,5 +1,10 @@
 #pragma once
 
+#include "cron_expression.h"
+#include "placement_scorer.h"
+#include "process_launcher.h"
+#include "resource_vector.h"
+
 #include <chrono>
 #include <cstddef>
 #include <cstdint>
@@ -9,14 +14,52 @@
 #include <sys/types.h>
 #include <vector>
 
+// 依赖条件：父任务成功 / 以任何方式结束（含取消）/ 失败或超时
+enum class DependencyCondition : std::uint8_t {
+    Success,
+    AnyFinish,
+    Failure
+};
+
+struct JobDependency {
+    // 父任务 id；submit_batch 中 -k 表示同一批的第 k 个（从 1 起）任务
+    int job_id{0};
+    DependencyCondition condition{DependencyCondition::Success};
+};
+
+// 数组任务的下标 first, first + step, ... 不超过 last；size() 为 0 表示普通任务
+struct ArrayRange {
+    int first{0};
+    int last{-1};
+    int step{1};
+    std::size_t size() const { return last < first || step <= 0 ? 0 : static_cast<std::size_t>((static_cast<std::int64_t>(last) - first) / step + 1); }
+    // 第 ordinal 个（从 0 起）下标的值
+    int index(std::size_t ordinal) const { return first + static_cast<int>(ordinal) * step; }
+};
+
 struct JobSpec {
     std::string cmd;        // 要执行的命令
     int cpu_cores{1};       // 需要的CPU核数
     std::size_t memory_mb{256};
     int timeout_sec{0};     // 0 表示无限制
     int priority{0};        // 越大优先级越高
+    int timeout_ms{0};      // 毫秒级超时，>0 时优先于 timeout_sec
+    std::int64_t pids{0};    // 最多同时存在的进程/线程数，0 表示不申请
+    std::int64_t io_mbps{0}; // 本地磁盘读写带宽 MB/s，0 表示不申请
+    ResourceTokens tokens;   // 自定义令牌，名称须在 ResourceQuota::tokens 中
+    std::string queue;       // 所属队列（租户），空为 "default"
+    std::vector<JobDependency> depends_on; // 全部满足后才进入待调度队列
+    // 非空时为数组任务：整体只占一个待调度条目，派发时逐个下标展开，cmd 中的 $TASK_INDEX 替换为下标值
+    ArrayRange array;
 };
 
+// 任务的实际超时时长，0 表示无限制
+inline std::chrono::milliseconds job_timeout(const JobSpec &spec) {
+    if (spec.timeout_ms > 0) return std::chrono::milliseconds(spec.timeout_ms);
+    if (spec.timeout_sec > 0) return std::chrono::seconds(spec.timeout_sec);
+    return std::chrono::milliseconds(0);
+}
+
 enum class JobStatus {
     Pending,
     Running,
@@ -32,18 +75,45 @@ enum class PersistStatus {
     Succeeded,
     Failed,
     Timeout,
-    LaunchFailed
+    LaunchFailed,
+    Cancelled // 依赖无法满足
+};
+
+enum class PersistBackend {
+    Sqlite,
+    Journal // 追加写二进制日志 + 快照压缩
 };
 
 struct ResourceQuota {
     int total_cpu{4};
     std::size_t total_mem_mb{2048};
+    std::int64_t total_pids{0};    // 0 表示不限
+    std::int64_t total_io_mbps{0}; // 0 表示不限
+    ResourceTokens tokens;         // 自定义令牌总量，最多 ResourceVector::kMaxTokens 种
 };
 
 struct CgroupConfig {
     bool enabled{false};
     std::string base_path{"/sys/fs/cgroup/scheduler"};
     int cpu_period_us{100000};
+    int pool_size{0}; // >0 时预建该数量的可复用任务 cgroup（不够时自动扩充）；0 为每个任务新建并删除
+    std::string io_device; // "MAJ:MIN"，非空时按 JobSpec::io_mbps 写 io.max 的 rbps/wbps
+};
+
+// 单个资源的压力阈值（some 压力百分比）；low 为 0 表示不监视该资源
+struct PressureThreshold {
+    double low{0};  // 超过即开始降速，同时作为 PSI trigger 的阈值
+    double high{0}; // 达到即降到最低速率
+};
+
+struct PsiConfig {
+    std::string dir;                // 压力文件目录；空则启用 cgroup 时用 cgroup.base_path，否则 /proc/pressure
+    PressureThreshold memory{10, 40};
+    PressureThreshold cpu{50, 90};
+    PressureThreshold io{20, 60};
+    int window_ms{1000};            // trigger 窗口与有压力时的复查间隔（内核要求 500ms..10s）
+    double max_dispatch_rate{200};  // 有压力时的派发速率 = 该值 × 系数（任务/秒）
+    double min_rate_fraction{0.05}; // 系数下限；0 表示压力达到 high 时完全停止派发
 };
 
 struct SchedulerOptions {
@@ -51,33 +121,88 @@ struct SchedulerOptions {
     CgroupConfig cgroup;
     int max_queue_size{1000};
     int kill_grace_sec{2};
+    LaunchBackend launch_backend{LaunchBackend::Vfork};
+    bool enable_zygote{false};       // 经预先 fork 的 zygote 进程启动任务
+    int launch_batch_size{32};       // 调度器单次选出并批量启动的最大任务数
     bool enable_priority{false};
+    bool enable_backfill{true};      // 队首资源不足时允许后续可容纳的任务先行
+    int backfill_scan_limit{256};    // 每次回填最多扫描的待调度任务数
+    int backfill_reserve_ms{-1};     // 队首阻塞超过该时长后停止回填为其预留资源；<0 关闭
     bool enable_psi_monitor{false};
+    PsiConfig psi;
+    bool cpu_pinning{false};         // 按 sysfs 拓扑为任务分配具体 CPU（cpuset 与亲和性）
+    PlacementPolicy placement{PlacementPolicy::FirstFit}; // 回填时挑选先行任务的评分策略
+    // 队列权重（加权 DRF），未列出的队列权重为 1
+    std::vector<std::pair<std::string, double>> queue_weights;
     std::vector<std::string> cmd_whitelist;
     std::vector<std::string> cmd_blacklist;
     std::string workdir;
     int metrics_http_port{-1};
+    int metrics_cache_ms{200}; // /metrics 渲染结果复用时长，0 为每次请求都渲染
     int rlimit_nofile{-1};
     bool disable_core_dump{true};
     bool enable_persistence{false};
     std::string db_path{"state/tasks.db"};
+    int persist_flush_ms{20};        // 持久化组提交间隔；0 表示每次写入同步提交
+#ifdef TASKSCHEDULER_DEFAULT_JOURNAL
+    PersistBackend persist_backend{PersistBackend::Journal};
+#else
+    PersistBackend persist_backend{PersistBackend::Sqlite};
+#endif
     bool enable_cron{false};
-    int cron_tick_ms{1000};
 };
 
-struct CronExpression {
-    // 仅支持 @every <n>s 简化表达式
-    std::string raw;
-    std::chrono::seconds interval{0};
-    static std::optional<CronExpression> parse(std::string_view expr);
-    std::chrono::system_clock::time_point next_run(std::chrono::system_clock::time_point from) const;
+// 错过触发（进程暂停、墙钟跳变、提交积压）时的处理方式
+enum class CronCatchUp {
+    Skip,     // 晚于宽限期的触发直接丢弃，等下一次
+    FireOnce, // 无论错过几次，只补一次
+    FireAll   // 每次错过的都补上（单次最多 CronScheduler::kMaxCatchUp 次）
 };
 
+inline std::string to_string(CronCatchUp c) {
+    switch (c) {
+    case CronCatchUp::Skip: return "skip";
+    case CronCatchUp::FireOnce: return "once";
+    case CronCatchUp::FireAll: return "all";
+    }
+    return "unknown";
+}
+
+inline std::optional<CronCatchUp> parse_cron_catch_up(std::string_view name) {
+    if (name == "skip") return CronCatchUp::Skip;
+    if (name == "once") return CronCatchUp::FireOnce;
+    if (name == "all") return CronCatchUp::FireAll;
+    return std::nullopt;
+}
+
 struct CronTemplate {
     bool enabled{true};
     CronExpression cron;
     JobSpec spec;
-    std::chrono::system_clock::time_point next_run;
+    std::chrono::system_clock::time_point next_run; // 下一次计划时间（未加抖动）
+    // 实际触发时间 = 计划时间 + [0, jitter) 内按模板确定的偏移，同一模板每次偏移相同
+    std::chrono::milliseconds jitter{0};
+    // 为 true 时抖动窗口取到下一次计划时间的整个间隔，同周期的模板均匀铺满整个周期（覆盖 jitter）
+    bool splay{false};
+    CronCatchUp catch_up{CronCatchUp::FireOnce};
+    int max_concurrent{0}; // 同一模板同时排队或运行的实例上限，超出的触发被跳过；0 表示不限
+};
+
+// 任务结束时从其 cgroup 读取的实际用量；对应控制器未启用的项为 0
+struct JobUsage {
+    bool valid{false};                  // 未启用 cgroup 或 cpu.stat 读取失败时为 false
+    std::uint64_t cpu_usec{0};          // cpu.stat usage_usec
+    std::uint64_t memory_peak_bytes{0}; // memory.peak
+    std::uint64_t io_read_bytes{0};     // io.stat 各设备 rbytes 之和
+    std::uint64_t io_write_bytes{0};    // io.stat 各设备 wbytes 之和
+    std::uint64_t pids_peak{0};         // pids.peak
+};
+
+// 拓扑感知放置为任务分配的逻辑 CPU 及其所在 NUMA 节点（cpuset.cpus / cpuset.mems）；空表示不绑核
+struct CpuPlacement {
+    std::vector<int> cpus;
+    std::vector<int> nodes;
+    bool empty() const { return cpus.empty(); }
 };
 
 struct Job {
@@ -93,8 +218,51 @@ struct Job {
     std::chrono::steady_clock::time_point end_time{};
     int exit_code{0};
     std::string cgroup_path;
+    int cgroup_slot{-1}; // 租用的 CgroupPool 槽位
+    JobUsage usage;
+    CpuPlacement placement;
+    ResourceVector demand; // 提交时由 ResourceManager::demand_of 换算
+    int queue{-1};         // FairShareQueue 中的队列编号，入队时设置
+    int cron_template{-1}; // 由 cron 模板触发时为模板编号，结束时归还并发名额
+    // 数组任务：数组占 id，第 k 个下标的任务 id 为 数组 id + 1 + k
+    int array_id{-1};          // 展开出的任务所属的数组
+    int array_index{-1};       // 展开出的任务的下标值
+    std::size_t array_next{0}; // 待调度队列中的数组条目：下一个要派发的序号
 };
 
+enum class SubmitError {
+    None,
+    CommandRejected, // 命中白名单/黑名单
+    ExceedsQuota,    // 单个任务超过总配额，永远无法调度
+    UnknownResource, // 申请了配额中没有的令牌
+    InvalidQueue,    // 队列名不合法，或不同队列数已达 kMaxQueues
+    InvalidArray,    // 数组下标范围不合法或超过上限
+    InvalidDependency, // 依赖的任务不存在，或依赖了同批中被拒绝的任务
+    DependencyCycle,   // 同批任务之间的依赖成环
+    QueueFull
+};
+
+// submit_batch 的逐项结果：成功时 id > 0 且 error == None
+struct SubmitResult {
+    int id{-1};
+    SubmitError error{SubmitError::None};
+};
+
+inline std::string to_string(SubmitError e) {
+    switch (e) {
+    case SubmitError::None: return "none";
+    case SubmitError::CommandRejected: return "command_rejected";
+    case SubmitError::ExceedsQuota: return "exceeds_quota";
+    case SubmitError::UnknownResource: return "unknown_resource";
+    case SubmitError::InvalidQueue: return "invalid_queue";
+    case SubmitError::InvalidArray: return "invalid_array";
+    case SubmitError::InvalidDependency: return "invalid_dependency";
+    case SubmitError::DependencyCycle: return "dependency_cycle";
+    case SubmitError::QueueFull: return "queue_full";
+    }
+    return "unknown";
+}
+
 inline std::string to_string(JobStatus s) {
     switch (s) {
     case JobStatus::Pending: return "pending";
@@ -0,0 +1,60 @@
+#include "job_array.h"
+
+#include <charconv>
+
+namespace {
+bool parse_int(std::string_view text, int &out) {
+    auto res = std::from_chars(text.data(), text.data() + text.size(), out);
+    return res.ec == std::errc{} && res.ptr == text.data() + text.size();
+}
+
+bool ident_char(char c) { return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_'; }
+}
+
+std::optional<ArrayRange> parse_array_range(std::string_view text) {
+    ArrayRange range;
+    auto colon = text.find(':');
+    if (colon != std::string_view::npos) {
+        if (!parse_int(text.substr(colon + 1), range.step) || range.step <= 0) return std::nullopt;
+        text = text.substr(0, colon);
+    }
+    auto dash = text.find('-');
+    if (!parse_int(text.substr(0, dash), range.first)) return std::nullopt;
+    range.last = range.first;
+    if (dash != std::string_view::npos && !parse_int(text.substr(dash + 1), range.last)) return std::nullopt;
+    if (range.first < 0 || range.last < range.first) return std::nullopt;
+    return range;
+}
+
+std::string format_array_range(const ArrayRange &range) {
+    std::string out = std::to_string(range.first) + '-' + std::to_string(range.last);
+    if (range.step != 1) out += ':' + std::to_string(range.step);
+    return out;
+}
+
+std::string expand_task_index(std::string_view cmd, int index) {
+    constexpr std::string_view kBraced = "${TASK_INDEX}";
+    constexpr std::string_view kPlain = "$TASK_INDEX";
+    std::string value = std::to_string(index);
+    std::string out;
+    out.reserve(cmd.size() + value.size());
+    std::size_t pos = 0;
+    while (true) {
+        auto dollar = cmd.find('$', pos);
+        if (dollar == std::string_view::npos) break;
+        out.append(cmd, pos, dollar - pos);
+        auto rest = cmd.substr(dollar);
+        if (rest.starts_with(kBraced)) {
+            out += value;
+            pos = dollar + kBraced.size();
+        } else if (rest.starts_with(kPlain) && (rest.size() == kPlain.size() || !ident_char(rest[kPlain.size()]))) {
+            out += value;
+            pos = dollar + kPlain.size();
+        } else {
+            out += '$';
+            pos = dollar + 1;
+        }
+    }
+    out.append(cmd, pos);
+    return out;
+}
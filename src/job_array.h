@@ -0,0 +1,17 @@
+#pragma once
+
+#include "job.h"
+
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <string_view>
+
+// 数组任务最多展开的下标个数
+inline constexpr std::size_t kMaxArrayTasks = std::size_t{1} << 20;
+
+// "0-99"、"0-99:2" 或单个 "7"：下标须非负，first <= last，step 为正
+std::optional<ArrayRange> parse_array_range(std::string_view text);
+std::string format_array_range(const ArrayRange &range);
+// 把命令中的 ${TASK_INDEX} 与 $TASK_INDEX（后面不紧跟标识符字符时）替换为下标值
+std::string expand_task_index(std::string_view cmd, int index);
@@ -1,4 +1,7 @@
 #include "job_store.h"
+#include "dependency_graph.h"
+#include "job_array.h"
+#include "journal_store.h"
 
 #include "NanoLogCpp17.h"
 
@@ -6,6 +9,7 @@
 #include <sqlite3.h>
 #endif
 
+#include <algorithm>
 #include <chrono>
 
 using namespace NanoLog::LogLevels;
@@ -18,17 +22,71 @@ const char *persist_status_str(PersistStatus s) {
     case PersistStatus::Failed: return "failed";
     case PersistStatus::Timeout: return "timeout";
     case PersistStatus::LaunchFailed: return "launch_failed";
+    case PersistStatus::Cancelled: return "cancelled";
     }
     return "unknown";
 }
+
+std::optional<PersistStatus> parse_persist_status(std::string_view s) {
+    for (auto st : {PersistStatus::Queued, PersistStatus::Running, PersistStatus::Succeeded, PersistStatus::Failed, PersistStatus::Timeout,
+                    PersistStatus::LaunchFailed, PersistStatus::Cancelled}) {
+        if (s == persist_status_str(st)) return st;
+    }
+    return std::nullopt;
+}
+
+#ifdef TASKSCHEDULER_ENABLE_SQLITE
+bool exec_sql(sqlite3 *db, const char *sql, bool log_error = true) {
+    char *errmsg = nullptr;
+    if (sqlite3_exec(db, sql, nullptr, nullptr, &errmsg) != SQLITE_OK) {
+        if (log_error) {
+            auto msg = std::string("sqlite exec failed: ") + (errmsg ? errmsg : "") + " sql=" + sql;
+            NANO_LOG(ERROR, "%s", msg.c_str());
+        }
+        sqlite3_free(errmsg);
+        return false;
+    }
+    return true;
+}
+#endif
+}
+
+bool JobStore::init(const std::string &path) { return init(path, Options{}); }
+
+std::unique_ptr<JobStore> make_job_store(PersistBackend backend) {
+#ifdef TASKSCHEDULER_ENABLE_SQLITE
+    if (backend == PersistBackend::Sqlite) return std::make_unique<SqliteJobStore>();
+#else
+    if (backend == PersistBackend::Sqlite) NANO_LOG(WARNING, "%s", "built without SQLite; using journal job store");
+#endif
+    return std::make_unique<JournalJobStore>();
+}
+
+std::optional<PersistBackend> parse_persist_backend(std::string_view name) {
+    if (name == "sqlite") return PersistBackend::Sqlite;
+    if (name == "journal") return PersistBackend::Journal;
+    return std::nullopt;
 }
 
-bool JobStore::init(const std::string &path) {
+const char *to_string(PersistBackend backend) {
+    switch (backend) {
+    case PersistBackend::Sqlite: return "sqlite";
+    case PersistBackend::Journal: return "journal";
+    }
+    return "unknown";
+}
+
+SqliteJobStore::~SqliteJobStore() { close(); }
+
+bool SqliteJobStore::init(const std::string &path, Options opts) {
     path_ = path;
+    opts_ = opts;
 #ifdef TASKSCHEDULER_ENABLE_SQLITE
-    sqlite3 *db = nullptr;
-    if (sqlite3_open(path_.c_str(), &db) != SQLITE_OK) {
+    std::lock_guard lk(db_mu_);
+    if (sqlite3_open_v2(path_.c_str(), &db_, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_NOMUTEX, nullptr) != SQLITE_OK) {
         NANO_LOG(ERROR, "%s", "Failed to open sqlite db");
+        sqlite3_close(db_);
+        db_ = nullptr;
         return false;
     }
     const char *ddl = R"(
@@ -43,18 +101,73 @@ CREATE TABLE IF NOT EXISTS jobs (
   submit_ms INTEGER,
   start_ms INTEGER,
   end_ms INTEGER,
-  exit_code INTEGER
+  exit_code INTEGER,
+  timeout_ms INTEGER DEFAULT 0,
+  cpu_usec INTEGER,
+  mem_peak_bytes INTEGER,
+  io_rbytes INTEGER,
+  io_wbytes INTEGER,
+  pids_peak INTEGER,
+  pids INTEGER DEFAULT 0,
+  io_mbps INTEGER DEFAULT 0,
+  tokens TEXT,
+  queue TEXT,
+  depends TEXT,
+  array TEXT
 );
+-- 数组任务每个结束的下标一行；数组本身在 jobs 中只占一行
+CREATE TABLE IF NOT EXISTS array_tasks (
+  id INTEGER PRIMARY KEY,
+  array_id INTEGER NOT NULL,
+  idx INTEGER,
+  status TEXT,
+  exit_code INTEGER,
+  start_ms INTEGER,
+  end_ms INTEGER
+);
+CREATE INDEX IF NOT EXISTS array_tasks_array ON array_tasks(array_id);
 )";
-    char *errmsg = nullptr;
-    if (sqlite3_exec(db, ddl, nullptr, nullptr, &errmsg) != SQLITE_OK) {
-        auto msg = std::string("Failed to create table: ") + (errmsg ? errmsg : "");
+    // WAL 下提交只追加日志；synchronous=FULL 保证每个组提交事务落盘
+    if (!exec_sql(db_, "PRAGMA journal_mode=WAL;") || !exec_sql(db_, "PRAGMA synchronous=FULL;") || !exec_sql(db_, ddl)) {
+        sqlite3_close(db_);
+        db_ = nullptr;
+        return false;
+    }
+    // 旧库缺少 timeout_ms 列时补齐；列已存在则忽略错误
+    exec_sql(db_, "ALTER TABLE jobs ADD COLUMN timeout_ms INTEGER DEFAULT 0;", false);
+    for (const char *col : {"cpu_usec", "mem_peak_bytes", "io_rbytes", "io_wbytes", "pids_peak"}) {
+        exec_sql(db_, ("ALTER TABLE jobs ADD COLUMN " + std::string(col) + " INTEGER;").c_str(), false);
+    }
+    exec_sql(db_, "ALTER TABLE jobs ADD COLUMN pids INTEGER DEFAULT 0;", false);
+    exec_sql(db_, "ALTER TABLE jobs ADD COLUMN io_mbps INTEGER DEFAULT 0;", false);
+    exec_sql(db_, "ALTER TABLE jobs ADD COLUMN tokens TEXT;", false);
+    exec_sql(db_, "ALTER TABLE jobs ADD COLUMN queue TEXT;", false);
+    exec_sql(db_, "ALTER TABLE jobs ADD COLUMN depends TEXT;", false);
+    exec_sql(db_, "ALTER TABLE jobs ADD COLUMN array TEXT;", false);
+
+    const char *insert_sql = "INSERT INTO jobs(id,cmd,cpu_cores,memory_mb,timeout_sec,priority,status,submit_ms,timeout_ms,pids,io_mbps,tokens,queue,depends,array) VALUES(?,?,?,?,?,?,?,?,?,?,?,?,?,?,?);";
+    const char *update_sql = "UPDATE jobs SET status=?, exit_code=?, start_ms=?, end_ms=? WHERE id=?";
+    const char *usage_sql = "UPDATE jobs SET cpu_usec=?, mem_peak_bytes=?, io_rbytes=?, io_wbytes=?, pids_peak=? WHERE id=?";
+    const char *array_task_sql = "INSERT OR REPLACE INTO array_tasks(id,array_id,idx,status,exit_code,start_ms,end_ms) VALUES(?,?,?,?,?,?,?);";
+    if (sqlite3_prepare_v2(db_, insert_sql, -1, &insert_stmt_, nullptr) != SQLITE_OK ||
+        sqlite3_prepare_v2(db_, update_sql, -1, &update_stmt_, nullptr) != SQLITE_OK ||
+        sqlite3_prepare_v2(db_, usage_sql, -1, &usage_stmt_, nullptr) != SQLITE_OK ||
+        sqlite3_prepare_v2(db_, array_task_sql, -1, &array_task_stmt_, nullptr) != SQLITE_OK) {
+        auto msg = std::string("Failed to prepare statements: ") + sqlite3_errmsg(db_);
         NANO_LOG(ERROR, "%s", msg.c_str());
-        sqlite3_free(errmsg);
-        sqlite3_close(db);
+        sqlite3_finalize(insert_stmt_);
+        sqlite3_finalize(update_stmt_);
+        sqlite3_finalize(usage_stmt_);
+        sqlite3_finalize(array_task_stmt_);
+        insert_stmt_ = update_stmt_ = usage_stmt_ = array_task_stmt_ = nullptr;
+        sqlite3_close(db_);
+        db_ = nullptr;
         return false;
     }
-    sqlite3_close(db);
+    if (opts_.flush_interval_ms > 0) {
+        stopping_ = false;
+        writer_ = std::thread([this] { writer_loop(); });
+    }
     return true;
 #else
     NANO_LOG(NOTICE, "%s", "Persistence disabled; init is a no-op");
@@ -63,66 +176,256 @@ CREATE TABLE IF NOT EXISTS jobs (
 #endif
 }
 
-int JobStore::insert_job(const JobSpec &spec, PersistStatus status, int64_t submit_ms) {
+void SqliteJobStore::close() {
+    {
+        std::lock_guard lk(q_mu_);
+        stopping_ = true;
+    }
+    q_cv_.notify_all();
+    if (writer_.joinable()) writer_.join();
 #ifdef TASKSCHEDULER_ENABLE_SQLITE
-    sqlite3 *db = nullptr;
-    if (sqlite3_open(path_.c_str(), &db) != SQLITE_OK) return -1;
-    sqlite3_stmt *stmt = nullptr;
-    const char *sql = "INSERT INTO jobs(cmd,cpu_cores,memory_mb,timeout_sec,priority,status,submit_ms) VALUES(?,?,?,?,?,?,?);";
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
-        sqlite3_close(db);
-        return -1;
-    }
-    sqlite3_bind_text(stmt, 1, spec.cmd.c_str(), -1, SQLITE_TRANSIENT);
-    sqlite3_bind_int(stmt, 2, spec.cpu_cores);
-    sqlite3_bind_int(stmt, 3, static_cast<int>(spec.memory_mb));
-    sqlite3_bind_int(stmt, 4, spec.timeout_sec);
-    sqlite3_bind_int(stmt, 5, spec.priority);
-    sqlite3_bind_text(stmt, 6, persist_status_str(status), -1, SQLITE_TRANSIENT);
-    sqlite3_bind_int64(stmt, 7, submit_ms);
-    if (sqlite3_step(stmt) != SQLITE_DONE) {
-        sqlite3_finalize(stmt);
-        sqlite3_close(db);
-        return -1;
-    }
-    int id = static_cast<int>(sqlite3_last_insert_rowid(db));
-    sqlite3_finalize(stmt);
-    sqlite3_close(db);
-    return id;
+    std::lock_guard lk(db_mu_);
+    sqlite3_finalize(insert_stmt_);
+    sqlite3_finalize(update_stmt_);
+    sqlite3_finalize(usage_stmt_);
+    sqlite3_finalize(array_task_stmt_);
+    insert_stmt_ = update_stmt_ = usage_stmt_ = array_task_stmt_ = nullptr;
+    if (db_) sqlite3_close(db_);
+    db_ = nullptr;
+#endif
+}
+
+bool SqliteJobStore::insert_job(int id, const JobSpec &spec, PersistStatus status, int64_t submit_ms) {
+#ifdef TASKSCHEDULER_ENABLE_SQLITE
+    if (!db_) return false;
+    WriteOp op;
+    op.kind = WriteOp::Kind::Insert;
+    op.id = id;
+    op.spec = spec;
+    op.status = status;
+    op.submit_ms = submit_ms;
+    enqueue(std::move(op));
+    return true;
 #else
-    (void)spec; (void)status; (void)submit_ms;
-    return -1;
+    (void)id; (void)spec; (void)status; (void)submit_ms;
+    return false;
 #endif
 }
 
-void JobStore::update_status(int id, PersistStatus status, int exit_code, int64_t start_ms, int64_t end_ms) {
+bool SqliteJobStore::insert_jobs(std::span<const Job> jobs, PersistStatus status, int64_t submit_ms) {
 #ifdef TASKSCHEDULER_ENABLE_SQLITE
-    sqlite3 *db = nullptr;
-    if (sqlite3_open(path_.c_str(), &db) != SQLITE_OK) return;
-    sqlite3_stmt *stmt = nullptr;
-    const char *sql = "UPDATE jobs SET status=?, exit_code=?, start_ms=?, end_ms=? WHERE id=?";
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) { sqlite3_close(db); return; }
-    sqlite3_bind_text(stmt, 1, persist_status_str(status), -1, SQLITE_TRANSIENT);
-    sqlite3_bind_int(stmt, 2, exit_code);
-    sqlite3_bind_int64(stmt, 3, start_ms);
-    sqlite3_bind_int64(stmt, 4, end_ms);
-    sqlite3_bind_int(stmt, 5, id);
-    sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
-    sqlite3_close(db);
+    if (!db_) return false;
+    std::vector<WriteOp> ops(jobs.size());
+    for (std::size_t i = 0; i < jobs.size(); ++i) {
+        ops[i].kind = WriteOp::Kind::Insert;
+        ops[i].id = jobs[i].id;
+        ops[i].spec = jobs[i].spec;
+        ops[i].status = status;
+        ops[i].submit_ms = submit_ms;
+    }
+    enqueue_all(std::move(ops));
+    return true;
+#else
+    (void)jobs; (void)status; (void)submit_ms;
+    return false;
+#endif
+}
+
+void SqliteJobStore::update_status(int id, PersistStatus status, int exit_code, int64_t start_ms, int64_t end_ms) {
+#ifdef TASKSCHEDULER_ENABLE_SQLITE
+    if (!db_) return;
+    WriteOp op;
+    op.id = id;
+    op.status = status;
+    op.exit_code = exit_code;
+    op.start_ms = start_ms;
+    op.end_ms = end_ms;
+    enqueue(std::move(op));
 #else
     (void)id; (void)status; (void)exit_code; (void)start_ms; (void)end_ms;
 #endif
 }
 
-std::vector<PersistedJob> JobStore::load_unfinished() {
+void SqliteJobStore::record_array_task(int array_id, int task_id, int index, PersistStatus status, int exit_code, int64_t start_ms, int64_t end_ms) {
+#ifdef TASKSCHEDULER_ENABLE_SQLITE
+    if (!db_) return;
+    WriteOp op;
+    op.kind = WriteOp::Kind::ArrayTask;
+    op.id = task_id;
+    op.array_id = array_id;
+    op.index = index;
+    op.status = status;
+    op.exit_code = exit_code;
+    op.start_ms = start_ms;
+    op.end_ms = end_ms;
+    enqueue(std::move(op));
+#else
+    (void)array_id; (void)task_id; (void)index; (void)status; (void)exit_code; (void)start_ms; (void)end_ms;
+#endif
+}
+
+void SqliteJobStore::record_usage(int id, const JobUsage &usage) {
+#ifdef TASKSCHEDULER_ENABLE_SQLITE
+    if (!db_ || !usage.valid) return;
+    WriteOp op;
+    op.kind = WriteOp::Kind::Usage;
+    op.id = id;
+    op.usage = usage;
+    enqueue(std::move(op));
+#else
+    (void)id; (void)usage;
+#endif
+}
+
+void SqliteJobStore::enqueue(WriteOp op) {
+    if (!writer_.joinable()) {
+        // 同步模式：每次调用一个事务
+        std::vector<WriteOp> ops;
+        ops.push_back(std::move(op));
+        apply_batch(ops);
+        return;
+    }
+    {
+        std::lock_guard lk(q_mu_);
+        queue_.push_back(std::move(op));
+        ++enqueued_;
+    }
+    q_cv_.notify_one();
+}
+
+void SqliteJobStore::enqueue_all(std::vector<WriteOp> ops) {
+    if (!writer_.joinable()) {
+        apply_batch(ops);
+        return;
+    }
+    {
+        // 一次入队，写线程整批取走，保证落在同一个事务里
+        std::lock_guard lk(q_mu_);
+        for (auto &op : ops) queue_.push_back(std::move(op));
+        enqueued_ += ops.size();
+    }
+    q_cv_.notify_one();
+}
+
+void SqliteJobStore::flush() {
+    std::unique_lock lk(q_mu_);
+    if (!writer_.joinable()) return;
+    auto target = enqueued_;
+    flush_target_ = std::max(flush_target_, target);
+    q_cv_.notify_one();
+    flushed_cv_.wait(lk, [&] { return committed_ >= target || stopping_; });
+}
+
+void SqliteJobStore::writer_loop() {
+    std::vector<WriteOp> batch;
+    std::unique_lock lk(q_mu_);
+    while (true) {
+        q_cv_.wait(lk, [&] { return stopping_ || !queue_.empty(); });
+        if (queue_.empty() && stopping_) break;
+        // 组提交窗口：等待更多写入合并，队列达到上限或收到 flush/stop 时提前提交
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(opts_.flush_interval_ms);
+        q_cv_.wait_until(lk, deadline, [&] { return stopping_ || queue_.size() >= opts_.max_batch || flush_target_ > committed_; });
+
+        std::size_t n = queue_.size();
+        batch.clear();
+        batch.reserve(n);
+        for (std::size_t i = 0; i < n; ++i) {
+            batch.push_back(std::move(queue_.front()));
+            queue_.pop_front();
+        }
+        lk.unlock();
+        apply_batch(batch);
+        lk.lock();
+        committed_ += n;
+        flushed_cv_.notify_all();
+    }
+    flushed_cv_.notify_all();
+}
+
+void SqliteJobStore::apply_batch(std::vector<WriteOp> &ops) {
+#ifdef TASKSCHEDULER_ENABLE_SQLITE
+    std::lock_guard lk(db_mu_);
+    if (!db_ || ops.empty()) return;
+    exec_sql(db_, "BEGIN;");
+    for (const auto &op : ops) {
+        if (!apply(op)) {
+            auto msg = std::string("persist job id=") + std::to_string(op.id) + " failed: " + sqlite3_errmsg(db_);
+            NANO_LOG(ERROR, "%s", msg.c_str());
+        }
+    }
+    if (!exec_sql(db_, "COMMIT;")) exec_sql(db_, "ROLLBACK;", false);
+#else
+    (void)ops;
+#endif
+}
+
+bool SqliteJobStore::apply(const WriteOp &op) {
 #ifdef TASKSCHEDULER_ENABLE_SQLITE
-    sqlite3 *db = nullptr;
+    sqlite3_stmt *stmt = op.kind == WriteOp::Kind::Insert      ? insert_stmt_
+                         : op.kind == WriteOp::Kind::Usage     ? usage_stmt_
+                         : op.kind == WriteOp::Kind::ArrayTask ? array_task_stmt_
+                                                               : update_stmt_;
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+    if (op.kind == WriteOp::Kind::Insert) {
+        sqlite3_bind_int(stmt, 1, op.id);
+        sqlite3_bind_text(stmt, 2, op.spec.cmd.c_str(), -1, SQLITE_STATIC);
+        sqlite3_bind_int(stmt, 3, op.spec.cpu_cores);
+        sqlite3_bind_int(stmt, 4, static_cast<int>(op.spec.memory_mb));
+        sqlite3_bind_int(stmt, 5, op.spec.timeout_sec);
+        sqlite3_bind_int(stmt, 6, op.spec.priority);
+        sqlite3_bind_text(stmt, 7, persist_status_str(op.status), -1, SQLITE_STATIC);
+        sqlite3_bind_int64(stmt, 8, op.submit_ms);
+        sqlite3_bind_int(stmt, 9, op.spec.timeout_ms);
+        sqlite3_bind_int64(stmt, 10, op.spec.pids);
+        sqlite3_bind_int64(stmt, 11, op.spec.io_mbps);
+        if (!op.spec.tokens.empty()) sqlite3_bind_text(stmt, 12, format_resource_tokens(op.spec.tokens).c_str(), -1, SQLITE_TRANSIENT);
+        if (!op.spec.queue.empty()) sqlite3_bind_text(stmt, 13, op.spec.queue.c_str(), -1, SQLITE_STATIC);
+        if (!op.spec.depends_on.empty()) sqlite3_bind_text(stmt, 14, format_dependencies(op.spec.depends_on).c_str(), -1, SQLITE_TRANSIENT);
+        if (op.spec.array.size() > 0) sqlite3_bind_text(stmt, 15, format_array_range(op.spec.array).c_str(), -1, SQLITE_TRANSIENT);
+    } else if (op.kind == WriteOp::Kind::ArrayTask) {
+        sqlite3_bind_int(stmt, 1, op.id);
+        sqlite3_bind_int(stmt, 2, op.array_id);
+        sqlite3_bind_int(stmt, 3, op.index);
+        sqlite3_bind_text(stmt, 4, persist_status_str(op.status), -1, SQLITE_STATIC);
+        sqlite3_bind_int(stmt, 5, op.exit_code);
+        sqlite3_bind_int64(stmt, 6, op.start_ms);
+        sqlite3_bind_int64(stmt, 7, op.end_ms);
+    } else if (op.kind == WriteOp::Kind::Usage) {
+        // 峰值为 0 表示未采集到（控制器未启用或无法按租约重置），存为 NULL
+        auto bind_u64 = [stmt](int col, std::uint64_t v, bool known) {
+            if (known) sqlite3_bind_int64(stmt, col, static_cast<sqlite3_int64>(v));
+            else sqlite3_bind_null(stmt, col);
+        };
+        bind_u64(1, op.usage.cpu_usec, true);
+        bind_u64(2, op.usage.memory_peak_bytes, op.usage.memory_peak_bytes > 0);
+        bind_u64(3, op.usage.io_read_bytes, true);
+        bind_u64(4, op.usage.io_write_bytes, true);
+        bind_u64(5, op.usage.pids_peak, op.usage.pids_peak > 0);
+        sqlite3_bind_int(stmt, 6, op.id);
+    } else {
+        sqlite3_bind_text(stmt, 1, persist_status_str(op.status), -1, SQLITE_STATIC);
+        sqlite3_bind_int(stmt, 2, op.exit_code);
+        sqlite3_bind_int64(stmt, 3, op.start_ms);
+        sqlite3_bind_int64(stmt, 4, op.end_ms);
+        sqlite3_bind_int(stmt, 5, op.id);
+    }
+    return sqlite3_step(stmt) == SQLITE_DONE;
+#else
+    (void)op;
+    return false;
+#endif
+}
+
+std::vector<PersistedJob> SqliteJobStore::load_unfinished() {
+#ifdef TASKSCHEDULER_ENABLE_SQLITE
+    flush();
     std::vector<PersistedJob> res;
-    if (sqlite3_open(path_.c_str(), &db) != SQLITE_OK) return res;
-    const char *sql = "SELECT id, cmd, cpu_cores, memory_mb, timeout_sec, priority FROM jobs WHERE status IN ('queued','running')";
+    std::lock_guard lk(db_mu_);
+    if (!db_) return res;
+    const char *sql = "SELECT id, cmd, cpu_cores, memory_mb, timeout_sec, priority, timeout_ms, pids, io_mbps, tokens, queue, depends, array FROM jobs WHERE status IN ('queued','running')";
     sqlite3_stmt *stmt = nullptr;
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) { sqlite3_close(db); return res; }
+    if (sqlite3_prepare_v2(db_, sql, -1, &stmt, nullptr) != SQLITE_OK) return res;
     while (sqlite3_step(stmt) == SQLITE_ROW) {
         PersistedJob pj;
         pj.id = sqlite3_column_int(stmt, 0);
@@ -131,13 +434,113 @@ std::vector<PersistedJob> JobStore::load_unfinished() {
         pj.spec.memory_mb = static_cast<std::size_t>(sqlite3_column_int(stmt, 3));
         pj.spec.timeout_sec = sqlite3_column_int(stmt, 4);
         pj.spec.priority = sqlite3_column_int(stmt, 5);
+        pj.spec.timeout_ms = sqlite3_column_int(stmt, 6);
+        pj.spec.pids = sqlite3_column_int64(stmt, 7);
+        pj.spec.io_mbps = sqlite3_column_int64(stmt, 8);
+        if (auto text = sqlite3_column_text(stmt, 9)) {
+            pj.spec.tokens = parse_resource_tokens(reinterpret_cast<const char *>(text)).value_or(ResourceTokens{});
+        }
+        if (auto text = sqlite3_column_text(stmt, 10)) pj.spec.queue = reinterpret_cast<const char *>(text);
+        if (auto text = sqlite3_column_text(stmt, 11)) {
+            pj.spec.depends_on = parse_dependencies(reinterpret_cast<const char *>(text)).value_or(std::vector<JobDependency>{});
+        }
+        if (auto text = sqlite3_column_text(stmt, 12)) pj.spec.array = parse_array_range(reinterpret_cast<const char *>(text)).value_or(ArrayRange{});
         pj.status = PersistStatus::Queued;
         res.push_back(std::move(pj));
     }
     sqlite3_finalize(stmt);
-    sqlite3_close(db);
+    // 未完成数组中已结束的下标
+    sqlite3_stmt *tasks = nullptr;
+    if (sqlite3_prepare_v2(db_, "SELECT id, status FROM array_tasks WHERE array_id=?", -1, &tasks, nullptr) != SQLITE_OK) return res;
+    for (auto &pj : res) {
+        if (pj.spec.array.size() == 0) continue;
+        sqlite3_reset(tasks);
+        sqlite3_bind_int(tasks, 1, pj.id);
+        while (sqlite3_step(tasks) == SQLITE_ROW) {
+            auto text = sqlite3_column_text(tasks, 1);
+            auto st = text ? parse_persist_status(reinterpret_cast<const char *>(text)) : std::nullopt;
+            if (st) pj.finished_tasks.emplace_back(sqlite3_column_int(tasks, 0), *st);
+        }
+    }
+    sqlite3_finalize(tasks);
     return res;
 #else
     return {};
 #endif
 }
+
+int SqliteJobStore::max_id() {
+#ifdef TASKSCHEDULER_ENABLE_SQLITE
+    flush();
+    std::lock_guard lk(db_mu_);
+    if (!db_) return 0;
+    int res = 0;
+    // id 单调分配：最大的一行若是数组，其下标的 id 紧随其后（取消的数组不写 array_tasks）
+    sqlite3_stmt *stmt = nullptr;
+    if (sqlite3_prepare_v2(db_, "SELECT id, array FROM jobs ORDER BY id DESC LIMIT 1", -1, &stmt, nullptr) == SQLITE_OK && sqlite3_step(stmt) == SQLITE_ROW) {
+        res = sqlite3_column_int(stmt, 0);
+        if (auto text = sqlite3_column_text(stmt, 1)) {
+            if (auto range = parse_array_range(reinterpret_cast<const char *>(text))) res += static_cast<int>(range->size());
+        }
+    }
+    sqlite3_finalize(stmt);
+    stmt = nullptr;
+    if (sqlite3_prepare_v2(db_, "SELECT MAX(id) FROM array_tasks", -1, &stmt, nullptr) == SQLITE_OK && sqlite3_step(stmt) == SQLITE_ROW) {
+        res = std::max(res, sqlite3_column_int(stmt, 0));
+    }
+    sqlite3_finalize(stmt);
+    return res;
+#else
+    return 0;
+#endif
+}
+
+std::optional<JobUsage> SqliteJobStore::load_usage(int id) {
+#ifdef TASKSCHEDULER_ENABLE_SQLITE
+    flush();
+    std::lock_guard lk(db_mu_);
+    if (!db_) return std::nullopt;
+    const char *sql = "SELECT cpu_usec, mem_peak_bytes, io_rbytes, io_wbytes, pids_peak FROM jobs WHERE id=? AND cpu_usec IS NOT NULL";
+    sqlite3_stmt *stmt = nullptr;
+    if (sqlite3_prepare_v2(db_, sql, -1, &stmt, nullptr) != SQLITE_OK) return std::nullopt;
+    sqlite3_bind_int(stmt, 1, id);
+    std::optional<JobUsage> res;
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        JobUsage u;
+        u.valid = true;
+        u.cpu_usec = static_cast<std::uint64_t>(sqlite3_column_int64(stmt, 0));
+        u.memory_peak_bytes = static_cast<std::uint64_t>(sqlite3_column_int64(stmt, 1)); // NULL 读出为 0
+        u.io_read_bytes = static_cast<std::uint64_t>(sqlite3_column_int64(stmt, 2));
+        u.io_write_bytes = static_cast<std::uint64_t>(sqlite3_column_int64(stmt, 3));
+        u.pids_peak = static_cast<std::uint64_t>(sqlite3_column_int64(stmt, 4));
+        res = u;
+    }
+    sqlite3_finalize(stmt);
+    return res;
+#else
+    (void)id;
+    return std::nullopt;
+#endif
+}
+
+std::optional<PersistStatus> SqliteJobStore::load_status(int id) {
+#ifdef TASKSCHEDULER_ENABLE_SQLITE
+    // 不 flush：只查重启前已结束的任务，恢复时 load_unfinished 已刷过盘，不必等组提交窗口
+    std::lock_guard lk(db_mu_);
+    if (!db_) return std::nullopt;
+    sqlite3_stmt *stmt = nullptr;
+    // 数组展开出的任务不在 jobs 中，查 array_tasks
+    const char *sql = "SELECT status FROM jobs WHERE id=?1 UNION ALL SELECT status FROM array_tasks WHERE id=?1";
+    if (sqlite3_prepare_v2(db_, sql, -1, &stmt, nullptr) != SQLITE_OK) return std::nullopt;
+    sqlite3_bind_int(stmt, 1, id);
+    std::optional<PersistStatus> res;
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        if (auto text = sqlite3_column_text(stmt, 0)) res = parse_persist_status(reinterpret_cast<const char *>(text));
+    }
+    sqlite3_finalize(stmt);
+    return res;
+#else
+    (void)id;
+    return std::nullopt;
+#endif
+}
@@ -1,23 +1,136 @@
 #pragma once
 
 #include "job.h"
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
 #include <optional>
+#include <span>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
 #include <vector>
 
+struct sqlite3;
+struct sqlite3_stmt;
+
 struct PersistedJob {
     int id{0};
     JobSpec spec;
     PersistStatus status{PersistStatus::Queued};
+    // 数组任务：已结束的下标（任务 id, 终态），恢复后跳过
+    std::vector<std::pair<int, PersistStatus>> finished_tasks;
 };
 
+// 持久化后端接口。写入可以异步组提交，flush() 之后此前的写入保证落盘。
 class JobStore {
 public:
+    struct Options {
+        int flush_interval_ms{20};             // 组提交间隔；0 表示每次调用同步提交
+        std::size_t max_batch{4096};           // SQLite：积压达到该值时不等间隔立即提交
+        std::size_t snapshot_records{1 << 20}; // Journal：日志记录数超过该值时压缩为快照
+    };
+
+    virtual ~JobStore() = default;
+
     bool init(const std::string &path);
-    int insert_job(const JobSpec &spec, PersistStatus status, int64_t submit_ms);
-    void update_status(int id, PersistStatus status, int exit_code = 0, int64_t start_ms = 0, int64_t end_ms = 0);
-    std::vector<PersistedJob> load_unfinished();
+    virtual bool init(const std::string &path, Options opts) = 0;
+    // id 由调度器分配，与内存中的 Job::id 一致
+    virtual bool insert_job(int id, const JobSpec &spec, PersistStatus status, int64_t submit_ms) = 0;
+    // 批量插入，作为同一个事务/同一批日志记录提交
+    virtual bool insert_jobs(std::span<const Job> jobs, PersistStatus status, int64_t submit_ms) = 0;
+    virtual void update_status(int id, PersistStatus status, int exit_code = 0, int64_t start_ms = 0, int64_t end_ms = 0) = 0;
+    // 数组中一个下标结束（task_id = 数组 id + 1 + 序号）。默认按任务 id 写状态记录
+    virtual void record_array_task(int array_id, int task_id, int index, PersistStatus status, int exit_code = 0, int64_t start_ms = 0, int64_t end_ms = 0) {
+        (void)array_id;
+        (void)index;
+        update_status(task_id, status, exit_code, start_ms, end_ms);
+    }
+    virtual std::vector<PersistedJob> load_unfinished() = 0;
+    // 用过的最大任务 id（含已结束任务与数组下标），没有记录时为 0。重启后新任务的 id 须大于它，否则会与旧记录冲突
+    virtual int max_id() = 0;
+    // 任务结束时的 cgroup 用量。默认不保存：Journal 只为崩溃恢复保留未完成任务，已结束任务不留记录
+    virtual void record_usage(int id, const JobUsage &usage) { (void)id; (void)usage; }
+    virtual std::optional<JobUsage> load_usage(int id) { (void)id; return std::nullopt; }
+    // 已结束任务的终态，供重启后解析对它的依赖；未保存或任务未结束时返回 nullopt。
+    // 不等待尚在组提交队列中的写入，需要时先调用 flush()
+    virtual std::optional<PersistStatus> load_status(int id) { (void)id; return std::nullopt; }
+    // 阻塞直到此前的写入全部提交
+    virtual void flush() = 0;
+    virtual void close() = 0;
+};
+
+// SQLite 持久化：单一长连接 + 预编译语句，WAL 模式。
+// flush_interval_ms > 0 时写入进入队列，由后台线程按间隔合并为一个事务提交（组提交），
+// 崩溃时最多丢失一个间隔内的写入；= 0 时每次调用同步提交。
+class SqliteJobStore final : public JobStore {
+public:
+    SqliteJobStore() = default;
+    ~SqliteJobStore() override;
+    SqliteJobStore(const SqliteJobStore &) = delete;
+    SqliteJobStore &operator=(const SqliteJobStore &) = delete;
+
+    using JobStore::init;
+    bool init(const std::string &path, Options opts) override;
+    bool insert_job(int id, const JobSpec &spec, PersistStatus status, int64_t submit_ms) override;
+    bool insert_jobs(std::span<const Job> jobs, PersistStatus status, int64_t submit_ms) override;
+    void update_status(int id, PersistStatus status, int exit_code = 0, int64_t start_ms = 0, int64_t end_ms = 0) override;
+    void record_array_task(int array_id, int task_id, int index, PersistStatus status, int exit_code = 0, int64_t start_ms = 0, int64_t end_ms = 0) override;
+    std::vector<PersistedJob> load_unfinished() override;
+    int max_id() override;
+    void record_usage(int id, const JobUsage &usage) override;
+    std::optional<JobUsage> load_usage(int id) override;
+    std::optional<PersistStatus> load_status(int id) override;
+    void flush() override;
+    void close() override;
 
 private:
+    struct WriteOp {
+        enum class Kind { Insert, Update, Usage, ArrayTask };
+        Kind kind{Kind::Update};
+        int id{0};
+        int array_id{0}; // 仅 ArrayTask 使用
+        int index{0};
+        JobSpec spec; // 仅 Insert 使用
+        JobUsage usage; // 仅 Usage 使用
+        PersistStatus status{PersistStatus::Queued};
+        int exit_code{0};
+        int64_t submit_ms{0};
+        int64_t start_ms{0};
+        int64_t end_ms{0};
+    };
+
+    void enqueue(WriteOp op);
+    void enqueue_all(std::vector<WriteOp> ops);
+    void writer_loop();
+    void apply_batch(std::vector<WriteOp> &ops);
+    bool apply(const WriteOp &op);
+
     std::string path_;
+    Options opts_;
+
+    std::mutex db_mu_; // 保护 db_ 与语句
+    sqlite3 *db_{nullptr};
+    sqlite3_stmt *insert_stmt_{nullptr};
+    sqlite3_stmt *update_stmt_{nullptr};
+    sqlite3_stmt *usage_stmt_{nullptr};
+    sqlite3_stmt *array_task_stmt_{nullptr};
+
+    std::mutex q_mu_;
+    std::condition_variable q_cv_;
+    std::condition_variable flushed_cv_;
+    std::deque<WriteOp> queue_;
+    std::uint64_t enqueued_{0};
+    std::uint64_t committed_{0};
+    std::uint64_t flush_target_{0}; // flush() 请求提交到的序号
+    bool stopping_{false};
+    std::thread writer_;
 };
+
+// 未编译 SQLite 时请求 Sqlite 后端会回退到 Journal
+std::unique_ptr<JobStore> make_job_store(PersistBackend backend);
+std::optional<PersistBackend> parse_persist_backend(std::string_view name);
+const char *to_string(PersistBackend backend);
@@ -0,0 +1,602 @@
+#include "journal_store.h"
+#include "dependency_graph.h"
+#include "job_array.h"
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <limits>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "NanoLogCpp17.h"
+
+using namespace NanoLog::LogLevels;
+
+namespace {
+enum class RecordType : std::uint8_t {
+    Submit = 1,
+    Status = 2,
+    // 3～6 是旧版本写的提交附加记录，只在回放时识别：它们与 Submit 分属不同记录，崩溃时可能只留下前半部分
+    SubmitExt = 3, // Submit 之后追加 pids、io_mbps 与令牌
+    Queue = 4,     // 紧跟在提交记录之后，任务不在默认队列时才写
+    Depends = 5,   // 紧跟在提交记录之后，任务有依赖时才写；剩余字节为 format_dependencies 的文本
+    Array = 6,     // 紧跟在提交记录之后，数组任务才写；剩余字节为 format_array_range 的文本
+    MaxId = 7,     // 快照开头：压缩前用过的最大 id，已结束任务不进快照也不会被重新分配
+    // Submit 之后追加 pids、io_mbps 与令牌、队列、依赖、数组五段文本的长度（u32）及内容。
+    // 任务申请了扩展资源、不在默认队列、有依赖或是数组时使用，整个任务在一条记录里，要么完整回放要么整条丢弃。
+    // 数组各下标的终态为按任务 id 的 Status 记录
+    SubmitFull = 8,
+    // 快照中的终态表：i32 起始 id，其后每个 id 一字节 PersistStatus，0 表示未结束或未知
+    StatusTable = 9,
+};
+
+constexpr std::size_t kHeaderSize = 2 * sizeof(std::uint32_t);
+// 单条记录上限，防止损坏的长度字段导致越界读取
+constexpr std::uint32_t kMaxPayload = 16 * 1024 * 1024;
+
+// CRC32C（Castagnoli）slicing-by-8 查表
+constexpr std::array<std::array<std::uint32_t, 256>, 8> make_crc_tables() {
+    std::array<std::array<std::uint32_t, 256>, 8> t{};
+    for (std::uint32_t i = 0; i < 256; ++i) {
+        std::uint32_t c = i;
+        for (int k = 0; k < 8; ++k) c = (c & 1) ? (c >> 1) ^ 0x82F63B78u : c >> 1;
+        t[0][i] = c;
+    }
+    for (std::uint32_t i = 0; i < 256; ++i) {
+        for (int s = 1; s < 8; ++s) t[s][i] = (t[s - 1][i] >> 8) ^ t[0][t[s - 1][i] & 0xff];
+    }
+    return t;
+}
+
+constexpr auto kCrcTables = make_crc_tables();
+
+std::uint32_t crc32c(const char *data, std::size_t n) {
+    const auto &t = kCrcTables;
+    auto *p = reinterpret_cast<const unsigned char *>(data);
+    std::uint32_t crc = ~0u;
+    while (n >= 8) {
+        std::uint64_t v;
+        std::memcpy(&v, p, sizeof(v));
+        v ^= crc;
+        crc = t[7][v & 0xff] ^ t[6][(v >> 8) & 0xff] ^ t[5][(v >> 16) & 0xff] ^ t[4][(v >> 24) & 0xff] ^
+              t[3][(v >> 32) & 0xff] ^ t[2][(v >> 40) & 0xff] ^ t[1][(v >> 48) & 0xff] ^ t[0][v >> 56];
+        p += 8;
+        n -= 8;
+    }
+    while (n--) crc = t[0][(crc ^ *p++) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
+
+template <class T>
+void put(std::string &out, T v) {
+    out.append(reinterpret_cast<const char *>(&v), sizeof(T));
+}
+
+template <class T>
+T get(const char *&p) {
+    T v;
+    std::memcpy(&v, p, sizeof(T));
+    p += sizeof(T);
+    return v;
+}
+
+// 先写占位头，payload 写完后回填长度与 CRC
+std::size_t begin_record(std::string &out) {
+    std::size_t start = out.size();
+    out.append(kHeaderSize, '\0');
+    return start;
+}
+
+void end_record(std::string &out, std::size_t start) {
+    auto len = static_cast<std::uint32_t>(out.size() - start - kHeaderSize);
+    std::uint32_t crc = crc32c(out.data() + start + kHeaderSize, len);
+    std::memcpy(out.data() + start, &len, sizeof(len));
+    std::memcpy(out.data() + start + sizeof(len), &crc, sizeof(crc));
+}
+
+void encode_submit(std::string &out, int id, const JobSpec &spec, int64_t submit_ms) {
+    const bool full = spec.pids != 0 || spec.io_mbps != 0 || !spec.tokens.empty() || !spec.queue.empty() || !spec.depends_on.empty() ||
+                      spec.array.size() > 0;
+    auto start = begin_record(out);
+    put<std::uint8_t>(out, static_cast<std::uint8_t>(full ? RecordType::SubmitFull : RecordType::Submit));
+    put<std::int32_t>(out, id);
+    put<std::int64_t>(out, submit_ms);
+    put<std::int32_t>(out, spec.cpu_cores);
+    put<std::uint64_t>(out, spec.memory_mb);
+    put<std::int32_t>(out, spec.timeout_sec);
+    put<std::int32_t>(out, spec.priority);
+    put<std::int32_t>(out, spec.timeout_ms);
+    if (full) {
+        put<std::int64_t>(out, spec.pids);
+        put<std::int64_t>(out, spec.io_mbps);
+        const std::string tokens = format_resource_tokens(spec.tokens);
+        const std::string deps = spec.depends_on.empty() ? std::string() : format_dependencies(spec.depends_on);
+        const std::string array = spec.array.size() > 0 ? format_array_range(spec.array) : std::string();
+        put<std::uint32_t>(out, static_cast<std::uint32_t>(spec.cmd.size()));
+        put<std::uint32_t>(out, static_cast<std::uint32_t>(tokens.size()));
+        put<std::uint32_t>(out, static_cast<std::uint32_t>(spec.queue.size()));
+        put<std::uint32_t>(out, static_cast<std::uint32_t>(deps.size()));
+        put<std::uint32_t>(out, static_cast<std::uint32_t>(array.size()));
+        out.append(spec.cmd);
+        out.append(tokens);
+        out.append(spec.queue);
+        out.append(deps);
+        out.append(array);
+    } else {
+        out.append(spec.cmd); // 剩余字节即命令
+    }
+    end_record(out, start);
+}
+
+void encode_status(std::string &out, int id, PersistStatus status, int exit_code, int64_t start_ms, int64_t end_ms) {
+    auto start = begin_record(out);
+    put<std::uint8_t>(out, static_cast<std::uint8_t>(RecordType::Status));
+    put<std::int32_t>(out, id);
+    put<std::uint8_t>(out, static_cast<std::uint8_t>(status));
+    put<std::int32_t>(out, exit_code);
+    put<std::int64_t>(out, start_ms);
+    put<std::int64_t>(out, end_ms);
+    end_record(out, start);
+}
+
+constexpr std::size_t kSubmitFixed = 1 + 4 + 8 + 4 + 8 + 4 + 4 + 4;
+constexpr std::size_t kSubmitExtFixed = kSubmitFixed + 8 + 8 + 4;
+constexpr std::size_t kSubmitFullFixed = kSubmitFixed + 8 + 8 + 5 * 4;
+constexpr std::size_t kStatusSize = 1 + 4 + 1 + 4 + 8 + 8;
+constexpr std::size_t kQueueFixed = 1 + 4;
+constexpr std::size_t kDependsFixed = 1 + 4;
+constexpr std::size_t kArrayFixed = 1 + 4;
+constexpr std::size_t kMaxIdSize = 1 + 4;
+constexpr std::size_t kStatusTableFixed = 1 + 4;
+// 终态表每条记录覆盖的 id 数，全为 0 的段不写
+constexpr std::size_t kStatusTableChunk = 1 << 20;
+
+bool terminal(PersistStatus s) { return s != PersistStatus::Queued && s != PersistStatus::Running; }
+
+void set_finished(std::vector<std::uint8_t> &table, int id, PersistStatus status) {
+    if (id <= 0) return;
+    auto i = static_cast<std::size_t>(id);
+    if (table.size() <= i) table.resize(std::max(i + 1, table.size() * 2));
+    table[i] = static_cast<std::uint8_t>(status);
+}
+
+std::optional<PersistStatus> finished_status(const std::vector<std::uint8_t> &table, int id) {
+    if (id <= 0 || static_cast<std::size_t>(id) >= table.size() || table[static_cast<std::size_t>(id)] == 0) return std::nullopt;
+    return static_cast<PersistStatus>(table[static_cast<std::size_t>(id)]);
+}
+
+void encode_status_table(std::string &out, const std::vector<std::uint8_t> &table) {
+    for (std::size_t first = 0; first < table.size(); first += kStatusTableChunk) {
+        std::size_t last = std::min(first + kStatusTableChunk, table.size());
+        while (first < last && table[first] == 0) ++first;
+        while (last > first && table[last - 1] == 0) --last;
+        if (first == last) continue;
+        auto start = begin_record(out);
+        put<std::uint8_t>(out, static_cast<std::uint8_t>(RecordType::StatusTable));
+        put<std::int32_t>(out, static_cast<std::int32_t>(first));
+        out.append(reinterpret_cast<const char *>(table.data() + first), last - first);
+        end_record(out, start);
+    }
+}
+
+bool fsync_parent_dir(const std::string &path) {
+    auto dir = std::filesystem::path(path).parent_path();
+    int dfd = ::open(dir.empty() ? "." : dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dfd < 0) return false;
+    bool ok = ::fsync(dfd) == 0;
+    ::close(dfd);
+    return ok;
+}
+
+bool write_all(int fd, const char *data, std::size_t n) {
+    while (n > 0) {
+        ssize_t w = ::write(fd, data, n);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += w;
+        n -= static_cast<std::size_t>(w);
+    }
+    return true;
+}
+}
+
+JournalJobStore::~JournalJobStore() { close(); }
+
+bool JournalJobStore::init(const std::string &path, Options opts) {
+    path_ = path;
+    snap_path_ = path + ".snap";
+    opts_ = opts;
+
+    std::lock_guard io(io_mu_);
+    LiveMap live;
+    FinishedMap finished;
+    std::size_t snap_records = 0;
+    journal_records_ = 0;
+    replay_file(snap_path_, live, snap_records, &finished);
+    std::size_t valid = replay_file(path_, live, journal_records_, &finished);
+
+    fd_ = ::open(path_.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd_ < 0) {
+        auto msg = std::string("Failed to open journal ") + path_ + ": " + std::strerror(errno);
+        NANO_LOG(ERROR, "%s", msg.c_str());
+        return false;
+    }
+    struct stat st{};
+    if (::fstat(fd_, &st) == 0 && static_cast<std::size_t>(st.st_size) > valid) {
+        // 丢弃崩溃时写了一半的尾部，否则后续追加的记录无法被回放
+        NANO_LOG(WARNING, "journal tail truncated from %lld to %zu bytes", static_cast<long long>(st.st_size), valid);
+        if (::ftruncate(fd_, static_cast<off_t>(valid)) != 0 || ::fdatasync(fd_) != 0) {
+            auto msg = std::string("Failed to truncate journal: ") + std::strerror(errno);
+            NANO_LOG(ERROR, "%s", msg.c_str());
+        }
+    }
+    recovered_ = collect(live);
+    finished_ = std::move(finished);
+    attach_array_tasks(recovered_, finished_);
+    NANO_LOG(NOTICE, "journal replayed snapshot_records=%zu journal_records=%zu unfinished=%zu", snap_records, journal_records_, recovered_.size());
+
+    if (opts_.flush_interval_ms > 0) {
+        stopping_ = false;
+        flusher_ = std::thread([this] { flusher_loop(); });
+    }
+    return true;
+}
+
+void JournalJobStore::close() {
+    {
+        std::lock_guard lk(mu_);
+        stopping_ = true;
+    }
+    cv_.notify_all();
+    if (flusher_.joinable()) flusher_.join();
+    if (fd_ >= 0) {
+        write_out();
+        std::lock_guard io(io_mu_);
+        ::close(fd_);
+        fd_ = -1;
+    }
+}
+
+bool JournalJobStore::insert_job(int id, const JobSpec &spec, PersistStatus status, int64_t submit_ms) {
+    if (fd_ < 0) return false;
+    std::string rec;
+    rec.reserve(kHeaderSize + kSubmitFixed + spec.cmd.size());
+    encode_submit(rec, id, spec, submit_ms);
+    append(rec);
+    if (status != PersistStatus::Queued) update_status(id, status);
+    return true;
+}
+
+bool JournalJobStore::insert_jobs(std::span<const Job> jobs, PersistStatus status, int64_t submit_ms) {
+    if (fd_ < 0) return false;
+    std::string recs;
+    std::size_t bytes = 0;
+    for (const auto &job : jobs) bytes += kHeaderSize + kSubmitFixed + job.spec.cmd.size();
+    recs.reserve(bytes);
+    for (const auto &job : jobs) encode_submit(recs, job.id, job.spec, submit_ms);
+    append(recs, jobs.size());
+    if (status != PersistStatus::Queued) {
+        for (const auto &job : jobs) update_status(job.id, status);
+    }
+    return true;
+}
+
+void JournalJobStore::update_status(int id, PersistStatus status, int exit_code, int64_t start_ms, int64_t end_ms) {
+    if (fd_ < 0) return;
+    std::string rec;
+    rec.reserve(kHeaderSize + kStatusSize);
+    encode_status(rec, id, status, exit_code, start_ms, end_ms);
+    append(rec);
+}
+
+void JournalJobStore::append(const std::string &records, std::size_t count) {
+    {
+        std::lock_guard lk(mu_);
+        buf_.append(records);
+        buf_records_ += count;
+        appended_ += count;
+    }
+    if (!flusher_.joinable()) {
+        // 同步模式：每次调用 write + fdatasync
+        write_out();
+        return;
+    }
+    cv_.notify_one();
+}
+
+void JournalJobStore::flush() {
+    std::unique_lock lk(mu_);
+    if (!flusher_.joinable()) return;
+    auto target = appended_;
+    flush_target_ = std::max(flush_target_, target);
+    cv_.notify_one();
+    durable_cv_.wait(lk, [&] { return durable_ >= target || stopping_; });
+}
+
+void JournalJobStore::flusher_loop() {
+    std::unique_lock lk(mu_);
+    while (true) {
+        cv_.wait(lk, [&] { return stopping_ || !buf_.empty(); });
+        if (buf_.empty() && stopping_) break;
+        // 组提交窗口：合并更多记录后一次 fdatasync，flush/stop 时提前提交
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(opts_.flush_interval_ms);
+        cv_.wait_until(lk, deadline, [&] { return stopping_ || flush_target_ > durable_; });
+        lk.unlock();
+        write_out();
+        lk.lock();
+    }
+    durable_cv_.notify_all();
+}
+
+void JournalJobStore::write_out() {
+    std::lock_guard io(io_mu_);
+    std::string out;
+    std::size_t records = 0;
+    std::uint64_t target = 0;
+    {
+        std::lock_guard lk(mu_);
+        out.swap(buf_);
+        records = buf_records_;
+        buf_records_ = 0;
+        target = appended_;
+    }
+    if (!out.empty() && fd_ >= 0) {
+        if (!write_all(fd_, out.data(), out.size()) || ::fdatasync(fd_) != 0) {
+            auto msg = std::string("journal write failed: ") + std::strerror(errno);
+            NANO_LOG(ERROR, "%s", msg.c_str());
+        }
+        journal_records_ += records;
+        if (journal_records_ >= opts_.snapshot_records) compact_locked();
+    }
+    {
+        std::lock_guard lk(mu_);
+        durable_ = std::max(durable_, target);
+    }
+    durable_cv_.notify_all();
+}
+
+bool JournalJobStore::compact_locked() {
+    // 此时日志内容已全部落盘且持有 io_mu_，没有并发写入文件
+    LiveMap live;
+    FinishedMap finished;
+    std::size_t records = 0;
+    replay_file(snap_path_, live, records, &finished);
+    replay_file(path_, live, records, &finished);
+
+    std::string out;
+    auto start = begin_record(out);
+    put<std::uint8_t>(out, static_cast<std::uint8_t>(RecordType::MaxId));
+    put<std::int32_t>(out, max_id_);
+    end_record(out, start);
+    auto jobs = collect(live);
+    for (const auto &pj : jobs) {
+        encode_submit(out, pj.id, pj.spec, 0);
+    }
+    // 已结束任务只保留终态表，重启后据此判断对任意旧任务的依赖
+    encode_status_table(out, finished);
+    finished_ = std::move(finished);
+    auto tmp = snap_path_ + ".tmp";
+    int sfd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (sfd < 0) {
+        auto msg = std::string("Failed to create snapshot ") + tmp + ": " + std::strerror(errno);
+        NANO_LOG(ERROR, "%s", msg.c_str());
+        return false;
+    }
+    bool ok = write_all(sfd, out.data(), out.size()) && ::fsync(sfd) == 0;
+    ::close(sfd);
+    // rename 之后、截断之前崩溃也安全：快照 + 旧日志回放结果相同
+    if (!ok || ::rename(tmp.c_str(), snap_path_.c_str()) != 0 || !fsync_parent_dir(snap_path_)) {
+        auto msg = std::string("Failed to install snapshot: ") + std::strerror(errno);
+        NANO_LOG(ERROR, "%s", msg.c_str());
+        ::unlink(tmp.c_str());
+        return false;
+    }
+    if (::ftruncate(fd_, 0) != 0 || ::fdatasync(fd_) != 0) {
+        auto msg = std::string("Failed to truncate journal after snapshot: ") + std::strerror(errno);
+        NANO_LOG(ERROR, "%s", msg.c_str());
+        return false;
+    }
+    NANO_LOG(NOTICE, "journal compacted records=%zu live=%zu", journal_records_, jobs.size());
+    journal_records_ = 0;
+    return true;
+}
+
+std::size_t JournalJobStore::replay_file(const std::string &path, LiveMap &live, std::size_t &records, FinishedMap *finished) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return 0;
+    struct stat st{};
+    if (::fstat(fd, &st) != 0 || st.st_size == 0) {
+        ::close(fd);
+        return 0;
+    }
+    auto size = static_cast<std::size_t>(st.st_size);
+    void *map = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED) {
+        auto msg = std::string("Failed to mmap ") + path + ": " + std::strerror(errno);
+        NANO_LOG(ERROR, "%s", msg.c_str());
+        return 0;
+    }
+    ::madvise(map, size, MADV_SEQUENTIAL);
+    live.reserve(live.size() + size / 256);
+
+    const char *base = static_cast<const char *>(map);
+    std::size_t off = 0;
+    while (off + kHeaderSize <= size) {
+        const char *h = base + off;
+        auto len = get<std::uint32_t>(h);
+        auto crc = get<std::uint32_t>(h);
+        if (len == 0 || len > kMaxPayload || off + kHeaderSize + len > size) break;
+        if (crc32c(h, len) != crc) break;
+
+        const char *p = h;
+        auto type = static_cast<RecordType>(get<std::uint8_t>(p));
+        if ((type == RecordType::Submit && len >= kSubmitFixed) || (type == RecordType::SubmitExt && len >= kSubmitExtFixed) ||
+            (type == RecordType::SubmitFull && len >= kSubmitFullFixed)) {
+            PersistedJob pj;
+            pj.id = get<std::int32_t>(p);
+            get<std::int64_t>(p); // submit_ms
+            pj.spec.cpu_cores = get<std::int32_t>(p);
+            pj.spec.memory_mb = static_cast<std::size_t>(get<std::uint64_t>(p));
+            pj.spec.timeout_sec = get<std::int32_t>(p);
+            pj.spec.priority = get<std::int32_t>(p);
+            pj.spec.timeout_ms = get<std::int32_t>(p);
+            if (type == RecordType::Submit) {
+                pj.spec.cmd.assign(p, len - kSubmitFixed);
+            } else if (type == RecordType::SubmitFull) {
+                pj.spec.pids = get<std::int64_t>(p);
+                pj.spec.io_mbps = get<std::int64_t>(p);
+                std::array<std::uint32_t, 5> sizes;
+                std::uint64_t total = 0;
+                for (auto &n : sizes) total += n = get<std::uint32_t>(p);
+                if (total != len - kSubmitFullFixed) break;
+                std::array<std::string_view, 5> text;
+                for (std::size_t i = 0; i < sizes.size(); ++i) {
+                    text[i] = std::string_view(p, sizes[i]);
+                    p += sizes[i];
+                }
+                pj.spec.cmd.assign(text[0]);
+                auto tokens = parse_resource_tokens(text[1]);
+                if (!tokens) break;
+                pj.spec.tokens = std::move(*tokens);
+                pj.spec.queue.assign(text[2]);
+                if (!text[3].empty()) {
+                    auto deps = parse_dependencies(text[3]);
+                    if (!deps) break;
+                    pj.spec.depends_on = std::move(*deps);
+                }
+                if (!text[4].empty()) {
+                    auto range = parse_array_range(text[4]);
+                    if (!range) break;
+                    pj.spec.array = *range;
+                }
+            } else {
+                pj.spec.pids = get<std::int64_t>(p);
+                pj.spec.io_mbps = get<std::int64_t>(p);
+                auto cmd_len = get<std::uint32_t>(p);
+                if (cmd_len > len - kSubmitExtFixed) break;
+                pj.spec.cmd.assign(p, cmd_len);
+                auto tokens = parse_resource_tokens(std::string_view(p + cmd_len, len - kSubmitExtFixed - cmd_len));
+                if (!tokens) break;
+                pj.spec.tokens = std::move(*tokens);
+            }
+            max_id_ = std::max(max_id_, pj.id + static_cast<int>(pj.spec.array.size()));
+            live[pj.id] = std::move(pj);
+        } else if (type == RecordType::Queue && len > kQueueFixed) {
+            auto id = get<std::int32_t>(p);
+            if (auto it = live.find(id); it != live.end()) it->second.spec.queue.assign(p, len - kQueueFixed);
+        } else if (type == RecordType::Depends && len > kDependsFixed) {
+            auto id = get<std::int32_t>(p);
+            auto deps = parse_dependencies(std::string_view(p, len - kDependsFixed));
+            if (!deps) break;
+            if (auto it = live.find(id); it != live.end()) it->second.spec.depends_on = std::move(*deps);
+        } else if (type == RecordType::Array && len > kArrayFixed) {
+            auto id = get<std::int32_t>(p);
+            auto range = parse_array_range(std::string_view(p, len - kArrayFixed));
+            if (!range) break;
+            max_id_ = std::max(max_id_, id + static_cast<int>(range->size()));
+            if (auto it = live.find(id); it != live.end()) it->second.spec.array = *range;
+        } else if (type == RecordType::StatusTable && len > kStatusTableFixed) {
+            auto first = get<std::int32_t>(p);
+            auto n = len - kStatusTableFixed;
+            if (first <= 0 || static_cast<std::int64_t>(first) + n - 1 > std::numeric_limits<std::int32_t>::max()) break;
+            max_id_ = std::max(max_id_, first + static_cast<int>(n) - 1);
+            if (finished) {
+                auto begin = static_cast<std::size_t>(first);
+                if (finished->size() < begin + n) finished->resize(begin + n);
+                std::memcpy(finished->data() + begin, p, n);
+            }
+        } else if (type == RecordType::MaxId && len == kMaxIdSize) {
+            max_id_ = std::max(max_id_, get<std::int32_t>(p));
+        } else if (type == RecordType::Status && len == kStatusSize) {
+            auto id = get<std::int32_t>(p);
+            auto status = static_cast<PersistStatus>(get<std::uint8_t>(p));
+            max_id_ = std::max(max_id_, id);
+            if (terminal(status)) {
+                live.erase(id);
+                if (finished) set_finished(*finished, id, status);
+            } else if (auto it = live.find(id); it != live.end()) {
+                it->second.status = status;
+            }
+        } else {
+            break;
+        }
+        off += kHeaderSize + len;
+        ++records;
+    }
+    ::munmap(map, size);
+    return off;
+}
+
+std::vector<PersistedJob> JournalJobStore::collect(LiveMap &live) const {
+    std::vector<PersistedJob> res;
+    res.reserve(live.size());
+    for (auto &[id, pj] : live) res.push_back(std::move(pj));
+    std::sort(res.begin(), res.end(), [](const PersistedJob &a, const PersistedJob &b) { return a.id < b.id; });
+    return res;
+}
+
+std::vector<PersistedJob> JournalJobStore::load_unfinished() {
+    flush();
+    {
+        std::lock_guard lk(mu_);
+        if (appended_ == 0) {
+            for (auto &pj : recovered_) pj.status = PersistStatus::Queued;
+            return recovered_;
+        }
+    }
+    write_out();
+    std::lock_guard io(io_mu_);
+    LiveMap live;
+    FinishedMap finished;
+    std::size_t records = 0;
+    replay_file(snap_path_, live, records, &finished);
+    replay_file(path_, live, records, &finished);
+    auto res = collect(live);
+    for (auto &pj : res) pj.status = PersistStatus::Queued;
+    finished_ = std::move(finished);
+    attach_array_tasks(res, finished_);
+    return res;
+}
+
+void JournalJobStore::attach_array_tasks(std::vector<PersistedJob> &jobs, const FinishedMap &finished) {
+    for (auto &pj : jobs) {
+        pj.finished_tasks.clear();
+        for (std::size_t k = 0, n = pj.spec.array.size(); k < n; ++k) {
+            int task = pj.id + 1 + static_cast<int>(k);
+            if (auto ps = finished_status(finished, task)) pj.finished_tasks.emplace_back(task, *ps);
+        }
+    }
+}
+
+int JournalJobStore::max_id() {
+    flush();
+    bool replayed = false;
+    {
+        std::lock_guard lk(mu_);
+        replayed = appended_ == 0;
+    }
+    if (!replayed) write_out();
+    std::lock_guard io(io_mu_);
+    if (!replayed) {
+        // init 之后追加的记录未经回放，重新回放一遍取最大值
+        LiveMap live;
+        std::size_t records = 0;
+        replay_file(snap_path_, live, records);
+        replay_file(path_, live, records);
+    }
+    return max_id_;
+}
+
+std::optional<PersistStatus> JournalJobStore::load_status(int id) {
+    std::lock_guard io(io_mu_);
+    return finished_status(finished_, id);
+}
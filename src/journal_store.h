@@ -0,0 +1,78 @@
+#pragma once
+
+#include "job_store.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// 追加写二进制日志持久化，只用于崩溃恢复。
+// 记录格式（主机字节序）：u32 payload_len, u32 crc32c(payload), payload。
+// 启动时 mmap 顺序回放 <path>.snap 与 <path>，遇到长度越界或 CRC 不符的尾部记录即截断
+// （崩溃时写了一半）。记录数超过 snapshot_records 时把未完成任务与已结束任务的终态表写成新快照并清空日志。
+// flush_interval_ms > 0 时由后台线程按间隔 write + fdatasync 组提交。
+class JournalJobStore final : public JobStore {
+public:
+    JournalJobStore() = default;
+    ~JournalJobStore() override;
+    JournalJobStore(const JournalJobStore &) = delete;
+    JournalJobStore &operator=(const JournalJobStore &) = delete;
+
+    using JobStore::init;
+    bool init(const std::string &path, Options opts) override;
+    bool insert_job(int id, const JobSpec &spec, PersistStatus status, int64_t submit_ms) override;
+    bool insert_jobs(std::span<const Job> jobs, PersistStatus status, int64_t submit_ms) override;
+    void update_status(int id, PersistStatus status, int exit_code = 0, int64_t start_ms = 0, int64_t end_ms = 0) override;
+    std::vector<PersistedJob> load_unfinished() override;
+    int max_id() override;
+    std::optional<PersistStatus> load_status(int id) override;
+    void flush() override;
+    void close() override;
+
+private:
+    using LiveMap = std::unordered_map<int, PersistedJob>;
+    // 已结束任务的终态，按 id 下标、每个 id 一字节；0（Queued）表示未结束或未知
+    using FinishedMap = std::vector<std::uint8_t>;
+
+    void append(const std::string &records, std::size_t count = 1);
+    void flusher_loop();
+    // 把缓冲区写入日志并 fdatasync；必要时压缩。调用方不得持有 mu_
+    void write_out();
+    bool compact_locked();
+    // 回放单个文件，返回有效前缀字节数；文件不存在返回 0。finished 非空时记录已结束任务的终态
+    std::size_t replay_file(const std::string &path, LiveMap &live, std::size_t &records, FinishedMap *finished = nullptr);
+    // 按 id 排序取出未完成任务，live 中的条目被移走
+    std::vector<PersistedJob> collect(LiveMap &live) const;
+    // 按 finished 填写未完成数组的 finished_tasks
+    static void attach_array_tasks(std::vector<PersistedJob> &jobs, const FinishedMap &finished);
+
+    std::string path_;
+    std::string snap_path_;
+    Options opts_;
+
+    std::mutex io_mu_; // 保护 fd_ 写入、快照与回放
+    int fd_{-1};
+    std::size_t journal_records_{0};
+    // 回放得到的全部已结束任务（含数组下标）的终态，重启后对任意旧任务的依赖据此判断；
+    // 压缩时整表写进快照，受 io_mu_ 保护
+    FinishedMap finished_;
+    // 回放见过的最大 id（含数组下标）；压缩时写进快照，受 io_mu_ 保护
+    int max_id_{0};
+
+    std::mutex mu_;
+    std::condition_variable cv_;
+    std::condition_variable durable_cv_;
+    std::string buf_; // 尚未写入文件的记录
+    std::size_t buf_records_{0};
+    std::uint64_t appended_{0};
+    std::uint64_t durable_{0};
+    std::uint64_t flush_target_{0};
+    bool stopping_{false};
+    std::thread flusher_;
+
+    std::vector<PersistedJob> recovered_; // init 时回放的结果，之后无写入则直接复用
+};
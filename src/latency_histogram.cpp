@@ -0,0 +1,97 @@
+#include "latency_histogram.h"
+
+#include <charconv>
+#include <cmath>
+
+namespace {
+void append_uint(std::string &out, std::uint64_t v) {
+    char buf[24];
+    auto res = std::to_chars(buf, buf + sizeof(buf), v);
+    out.append(buf, res.ptr);
+}
+
+// 秒数的最短精确十进制表示，保证同一边界每次导出的 le 文本一致
+void append_seconds(std::string &out, double sec) {
+    char buf[32];
+    auto res = std::to_chars(buf, buf + sizeof(buf), sec);
+    out.append(buf, res.ptr);
+}
+
+using Bounds = std::array<std::string, LatencyHistogram::kExportMaxExp + 1>;
+
+// 导出边界固定，le 文本按单位各格式化一次
+const Bounds &export_bounds(LatencyHistogram::Unit unit) {
+    static const std::array<Bounds, 3> bounds = [] {
+        std::array<Bounds, 3> b;
+        for (int exp = 0; exp <= LatencyHistogram::kExportMaxExp; ++exp) {
+            std::uint64_t v = std::uint64_t{1} << exp;
+            append_seconds(b[0][exp], static_cast<double>(v) / 1e6);
+            append_uint(b[1][exp], v * 1024);
+            append_uint(b[2][exp], v);
+        }
+        return b;
+    }();
+    return bounds[static_cast<int>(unit)];
+}
+}
+
+std::uint64_t LatencyHistogram::bucket_upper(int idx) {
+    if (idx < kSub) return static_cast<std::uint64_t>(idx) + 1;
+    int shift = idx / kSub - 1;
+    std::uint64_t sub = static_cast<std::uint64_t>(kSub + idx % kSub);
+    return (sub + 1) << shift;
+}
+
+std::uint64_t LatencyHistogram::count() const {
+    std::uint64_t n = 0;
+    for (const auto &b : buckets_) n += b.load(std::memory_order_relaxed);
+    return n;
+}
+
+std::uint64_t LatencyHistogram::value_at_quantile(double q) const {
+    std::array<std::uint64_t, kBuckets> counts;
+    std::uint64_t total = 0;
+    for (int i = 0; i < kBuckets; ++i) {
+        counts[i] = buckets_[i].load(std::memory_order_relaxed);
+        total += counts[i];
+    }
+    if (total == 0) return 0;
+    auto target = static_cast<std::uint64_t>(std::ceil(q * static_cast<double>(total)));
+    if (target == 0) target = 1;
+    std::uint64_t seen = 0;
+    for (int i = 0; i < kBuckets; ++i) {
+        seen += counts[i];
+        if (seen >= target) return bucket_upper(i);
+    }
+    return bucket_upper(kBuckets - 1);
+}
+
+void LatencyHistogram::write_prometheus(std::string &out, std::string_view name, Unit unit) const {
+    // 各桶与 sum 分别读取，并发写入时 count 与 sum 可能相差几个样本，符合 Prometheus 的容忍范围
+    const auto &bounds = export_bounds(unit);
+    std::uint64_t cumulative = 0;
+    int idx = 0;
+    out.append("# TYPE ").append(name).append(" histogram\n");
+    for (int exp = 0; exp <= kExportMaxExp; ++exp) {
+        std::uint64_t bound = std::uint64_t{1} << exp;
+        while (idx < kBuckets && bucket_upper(idx) <= bound) {
+            cumulative += buckets_[idx].load(std::memory_order_relaxed);
+            ++idx;
+        }
+        out.append(name).append("_bucket{le=\"").append(bounds[exp]).append("\"} ");
+        append_uint(out, cumulative);
+        out += '\n';
+    }
+    for (; idx < kBuckets; ++idx) cumulative += buckets_[idx].load(std::memory_order_relaxed);
+    out.append(name).append("_bucket{le=\"+Inf\"} ");
+    append_uint(out, cumulative);
+    out.append("\n").append(name).append("_sum ");
+    switch (unit) {
+    case Unit::Microseconds: append_seconds(out, static_cast<double>(sum_us()) / 1e6); break;
+    case Unit::Kibibytes: append_uint(out, sum_us() * 1024); break;
+    case Unit::Count: append_uint(out, sum_us()); break;
+    }
+    out.append("\n").append(name).append("_count ");
+    append_uint(out, cumulative);
+    out += '\n';
+}
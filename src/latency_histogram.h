@@ -0,0 +1,61 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// 无锁对数-线性（HDR 风格）延迟直方图，单位微秒。
+// 每个 2 的幂区间再线性切分为 kSub 个子桶，相对误差不超过 1/kSub；
+// 记录只有一次位运算定位与两次 relaxed fetch_add。超过 2^kMaxExp 微秒的值计入最后一个桶。
+// 也可记录其它非负整数量（KiB、个数），导出时用 Unit 指定换算。
+class LatencyHistogram {
+public:
+    enum class Unit {
+        Microseconds, // 导出为秒
+        Kibibytes,    // 导出为字节
+        Count         // 原值导出
+    };
+
+    static constexpr int kSubBits = 3;
+    static constexpr int kSub = 1 << kSubBits;
+    static constexpr int kMaxExp = 40; // 约 12.7 天
+    static constexpr int kBuckets = (kMaxExp - kSubBits + 1) * kSub;
+    // Prometheus 导出边界：1us..2^kExportMaxExp us 的 2 的幂（与子桶边界对齐，导出是精确的）
+    static constexpr int kExportMaxExp = 35;
+
+    void record(std::uint64_t us) {
+        buckets_[bucket_index(us)].fetch_add(1, std::memory_order_relaxed);
+        sum_us_.fetch_add(us, std::memory_order_relaxed);
+    }
+    void record(std::chrono::steady_clock::duration d) {
+        auto us = std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+        record(static_cast<std::uint64_t>(us < 0 ? 0 : us));
+    }
+
+    std::uint64_t count() const;
+    std::uint64_t sum_us() const { return sum_us_.load(std::memory_order_relaxed); }
+    // 返回不小于 q 分位（0..1）样本的桶上界（微秒）；无样本时为 0
+    std::uint64_t value_at_quantile(double q) const;
+    // 追加 <name>_bucket{le=...}/<name>_sum/<name>_count 到 out，按 unit 换算；复用 out 的容量，不经过流
+    void write_prometheus(std::string &out, std::string_view name, Unit unit = Unit::Microseconds) const;
+
+    static int bucket_index(std::uint64_t us);
+    // 桶 idx 覆盖 [lower, upper)
+    static std::uint64_t bucket_upper(int idx);
+
+private:
+    std::array<std::atomic<std::uint64_t>, kBuckets> buckets_{};
+    std::atomic<std::uint64_t> sum_us_{0};
+};
+
+inline int LatencyHistogram::bucket_index(std::uint64_t us) {
+    if (us < static_cast<std::uint64_t>(kSub)) return static_cast<int>(us);
+    constexpr std::uint64_t kMax = (std::uint64_t{1} << kMaxExp) - 1;
+    if (us > kMax) us = kMax;
+    int exp = 63 - __builtin_clzll(us); // >= kSubBits
+    int shift = exp - kSubBits;
+    return (shift + 1) * kSub + static_cast<int>((us >> shift) - kSub);
+}
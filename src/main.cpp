@@ -19,6 +19,10 @@
 #endif
 
 namespace {
+volatile std::sig_atomic_t g_stop_requested = 0;
+
+extern "C" void on_stop_signal(int) { g_stop_requested = 1; }
+
 std::vector<std::string> split(const std::string &s, char delim) {
     std::vector<std::string> out;
     std::stringstream ss(s);
@@ -29,6 +33,15 @@ std::vector<std::string> split(const std::string &s, char delim) {
     return out;
 }
 
+// "low:high" 形式的压力阈值
+PressureThreshold parse_threshold(const std::string &s) {
+    PressureThreshold th;
+    auto parts = split(s, ':');
+    if (!parts.empty()) th.low = std::stod(parts[0]);
+    th.high = parts.size() > 1 ? std::stod(parts[1]) : th.low;
+    return th;
+}
+
 void print_stack(const char *ctx) {
 #if defined(TASKSCHEDULER_USE_BACKWARD) && TASKSCHEDULER_USE_BACKWARD
     backward::StackTrace st;
@@ -74,6 +87,8 @@ int main(int argc, char **argv) {
         SchedulerOptions opts;
         JobSpec spec;
         bool has_cmd = false;
+        std::string cron_expr;
+        CronTemplate cron_tpl;
 
         for (int i = 1; i < argc; ++i) {
             std::string arg = argv[i];
@@ -86,19 +101,93 @@ int main(int argc, char **argv) {
             else if (arg == "--cpu") { spec.cpu_cores = std::stoi(need(arg)); }
             else if (arg == "--mem") { spec.memory_mb = static_cast<std::size_t>(std::stol(need(arg))); }
             else if (arg == "--timeout") { spec.timeout_sec = std::stoi(need(arg)); }
+            else if (arg == "--timeout-ms") { spec.timeout_ms = std::stoi(need(arg)); }
             else if (arg == "--priority") { spec.priority = std::stoi(need(arg)); }
+            else if (arg == "--pids") { spec.pids = std::stoll(need(arg)); }
+            else if (arg == "--io-mbps") { spec.io_mbps = std::stoll(need(arg)); }
+            else if (arg == "--tokens") {
+                auto text = need(arg);
+                if (auto tokens = parse_resource_tokens(text)) spec.tokens = std::move(*tokens);
+                else std::cerr << "Invalid tokens: " << text << "\n";
+            }
+            else if (arg == "--queue") { spec.queue = need(arg); }
+            else if (arg == "--depends") {
+                auto text = need(arg);
+                if (auto deps = parse_dependencies(text)) spec.depends_on = std::move(*deps);
+                else std::cerr << "Invalid dependencies: " << text << "\n";
+            }
+            else if (arg == "--array") {
+                auto text = need(arg);
+                if (auto range = parse_array_range(text)) spec.array = *range;
+                else std::cerr << "Invalid array range: " << text << "\n";
+            }
+            else if (arg == "--queue-weights") {
+                auto text = need(arg);
+                if (auto weights = parse_queue_weights(text)) opts.queue_weights = std::move(*weights);
+                else std::cerr << "Invalid queue weights: " << text << "\n";
+            }
             else if (arg == "--total-cpu") { opts.quota.total_cpu = std::stoi(need(arg)); }
             else if (arg == "--total-mem") { opts.quota.total_mem_mb = static_cast<std::size_t>(std::stol(need(arg))); }
+            else if (arg == "--total-pids") { opts.quota.total_pids = std::stoll(need(arg)); }
+            else if (arg == "--total-io-mbps") { opts.quota.total_io_mbps = std::stoll(need(arg)); }
+            else if (arg == "--total-tokens") {
+                auto text = need(arg);
+                if (auto tokens = parse_resource_tokens(text)) opts.quota.tokens = std::move(*tokens);
+                else std::cerr << "Invalid tokens: " << text << "\n";
+            }
+            else if (arg == "--placement") {
+                auto name = need(arg);
+                if (auto policy = parse_placement_policy(name)) opts.placement = *policy;
+                else std::cerr << "Unknown placement policy: " << name << "\n";
+            }
             else if (arg == "--cgroup") { opts.cgroup.enabled = true; }
+            else if (arg == "--cgroup-io-device") { opts.cgroup.io_device = need(arg); }
+            else if (arg == "--cgroup-pool") { opts.cgroup.pool_size = std::stoi(need(arg)); opts.cgroup.enabled = true; }
+            else if (arg == "--cpu-pinning") { opts.cpu_pinning = true; }
+            else if (arg == "--psi") { opts.enable_psi_monitor = true; }
+            else if (arg == "--psi-dir") { opts.psi.dir = need(arg); opts.enable_psi_monitor = true; }
+            else if (arg == "--psi-memory") { opts.psi.memory = parse_threshold(need(arg)); }
+            else if (arg == "--psi-cpu") { opts.psi.cpu = parse_threshold(need(arg)); }
+            else if (arg == "--psi-io") { opts.psi.io = parse_threshold(need(arg)); }
+            else if (arg == "--psi-window-ms") { opts.psi.window_ms = std::stoi(need(arg)); }
+            else if (arg == "--psi-max-rate") { opts.psi.max_dispatch_rate = std::stod(need(arg)); }
+            else if (arg == "--psi-min-fraction") { opts.psi.min_rate_fraction = std::stod(need(arg)); }
             else if (arg == "--enable-priority") { opts.enable_priority = true; }
+            else if (arg == "--no-backfill") { opts.enable_backfill = false; }
+            else if (arg == "--backfill-reserve-ms") { opts.backfill_reserve_ms = std::stoi(need(arg)); }
             else if (arg == "--metrics-port") { opts.metrics_http_port = std::stoi(need(arg)); }
+            else if (arg == "--metrics-cache-ms") { opts.metrics_cache_ms = std::stoi(need(arg)); }
             else if (arg == "--whitelist") { opts.cmd_whitelist = split(need(arg), ','); }
             else if (arg == "--blacklist") { opts.cmd_blacklist = split(need(arg), ','); }
             else if (arg == "--workdir") { opts.workdir = need(arg); }
+            else if (arg == "--launch-backend") {
+                auto name = need(arg);
+                if (auto backend = parse_launch_backend(name)) opts.launch_backend = *backend;
+                else std::cerr << "Unknown launch backend: " << name << "\n";
+            }
+            else if (arg == "--zygote") { opts.enable_zygote = true; }
             else if (arg == "--rlimit-nofile") { opts.rlimit_nofile = std::stoi(need(arg)); }
             else if (arg == "--db-path") { opts.db_path = need(arg); opts.enable_persistence = true; }
+            else if (arg == "--persist-backend") {
+                auto name = need(arg);
+                if (auto backend = parse_persist_backend(name)) opts.persist_backend = *backend;
+                else std::cerr << "Unknown persist backend: " << name << "\n";
+            }
+            else if (arg == "--persist-flush-ms") { opts.persist_flush_ms = std::stoi(need(arg)); }
             else if (arg == "--enable-cron") { opts.enable_cron = true; }
-            else if (arg == "--cron-tick-ms") { opts.cron_tick_ms = std::stoi(need(arg)); }
+            else if (arg == "--cron") { cron_expr = need(arg); opts.enable_cron = true; }
+            else if (arg == "--cron-tick-ms") {
+                need(arg);
+                std::cerr << "--cron-tick-ms is ignored: cron now sleeps until the next fire time\n";
+            }
+            else if (arg == "--cron-jitter-ms") { cron_tpl.jitter = std::chrono::milliseconds(std::stol(need(arg))); }
+            else if (arg == "--cron-splay") { cron_tpl.splay = true; }
+            else if (arg == "--cron-catch-up") {
+                auto name = need(arg);
+                if (auto policy = parse_cron_catch_up(name)) cron_tpl.catch_up = *policy;
+                else std::cerr << "Unknown cron catch-up policy: " << name << "\n";
+            }
+            else if (arg == "--cron-max-concurrent") { cron_tpl.max_concurrent = std::stoi(need(arg)); }
             else {
                 std::cerr << "Unknown arg: " << arg << "\n";
             }
@@ -107,8 +196,28 @@ int main(int argc, char **argv) {
         Scheduler sched(opts);
         sched.start();
 
-        if (has_cmd) {
-            int id = sched.submit(spec);
+        int single_id = -1;
+        if (has_cmd && !cron_expr.empty()) {
+            auto cron = CronExpression::parse(cron_expr);
+            if (cron) {
+                cron_tpl.cron = std::move(*cron);
+                cron_tpl.spec = spec;
+            }
+            if (!cron || sched.add_cron(cron_tpl) < 0) {
+                std::cerr << "Invalid cron expression: " << cron_expr << std::endl;
+                sched.stop();
+                return 1;
+            }
+            // cron 模式常驻，直到收到 SIGINT/SIGTERM
+            std::signal(SIGINT, on_stop_signal);
+            std::signal(SIGTERM, on_stop_signal);
+            std::cout << "Registered cron template: " << cron_expr << std::endl;
+            while (!g_stop_requested) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(200));
+            }
+        } else if (has_cmd) {
+            single_id = sched.submit(spec);
+            int id = single_id;
             if (id < 0) {
                 std::cerr << "Submit failed" << std::endl;
             } else {
@@ -120,6 +229,12 @@ int main(int argc, char **argv) {
         while (!sched.idle()) {
             std::this_thread::sleep_for(std::chrono::milliseconds(200));
         }
+        // 启用 cgroup 时打印单个任务的用量
+        if (auto usage = single_id > 0 ? sched.job_usage(single_id) : std::nullopt) {
+            std::cout << "Job id=" << single_id << " usage: cpu_usec=" << usage->cpu_usec
+                      << " memory_peak_bytes=" << usage->memory_peak_bytes << " io_read_bytes=" << usage->io_read_bytes
+                      << " io_write_bytes=" << usage->io_write_bytes << " pids_peak=" << usage->pids_peak << std::endl;
+        }
         sched.stop();
         NanoLog::sync();
         return 0;
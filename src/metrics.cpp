@@ -1,68 +1,183 @@
 #include "metrics.h"
 
 #include <algorithm>
-#include <sstream>
+#include <charconv>
 
-void Metrics::inc_submitted() { submitted_.fetch_add(1); }
-void Metrics::inc_rejected() { rejected_.fetch_add(1); }
-void Metrics::inc_running() { running_.fetch_add(1); }
-void Metrics::dec_running() { running_.fetch_sub(1); }
-void Metrics::inc_succeeded() { succeeded_.fetch_add(1); }
-void Metrics::inc_failed() { failed_.fetch_add(1); }
-void Metrics::inc_timeout() { timeout_.fetch_add(1); }
-void Metrics::inc_launch_failed() { launch_failed_.fetch_add(1); }
-void Metrics::inc_pressure_blocked() { pressure_blocked_.fetch_add(1); }
-void Metrics::set_pressure_active(bool active) { pressure_active_.store(active ? 1 : 0); }
-void Metrics::record_queue_wait(long long ms) {
-    queue_wait_ms_total_.fetch_add(ms);
-    queue_wait_count_.fetch_add(1);
-    long long prev = queue_wait_ms_max_.load();
-    while (ms > prev && !queue_wait_ms_max_.compare_exchange_weak(prev, ms)) {
+namespace {
+// 追加 "<name> <value>\n"
+void append_sample(std::string &out, std::string_view name, long long v) {
+    char buf[24];
+    auto res = std::to_chars(buf, buf + sizeof(buf), v);
+    out.append(name).append(1, ' ').append(buf, res.ptr).append(1, '\n');
+}
+
+void append_sample(std::string &out, std::string_view name, double v) {
+    char buf[32];
+    auto res = std::to_chars(buf, buf + sizeof(buf), v);
+    out.append(name).append(1, ' ').append(buf, res.ptr).append(1, '\n');
+}
+}
+
+void Metrics::inc_submitted(long long n) { submitted_.add(n); }
+void Metrics::inc_rejected(long long n) { rejected_.add(n); }
+void Metrics::inc_running() { running_.add(); }
+void Metrics::dec_running() { running_.sub(); }
+void Metrics::inc_succeeded() { succeeded_.add(); }
+void Metrics::inc_failed() { failed_.add(); }
+void Metrics::inc_timeout() { timeout_.add(); }
+void Metrics::inc_launch_failed() { launch_failed_.add(); }
+void Metrics::inc_cancelled(long long n) { cancelled_.add(n); }
+void Metrics::inc_backfilled() { backfilled_.add(); }
+void Metrics::inc_pressure_blocked() { pressure_blocked_.add(); }
+void Metrics::set_pressure_active(bool active) { pressure_active_.store(active ? 1 : 0, std::memory_order_relaxed); }
+void Metrics::set_dispatch_factor(double f) { dispatch_factor_.store(f, std::memory_order_relaxed); }
+void Metrics::set_pressure(int resource, double pct) {
+    if (resource >= 0 && resource < 3) pressure_pct_[resource].store(pct, std::memory_order_relaxed);
+}
+void Metrics::set_cpuset(long long free_cpus, long long largest_node_free, long long split_cores) {
+    cpuset_free_.store(free_cpus, std::memory_order_relaxed);
+    cpuset_largest_node_free_.store(largest_node_free, std::memory_order_relaxed);
+    cpuset_split_cores_.store(split_cores, std::memory_order_relaxed);
+}
+void Metrics::record_queue_wait(std::chrono::steady_clock::duration d) {
+    queue_wait_hist_.record(d);
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(d).count();
+    queue_wait_ms_total_.add(ms);
+    queue_wait_count_.add();
+    // 绝大多数样本不刷新最大值，先读再 CAS，避免无谓的写
+    long long prev = queue_wait_ms_max_.load(std::memory_order_relaxed);
+    while (ms > prev && !queue_wait_ms_max_.compare_exchange_weak(prev, ms, std::memory_order_relaxed)) {
     }
 }
-void Metrics::set_pending(long long n) { pending_.store(n); }
+void Metrics::record_launch(std::chrono::steady_clock::duration d) { launch_hist_.record(d); }
+void Metrics::record_run(std::chrono::steady_clock::duration d) { run_hist_.record(d); }
+void Metrics::record_completion_lag(std::chrono::steady_clock::duration d) { completion_lag_hist_.record(d); }
+
+void Metrics::record_usage(const JobUsage &u) {
+    if (!u.valid) return;
+    cpu_usage_hist_.record(u.cpu_usec);
+    // 向上取整到 KiB，非零用量不会落进 0 桶
+    io_bytes_hist_.record((u.io_read_bytes + u.io_write_bytes + 1023) / 1024);
+    if (u.memory_peak_bytes > 0) memory_peak_hist_.record((u.memory_peak_bytes + 1023) / 1024);
+    if (u.pids_peak > 0) pids_peak_hist_.record(u.pids_peak);
+}
+void Metrics::set_pending(long long n) { pending_.store(n, std::memory_order_relaxed); }
+void Metrics::set_dependency_held(long long n) { dependency_held_.store(n, std::memory_order_relaxed); }
+
+void Metrics::set_queue(int queue, const std::string &name, long long pending, long long running, long long cpu, long long mem_mb, double share) {
+    if (queue < 0) return;
+    std::lock_guard lk(queues_mu_);
+    if (queue >= static_cast<int>(queues_.size())) queues_.resize(static_cast<std::size_t>(queue) + 1);
+    auto &g = queues_[queue];
+    if (g.name.empty()) g.name = name;
+    g.pending = pending;
+    g.running = running;
+    g.cpu = cpu;
+    g.mem_mb = mem_mb;
+    g.share = share;
+}
 
 Metrics::Snapshot Metrics::snapshot() const {
     Snapshot s;
-    s.submitted = submitted_.load();
-    s.rejected = rejected_.load();
-    s.running = running_.load();
-    s.succeeded = succeeded_.load();
-    s.failed = failed_.load();
-    s.timeout = timeout_.load();
-    s.launch_failed = launch_failed_.load();
-    s.pressure_blocked = pressure_blocked_.load();
-    s.pressure_active = pressure_active_.load();
-    s.queue_wait_ms_total = queue_wait_ms_total_.load();
-    s.queue_wait_count = queue_wait_count_.load();
-    s.queue_wait_ms_max = queue_wait_ms_max_.load();
-    s.pending = pending_.load();
+    s.submitted = submitted_.value();
+    s.rejected = rejected_.value();
+    s.running = running_.value();
+    s.succeeded = succeeded_.value();
+    s.failed = failed_.value();
+    s.timeout = timeout_.value();
+    s.launch_failed = launch_failed_.value();
+    s.cancelled = cancelled_.value();
+    s.backfilled = backfilled_.value();
+    s.pressure_blocked = pressure_blocked_.value();
+    s.pressure_active = pressure_active_.load(std::memory_order_relaxed);
+    s.queue_wait_ms_total = queue_wait_ms_total_.value();
+    s.queue_wait_count = queue_wait_count_.value();
+    s.queue_wait_ms_max = queue_wait_ms_max_.load(std::memory_order_relaxed);
+    s.pending = pending_.load(std::memory_order_relaxed);
+    s.dependency_held = dependency_held_.load(std::memory_order_relaxed);
+    s.dispatch_factor = dispatch_factor_.load(std::memory_order_relaxed);
+    for (int i = 0; i < 3; ++i) s.pressure_pct[i] = pressure_pct_[i].load(std::memory_order_relaxed);
+    s.cpuset_free = cpuset_free_.load(std::memory_order_relaxed);
+    s.cpuset_largest_node_free = cpuset_largest_node_free_.load(std::memory_order_relaxed);
+    s.cpuset_split_cores = cpuset_split_cores_.load(std::memory_order_relaxed);
     return s;
 }
 
-std::string Metrics::to_prometheus() const {
+void Metrics::render_prometheus(std::string &out) const {
     auto s = snapshot();
-    std::ostringstream oss;
-    oss << "# TYPE tasks_total counter\n";
-    oss << "tasks_total{status=\"submitted\"} " << s.submitted << "\n";
-    oss << "tasks_total{status=\"rejected\"} " << s.rejected << "\n";
-    oss << "tasks_total{status=\"succeeded\"} " << s.succeeded << "\n";
-    oss << "tasks_total{status=\"failed\"} " << s.failed << "\n";
-    oss << "tasks_total{status=\"timeout\"} " << s.timeout << "\n";
-    oss << "tasks_total{status=\"launch_failed\"} " << s.launch_failed << "\n";
-    oss << "# TYPE tasks_running_current gauge\n";
-    oss << "tasks_running_current " << s.running << "\n";
-    oss << "# TYPE tasks_pending_current gauge\n";
-    oss << "tasks_pending_current " << s.pending << "\n";
-    oss << "# TYPE tasks_pressure_blocked_total counter\n";
-    oss << "tasks_pressure_blocked_total " << s.pressure_blocked << "\n";
-    oss << "# TYPE tasks_pressure_active gauge\n";
-    oss << "tasks_pressure_active " << s.pressure_active << "\n";
-    oss << "# TYPE tasks_queue_wait_ms_total counter\n";
-    oss << "tasks_queue_wait_ms_total " << s.queue_wait_ms_total << "\n";
-    oss << "# TYPE tasks_queue_wait_count counter\n";
-    oss << "tasks_queue_wait_count " << s.queue_wait_count << "\n";
-    oss << "# TYPE tasks_queue_wait_ms_max gauge\n";
-    oss << "tasks_queue_wait_ms_max " << s.queue_wait_ms_max << "\n";
-    return oss.str();
+    out += "# TYPE tasks_total counter\n";
+    append_sample(out, "tasks_total{status=\"submitted\"}", s.submitted);
+    append_sample(out, "tasks_total{status=\"rejected\"}", s.rejected);
+    append_sample(out, "tasks_total{status=\"succeeded\"}", s.succeeded);
+    append_sample(out, "tasks_total{status=\"failed\"}", s.failed);
+    append_sample(out, "tasks_total{status=\"timeout\"}", s.timeout);
+    append_sample(out, "tasks_total{status=\"launch_failed\"}", s.launch_failed);
+    append_sample(out, "tasks_total{status=\"cancelled\"}", s.cancelled);
+    out += "# TYPE tasks_running_current gauge\n";
+    append_sample(out, "tasks_running_current", s.running);
+    out += "# TYPE tasks_pending_current gauge\n";
+    append_sample(out, "tasks_pending_current", s.pending);
+    out += "# TYPE tasks_dependency_held_current gauge\n";
+    append_sample(out, "tasks_dependency_held_current", s.dependency_held);
+    out += "# TYPE tasks_backfilled_total counter\n";
+    append_sample(out, "tasks_backfilled_total", s.backfilled);
+    out += "# TYPE tasks_pressure_blocked_total counter\n";
+    append_sample(out, "tasks_pressure_blocked_total", s.pressure_blocked);
+    out += "# TYPE tasks_pressure_active gauge\n";
+    append_sample(out, "tasks_pressure_active", s.pressure_active);
+    out += "# TYPE tasks_dispatch_rate_factor gauge\n";
+    append_sample(out, "tasks_dispatch_rate_factor", s.dispatch_factor);
+    out += "# TYPE tasks_pressure_percent gauge\n";
+    append_sample(out, "tasks_pressure_percent{resource=\"memory\"}", s.pressure_pct[0]);
+    append_sample(out, "tasks_pressure_percent{resource=\"cpu\"}", s.pressure_pct[1]);
+    append_sample(out, "tasks_pressure_percent{resource=\"io\"}", s.pressure_pct[2]);
+    out += "# TYPE tasks_cpuset_free_cpus gauge\n";
+    append_sample(out, "tasks_cpuset_free_cpus", s.cpuset_free);
+    out += "# TYPE tasks_cpuset_largest_node_free_cpus gauge\n";
+    append_sample(out, "tasks_cpuset_largest_node_free_cpus", s.cpuset_largest_node_free);
+    out += "# TYPE tasks_cpuset_split_cores gauge\n";
+    append_sample(out, "tasks_cpuset_split_cores", s.cpuset_split_cores);
+    // 单节点任务用不上的空闲 CPU 比例
+    out += "# TYPE tasks_cpuset_fragmentation_ratio gauge\n";
+    append_sample(out, "tasks_cpuset_fragmentation_ratio",
+                  s.cpuset_free > 0 ? 1.0 - static_cast<double>(s.cpuset_largest_node_free) / static_cast<double>(s.cpuset_free) : 0.0);
+    out += "# TYPE tasks_queue_wait_ms_total counter\n";
+    append_sample(out, "tasks_queue_wait_ms_total", s.queue_wait_ms_total);
+    out += "# TYPE tasks_queue_wait_count counter\n";
+    append_sample(out, "tasks_queue_wait_count", s.queue_wait_count);
+    out += "# TYPE tasks_queue_wait_ms_max gauge\n";
+    append_sample(out, "tasks_queue_wait_ms_max", s.queue_wait_ms_max);
+    {
+        // 队列名已在提交时校验，只含标签中无需转义的字符
+        std::lock_guard lk(queues_mu_);
+        auto family = [&](const char *name, auto value) {
+            out += "# TYPE ";
+            out += name;
+            out += " gauge\n";
+            for (const auto &g : queues_) {
+                if (g.name.empty()) continue;
+                label_.assign(name).append("{queue=\"").append(g.name).append("\"}");
+                append_sample(out, label_, value(g));
+            }
+        };
+        family("tasks_queue_pending", [](const QueueGauges &g) { return g.pending; });
+        family("tasks_queue_running", [](const QueueGauges &g) { return g.running; });
+        family("tasks_queue_cpu_used", [](const QueueGauges &g) { return g.cpu; });
+        family("tasks_queue_memory_used_bytes", [](const QueueGauges &g) { return g.mem_mb * 1024 * 1024; });
+        family("tasks_queue_dominant_share", [](const QueueGauges &g) { return g.share; });
+    }
+    queue_wait_hist_.write_prometheus(out, "tasks_queue_wait_seconds");
+    launch_hist_.write_prometheus(out, "tasks_launch_seconds");
+    run_hist_.write_prometheus(out, "tasks_run_duration_seconds");
+    completion_lag_hist_.write_prometheus(out, "tasks_completion_lag_seconds");
+    cpu_usage_hist_.write_prometheus(out, "tasks_job_cpu_seconds");
+    memory_peak_hist_.write_prometheus(out, "tasks_job_memory_peak_bytes", LatencyHistogram::Unit::Kibibytes);
+    io_bytes_hist_.write_prometheus(out, "tasks_job_io_bytes", LatencyHistogram::Unit::Kibibytes);
+    pids_peak_hist_.write_prometheus(out, "tasks_job_pids_peak", LatencyHistogram::Unit::Count);
+}
+
+std::string Metrics::to_prometheus() const {
+    std::string out;
+    render_prometheus(out);
+    return out;
 }
@@ -1,9 +1,17 @@
 #pragma once
 
+#include "job.h"
+#include "latency_histogram.h"
+#include "sharded_counter.h"
+
 #include <atomic>
+#include <chrono>
+#include <mutex>
 #include <string>
 #include <vector>
 
+// 计数类指标按线程分片（relaxed），snapshot() 时汇总；各分片与独立的原子量均按缓存行对齐，
+// 互不伪共享。snapshot 不是原子快照，并发写入时各项之间可能相差正在进行的几次更新。
 class Metrics {
 public:
     struct Snapshot {
@@ -14,42 +22,109 @@ public:
         long long failed{0};
         long long timeout{0};
         long long launch_failed{0};
+        long long cancelled{0};
+        long long backfilled{0};
         long long pressure_blocked{0};
         long long pressure_active{0};
         long long queue_wait_ms_total{0};
         long long queue_wait_count{0};
         long long queue_wait_ms_max{0};
         long long pending{0};
+        long long dependency_held{0}; // 等待依赖、尚不可派发的任务（计入 pending）
+        double dispatch_factor{1.0};     // PSI 分级限速系数，1 为不限速
+        double pressure_pct[3]{0, 0, 0}; // memory / cpu / io 的 some 压力百分比
+        long long cpuset_free{0};         // 拓扑感知放置：空闲逻辑 CPU
+        long long cpuset_largest_node_free{0};
+        long long cpuset_split_cores{0};
     };
 
-    void inc_submitted();
-    void inc_rejected();
+    void inc_submitted(long long n = 1);
+    void inc_rejected(long long n = 1);
     void inc_running();
     void dec_running();
     void inc_succeeded();
     void inc_failed();
     void inc_timeout();
     void inc_launch_failed();
+    // 依赖无法满足而被取消的任务
+    void inc_cancelled(long long n = 1);
+    void inc_backfilled();
     void inc_pressure_blocked();
     void set_pressure_active(bool active);
-    void record_queue_wait(long long ms);
+    void set_dispatch_factor(double f);
+    // resource 与 PressureMonitor::Resource 对应
+    void set_pressure(int resource, double pct);
+    // 拓扑感知放置的碎片情况，在每次分配与释放 CPU 后更新
+    void set_cpuset(long long free_cpus, long long largest_node_free, long long split_cores);
+    void record_queue_wait(std::chrono::steady_clock::duration d);
+    // 调用 launch_process 到返回（vfork/clone3 下即到子进程 exec）的耗时
+    void record_launch(std::chrono::steady_clock::duration d);
+    void record_run(std::chrono::steady_clock::duration d);
+    // 回收线程发现退出到收尾完成（资源释放、调度器已唤醒）的耗时
+    void record_completion_lag(std::chrono::steady_clock::duration d);
     void set_pending(long long n);
+    void set_dependency_held(long long n);
+    // 单个队列的待调度数、运行数、运行中 CPU/内存用量与加权主导份额；queue 为 FairShareQueue 的编号，
+    // 只在该队列变化时调用
+    void set_queue(int queue, const std::string &name, long long pending, long long running, long long cpu, long long mem_mb, double share);
+    // 任务 cgroup 删除前采集的用量；valid 为 false 时忽略，峰值为 0（未知）时不计入对应直方图
+    void record_usage(const JobUsage &u);
 
     Snapshot snapshot() const;
+    const LatencyHistogram &queue_wait_histogram() const { return queue_wait_hist_; }
+    const LatencyHistogram &launch_histogram() const { return launch_hist_; }
+    const LatencyHistogram &run_histogram() const { return run_hist_; }
+    const LatencyHistogram &completion_lag_histogram() const { return completion_lag_hist_; }
+    const LatencyHistogram &cpu_usage_histogram() const { return cpu_usage_hist_; }
+    const LatencyHistogram &memory_peak_histogram() const { return memory_peak_hist_; }
+    // 以 Prometheus 文本格式追加到 out；调用方复用同一缓冲区时稳态下不分配内存
+    void render_prometheus(std::string &out) const;
     std::string to_prometheus() const;
 
 private:
-    std::atomic<long long> submitted_{0};
-    std::atomic<long long> rejected_{0};
-    std::atomic<long long> running_{0};
-    std::atomic<long long> succeeded_{0};
-    std::atomic<long long> failed_{0};
-    std::atomic<long long> timeout_{0};
-    std::atomic<long long> launch_failed_{0};
-    std::atomic<long long> pressure_blocked_{0};
-    std::atomic<long long> pressure_active_{0};
-    std::atomic<long long> queue_wait_ms_total_{0};
-    std::atomic<long long> queue_wait_count_{0};
-    std::atomic<long long> queue_wait_ms_max_{0};
-    std::atomic<long long> pending_{0};
+    ShardedCounter submitted_;
+    ShardedCounter rejected_;
+    ShardedCounter running_;
+    ShardedCounter succeeded_;
+    ShardedCounter failed_;
+    ShardedCounter timeout_;
+    ShardedCounter launch_failed_;
+    ShardedCounter cancelled_;
+    ShardedCounter backfilled_;
+    ShardedCounter pressure_blocked_;
+    ShardedCounter queue_wait_ms_total_;
+    ShardedCounter queue_wait_count_;
+    // 直接赋值的量无法分片，各占一条缓存行
+    alignas(64) std::atomic<long long> pressure_active_{0};
+    alignas(64) std::atomic<long long> queue_wait_ms_max_{0};
+    alignas(64) std::atomic<long long> pending_{0};
+    std::atomic<long long> dependency_held_{0};
+    // 仅由 PSI 线程按窗口写入，共用一条缓存行
+    alignas(64) std::atomic<double> dispatch_factor_{1.0};
+    std::atomic<double> pressure_pct_[3]{};
+    // 派发与回收线程都会写，与 PSI 分开
+    alignas(64) std::atomic<long long> cpuset_free_{0};
+    std::atomic<long long> cpuset_largest_node_free_{0};
+    std::atomic<long long> cpuset_split_cores_{0};
+    // 各队列的量按编号存放，导出时带 queue 标签
+    struct QueueGauges {
+        std::string name;
+        long long pending{0};
+        long long running{0};
+        long long cpu{0};
+        long long mem_mb{0};
+        double share{0};
+    };
+    mutable std::mutex queues_mu_;
+    std::vector<QueueGauges> queues_;
+    mutable std::string label_; // 导出时拼接 "<名称>{queue=...}"，受 queues_mu_ 保护，稳态下不分配
+    LatencyHistogram queue_wait_hist_;
+    LatencyHistogram launch_hist_;
+    LatencyHistogram run_hist_;
+    LatencyHistogram completion_lag_hist_;
+    // 任务用量：cpu 以微秒记，内存与 io 以 KiB 记（导出为字节），pids 为个数
+    LatencyHistogram cpu_usage_hist_;
+    LatencyHistogram memory_peak_hist_;
+    LatencyHistogram io_bytes_hist_;
+    LatencyHistogram pids_peak_hist_;
 };
@@ -4,35 +4,137 @@
 
 #include <arpa/inet.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
+#include <cerrno>
+#include <algorithm>
+#include <charconv>
 #include <cstring>
+#include <string_view>
+#include <vector>
+
+#ifdef TASKSCHEDULER_ENABLE_ZLIB
+#include <zlib.h>
+#endif
 
 using namespace NanoLog::LogLevels;
 
 namespace {
-std::string build_response(const std::string &body, const std::string &content_type = "text/plain") {
-    std::string resp;
-    resp += "HTTP/1.1 200 OK\r\n";
-    resp += "Content-Type: " + content_type + "\r\n";
-    resp += "Content-Length: " + std::to_string(body.size()) + "\r\n";
-    resp += "Connection: close\r\n\r\n";
-    resp += body;
-    return resp;
+// 管线化请求的响应累计超过该值后暂停处理，等写出后再继续
+constexpr std::size_t kMaxPendingOutput = 1024 * 1024;
+// 读缓冲超过该值时暂停读取（客户端只发不收）
+constexpr std::size_t kMaxBufferedInput = 64 * 1024;
+// 单次 sendmsg 最多聚合的片段数
+constexpr int kMaxIov = 64;
+
+bool iequals(std::string_view a, std::string_view b) {
+    if (a.size() != b.size()) return false;
+    for (std::size_t i = 0; i < a.size(); ++i) {
+        char x = a[i], y = b[i];
+        if (x >= 'A' && x <= 'Z') x = static_cast<char>(x - 'A' + 'a');
+        if (y >= 'A' && y <= 'Z') y = static_cast<char>(y - 'A' + 'a');
+        if (x != y) return false;
+    }
+    return true;
 }
+
+std::string_view trim(std::string_view s) {
+    while (!s.empty() && (s.front() == ' ' || s.front() == '\t')) s.remove_prefix(1);
+    while (!s.empty() && (s.back() == ' ' || s.back() == '\t')) s.remove_suffix(1);
+    return s;
 }
 
-bool MetricsHttpServer::start(int port, MetricsHandler handler) {
+bool contains_token(std::string_view value, std::string_view token) {
+    while (!value.empty()) {
+        auto comma = value.find(',');
+        if (iequals(trim(value.substr(0, comma)), token)) return true;
+        if (comma == std::string_view::npos) break;
+        value.remove_prefix(comma + 1);
+    }
+    return false;
+}
+
+// Accept-Encoding 中列出 gzip 且未以 q=0 排除
+bool accepts_gzip(std::string_view value) {
+    while (!value.empty()) {
+        auto comma = value.find(',');
+        std::string_view item = value.substr(0, comma);
+        auto semi = item.find(';');
+        if (iequals(trim(item.substr(0, semi)), "gzip")) {
+            if (semi == std::string_view::npos) return true;
+            std::string_view param = trim(item.substr(semi + 1));
+            if (param.size() < 2 || !iequals(param.substr(0, 2), "q=")) return true;
+            return std::strtod(std::string(param.substr(2)).c_str(), nullptr) > 0;
+        }
+        if (comma == std::string_view::npos) break;
+        value.remove_prefix(comma + 1);
+    }
+    return false;
+}
+
+// 无其它引用时原地复用缓冲区（保留容量），否则换一份新的
+std::string &reusable(std::shared_ptr<std::string> &p) {
+    if (!p || p.use_count() > 1) p = std::make_shared<std::string>();
+    else p->clear();
+    return *p;
+}
+
+void append_status_line(std::string &out, int code, const char *reason) {
+    char buf[16];
+    auto res = std::to_chars(buf, buf + sizeof(buf), code);
+    out.append("HTTP/1.1 ").append(buf, res.ptr).append(1, ' ').append(reason);
+}
+
+void append_header_tail(std::string &out, std::size_t content_length, bool keep_alive, bool gzip) {
+    char buf[24];
+    auto res = std::to_chars(buf, buf + sizeof(buf), content_length);
+    out.append("\r\nContent-Type: text/plain; version=0.0.4\r\n");
+    if (gzip) out.append("Content-Encoding: gzip\r\n");
+    out.append("Content-Length: ").append(buf, res.ptr);
+    out.append(keep_alive ? "\r\nConnection: keep-alive\r\n\r\n" : "\r\nConnection: close\r\n\r\n");
+}
+}
+
+#ifdef TASKSCHEDULER_ENABLE_ZLIB
+// 复用同一个 deflate 状态，避免每次压缩重新分配 zlib 内部缓冲
+struct MetricsHttpServer::GzipState {
+    z_stream zs{};
+    bool ready{false};
+    ~GzipState() {
+        if (ready) deflateEnd(&zs);
+    }
+};
+#else
+struct MetricsHttpServer::GzipState {};
+#endif
+
+MetricsHttpServer::MetricsHttpServer() = default;
+MetricsHttpServer::~MetricsHttpServer() { stop(); }
+
+bool MetricsHttpServer::start(int port, MetricsHandler handler, int cache_ttl_ms) {
     if (running_.exchange(true)) return false;
     handler_ = std::move(handler);
+    cache_ttl_ = std::chrono::milliseconds(std::max(0, cache_ttl_ms));
+    cache_valid_ = false;
 
-    listen_fd_ = ::socket(AF_INET, SOCK_STREAM, 0);
-    if (listen_fd_ < 0) {
-        NANO_LOG(ERROR, "%s", "Failed to create socket");
+    auto fail = [this](const std::string &what) {
+        auto msg = what + ": " + std::strerror(errno);
+        NANO_LOG(ERROR, "%s", msg.c_str());
+        for (int *fd : {&listen_fd_, &epoll_fd_, &wake_fd_}) {
+            if (*fd >= 0) ::close(*fd);
+            *fd = -1;
+        }
         running_ = false;
         return false;
-    }
+    };
+
+    listen_fd_ = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listen_fd_ < 0) return fail("Failed to create socket");
 
     int opt = 1;
     setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
@@ -43,100 +145,373 @@ bool MetricsHttpServer::start(int port, MetricsHandler handler) {
     addr.sin_port = htons(static_cast<uint16_t>(port));
 
     if (bind(listen_fd_, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0) {
-        auto msg = std::string("Failed to bind port ") + std::to_string(port);
-        NANO_LOG(ERROR, "%s", msg.c_str());
-        ::close(listen_fd_);
-        running_ = false;
-        return false;
-    }
-    if (listen(listen_fd_, 64) < 0) {
-        NANO_LOG(ERROR, "%s", "listen() failed");
-        ::close(listen_fd_);
-        running_ = false;
-        return false;
+        return fail("Failed to bind port " + std::to_string(port));
     }
+    if (listen(listen_fd_, 1024) < 0) return fail("listen() failed");
+    socklen_t len = sizeof(addr);
+    if (getsockname(listen_fd_, reinterpret_cast<sockaddr *>(&addr), &len) == 0) port_ = ntohs(addr.sin_port);
 
-    accept_thread_ = std::thread(&MetricsHttpServer::accept_loop, this, port);
-
-    unsigned worker_count = std::max(2u, std::thread::hardware_concurrency());
-    for (unsigned i = 0; i < worker_count; ++i) {
-        workers_.emplace_back(&MetricsHttpServer::worker_loop, this);
+    epoll_fd_ = ::epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd_ < 0) return fail("epoll_create1 failed");
+    wake_fd_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wake_fd_ < 0) return fail("eventfd failed");
+    for (int fd : {listen_fd_, wake_fd_}) {
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.fd = fd;
+        if (::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev) < 0) return fail("epoll_ctl failed");
     }
-    NANO_LOG(NOTICE, "Metrics HTTP server started on port %d", port);
+
+    loop_thread_ = std::thread(&MetricsHttpServer::event_loop, this);
+    NANO_LOG(NOTICE, "Metrics HTTP server started on port %d", port_);
     return true;
 }
 
 void MetricsHttpServer::stop() {
     if (!running_.exchange(false)) return;
-    if (listen_fd_ >= 0) {
-        ::shutdown(listen_fd_, SHUT_RDWR);
-        ::close(listen_fd_);
-        listen_fd_ = -1;
+    std::uint64_t one = 1;
+    [[maybe_unused]] auto r = ::write(wake_fd_, &one, sizeof(one));
+    if (loop_thread_.joinable()) loop_thread_.join();
+    for (auto &[fd, c] : conns_) ::close(fd);
+    conns_.clear();
+    for (int *fd : {&listen_fd_, &epoll_fd_, &wake_fd_}) {
+        if (*fd >= 0) ::close(*fd);
+        *fd = -1;
     }
-    q_cv_.notify_all();
-    if (accept_thread_.joinable()) accept_thread_.join();
-    for (auto &t : workers_) {
-        if (t.joinable()) t.join();
-    }
-    workers_.clear();
     NANO_LOG(NOTICE, "%s", "Metrics HTTP server stopped");
 }
 
-void MetricsHttpServer::accept_loop(int /*port*/) {
+void MetricsHttpServer::event_loop() {
+    std::vector<epoll_event> events(256);
+    auto last_sweep = std::chrono::steady_clock::now();
     while (running_.load()) {
-        sockaddr_in cli{};
-        socklen_t len = sizeof(cli);
-        int fd = ::accept(listen_fd_, reinterpret_cast<sockaddr *>(&cli), &len);
-        if (fd < 0) {
-            if (!running_.load()) break;
-            continue;
+        int n = ::epoll_wait(epoll_fd_, events.data(), static_cast<int>(events.size()), 1000);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            auto msg = std::string("metrics epoll_wait failed: ") + std::strerror(errno);
+            NANO_LOG(ERROR, "%s", msg.c_str());
+            break;
         }
-        {
-            std::lock_guard lk(q_mu_);
-            if (conn_q_.size() < 128) {
-                conn_q_.push(fd);
-                q_cv_.notify_one();
-            } else {
-                ::close(fd); // drop when queue is full
+        for (int i = 0; i < n; ++i) {
+            int fd = events[i].data.fd;
+            if (fd == wake_fd_) continue;
+            if (fd == listen_fd_) {
+                accept_all();
+                continue;
             }
+            auto it = conns_.find(fd);
+            if (it == conns_.end()) continue;
+            Connection &c = it->second;
+            if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+                close_connection(fd);
+                continue;
+            }
+            if (events[i].events & EPOLLOUT) {
+                on_writable(c);
+            } else if (events[i].events & EPOLLIN) {
+                on_readable(c);
+            }
+        }
+        auto now = std::chrono::steady_clock::now();
+        if (now - last_sweep >= std::chrono::seconds(1)) {
+            sweep_idle(now);
+            last_sweep = now;
         }
     }
 }
 
-void MetricsHttpServer::worker_loop() {
-    while (running_.load()) {
-        int fd = -1;
-        {
-            std::unique_lock lk(q_mu_);
-            q_cv_.wait(lk, [&] { return !running_.load() || !conn_q_.empty(); });
-            if (!running_.load() && conn_q_.empty()) break;
-            if (!conn_q_.empty()) {
-                fd = conn_q_.front();
-                conn_q_.pop();
+void MetricsHttpServer::accept_all() {
+    while (true) {
+        int fd = ::accept4(listen_fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                auto msg = std::string("metrics accept failed: ") + std::strerror(errno);
+                NANO_LOG(WARNING, "%s", msg.c_str());
             }
+            return;
+        }
+        if (conns_.size() >= kMaxConnections) {
+            ::close(fd);
+            continue;
+        }
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.fd = fd;
+        if (::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev) < 0) {
+            ::close(fd);
+            continue;
         }
-        if (fd < 0) continue;
+        Connection &c = conns_[fd];
+        c.fd = fd;
+        c.last_active = std::chrono::steady_clock::now();
+    }
+}
 
-        char buf[1024]{};
-        ssize_t n = ::recv(fd, buf, sizeof(buf) - 1, 0);
-        std::string body = "ok\n";
-        std::string path = "/";
+void MetricsHttpServer::on_readable(Connection &c) {
+    char buf[4096];
+    while (c.in.size() < kMaxBufferedInput) {
+        ssize_t n = ::recv(c.fd, buf, sizeof(buf), 0);
         if (n > 0) {
-            std::string req(buf, buf + n);
-            auto pos = req.find(' ');
-            auto pos2 = req.find(' ', pos + 1);
-            if (pos != std::string::npos && pos2 != std::string::npos) {
-                path = req.substr(pos + 1, pos2 - pos - 1);
+            c.in.append(buf, static_cast<std::size_t>(n));
+            continue;
+        }
+        if (n == 0) {
+            close_connection(c.fd); // 对端关闭；未完成的请求无需应答
+            return;
+        }
+        if (errno == EINTR) continue;
+        if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+        close_connection(c.fd);
+        return;
+    }
+    c.last_active = std::chrono::steady_clock::now();
+    process_requests(c);
+    if (!flush_out(c)) {
+        close_connection(c.fd);
+        return;
+    }
+    update_interest(c);
+}
+
+void MetricsHttpServer::on_writable(Connection &c) {
+    c.last_active = std::chrono::steady_clock::now();
+    if (!flush_out(c)) {
+        close_connection(c.fd);
+        return;
+    }
+    // 写空后继续处理已缓冲的管线化请求
+    if (c.out.empty() && !c.close_after_write) {
+        process_requests(c);
+        if (!flush_out(c)) {
+            close_connection(c.fd);
+            return;
+        }
+    }
+    update_interest(c);
+}
+
+void MetricsHttpServer::process_requests(Connection &c) {
+    std::size_t consumed = 0;
+    std::string_view buf(c.in);
+    while (!c.close_after_write && c.out_bytes < kMaxPendingOutput) {
+        std::string_view rest = buf.substr(consumed);
+        auto header_end = rest.find("\r\n\r\n");
+        if (header_end == std::string_view::npos) {
+            if (rest.size() > kMaxRequestHeader) {
+                c.close_after_write = true;
+                append_response(c, 431, "Request Header Fields Too Large", "header too large\n", false);
+                consumed = buf.size();
+            }
+            break;
+        }
+        std::string_view head = rest.substr(0, header_end);
+        auto line_end = head.find("\r\n");
+        std::string_view request_line = head.substr(0, line_end);
+        auto sp1 = request_line.find(' ');
+        auto sp2 = sp1 == std::string_view::npos ? sp1 : request_line.find(' ', sp1 + 1);
+        if (sp2 == std::string_view::npos) {
+            c.close_after_write = true;
+            append_response(c, 400, "Bad Request", "bad request\n", false);
+            consumed = buf.size();
+            break;
+        }
+        std::string_view method = request_line.substr(0, sp1);
+        std::string_view target = request_line.substr(sp1 + 1, sp2 - sp1 - 1);
+        std::string_view version = request_line.substr(sp2 + 1);
+
+        bool keep_alive = version == "HTTP/1.1";
+        bool gzip = false;
+        bool bad_length = false;
+        std::size_t content_length = 0;
+        std::string_view headers = line_end == std::string_view::npos ? std::string_view{} : head.substr(line_end + 2);
+        while (!headers.empty()) {
+            auto eol = headers.find("\r\n");
+            std::string_view line = headers.substr(0, eol);
+            headers = eol == std::string_view::npos ? std::string_view{} : headers.substr(eol + 2);
+            auto colon = line.find(':');
+            if (colon == std::string_view::npos) continue;
+            std::string_view name = trim(line.substr(0, colon));
+            std::string_view value = trim(line.substr(colon + 1));
+            if (iequals(name, "connection")) {
+                if (contains_token(value, "close")) keep_alive = false;
+                else if (contains_token(value, "keep-alive")) keep_alive = true;
+            } else if (iequals(name, "accept-encoding")) {
+                gzip = accepts_gzip(value);
+            } else if (iequals(name, "content-length")) {
+                // 只接受纯十进制数字；溢出、空值或带符号的都按错误请求处理
+                auto res = std::from_chars(value.data(), value.data() + value.size(), content_length);
+                bad_length = bad_length || value.empty() || res.ec != std::errc{} || res.ptr != value.data() + value.size();
             }
-            if (path == "/metrics") {
-                body = handler_ ? handler_() : std::string{};
-            } else if (path == "/health") {
-                body = "ok\n";
+        }
+        if (bad_length) {
+            c.close_after_write = true;
+            append_response(c, 400, "Bad Request", "bad content-length\n", false);
+            consumed = buf.size();
+            break;
+        }
+        // 先限制长度再求和，total 不会回绕
+        if (content_length > kMaxBufferedInput) {
+            c.close_after_write = true;
+            append_response(c, 413, "Payload Too Large", "payload too large\n", false);
+            consumed = buf.size();
+            break;
+        }
+        std::size_t total = header_end + 4 + content_length;
+        if (rest.size() < total) break; // 请求体尚未收全
+        consumed += total;
+
+        if (auto q = target.find('?'); q != std::string_view::npos) target = target.substr(0, q);
+        c.close_after_write = !keep_alive;
+        bool head_only = method == "HEAD";
+        if (method != "GET" && !head_only) {
+            append_response(c, 405, "Method Not Allowed", "method not allowed\n", false);
+        } else if (target == "/metrics") {
+            append_metrics(c, gzip, head_only);
+        } else if (target == "/health" || target == "/") {
+            append_response(c, 200, "OK", "ok\n", head_only);
+        } else {
+            append_response(c, 404, "Not Found", "not found\n", head_only);
+        }
+    }
+    c.in.erase(0, consumed);
+}
+
+void MetricsHttpServer::append_response(Connection &c, int code, const char *reason, std::string_view body, bool head_only) {
+    auto resp = std::make_shared<std::string>();
+    append_status_line(*resp, code, reason);
+    append_header_tail(*resp, body.size(), !c.close_after_write, false);
+    if (!head_only) resp->append(body);
+    push_segment(c, std::move(resp));
+}
+
+void MetricsHttpServer::append_metrics(Connection &c, bool gzip, bool head_only) {
+    refresh_cache(std::chrono::steady_clock::now());
+    const Rendered &r = gzip && ensure_gzip() ? gzip_ : plain_;
+    push_segment(c, r.header[c.close_after_write ? 0 : 1]);
+    if (!head_only) push_segment(c, r.body);
+}
+
+void MetricsHttpServer::push_segment(Connection &c, Buffer b) {
+    if (!b || b->empty()) return;
+    c.out_bytes += b->size();
+    c.out.push_back(std::move(b));
+}
+
+void MetricsHttpServer::refresh_cache(std::chrono::steady_clock::time_point now) {
+    if (cache_valid_ && cache_ttl_.count() > 0 && now - rendered_at_ < cache_ttl_) return;
+    std::string &body = reusable(plain_.body);
+    if (handler_) handler_(body);
+    for (int keep_alive = 0; keep_alive < 2; ++keep_alive) {
+        std::string &h = reusable(plain_.header[keep_alive]);
+        append_status_line(h, 200, "OK");
+        append_header_tail(h, body.size(), keep_alive, false);
+    }
+    rendered_at_ = now;
+    cache_valid_ = true;
+    gzip_valid_ = false;
+}
+
+bool MetricsHttpServer::ensure_gzip() {
+#ifdef TASKSCHEDULER_ENABLE_ZLIB
+    if (gzip_valid_) return true;
+    if (!gz_) gz_ = std::make_unique<GzipState>();
+    z_stream &zs = gz_->zs;
+    if (!gz_->ready) {
+        // windowBits 15+16 输出 gzip 封装；指标文本重复度高，最快档位即可压到原来的一成左右
+        if (deflateInit2(&zs, Z_BEST_SPEED, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) return false;
+        gz_->ready = true;
+    } else {
+        deflateReset(&zs);
+    }
+    const std::string &in = *plain_.body;
+    std::string &out = reusable(gzip_.body);
+    out.resize(deflateBound(&zs, in.size()));
+    zs.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(in.data()));
+    zs.avail_in = static_cast<uInt>(in.size());
+    zs.next_out = reinterpret_cast<Bytef *>(out.data());
+    zs.avail_out = static_cast<uInt>(out.size());
+    if (deflate(&zs, Z_FINISH) != Z_STREAM_END) return false;
+    out.resize(zs.total_out);
+    for (int keep_alive = 0; keep_alive < 2; ++keep_alive) {
+        std::string &h = reusable(gzip_.header[keep_alive]);
+        append_status_line(h, 200, "OK");
+        append_header_tail(h, out.size(), keep_alive, true);
+    }
+    gzip_valid_ = true;
+    return true;
+#else
+    return false;
+#endif
+}
+
+// sendmsg 等同 writev 的聚合写，另外可带 MSG_NOSIGNAL
+bool MetricsHttpServer::flush_out(Connection &c) {
+    while (c.out_idx < c.out.size()) {
+        iovec iov[kMaxIov];
+        int n = 0;
+        for (std::size_t i = c.out_idx; i < c.out.size() && n < kMaxIov; ++i, ++n) {
+            const std::string &b = *c.out[i];
+            std::size_t off = i == c.out_idx ? c.out_off : 0;
+            iov[n].iov_base = const_cast<char *>(b.data() + off);
+            iov[n].iov_len = b.size() - off;
+        }
+        msghdr msg{};
+        msg.msg_iov = iov;
+        msg.msg_iovlen = static_cast<std::size_t>(n);
+        ssize_t w = ::sendmsg(c.fd, &msg, MSG_NOSIGNAL);
+        if (w < 0 && errno == EINTR) continue;
+        if (w < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return true;
+        if (w <= 0) return false;
+        auto left = static_cast<std::size_t>(w);
+        while (left > 0) {
+            std::size_t rem = c.out[c.out_idx]->size() - c.out_off;
+            if (left < rem) {
+                c.out_off += left;
+                break;
             }
+            left -= rem;
+            ++c.out_idx;
+            c.out_off = 0;
         }
-        auto resp = build_response(body);
-        ::send(fd, resp.data(), resp.size(), 0);
-        ::shutdown(fd, SHUT_RDWR);
-        ::close(fd);
     }
+    c.out.clear(); // 保留容量，稳态下不再分配
+    c.out_idx = 0;
+    c.out_off = 0;
+    c.out_bytes = 0;
+    return true;
+}
+
+// 有未写完的数据时只关注可写，不再读取新请求（背压）；写空后恢复读
+void MetricsHttpServer::update_interest(Connection &c) {
+    if (c.out.empty() && c.close_after_write) {
+        close_connection(c.fd);
+        return;
+    }
+    bool want_write = !c.out.empty();
+    if (want_write == c.want_write) return;
+    epoll_event ev{};
+    ev.events = want_write ? EPOLLOUT : EPOLLIN;
+    ev.data.fd = c.fd;
+    if (::epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, c.fd, &ev) < 0) {
+        close_connection(c.fd);
+        return;
+    }
+    c.want_write = want_write;
+}
+
+void MetricsHttpServer::close_connection(int fd) {
+    ::epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+    ::close(fd);
+    conns_.erase(fd);
+}
+
+void MetricsHttpServer::sweep_idle(std::chrono::steady_clock::time_point now) {
+    std::vector<int> idle;
+    for (const auto &[fd, c] : conns_) {
+        if (now - c.last_active >= std::chrono::milliseconds(kIdleTimeoutMs)) idle.push_back(fd);
+    }
+    for (int fd : idle) close_connection(fd);
 }
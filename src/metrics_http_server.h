@@ -1,33 +1,93 @@
 #pragma once
 
 #include <atomic>
-#include <condition_variable>
+#include <chrono>
+#include <cstddef>
 #include <functional>
-#include <mutex>
-#include <queue>
+#include <memory>
 #include <string>
+#include <string_view>
 #include <thread>
+#include <unordered_map>
 #include <vector>
 
+// 单线程 epoll 事件循环的指标 HTTP 服务：非阻塞 accept/读/写，支持 HTTP/1.1 keep-alive
+// 与管线化请求，按需解析分段到达的请求头，大响应体写不完时挂 EPOLLOUT 续写。
+// /metrics 正文在 cache_ttl_ms 内复用同一份渲染结果（连同预先拼好的响应头，writev 一次发出），
+// 客户端声明 Accept-Encoding: gzip 时返回按同一份正文压缩并缓存的 gzip 版本（需 zlib）。
 class MetricsHttpServer {
 public:
-    using MetricsHandler = std::function<std::string()>;
+    // 将指标正文追加到传入的缓冲区（调用前已清空，容量复用）
+    using MetricsHandler = std::function<void(std::string &)>;
 
-    bool start(int port, MetricsHandler handler);
+    static constexpr std::size_t kMaxConnections = 1024;
+    static constexpr std::size_t kMaxRequestHeader = 8 * 1024;
+    static constexpr int kIdleTimeoutMs = 30'000;
+    static constexpr int kDefaultCacheTtlMs = 200;
+
+    MetricsHttpServer();
+    ~MetricsHttpServer();
+    MetricsHttpServer(const MetricsHttpServer &) = delete;
+    MetricsHttpServer &operator=(const MetricsHttpServer &) = delete;
+
+    // port 为 0 时由内核分配，可通过 port() 取得实际端口；cache_ttl_ms 为 0 时每次请求都重新渲染
+    bool start(int port, MetricsHandler handler, int cache_ttl_ms = kDefaultCacheTtlMs);
     void stop();
+    int port() const { return port_; }
 
 private:
-    void accept_loop(int port);
-    void worker_loop();
+    using Buffer = std::shared_ptr<const std::string>;
+
+    struct Connection {
+        int fd{-1};
+        std::string in;
+        // 待写出的片段（缓存的响应头/正文以共享指针引用，不拷贝），out_idx/out_off 为写出进度
+        std::vector<Buffer> out;
+        std::size_t out_idx{0};
+        std::size_t out_off{0};
+        std::size_t out_bytes{0};
+        bool want_write{false}; // 已注册 EPOLLOUT
+        bool close_after_write{false};
+        std::chrono::steady_clock::time_point last_active;
+    };
+
+    void event_loop();
+    void accept_all();
+    void on_readable(Connection &c);
+    void on_writable(Connection &c);
+    // 解析缓冲区中所有完整请求并追加响应；请求非法时追加错误响应并标记写完后关闭
+    void process_requests(Connection &c);
+    void append_response(Connection &c, int code, const char *reason, std::string_view body, bool head_only);
+    void append_metrics(Connection &c, bool gzip, bool head_only);
+    void push_segment(Connection &c, Buffer b);
+    // TTL 过期时重新渲染正文并重建响应头；gzip 版本按需生成
+    void refresh_cache(std::chrono::steady_clock::time_point now);
+    bool ensure_gzip();
+    bool flush_out(Connection &c);
+    void update_interest(Connection &c);
+    void close_connection(int fd);
+    void sweep_idle(std::chrono::steady_clock::time_point now);
 
     std::atomic<bool> running_{false};
     MetricsHandler handler_;
     int listen_fd_{-1};
+    int epoll_fd_{-1};
+    int wake_fd_{-1};
+    int port_{0};
+    std::thread loop_thread_;
+    std::unordered_map<int, Connection> conns_; // 仅事件循环线程访问
 
-    std::thread accept_thread_;
-    std::vector<std::thread> workers_;
-
-    std::mutex q_mu_;
-    std::condition_variable q_cv_;
-    std::queue<int> conn_q_;
+    // 渲染缓存，仅事件循环线程访问。缓冲区无人引用时原地复用，否则另起一份（旧的由连接持有直到写完）
+    struct Rendered {
+        std::shared_ptr<std::string> body;
+        std::shared_ptr<std::string> header[2]; // [keep_alive]
+    };
+    std::chrono::milliseconds cache_ttl_{kDefaultCacheTtlMs};
+    std::chrono::steady_clock::time_point rendered_at_;
+    bool cache_valid_{false};
+    bool gzip_valid_{false};
+    Rendered plain_;
+    Rendered gzip_;
+    struct GzipState;
+    std::unique_ptr<GzipState> gz_;
 };
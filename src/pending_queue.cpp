@@ -0,0 +1,26 @@
+#include "pending_queue.h"
+
+#include <utility>
+
+PendingQueue::PendingQueue(bool by_priority) : by_priority_(by_priority) {}
+
+void PendingQueue::push(Job job) {
+    Key key{by_priority_ ? job.spec.priority : 0, job.id};
+    jobs_.insert_or_assign(key, std::move(job));
+}
+
+bool PendingQueue::pop(Job &out) {
+    if (jobs_.empty()) return false;
+    out = take(jobs_.begin());
+    return true;
+}
+
+Job PendingQueue::take(iterator it) {
+    auto node = jobs_.extract(it);
+    return std::move(node.mapped());
+}
+
+const Job *PendingQueue::front() const {
+    if (jobs_.empty()) return nullptr;
+    return &jobs_.begin()->second;
+}
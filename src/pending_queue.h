@@ -0,0 +1,44 @@
+#pragma once
+
+#include "job.h"
+
+#include <cstddef>
+#include <map>
+
+// 待调度队列：按 (priority 降序, id 升序) 排序，入队 O(log n)，取队首 O(1)。
+// 未开启优先级时所有任务视为同一优先级，退化为按 id 的 FIFO。
+class PendingQueue {
+public:
+    struct Key {
+        int priority{0};
+        int id{0};
+    };
+    struct KeyLess {
+        bool operator()(const Key &a, const Key &b) const {
+            if (a.priority != b.priority) return a.priority > b.priority;
+            return a.id < b.id; // FIFO when equal priority
+        }
+    };
+    using Container = std::map<Key, Job, KeyLess>;
+    using iterator = Container::iterator;
+    using const_iterator = Container::const_iterator;
+
+    explicit PendingQueue(bool by_priority = false);
+
+    void push(Job job);
+    bool pop(Job &out);
+    Job take(iterator it);
+    const Job *front() const;
+
+    bool empty() const { return jobs_.empty(); }
+    std::size_t size() const { return jobs_.size(); }
+
+    iterator begin() { return jobs_.begin(); }
+    iterator end() { return jobs_.end(); }
+    const_iterator begin() const { return jobs_.begin(); }
+    const_iterator end() const { return jobs_.end(); }
+
+private:
+    bool by_priority_;
+    Container jobs_;
+};
@@ -0,0 +1,80 @@
+#include "placement_scorer.h"
+
+#include <algorithm>
+
+namespace {
+// 有上限且容量为正的维度上，放入后的平均与最大利用率
+struct Utilisation {
+    double mean{0};
+    double max{0};
+    double demand_share{0}; // 需求占容量的平均比例
+};
+
+Utilisation utilisation(const ResourceVector &demand, const ResourceUsage &usage) {
+    Utilisation u;
+    int dims = 0;
+    for (int d = 0; d < ResourceVector::kDims; ++d) {
+        if (!usage.bounded(d) || usage.capacity[d] <= 0) continue;
+        double after = usage.utilisation_after(demand, d);
+        u.mean += after;
+        u.max = std::max(u.max, after);
+        u.demand_share += static_cast<double>(demand[d]) / static_cast<double>(usage.capacity[d]);
+        ++dims;
+    }
+    if (dims > 0) {
+        u.mean /= dims;
+        u.demand_share /= dims;
+    }
+    return u;
+}
+
+class BestFitScorer final : public PlacementScorer {
+public:
+    const char *name() const override { return "best-fit"; }
+    double score(const ResourceVector &demand, const ResourceUsage &usage) const override { return utilisation(demand, usage).mean; }
+};
+
+class WorstFitScorer final : public PlacementScorer {
+public:
+    const char *name() const override { return "worst-fit"; }
+    double score(const ResourceVector &demand, const ResourceUsage &usage) const override { return -utilisation(demand, usage).mean; }
+};
+
+class DominantResourceScorer final : public PlacementScorer {
+public:
+    const char *name() const override { return "dominant-resource"; }
+    double score(const ResourceVector &demand, const ResourceUsage &usage) const override {
+        auto u = utilisation(demand, usage);
+        // 主导份额相同时偏向较大的任务，避免总挑最小的
+        return -u.max + 1e-3 * u.demand_share;
+    }
+};
+}
+
+std::optional<PlacementPolicy> parse_placement_policy(std::string_view name) {
+    if (name == "first-fit") return PlacementPolicy::FirstFit;
+    if (name == "best-fit") return PlacementPolicy::BestFit;
+    if (name == "worst-fit") return PlacementPolicy::WorstFit;
+    if (name == "dominant-resource" || name == "drf") return PlacementPolicy::DominantResource;
+    return std::nullopt;
+}
+
+const char *to_string(PlacementPolicy policy) {
+    switch (policy) {
+    case PlacementPolicy::FirstFit: return "first-fit";
+    case PlacementPolicy::BestFit: return "best-fit";
+    case PlacementPolicy::WorstFit: return "worst-fit";
+    case PlacementPolicy::DominantResource: return "dominant-resource";
+    }
+    return "unknown";
+}
+
+std::unique_ptr<PlacementScorer> make_placement_scorer(PlacementPolicy policy) {
+    switch (policy) {
+    case PlacementPolicy::BestFit: return std::make_unique<BestFitScorer>();
+    case PlacementPolicy::WorstFit: return std::make_unique<WorstFitScorer>();
+    case PlacementPolicy::DominantResource: return std::make_unique<DominantResourceScorer>();
+    case PlacementPolicy::FirstFit: break;
+    }
+    return nullptr;
+}
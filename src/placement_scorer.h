@@ -0,0 +1,49 @@
+#pragma once
+
+#include "resource_vector.h"
+
+#include <limits>
+#include <memory>
+#include <optional>
+#include <string_view>
+
+// 队首放不下时，从回填窗口中挑选先行任务的策略
+enum class PlacementPolicy {
+    FirstFit,        // 按队列顺序取第一个放得下的（原有行为，不评分）
+    BestFit,         // 放入后各维平均利用率最高：剩余最少，大任务先行，压紧装箱
+    WorstFit,        // 放入后各维平均利用率最低：保留余量，小任务先行
+    DominantResource // 放入后最紧张一维（主导份额）的利用率最低：与当前负载互补，避免单一资源先耗尽
+};
+
+std::optional<PlacementPolicy> parse_placement_policy(std::string_view name);
+const char *to_string(PlacementPolicy policy);
+
+// 评分接口：分数越高越优先，只对放得下的任务调用；同分时保持队列顺序
+class PlacementScorer {
+public:
+    virtual ~PlacementScorer() = default;
+    virtual const char *name() const = 0;
+    virtual double score(const ResourceVector &demand, const ResourceUsage &usage) const = 0;
+};
+
+// FirstFit 返回 nullptr（调用方按队列顺序取第一个放得下的）
+std::unique_ptr<PlacementScorer> make_placement_scorer(PlacementPolicy policy);
+
+// 在 [first, last) 中选出放得下且得分最高的候选，没有则返回 last。
+// demand_of(*it) 返回该候选的 ResourceVector；scorer 为空时取第一个放得下的
+template <class It, class DemandOf>
+It pick_placement(It first, It last, const ResourceUsage &usage, const PlacementScorer *scorer, DemandOf &&demand_of) {
+    It best = last;
+    double best_score = -std::numeric_limits<double>::infinity();
+    for (It it = first; it != last; ++it) {
+        const ResourceVector &demand = demand_of(*it);
+        if (!usage.fits(demand)) continue;
+        if (!scorer) return it;
+        double s = scorer->score(demand, usage);
+        if (s > best_score) {
+            best = it;
+            best_score = s;
+        }
+    }
+    return best;
+}
@@ -0,0 +1,229 @@
+#include "pressure_monitor.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/vfs.h>
+#include <unistd.h>
+
+#include "NanoLogCpp17.h"
+
+using namespace NanoLog::LogLevels;
+
+namespace {
+const PressureThreshold &threshold_of(const PsiConfig &cfg, int r) {
+    switch (r) {
+    case PressureMonitor::Memory: return cfg.memory;
+    case PressureMonitor::Cpu: return cfg.cpu;
+    default: return cfg.io;
+    }
+}
+
+// 在 "key=value" 形式的字段中取 value
+std::string_view field_value(std::string_view line, std::string_view key) {
+    auto pos = line.find(key);
+    if (pos == std::string_view::npos) return {};
+    auto v = line.substr(pos + key.size());
+    return v.substr(0, v.find_first_of(" \n"));
+}
+
+// 只有 procfs 与 cgroup2 上的压力文件支持 trigger；普通文件写入会成功但毫无意义
+bool supports_trigger(int fd) {
+    constexpr long kProcSuperMagic = 0x9fa0;
+    constexpr long kCgroup2SuperMagic = 0x63677270;
+    struct statfs fs{};
+    if (::fstatfs(fd, &fs) != 0) return false;
+    return static_cast<long>(fs.f_type) == kProcSuperMagic || static_cast<long>(fs.f_type) == kCgroup2SuperMagic;
+}
+
+// 窗口内累计停顿超过 pct% 即通知
+bool arm_trigger(int fd, double pct, long long window_us) {
+    long long stall_us = std::clamp(static_cast<long long>(window_us * pct / 100.0), 1LL, window_us - 1);
+    std::string trig = "some " + std::to_string(stall_us) + " " + std::to_string(window_us);
+    return ::write(fd, trig.c_str(), trig.size() + 1) >= 0;
+}
+
+bool read_all(int fd, char *buf, std::size_t cap, std::size_t &len) {
+    ssize_t n = ::pread(fd, buf, cap, 0);
+    if (n < 0) return false;
+    len = static_cast<std::size_t>(n);
+    return true;
+}
+}
+
+PressureMonitor::PressureMonitor() {
+    wake_fd_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wake_fd_ < 0) {
+        auto msg = std::string("PressureMonitor eventfd failed: ") + std::strerror(errno);
+        NANO_LOG(ERROR, "%s", msg.c_str());
+    }
+}
+
+PressureMonitor::~PressureMonitor() {
+    for (auto &s : src_) {
+        if (s.fd >= 0) ::close(s.fd);
+    }
+    if (wake_fd_ >= 0) ::close(wake_fd_);
+}
+
+int PressureMonitor::open(const std::string &dir, const PsiConfig &cfg) {
+    window_ms_ = std::clamp(cfg.window_ms, 500, 10'000);
+    const bool proc = dir.ends_with("/proc/pressure");
+    int opened_count = 0;
+    for (int r = 0; r < kResources; ++r) {
+        auto &s = src_[r];
+        if (s.fd >= 0) {
+            ::close(s.fd);
+            s = Source{};
+        }
+        const auto &th = threshold_of(cfg, r);
+        if (th.low <= 0) continue;
+        std::string path = dir + "/" + std::string(kNames[r]) + (proc ? "" : ".pressure");
+        s.fd = ::open(path.c_str(), O_RDWR | O_NONBLOCK | O_CLOEXEC);
+        if (s.fd < 0) s.fd = ::open(path.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+        if (s.fd < 0) {
+            auto msg = "cannot open " + path + ": " + std::strerror(errno);
+            NANO_LOG(WARNING, "%s", msg.c_str());
+            continue;
+        }
+        ++opened_count;
+        const bool psi_fs = supports_trigger(s.fd);
+        if (psi_fs) {
+            long long window_us = static_cast<long long>(window_ms_) * 1000;
+            s.trigger = arm_trigger(s.fd, th.low, window_us);
+            // 没有 CAP_SYS_RESOURCE 时内核只接受 2s 整数倍的窗口
+            if (!s.trigger && errno == EINVAL && window_us % 2'000'000 != 0) {
+                s.trigger = arm_trigger(s.fd, th.low, (window_us / 2'000'000 + 1) * 2'000'000);
+            }
+        }
+        if (!s.trigger) {
+            auto msg = "PSI trigger unavailable for " + path + " (" + (psi_fs ? std::strerror(errno) : "not procfs/cgroup2") +
+                       "); sampling every " + std::to_string(window_ms_) + "ms";
+            NANO_LOG(NOTICE, "%s", msg.c_str());
+        }
+    }
+    return opened_count;
+}
+
+bool PressureMonitor::wait(int timeout_ms) {
+    std::array<pollfd, kResources + 1> fds{};
+    nfds_t n = 0;
+    fds[n++] = pollfd{wake_fd_, POLLIN, 0};
+    for (auto &s : src_) {
+        if (s.trigger) fds[n++] = pollfd{s.fd, POLLPRI, 0};
+    }
+    int rc = ::poll(fds.data(), n, timeout_ms);
+    if (rc <= 0) return false;
+    if (fds[0].revents & POLLIN) {
+        std::uint64_t v;
+        while (::read(wake_fd_, &v, sizeof(v)) > 0) {
+        }
+    }
+    bool fired = false;
+    for (nfds_t i = 1; i < n; ++i) {
+        if (fds[i].revents & POLLPRI) fired = true;
+        if (fds[i].revents & POLLERR) {
+            // 监视的 cgroup 被删除：放弃 trigger，改为周期采样
+            for (auto &s : src_) {
+                if (s.fd == fds[i].fd) s.trigger = false;
+            }
+        }
+    }
+    return fired;
+}
+
+void PressureMonitor::wake() {
+    if (wake_fd_ < 0) return;
+    std::uint64_t one = 1;
+    [[maybe_unused]] auto n = ::write(wake_fd_, &one, sizeof(one));
+}
+
+PressureMonitor::Levels PressureMonitor::sample() {
+    Levels out{};
+    char buf[256];
+    auto now = std::chrono::steady_clock::now();
+    for (int r = 0; r < kResources; ++r) {
+        auto &s = src_[r];
+        std::size_t len = 0;
+        if (s.fd < 0 || !read_all(s.fd, buf, sizeof(buf), len)) continue;
+        double avg10 = 0;
+        std::uint64_t total = 0;
+        if (!parse_some(std::string_view(buf, len), avg10, total)) continue;
+        auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(now - s.at).count();
+        // 两次采样相隔不超过两个窗口时用 total 增量，反应比 avg10 快；否则退回 avg10
+        if (s.at != std::chrono::steady_clock::time_point{} && elapsed > 0 && elapsed <= 2LL * window_ms_ * 1000 &&
+            total >= s.total_us) {
+            out[r] = std::min(100.0, static_cast<double>(total - s.total_us) * 100.0 / static_cast<double>(elapsed));
+        } else {
+            out[r] = avg10;
+        }
+        s.total_us = total;
+        s.at = now;
+    }
+    return out;
+}
+
+bool PressureMonitor::all_triggered() const {
+    return std::all_of(src_.begin(), src_.end(), [](const Source &s) { return s.fd < 0 || s.trigger; });
+}
+
+bool PressureMonitor::parse_some(std::string_view text, double &avg10, std::uint64_t &total_us) {
+    // 格式：some avg10=12.34 avg60=... avg300=... total=123456
+    while (!text.empty()) {
+        auto eol = text.find('\n');
+        auto line = text.substr(0, eol);
+        text = eol == std::string_view::npos ? std::string_view{} : text.substr(eol + 1);
+        if (!line.starts_with("some ")) continue;
+        auto a = field_value(line, "avg10=");
+        auto t = field_value(line, "total=");
+        if (std::from_chars(a.data(), a.data() + a.size(), avg10).ec != std::errc{}) return false;
+        if (std::from_chars(t.data(), t.data() + t.size(), total_us).ec != std::errc{}) total_us = 0;
+        return true;
+    }
+    return false;
+}
+
+double PressureMonitor::throttle_factor(const Levels &levels, const PsiConfig &cfg) {
+    double factor = 1.0;
+    const double floor = std::clamp(cfg.min_rate_fraction, 0.0, 1.0);
+    for (int r = 0; r < kResources; ++r) {
+        const auto &th = threshold_of(cfg, r);
+        double p = levels[r];
+        if (th.low <= 0 || p <= th.low) continue;
+        double f = floor;
+        if (th.high > th.low && p < th.high) f = 1.0 - (p - th.low) / (th.high - th.low) * (1.0 - floor);
+        factor = std::min(factor, f);
+    }
+    return factor;
+}
+
+double AdmissionController::rate() const { return max_rate_ * std::max(0.0, factor()); }
+
+std::size_t AdmissionController::available(Clock::time_point now, std::size_t limit) {
+    double r = rate();
+    double cap = std::max(1.0, r / 10.0);
+    if (factor() >= 1.0) {
+        tokens_ = cap;
+        last_ = now;
+        return limit;
+    }
+    if (last_ != Clock::time_point{} && now > last_) {
+        tokens_ = std::min(cap, tokens_ + r * std::chrono::duration<double>(now - last_).count());
+    }
+    tokens_ = std::min(tokens_, cap);
+    last_ = now;
+    return std::min(limit, static_cast<std::size_t>(tokens_));
+}
+
+void AdmissionController::consume(std::size_t n) { tokens_ = std::max(0.0, tokens_ - static_cast<double>(n)); }
+
+AdmissionController::Clock::time_point AdmissionController::next_token(Clock::time_point now) const {
+    double r = rate();
+    if (r <= 0) return Clock::time_point::max();
+    double missing = std::max(0.0, 1.0 - tokens_);
+    return now + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(missing / r));
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "job.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// PSI（/proc/pressure 或 cgroup 的 *.pressure）监视：对每个压力文件写入 "some <stall_us> <window_us>" 注册内核 trigger，
+// 用 poll 等待 POLLPRI，无压力时线程一直阻塞。写 trigger 失败（旧内核、普通文件、权限不足）的文件退回按窗口周期读取。
+// 压力值取两次采样间 some total 的增量占比，间隔过长（刚从长时间阻塞中醒来）时取 avg10。
+class PressureMonitor {
+public:
+    enum Resource { Memory, Cpu, Io };
+    static constexpr int kResources = 3;
+    static constexpr std::array<std::string_view, kResources> kNames{"memory", "cpu", "io"};
+
+    using Levels = std::array<double, kResources>; // 各资源的压力百分比
+
+    PressureMonitor();
+    ~PressureMonitor();
+    PressureMonitor(const PressureMonitor &) = delete;
+    PressureMonitor &operator=(const PressureMonitor &) = delete;
+
+    // 打开 dir 下阈值 low > 0 的压力文件并注册 trigger，返回成功打开的文件数。
+    // dir 为 /proc/pressure 时文件名为 memory/cpu/io，否则为 memory.pressure 等（cgroup v2）
+    int open(const std::string &dir, const PsiConfig &cfg);
+    // 等待至多 timeout_ms（<0 表示无限）；返回 true 表示有 trigger 触发
+    bool wait(int timeout_ms);
+    // 唤醒阻塞中的 wait()
+    void wake();
+    // 读取各文件并计算当前压力；未打开的资源为 0
+    Levels sample();
+    // 所有已打开的文件都注册了 trigger（否则调用方需要周期性采样）
+    bool all_triggered() const;
+    bool opened(Resource r) const { return src_[r].fd >= 0; }
+    bool triggered(Resource r) const { return src_[r].trigger; }
+
+    // 解析压力文件中 "some" 行的 avg10 与 total（微秒），找不到时返回 false
+    static bool parse_some(std::string_view text, double &avg10, std::uint64_t &total_us);
+    // 分级限速系数：低于 low 为 1，达到 high 为 min_rate_fraction，中间线性；多个资源取最小值
+    static double throttle_factor(const Levels &levels, const PsiConfig &cfg);
+
+private:
+    struct Source {
+        int fd{-1};
+        bool trigger{false};
+        std::uint64_t total_us{0};
+        std::chrono::steady_clock::time_point at{};
+    };
+
+    std::array<Source, kResources> src_;
+    int wake_fd_{-1};
+    int window_ms_{1000};
+};
+
+// 派发速率的令牌桶：系数为 1 时不限速；系数 f < 1 时以 max_rate × f 个/秒发放名额，
+// 桶容量为 100ms 的量（至少 1 个）。系数由监视线程写入，其余状态只由派发线程访问。
+class AdmissionController {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit AdmissionController(double max_rate = 200.0) : max_rate_(max_rate) {}
+
+    void set_max_rate(double rate) { max_rate_ = rate; }
+    void set_factor(double f) { factor_.store(f, std::memory_order_relaxed); }
+    double factor() const { return factor_.load(std::memory_order_relaxed); }
+    // 当前可派发的任务数，不超过 limit；不限速时返回 limit
+    std::size_t available(Clock::time_point now, std::size_t limit);
+    // 实际派发了 n 个，扣除名额
+    void consume(std::size_t n);
+    // 下一个名额产生的时间；速率为 0 时返回 time_point::max()
+    Clock::time_point next_token(Clock::time_point now) const;
+
+private:
+    double rate() const;
+
+    double max_rate_;
+    std::atomic<double> factor_{1.0};
+    double tokens_{0};
+    Clock::time_point last_{};
+};
@@ -0,0 +1,189 @@
+#include "process_launcher.h"
+
+#include <atomic>
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#ifndef CLONE_PIDFD
+#define CLONE_PIDFD 0x00001000
+#endif
+#ifndef CLONE_INTO_CGROUP
+#define CLONE_INTO_CGROUP 0x200000000ULL
+#endif
+
+extern char **environ;
+
+namespace {
+// 与内核 struct clone_args (CLONE_ARGS_SIZE_VER2) 布局一致，避免 <linux/sched.h> 与 <sched.h> 冲突
+struct CloneArgs {
+    std::uint64_t flags;
+    std::uint64_t pidfd;
+    std::uint64_t child_tid;
+    std::uint64_t parent_tid;
+    std::uint64_t exit_signal;
+    std::uint64_t stack;
+    std::uint64_t stack_size;
+    std::uint64_t tls;
+    std::uint64_t set_tid;
+    std::uint64_t set_tid_size;
+    std::uint64_t cgroup;
+};
+
+constexpr std::size_t kVforkStackSize = 64 * 1024;
+
+std::atomic<bool> clone3_unsupported{false};
+
+// 子进程：只允许系统调用，不得分配内存或加锁
+[[noreturn]] void child_exec(const LaunchParams &p, const sigset_t *restore_mask) {
+    ::setpgid(0, 0);
+    if (p.cgroup_procs_fd >= 0) {
+        // 向 cgroup.procs 写 "0" 表示把当前进程移入该 cgroup
+        [[maybe_unused]] auto r = ::write(p.cgroup_procs_fd, "0", 1);
+    }
+    if (p.affinity) ::sched_setaffinity(0, sizeof(cpu_set_t), p.affinity);
+    if (p.rlimit_nofile >= 0) {
+        struct rlimit rl{static_cast<rlim_t>(p.rlimit_nofile), static_cast<rlim_t>(p.rlimit_nofile)};
+        ::setrlimit(RLIMIT_NOFILE, &rl);
+    }
+    if (p.disable_core_dump) {
+        struct rlimit rl{0, 0};
+        ::setrlimit(RLIMIT_CORE, &rl);
+    }
+    if (p.workdir) {
+        [[maybe_unused]] auto r = ::chdir(p.workdir);
+    }
+    if (restore_mask) ::sigprocmask(SIG_SETMASK, restore_mask, nullptr);
+    char *const argv[] = {const_cast<char *>("sh"), const_cast<char *>("-c"), const_cast<char *>(p.cmd), nullptr};
+    ::execve("/bin/sh", argv, environ);
+    ::_exit(127);
+}
+
+struct VforkContext {
+    const LaunchParams *params;
+    const sigset_t *restore_mask;
+};
+
+int vfork_child(void *arg) {
+    auto *ctx = static_cast<VforkContext *>(arg);
+    child_exec(*ctx->params, ctx->restore_mask);
+}
+
+LaunchResult launch_fork(const LaunchParams &p) {
+    LaunchResult res;
+    pid_t pid = ::fork();
+    if (pid < 0) {
+        res.error = errno;
+        return res;
+    }
+    if (pid == 0) child_exec(p, nullptr);
+    res.pid = pid;
+    return res;
+}
+
+LaunchResult launch_vfork(const LaunchParams &p) {
+    LaunchResult res;
+    void *stack = ::mmap(nullptr, kVforkStackSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
+    if (stack == MAP_FAILED) {
+        res.error = errno;
+        return res;
+    }
+    // 子进程与父线程共享内存：屏蔽全部信号，避免父进程的信号处理函数在子进程中运行
+    sigset_t all, old;
+    sigfillset(&all);
+    pthread_sigmask(SIG_BLOCK, &all, &old);
+
+    VforkContext ctx{&p, &old};
+    int pidfd = -1;
+    int flags = CLONE_VM | CLONE_VFORK | SIGCHLD;
+    flags |= p.clone_parent ? CLONE_PARENT : CLONE_PIDFD;
+    pid_t pid = ::clone(vfork_child, static_cast<char *>(stack) + kVforkStackSize, flags, &ctx, &pidfd);
+    int err = errno;
+
+    pthread_sigmask(SIG_SETMASK, &old, nullptr);
+    // CLONE_VFORK：返回时子进程已 exec 或退出，栈可以安全释放
+    ::munmap(stack, kVforkStackSize);
+    if (pid < 0) {
+        res.error = err;
+        return res;
+    }
+    res.pid = pid;
+    res.pidfd = pidfd;
+    return res;
+}
+
+LaunchResult launch_clone3(const LaunchParams &p) {
+#ifdef SYS_clone3
+    LaunchResult res;
+    int pidfd = -1;
+    CloneArgs args{};
+    if (p.clone_parent) {
+        args.flags = CLONE_VFORK | CLONE_PARENT;
+    } else {
+        args.flags = CLONE_VFORK | CLONE_PIDFD;
+        args.pidfd = reinterpret_cast<std::uint64_t>(&pidfd);
+    }
+    args.exit_signal = SIGCHLD;
+    if (p.cgroup_fd >= 0) {
+        args.flags |= CLONE_INTO_CGROUP;
+        args.cgroup = static_cast<std::uint64_t>(p.cgroup_fd);
+    }
+    long ret = ::syscall(SYS_clone3, &args, sizeof(args));
+    if (ret == 0) {
+        // 已经位于目标 cgroup，无需再写 cgroup.procs
+        LaunchParams child = p;
+        if (p.cgroup_fd >= 0) child.cgroup_procs_fd = -1;
+        child_exec(child, nullptr);
+    }
+    if (ret < 0) {
+        res.error = errno;
+        // ENOSYS/E2BIG 说明内核不支持 clone3（或不认识 cgroup 字段），之后一律退回 vfork。
+        // EINVAL 在带 CLONE_INTO_CGROUP 时可能只是本任务的 cgroup fd 不可用，只让这一次退回
+        if (res.error == ENOSYS || res.error == E2BIG || (res.error == EINVAL && p.cgroup_fd < 0)) {
+            clone3_unsupported.store(true);
+            return launch_vfork(p);
+        }
+        if (res.error == EINVAL) return launch_vfork(p);
+        return res;
+    }
+    res.pid = static_cast<pid_t>(ret);
+    res.pidfd = pidfd;
+    return res;
+#else
+    clone3_unsupported.store(true);
+    return launch_vfork(p);
+#endif
+}
+}
+
+LaunchResult launch_process(LaunchBackend backend, const LaunchParams &params) {
+    switch (backend) {
+    case LaunchBackend::Fork: return params.clone_parent ? launch_vfork(params) : launch_fork(params);
+    case LaunchBackend::Vfork: return launch_vfork(params);
+    case LaunchBackend::Clone3:
+        if (clone3_unsupported.load(std::memory_order_relaxed)) return launch_vfork(params);
+        return launch_clone3(params);
+    }
+    return launch_fork(params);
+}
+
+std::optional<LaunchBackend> parse_launch_backend(std::string_view name) {
+    if (name == "fork") return LaunchBackend::Fork;
+    if (name == "vfork") return LaunchBackend::Vfork;
+    if (name == "clone3") return LaunchBackend::Clone3;
+    return std::nullopt;
+}
+
+const char *to_string(LaunchBackend backend) {
+    switch (backend) {
+    case LaunchBackend::Fork: return "fork";
+    case LaunchBackend::Vfork: return "vfork";
+    case LaunchBackend::Clone3: return "clone3";
+    }
+    return "unknown";
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <optional>
+#include <sched.h>
+#include <string_view>
+#include <sys/types.h>
+
+// 任务进程的创建方式
+enum class LaunchBackend {
+    Fork,   // fork() + exec，子进程复制父进程页表，随调度器 RSS 增长变慢
+    Vfork,  // clone(CLONE_VM|CLONE_VFORK)，共享地址空间直到 exec，无页表复制
+    Clone3  // clone3(CLONE_VFORK|CLONE_INTO_CGROUP|CLONE_PIDFD)，原子地落入 cgroup
+};
+
+struct LaunchParams {
+    const char *cmd{nullptr};      // 经 /bin/sh -c 执行
+    const char *workdir{nullptr};  // nullptr 表示继承当前目录
+    int cgroup_fd{-1};             // cgroup 目录 fd，Clone3 用于 CLONE_INTO_CGROUP
+    int cgroup_procs_fd{-1};       // cgroup.procs fd，其余后端在子进程 exec 前写入
+    const cpu_set_t *affinity{nullptr}; // 非空时子进程在加入 cgroup 后、exec 前绑定到这些 CPU
+    int rlimit_nofile{-1};
+    bool disable_core_dump{true};
+    bool clone_parent{false};      // CLONE_PARENT：新进程的父进程为调用者的父进程（zygote 使用）
+};
+
+struct LaunchResult {
+    pid_t pid{-1};
+    int pidfd{-1}; // 后端能直接拿到 pidfd 时返回，调用方负责关闭
+    int error{0};  // 失败时的 errno
+};
+
+// 启动 /bin/sh -c <cmd>，子进程成为新进程组组长。子进程中只做系统调用，
+// 所需字符串与 fd 由调用方预先准备。Clone3 在内核不支持时自动回退到 Vfork；
+// clone_parent 时 Fork 以 Vfork 实现，且不返回 pidfd。
+LaunchResult launch_process(LaunchBackend backend, const LaunchParams &params);
+
+std::optional<LaunchBackend> parse_launch_backend(std::string_view name);
+const char *to_string(LaunchBackend backend);
@@ -1,24 +1,202 @@
 #include "resource_manager.h"
 
-ResourceManager::ResourceManager(ResourceQuota quota) : quota_(quota) {}
+#include <algorithm>
+#include <numeric>
 
-bool ResourceManager::reserve(int cpu, std::size_t mem_mb) {
+#include "NanoLogCpp17.h"
+
+using namespace NanoLog::LogLevels;
+
+ResourceManager::ResourceManager(ResourceQuota quota) {
+    capacity_.v.fill(ResourceVector::kUnlimited);
+    capacity_[ResourceVector::Cpu] = quota.total_cpu;
+    capacity_[ResourceVector::MemoryMb] = static_cast<std::int64_t>(quota.total_mem_mb);
+    if (quota.total_pids > 0) capacity_[ResourceVector::Pids] = quota.total_pids;
+    if (quota.total_io_mbps > 0) capacity_[ResourceVector::IoMbps] = quota.total_io_mbps;
+    for (const auto &[name, total] : quota.tokens) {
+        if (static_cast<int>(token_names_.size()) >= ResourceVector::kMaxTokens) {
+            NANO_LOG(WARNING, "too many resource tokens; ignoring %s", name.c_str());
+            continue;
+        }
+        capacity_[ResourceVector::kBuiltinDims + static_cast<int>(token_names_.size())] = total;
+        token_names_.push_back(name);
+    }
+}
+
+void ResourceManager::set_topology(CpuTopology topo) {
     std::lock_guard lk(mu_);
-    if (used_cpu_ + cpu > quota_.total_cpu || used_mem_mb_ + mem_mb > quota_.total_mem_mb) {
-        return false;
+    topo_ = std::move(topo);
+    // 只能分配拓扑中存在的 CPU
+    capacity_[ResourceVector::Cpu] = std::min<std::int64_t>(capacity_[ResourceVector::Cpu], topo_->cpu_count());
+    core_of_.assign(static_cast<std::size_t>(topo_->max_cpu_id() + 1), -1);
+    cpu_taken_.assign(core_of_.size(), 0);
+    core_free_.resize(topo_->cores.size());
+    node_free_.resize(topo_->nodes.size());
+    for (std::size_t i = 0; i < topo_->cores.size(); ++i) {
+        for (int c : topo_->cores[i].cpus) core_of_[c] = static_cast<int>(i);
+        core_free_[i] = static_cast<int>(topo_->cores[i].cpus.size());
+    }
+    for (std::size_t i = 0; i < topo_->nodes.size(); ++i) node_free_[i] = topo_->nodes[i].cpu_count;
+    split_cores_ = 0;
+}
+
+ResourceVector ResourceManager::cpu_mem(int cpu, std::size_t mem_mb) {
+    ResourceVector d;
+    d[ResourceVector::Cpu] = cpu;
+    d[ResourceVector::MemoryMb] = static_cast<std::int64_t>(mem_mb);
+    return d;
+}
+
+std::optional<ResourceVector> ResourceManager::demand_of(const JobSpec &spec) const {
+    ResourceVector d = cpu_mem(spec.cpu_cores, spec.memory_mb);
+    d[ResourceVector::Pids] = spec.pids;
+    d[ResourceVector::IoMbps] = spec.io_mbps;
+    for (const auto &[name, n] : spec.tokens) {
+        auto it = std::find(token_names_.begin(), token_names_.end(), name);
+        if (it == token_names_.end()) return std::nullopt;
+        d[ResourceVector::kBuiltinDims + static_cast<int>(it - token_names_.begin())] += n;
     }
-    used_cpu_ += cpu;
-    used_mem_mb_ += mem_mb;
+    return d;
+}
+
+bool ResourceManager::reserve(const ResourceVector &demand, CpuPlacement &placement) {
+    std::lock_guard lk(mu_);
+    placement = CpuPlacement{};
+    if (!ResourceUsage{used_, capacity_}.fits(demand)) return false;
+    int cpu = static_cast<int>(demand[ResourceVector::Cpu]);
+    if (topo_ && cpu > 0 && !place_locked(cpu, placement)) return false;
+    used_ += demand;
     return true;
 }
 
-void ResourceManager::release(int cpu, std::size_t mem_mb) {
+void ResourceManager::release(const ResourceVector &demand, const CpuPlacement &placement) {
     std::lock_guard lk(mu_);
-    used_cpu_ = std::max(0, used_cpu_ - cpu);
-    used_mem_mb_ = used_mem_mb_ > mem_mb ? used_mem_mb_ - mem_mb : 0;
+    used_ -= demand;
+    if (!topo_) return;
+    for (int c : placement.cpus) {
+        if (c < 0 || c >= static_cast<int>(cpu_taken_.size()) || !cpu_taken_[c]) continue;
+        int core = core_of_[c];
+        cpu_taken_[c] = 0;
+        int threads = static_cast<int>(topo_->cores[core].cpus.size());
+        if (core_free_[core] == 0 && threads > 1) ++split_cores_;
+        ++core_free_[core];
+        if (core_free_[core] == threads && threads > 1) --split_cores_;
+        ++node_free_[topo_->cores[core].node];
+    }
+}
+
+bool ResourceManager::reserve(int cpu, std::size_t mem_mb) {
+    CpuPlacement placement;
+    return reserve(cpu_mem(cpu, mem_mb), placement);
+}
+
+void ResourceManager::release(int cpu, std::size_t mem_mb) { release(cpu_mem(cpu, mem_mb), CpuPlacement{}); }
+
+bool ResourceManager::reserve(int cpu, std::size_t mem_mb, CpuPlacement &placement) { return reserve(cpu_mem(cpu, mem_mb), placement); }
+
+void ResourceManager::release(int cpu, std::size_t mem_mb, const CpuPlacement &placement) { release(cpu_mem(cpu, mem_mb), placement); }
+
+void ResourceManager::take_cpu_locked(int cpu) {
+    int core = core_of_[cpu];
+    int threads = static_cast<int>(topo_->cores[core].cpus.size());
+    cpu_taken_[cpu] = 1;
+    if (core_free_[core] == threads && threads > 1) ++split_cores_;
+    --core_free_[core];
+    if (core_free_[core] == 0 && threads > 1) --split_cores_;
+    --node_free_[topo_->cores[core].node];
+}
+
+void ResourceManager::take_from_node_locked(int node, int n, std::vector<int> &cpus) {
+    const auto &cores = topo_->nodes[node].cores;
+    // 先取整核（需求不少于一个核的线程数时），同一任务的线程共享 L1/L2
+    for (int core : cores) {
+        const auto &threads = topo_->cores[core].cpus;
+        int t = static_cast<int>(threads.size());
+        if (n < t || core_free_[core] != t) continue;
+        for (int c : threads) {
+            take_cpu_locked(c);
+            cpus.push_back(c);
+        }
+        n -= t;
+    }
+    // 零头：优先填已部分占用的核（空闲线程最少的），避免拆开新的整核
+    while (n > 0) {
+        int best = -1;
+        for (int core : cores) {
+            if (core_free_[core] == 0) continue;
+            if (best < 0 || core_free_[core] < core_free_[best]) best = core;
+        }
+        if (best < 0) break;
+        for (int c : topo_->cores[best].cpus) {
+            if (n == 0) break;
+            if (cpu_taken_[c]) continue;
+            take_cpu_locked(c);
+            cpus.push_back(c);
+            --n;
+        }
+    }
+}
+
+bool ResourceManager::place_locked(int n, CpuPlacement &out) {
+    const int node_count = static_cast<int>(node_free_.size());
+    if (std::accumulate(node_free_.begin(), node_free_.end(), 0) < n) return false;
+    // best-fit：空闲数最少且放得下的节点，尽量把大块空闲留给大任务
+    int best = -1;
+    for (int i = 0; i < node_count; ++i) {
+        if (node_free_[i] >= n && (best < 0 || node_free_[i] < node_free_[best])) best = i;
+    }
+    std::vector<int> order;
+    if (best >= 0) {
+        order.push_back(best);
+    } else {
+        // 跨节点：从空闲最多的节点开始，同插槽的节点优先，跨的节点数最少
+        order.resize(node_count);
+        std::iota(order.begin(), order.end(), 0);
+        int first = *std::max_element(order.begin(), order.end(), [&](int a, int b) { return node_free_[a] < node_free_[b]; });
+        int socket = topo_->nodes[first].socket;
+        std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+            bool sa = topo_->nodes[a].socket == socket, sb = topo_->nodes[b].socket == socket;
+            if (sa != sb) return sa;
+            return node_free_[a] > node_free_[b];
+        });
+    }
+    int remaining = n;
+    for (int node : order) {
+        if (remaining == 0) break;
+        int take = std::min(remaining, node_free_[node]);
+        if (take == 0) continue;
+        take_from_node_locked(node, take, out.cpus);
+        out.nodes.push_back(topo_->nodes[node].id);
+        remaining -= take;
+    }
+    std::sort(out.cpus.begin(), out.cpus.end());
+    std::sort(out.nodes.begin(), out.nodes.end());
+    return true;
 }
 
 std::pair<int, std::size_t> ResourceManager::used() const {
     std::lock_guard lk(mu_);
-    return {used_cpu_, used_mem_mb_};
+    return {static_cast<int>(used_[ResourceVector::Cpu]), static_cast<std::size_t>(used_[ResourceVector::MemoryMb])};
+}
+
+ResourceUsage ResourceManager::usage() const {
+    std::lock_guard lk(mu_);
+    return ResourceUsage{used_, capacity_};
+}
+
+bool ResourceManager::within_quota(const ResourceVector &demand) const {
+    return ResourceUsage{ResourceVector{}, capacity_}.fits(demand);
+}
+
+bool ResourceManager::within_quota(int cpu, std::size_t mem_mb) const { return within_quota(cpu_mem(cpu, mem_mb)); }
+
+ResourceManager::CpuFragmentation ResourceManager::cpu_fragmentation() const {
+    std::lock_guard lk(mu_);
+    CpuFragmentation f;
+    for (int free : node_free_) {
+        f.free_cpus += free;
+        f.largest_node_free = std::max(f.largest_node_free, free);
+    }
+    f.split_cores = split_cores_;
+    return f;
 }
@@ -1,20 +1,71 @@
 #pragma once
 
+#include "cpu_topology.h"
 #include "job.h"
+#include "resource_vector.h"
+#include <cstdint>
 #include <mutex>
+#include <optional>
+#include <string>
 #include <utility>
+#include <vector>
 
+// 按资源向量（CPU、内存、pids、磁盘带宽与自定义令牌）预留与释放
 class ResourceManager {
 public:
+    // CPU 碎片情况（仅拓扑感知时有意义）
+    struct CpuFragmentation {
+        int free_cpus{0};
+        int largest_node_free{0}; // 空闲 CPU 最多的节点上的空闲数，单节点内能放下的最大任务
+        int split_cores{0};       // 部分 SMT 线程已被占用的物理核
+        // 单节点任务用不上的空闲 CPU 比例
+        double ratio() const { return free_cpus > 0 ? 1.0 - static_cast<double>(largest_node_free) / free_cpus : 0.0; }
+    };
+
     explicit ResourceManager(ResourceQuota quota);
 
+    // 启用拓扑感知放置，须在首次 reserve 之前调用
+    void set_topology(CpuTopology topo);
+    bool topology_aware() const { return topo_.has_value(); }
+
+    // 把任务规格换算为资源向量；申请了配额中没有的令牌时返回 nullopt
+    std::optional<ResourceVector> demand_of(const JobSpec &spec) const;
+    // 拓扑感知时同时在 placement 中返回分配到的 CPU 与节点：优先放进一个节点（best-fit），
+    // 节点内先整核分配、零头从已部分占用的核上取，保留完整的核；单个节点放不下时跨最少的节点。
+    // 释放时传回同一 placement
+    bool reserve(const ResourceVector &demand, CpuPlacement &placement);
+    void release(const ResourceVector &demand, const CpuPlacement &placement);
+    // 只有 CPU 与内存两维的简写
     bool reserve(int cpu, std::size_t mem_mb);
     void release(int cpu, std::size_t mem_mb);
+    bool reserve(int cpu, std::size_t mem_mb, CpuPlacement &placement);
+    void release(int cpu, std::size_t mem_mb, const CpuPlacement &placement);
+
     std::pair<int, std::size_t> used() const;
+    // 当前已用量与容量的快照，供评分使用
+    ResourceUsage usage() const;
+    // 请求是否可能被满足（不超过总配额），用于提交时拒绝永远无法调度的任务
+    bool within_quota(const ResourceVector &demand) const;
+    bool within_quota(int cpu, std::size_t mem_mb) const;
+    CpuFragmentation cpu_fragmentation() const;
+    // 令牌维度的名称，下标为 维度 - ResourceVector::kBuiltinDims
+    const std::vector<std::string> &token_names() const { return token_names_; }
 
 private:
-    ResourceQuota quota_;
-    int used_cpu_{0};
-    std::size_t used_mem_mb_{0};
+    static ResourceVector cpu_mem(int cpu, std::size_t mem_mb);
+    bool place_locked(int n, CpuPlacement &out);
+    // 在节点内取 n 个空闲 CPU（调用方保证足够）
+    void take_from_node_locked(int node, int n, std::vector<int> &cpus);
+    void take_cpu_locked(int cpu);
+
+    ResourceVector capacity_; // 构造后只在 set_topology 中修改
+    ResourceVector used_;
+    std::vector<std::string> token_names_;
+    std::optional<CpuTopology> topo_;
+    std::vector<int> core_of_;            // 逻辑 CPU → cores 下标，不在拓扑中为 -1
+    std::vector<std::uint8_t> cpu_taken_; // 逻辑 CPU 是否已分配
+    std::vector<int> core_free_;          // 各物理核空闲线程数
+    std::vector<int> node_free_;          // 各节点空闲 CPU 数
+    int split_cores_{0};
     mutable std::mutex mu_;
 };
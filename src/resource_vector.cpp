@@ -0,0 +1,65 @@
+#include "resource_vector.h"
+
+#include <algorithm>
+#include <charconv>
+
+std::optional<ResourceTokens> parse_resource_tokens(std::string_view text) {
+    ResourceTokens out;
+    while (!text.empty()) {
+        auto comma = text.find(',');
+        auto item = text.substr(0, comma);
+        text = comma == std::string_view::npos ? std::string_view{} : text.substr(comma + 1);
+        auto eq = item.find('=');
+        if (eq == 0 || eq == std::string_view::npos) return std::nullopt;
+        auto name = item.substr(0, eq);
+        auto num = item.substr(eq + 1);
+        std::int64_t n = 0;
+        auto res = std::from_chars(num.data(), num.data() + num.size(), n);
+        if (res.ec != std::errc{} || res.ptr != num.data() + num.size() || n <= 0) return std::nullopt;
+        if (std::any_of(out.begin(), out.end(), [&](const auto &t) { return t.first == name; })) return std::nullopt;
+        out.emplace_back(std::string(name), n);
+    }
+    return out;
+}
+
+std::string format_resource_tokens(const ResourceTokens &tokens) {
+    std::string out;
+    for (const auto &[name, n] : tokens) {
+        if (!out.empty()) out += ',';
+        out += name;
+        out += '=';
+        out += std::to_string(n);
+    }
+    return out;
+}
+
+ResourceVector &ResourceVector::operator+=(const ResourceVector &o) {
+    for (int d = 0; d < kDims; ++d) v[d] += o.v[d];
+    return *this;
+}
+
+ResourceVector &ResourceVector::operator-=(const ResourceVector &o) {
+    for (int d = 0; d < kDims; ++d) v[d] = v[d] > o.v[d] ? v[d] - o.v[d] : 0;
+    return *this;
+}
+
+bool ResourceUsage::fits(const ResourceVector &demand) const {
+    for (int d = 0; d < ResourceVector::kDims; ++d) {
+        if (demand[d] > 0 && bounded(d) && demand[d] > capacity[d] - used[d]) return false;
+    }
+    return true;
+}
+
+double ResourceUsage::utilisation_after(const ResourceVector &demand, int d) const {
+    return static_cast<double>(used[d] + demand[d]) / static_cast<double>(capacity[d]);
+}
+
+const char *resource_dim_name(int d) {
+    switch (d) {
+    case ResourceVector::Cpu: return "cpu";
+    case ResourceVector::MemoryMb: return "memory_mb";
+    case ResourceVector::Pids: return "pids";
+    case ResourceVector::IoMbps: return "io_mbps";
+    default: return nullptr;
+    }
+}
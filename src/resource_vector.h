@@ -0,0 +1,47 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// 用户自定义的可计数资源（许可证、数据库连接等）：名称 → 数量
+using ResourceTokens = std::vector<std::pair<std::string, std::int64_t>>;
+
+// "license=2,db=1"；名称为空、重复、数量不是正整数时返回 nullopt
+std::optional<ResourceTokens> parse_resource_tokens(std::string_view text);
+std::string format_resource_tokens(const ResourceTokens &tokens);
+
+// 定长资源向量：内置维度在前，自定义令牌按 ResourceQuota::tokens 的顺序排在其后。
+// 定长数组避免派发路径上的分配；容量为 kUnlimited 的维度不参与准入与评分。
+struct ResourceVector {
+    enum Dim { Cpu, MemoryMb, Pids, IoMbps, kBuiltinDims };
+    static constexpr int kMaxTokens = 8;
+    static constexpr int kDims = kBuiltinDims + kMaxTokens;
+    static constexpr std::int64_t kUnlimited = std::numeric_limits<std::int64_t>::max();
+
+    std::array<std::int64_t, kDims> v{};
+
+    std::int64_t &operator[](int d) { return v[d]; }
+    std::int64_t operator[](int d) const { return v[d]; }
+    ResourceVector &operator+=(const ResourceVector &o);
+    // 逐维相减，下限为 0
+    ResourceVector &operator-=(const ResourceVector &o);
+};
+
+// 某一时刻的已用量与容量，评分与准入判断都基于它
+struct ResourceUsage {
+    ResourceVector used;
+    ResourceVector capacity;
+
+    bool bounded(int d) const { return capacity[d] != ResourceVector::kUnlimited; }
+    bool fits(const ResourceVector &demand) const;
+    // 放入 demand 之后第 d 维的利用率（0..1）；调用方保证 bounded(d) 且 capacity > 0
+    double utilisation_after(const ResourceVector &demand, int d) const;
+};
+
+const char *resource_dim_name(int d); // 内置维度名；令牌维度返回 nullptr
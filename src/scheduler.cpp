@@ -1,13 +1,15 @@
 #include "scheduler.h"
 
 #include <algorithm>
+#include <cmath>
 #include <csignal>
 #include <cstring>
 #include <cerrno>
 #include <fstream>
+#include <limits>
+#include <numeric>
 #include <functional>
 #include <sstream>
-#include <sys/resource.h>
 #include <sys/wait.h>
 #include <unistd.h>
 
@@ -44,6 +46,58 @@ void print_stack(const char *ctx) {
 #endif
 }
 
+// 拓扑感知放置的 CPU 转为亲和性掩码；未绑核返回 false
+bool to_cpu_set(const CpuPlacement &placement, cpu_set_t &set) {
+    if (placement.empty()) return false;
+    CPU_ZERO(&set);
+    for (int c : placement.cpus) {
+        if (c >= 0 && c < CPU_SETSIZE) CPU_SET(c, &set);
+    }
+    return true;
+}
+
+// 重启前已结束的任务在持久化中的状态
+std::optional<JobStatus> job_status_of(PersistStatus s) {
+    switch (s) {
+    case PersistStatus::Succeeded: return JobStatus::Succeeded;
+    case PersistStatus::Failed:
+    case PersistStatus::LaunchFailed: return JobStatus::Failed;
+    case PersistStatus::Timeout: return JobStatus::Timeout;
+    case PersistStatus::Cancelled: return JobStatus::Cancelled;
+    case PersistStatus::Queued:
+    case PersistStatus::Running: break;
+    }
+    return std::nullopt;
+}
+
+// 同批依赖（-k）按 Kahn 算法排出父在前的顺序。排不进去的任务在环上或依赖环上的任务，以 DependencyCycle 拒绝
+std::vector<std::size_t> order_batch(std::span<const JobSpec> specs, std::vector<SubmitResult> &results) {
+    const std::size_t n = specs.size();
+    std::vector<int> indegree(n, 0);
+    std::vector<std::vector<std::size_t>> children(n);
+    for (std::size_t i = 0; i < n; ++i) {
+        for (const auto &dep : specs[i].depends_on) {
+            if (dep.job_id >= 0 || static_cast<std::size_t>(-dep.job_id) > n) continue;
+            children[static_cast<std::size_t>(-dep.job_id) - 1].push_back(i);
+            ++indegree[i];
+        }
+    }
+    std::vector<std::size_t> order;
+    order.reserve(n);
+    for (std::size_t i = 0; i < n; ++i) {
+        if (indegree[i] == 0) order.push_back(i);
+    }
+    for (std::size_t k = 0; k < order.size(); ++k) {
+        for (std::size_t c : children[order[k]]) {
+            if (--indegree[c] == 0) order.push_back(c);
+        }
+    }
+    for (std::size_t i = 0; i < n && order.size() < n; ++i) {
+        if (indegree[i] > 0 && results[i].error == SubmitError::None) results[i].error = SubmitError::DependencyCycle;
+    }
+    return order;
+}
+
 template <class Fn>
 void run_guarded(const char *ctx, Fn &&fn) {
     try {
@@ -61,10 +115,13 @@ void run_guarded(const char *ctx, Fn &&fn) {
 }
 
 Scheduler::Scheduler(SchedulerOptions opts)
-    : opts_(std::move(opts)), rm_(opts_.quota) {
+    : opts_(std::move(opts)), rm_(opts_.quota), scorer_(make_placement_scorer(opts_.placement)), pending_(opts_.enable_priority),
+      intake_(static_cast<std::size_t>(std::clamp(opts_.max_queue_size, 1, kMaxIntakeCapacity))) {
     if (opts_.enable_persistence) {
-        store_ = std::make_unique<JobStore>();
-        store_->init(opts_.db_path);
+        store_ = make_job_store(opts_.persist_backend);
+        JobStore::Options sopts;
+        sopts.flush_interval_ms = opts_.persist_flush_ms;
+        store_->init(opts_.db_path, sopts);
     }
     if (opts_.enable_cron) {
         cron_sched_ = std::make_unique<CronScheduler>();
@@ -72,6 +129,25 @@ Scheduler::Scheduler(SchedulerOptions opts)
     if (opts_.metrics_http_port > 0) {
         metrics_server_ = std::make_unique<MetricsHttpServer>();
     }
+    if (opts_.cgroup.enabled && opts_.cgroup.pool_size > 0) {
+        cgroup_pool_ = std::make_unique<CgroupPool>();
+    }
+    if (opts_.cpu_pinning) {
+        if (auto topo = CpuTopology::detect()) {
+            NANO_LOG(NOTICE, "cpu pinning enabled cpus=%d nodes=%zu cores=%zu", topo->cpu_count(), topo->nodes.size(), topo->cores.size());
+            rm_.set_topology(std::move(*topo));
+            update_cpuset_metrics();
+        } else {
+            NANO_LOG(WARNING, "%s", "cpu topology unavailable; cpu pinning disabled");
+        }
+    }
+    pending_.set_capacity(rm_.usage().capacity);
+    reserve_queue(FairShareQueue::kDefaultQueue, true);
+    for (const auto &[name, weight] : opts_.queue_weights) {
+        reserve_queue(name, true);
+        pending_.set_weight(name, weight);
+        publish_queue_locked(pending_.queue_id(name));
+    }
 }
 
 Scheduler::~Scheduler() { stop(); }
@@ -87,303 +163,1095 @@ bool Scheduler::validate_cmd(const std::string &cmd) const {
     return !blocked;
 }
 
-int Scheduler::submit(const JobSpec &spec) {
-    if (!validate_cmd(spec.cmd)) {
+bool Scheduler::reserve_queue(std::string_view name, bool force) {
+    if (name.empty()) name = FairShareQueue::kDefaultQueue;
+    std::lock_guard lk(queue_names_mu_);
+    std::string key(name);
+    if (queue_names_.count(key)) return true;
+    if (!force && queue_names_.size() >= kMaxQueues) return false;
+    queue_names_.insert(std::move(key));
+    return true;
+}
+
+SubmitError Scheduler::check_spec(const JobSpec &spec, ResourceVector &demand, std::size_t batch_size) {
+    if (!validate_cmd(spec.cmd)) return SubmitError::CommandRejected;
+    if (!spec.queue.empty() && !valid_queue_name(spec.queue)) return SubmitError::InvalidQueue;
+    const int next_id = next_id_.load(std::memory_order_relaxed);
+    if (auto n = spec.array.size(); spec.array.step <= 0 || (n > 0 && (spec.array.first < 0 || n > kMaxArrayTasks))) return SubmitError::InvalidArray;
+    // 数组连同下标占用 1 + n 个 id
+    if (static_cast<std::int64_t>(next_id) + 1 + static_cast<std::int64_t>(spec.array.size()) > std::numeric_limits<int>::max()) return SubmitError::InvalidArray;
+    for (const auto &dep : spec.depends_on) {
+        // id 只分配给被接受的任务，小于 next_id_ 的都存在过
+        bool known = dep.job_id > 0 ? dep.job_id < next_id : dep.job_id < 0 && static_cast<std::size_t>(-dep.job_id) <= batch_size;
+        if (!known) return SubmitError::InvalidDependency;
+    }
+    auto d = rm_.demand_of(spec);
+    if (!d) return SubmitError::UnknownResource;
+    if (!rm_.within_quota(*d)) return SubmitError::ExceedsQuota;
+    // 最后登记队列名，被其它原因拒绝的任务不占队列名额
+    if (!reserve_queue(spec.queue)) return SubmitError::InvalidQueue;
+    demand = *d;
+    return SubmitError::None;
+}
+
+int Scheduler::submit(const JobSpec &spec) { return submit_job(spec, -1); }
+
+int Scheduler::submit_job(const JobSpec &spec, int cron_template) {
+    ResourceVector demand;
+    switch (check_spec(spec, demand)) {
+    case SubmitError::CommandRejected:
         metrics_.inc_rejected();
         NANO_LOG(WARNING, "%s", "command rejected by whitelist/blacklist");
         return -1;
+    case SubmitError::ExceedsQuota:
+        metrics_.inc_rejected();
+        NANO_LOG(WARNING, "job exceeds total quota cpu=%d mem_mb=%zu, cmd=%s", spec.cpu_cores, spec.memory_mb, spec.cmd.c_str());
+        return -1;
+    case SubmitError::UnknownResource: {
+        metrics_.inc_rejected();
+        auto tokens = format_resource_tokens(spec.tokens);
+        NANO_LOG(WARNING, "job requests unknown resource tokens=%s, cmd=%s", tokens.c_str(), spec.cmd.c_str());
+        return -1;
+    }
+    case SubmitError::InvalidQueue:
+        metrics_.inc_rejected();
+        NANO_LOG(WARNING, "invalid queue or too many queues name=%s, cmd=%s", spec.queue.c_str(), spec.cmd.c_str());
+        return -1;
+    case SubmitError::InvalidDependency: {
+        metrics_.inc_rejected();
+        auto deps = format_dependencies(spec.depends_on);
+        NANO_LOG(WARNING, "job depends on unknown jobs depends=%s, cmd=%s", deps.c_str(), spec.cmd.c_str());
+        return -1;
     }
+    case SubmitError::InvalidArray:
+        metrics_.inc_rejected();
+        NANO_LOG(WARNING, "invalid job array first=%d last=%d step=%d, cmd=%s", spec.array.first, spec.array.last, spec.array.step, spec.cmd.c_str());
+        return -1;
+    default:
+        break;
+    }
+    RestartParents restart_parents;
+    lookup_restart_parents(spec.depends_on, restart_parents);
 
-    std::unique_lock lk(mu_);
-    if (static_cast<int>(pending_.size()) >= opts_.max_queue_size) {
+    // 先占名额再入队：queued_ 覆盖入口环与 pending_，上限与 max_queue_size 一致
+    int queued = queued_.fetch_add(1, std::memory_order_relaxed);
+    if (queued >= opts_.max_queue_size) {
+        queued_.fetch_sub(1, std::memory_order_relaxed);
         metrics_.inc_rejected();
-        NANO_LOG(WARNING, "queue full size=%zu, cmd=%s", pending_.size(), spec.cmd.c_str());
+        NANO_LOG(WARNING, "queue full size=%d, cmd=%s", queued, spec.cmd.c_str());
         return -1;
     }
+    const auto tasks = spec.array.size();
     Job job;
-    job.id = next_id_++;
+    job.id = next_id_.fetch_add(1 + static_cast<int>(tasks), std::memory_order_relaxed);
     job.spec = spec;
+    job.demand = demand;
     job.status = JobStatus::Pending;
     job.enqueue_time = std::chrono::steady_clock::now();
-    pending_.push_back(job);
-    metrics_.inc_submitted();
-    metrics_.set_pending(static_cast<long long>(pending_.size()));
+    job.cron_template = cron_template;
+    int id = job.id;
 
     if (store_) {
+        // 必须先于入队：派发后的 Running 更新不能早于插入
         auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
-        store_->insert_job(spec, PersistStatus::Queued, ms);
+        store_->insert_job(id, spec, PersistStatus::Queued, ms);
     }
+    metrics_.inc_submitted(static_cast<long long>(std::max<std::size_t>(tasks, 1)));
 
-    NANO_LOG(NOTICE, "job queued id=%d cmd=%s cpu=%d mem_mb=%zu pending=%zu", job.id, spec.cmd.c_str(), spec.cpu_cores, spec.memory_mb, pending_.size());
+    if (!spec.depends_on.empty() || tasks > 0) {
+        // 有依赖的任务与数组不走入口环：加锁按父任务状态直接入队、放入依赖图或取消
+        std::vector<Job> cancelled;
+        {
+            std::lock_guard lk(pending_mu_);
+            admit_locked(std::move(job), restart_parents, cancelled);
+            cv_.notify_all();
+        }
+        finish_cancelled(cancelled);
+    } else if (intake_.try_push(job)) {
+        // 与派发线程的 dispatcher_sleeping_ 构成 Dekker 式握手：要么它看到新任务，要么我们看到它在睡
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (dispatcher_sleeping_.load(std::memory_order_relaxed)) {
+            std::lock_guard lk(pending_mu_);
+            cv_.notify_all();
+        }
+    } else {
+        // 入口环满（派发线程跟不上）：退回加锁直接入队
+        std::lock_guard lk(pending_mu_);
+        publish_queue_locked(pending_.push(std::move(job)));
+        dispatch_dirty_ = true;
+        cv_.notify_all();
+    }
 
-    lk.unlock();
-    cv_.notify_all();
-    return job.id;
+    if (tasks > 0) {
+        auto range = format_array_range(spec.array);
+        NANO_LOG(NOTICE, "job array queued id=%d array=%s tasks=%zu cmd=%s cpu=%d mem_mb=%zu pending=%d", id, range.c_str(), tasks, spec.cmd.c_str(), spec.cpu_cores, spec.memory_mb, queued + 1);
+    } else {
+        NANO_LOG(NOTICE, "job queued id=%d cmd=%s cpu=%d mem_mb=%zu pending=%d", id, spec.cmd.c_str(), spec.cpu_cores, spec.memory_mb, queued + 1);
+    }
+    return id;
+}
+
+std::vector<SubmitResult> Scheduler::submit_batch(std::span<const JobSpec> specs) {
+    std::vector<SubmitResult> results(specs.size());
+    std::vector<ResourceVector> demands(specs.size());
+    bool has_deps = false;
+    bool has_arrays = false;
+    for (std::size_t i = 0; i < specs.size(); ++i) {
+        results[i].error = check_spec(specs[i], demands[i], specs.size());
+        has_deps = has_deps || !specs[i].depends_on.empty();
+        has_arrays = has_arrays || specs[i].array.size() > 0;
+    }
+    // 有依赖时按父在前的顺序放入依赖图，同批的父任务先于子任务登记；只有数组时按提交顺序逐个登记
+    const bool admit_each = has_deps || has_arrays;
+    std::vector<std::size_t> order;
+    if (has_deps) {
+        order = order_batch(specs, results);
+    } else if (has_arrays) {
+        order.resize(specs.size());
+        std::iota(order.begin(), order.end(), std::size_t{0});
+    }
+    auto is_valid = [](const SubmitResult &r) { return r.error == SubmitError::None; };
+    auto valid = static_cast<std::size_t>(std::count_if(results.begin(), results.end(), is_valid));
+
+    std::vector<Job> accepted;
+    accepted.reserve(valid);
+    auto submit_ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    // 一次性占用名额，多占的部分在入队后归还
+    int queued = queued_.fetch_add(static_cast<int>(valid), std::memory_order_relaxed);
+    auto room = static_cast<std::size_t>(std::clamp(opts_.max_queue_size - queued, 0, static_cast<int>(valid)));
+    std::size_t taken = 0;
+    for (auto &r : results) {
+        if (is_valid(r) && taken++ >= room) r.error = SubmitError::QueueFull;
+    }
+    if (has_deps) {
+        // 依赖了同批中被拒绝任务的也拒绝（父在前，一遍即可传递）
+        for (std::size_t i : order) {
+            if (!is_valid(results[i])) continue;
+            for (const auto &dep : specs[i].depends_on) {
+                if (dep.job_id < 0 && !is_valid(results[static_cast<std::size_t>(-dep.job_id) - 1])) {
+                    results[i].error = SubmitError::InvalidDependency;
+                    break;
+                }
+            }
+        }
+    }
+    auto admitted = static_cast<std::size_t>(std::count_if(results.begin(), results.end(), is_valid));
+    if (admitted < valid) queued_.fetch_sub(static_cast<int>(valid - admitted), std::memory_order_relaxed);
+    int pending_size = queued + static_cast<int>(admitted);
+    RestartParents restart_parents;
+    for (std::size_t i = 0; has_deps && i < specs.size(); ++i) {
+        if (is_valid(results[i])) lookup_restart_parents(specs[i].depends_on, restart_parents);
+    }
+    std::vector<Job> cancelled;
+    std::vector<std::size_t> slot(admit_each ? specs.size() : 0); // specs 下标 → accepted 下标
+    long long tasks = 0;
+    // id 一次性分配（数组占 1 + 下标数个），锁外构造任务并持久化，与 submit_job 一样不在 pending_mu_ 下做 I/O
+    int ids = 0;
+    for (std::size_t i = 0; i < specs.size(); ++i) {
+        if (is_valid(results[i])) ids += 1 + static_cast<int>(specs[i].array.size());
+    }
+    int next = next_id_.fetch_add(ids, std::memory_order_relaxed);
+    auto now = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < specs.size(); ++i) {
+        if (!is_valid(results[i])) continue;
+        if (admit_each) slot[i] = accepted.size();
+        auto n = specs[i].array.size();
+        tasks += static_cast<long long>(std::max<std::size_t>(n, 1));
+        Job job;
+        job.id = next;
+        next += 1 + static_cast<int>(n);
+        job.spec = specs[i];
+        job.demand = demands[i];
+        job.status = JobStatus::Pending;
+        job.enqueue_time = now;
+        results[i].id = job.id;
+        accepted.push_back(std::move(job));
+    }
+    if (has_deps) {
+        // 同批引用换成分配到的 id，持久化的是换算后的依赖
+        for (auto &job : accepted) {
+            for (auto &dep : job.spec.depends_on) {
+                if (dep.job_id < 0) dep.job_id = results[static_cast<std::size_t>(-dep.job_id) - 1].id;
+            }
+        }
+    }
+    // 必须先于入队：派发后的 Running 更新不能早于插入
+    if (store_ && !accepted.empty()) store_->insert_jobs(accepted, PersistStatus::Queued, submit_ms);
+    {
+        std::lock_guard lk(pending_mu_);
+        if (!accepted.empty()) {
+            if (admit_each) {
+                for (std::size_t i : order) {
+                    if (is_valid(results[i])) admit_locked(std::move(accepted[slot[i]]), restart_parents, cancelled);
+                }
+            } else {
+                int last_queue = -1;
+                for (auto &job : accepted) {
+                    int q = pending_.push(std::move(job));
+                    if (q != last_queue && last_queue >= 0) publish_queue_locked(last_queue);
+                    last_queue = q;
+                }
+                publish_queue_locked(last_queue);
+                dispatch_dirty_ = true;
+            }
+        }
+        metrics_.set_pending(pending_size);
+    }
+    finish_cancelled(cancelled);
+    metrics_.inc_submitted(tasks);
+    metrics_.inc_rejected(static_cast<long long>(specs.size() - accepted.size()));
+
+    NANO_LOG(NOTICE, "job batch queued accepted=%zu rejected=%zu pending=%d", accepted.size(), specs.size() - accepted.size(), pending_size);
+    if (!accepted.empty()) cv_.notify_all();
+    return results;
 }
 
 void Scheduler::start() {
     shutting_down_.store(false);
     restore_from_store();
+    // 池中槽位在 init 时打开 cpuset 文件，须先在基路径启用 cpuset 控制器
+    if (opts_.cgroup.enabled && rm_.topology_aware() && !enable_cgroup_controller(opts_.cgroup.base_path, "cpuset")) {
+        NANO_LOG(NOTICE, "%s", "cpuset controller unavailable; pinning jobs with sched_setaffinity only");
+    }
+    if (cgroup_pool_ && cgroup_pool_->size() == 0 && cgroup_pool_->init(opts_.cgroup, opts_.cgroup.pool_size) == 0) {
+        NANO_LOG(WARNING, "%s", "cgroup pool unavailable; creating a cgroup per job");
+        cgroup_pool_.reset();
+    }
+    if (opts_.enable_zygote) {
+        ZygoteLauncher::Config zcfg;
+        zcfg.backend = opts_.launch_backend;
+        zcfg.workdir = opts_.workdir;
+        zcfg.rlimit_nofile = opts_.rlimit_nofile;
+        zcfg.disable_core_dump = opts_.disable_core_dump;
+        if (!zygote_.start(std::move(zcfg))) {
+            NANO_LOG(WARNING, "%s", "zygote unavailable; launching jobs directly");
+        }
+    }
 
+    // 先采样一次压力再启动派发线程，避免启动瞬间不限速
+    const bool psi_ready = opts_.enable_psi_monitor && open_psi();
     threads_.emplace_back([this] { run_guarded("dispatcher_loop", [this] { dispatcher_loop(); }); });
     threads_.emplace_back([this] { run_guarded("reaper_loop", [this] { reaper_loop(); }); });
-    if (opts_.enable_psi_monitor) {
+    if (psi_ready) {
         threads_.emplace_back([this] { run_guarded("psi_loop", [this] { psi_loop(); }); });
     }
     if (opts_.enable_cron && cron_sched_) {
         threads_.emplace_back([this] { run_guarded("cron_loop", [this] { cron_loop(); }); });
     }
     if (metrics_server_) {
-        metrics_server_->start(opts_.metrics_http_port, [this] { return metrics_.to_prometheus(); });
+        metrics_server_->start(
+            opts_.metrics_http_port, [this](std::string &out) { metrics_.render_prometheus(out); }, opts_.metrics_cache_ms);
     }
 }
 
 void Scheduler::stop() {
     if (shutting_down_.exchange(true)) return;
     cv_.notify_all();
+    watcher_.wake();
+    if (cron_sched_) cron_sched_->stop();
+    psi_.wake();
     if (metrics_server_) metrics_server_->stop();
     for (auto &t : threads_) {
         if (t.joinable()) t.join();
     }
     threads_.clear();
+    zygote_.stop();
+    if (store_) store_->flush();
+}
+
+int Scheduler::add_cron(std::string_view expr, const JobSpec &spec) {
+    if (!cron_sched_) {
+        NANO_LOG(WARNING, "%s", "cron is disabled; template ignored");
+        return -1;
+    }
+    auto cron = CronExpression::parse(expr);
+    if (!cron) {
+        auto msg = "invalid cron expression: " + std::string(expr);
+        NANO_LOG(WARNING, "%s", msg.c_str());
+        return -1;
+    }
+    CronTemplate tpl;
+    tpl.cron = std::move(*cron);
+    tpl.spec = spec;
+    return cron_sched_->add_template(tpl);
+}
+
+int Scheduler::add_cron(const CronTemplate &tpl) {
+    if (!cron_sched_) {
+        NANO_LOG(WARNING, "%s", "cron is disabled; template ignored");
+        return -1;
+    }
+    return cron_sched_->add_template(tpl);
 }
 
 bool Scheduler::idle() const {
-    std::lock_guard lk(mu_);
-    return pending_.empty() && running_.empty();
+    std::scoped_lock lk(pending_mu_, running_mu_);
+    return queued_.load() == 0 && running_.empty() && in_flight_.load() == 0;
 }
 
 Metrics::Snapshot Scheduler::metrics_snapshot() const { return metrics_.snapshot(); }
 
+// 选出下一个可运行的任务并预留资源。队首为加权主导份额最小的队列的第一个任务；
+// 放不下时按份额顺序从各队列（队首所在队列从第二个起）共 backfill_scan_limit 个任务中回填一个放得下的：
+// 未配置评分器时按此顺序取第一个，否则取得分最高的；
+// 若开启预留且队首阻塞超过 backfill_reserve_ms，则停止回填，等待资源释放给队首。
 bool Scheduler::pick_next_job(Job &out) {
-    if (pending_.empty()) return false;
-    if (opts_.enable_priority) {
-        auto it = std::max_element(pending_.begin(), pending_.end(), [](const Job &a, const Job &b) {
-            if (a.spec.priority == b.spec.priority) return a.id > b.id; // FIFO when equal priority
-            return a.spec.priority < b.spec.priority;
-        });
-        out = *it;
-        pending_.erase(it);
-    } else {
-        out = pending_.front();
-        pending_.pop_front();
+    const int head_queue = pending_.front();
+    if (head_queue < 0) return false;
+    auto head = pending_.queue(head_queue).begin();
+
+    const Job &head_job = head->second;
+    CpuPlacement placement;
+    if (rm_.reserve(head_job.demand, placement)) {
+        blocked_head_id_ = 0;
+        take_pending_locked(head_queue, head, out);
+        out.placement = std::move(placement);
+        update_cpuset_metrics();
+        publish_queue_locked(head_queue);
+        return true;
     }
-    metrics_.set_pending(static_cast<long long>(pending_.size()));
+
+    auto now = std::chrono::steady_clock::now();
+    if (blocked_head_id_ != head_job.id) {
+        blocked_head_id_ = head_job.id;
+        blocked_since_ = now;
+        NANO_LOG(NOTICE, "resource busy head job id=%d cpu=%d mem_mb=%zu pending=%zu", head_job.id, head_job.spec.cpu_cores, head_job.spec.memory_mb, pending_.size());
+    }
+    if (!opts_.enable_backfill) return false;
+    if (opts_.backfill_reserve_ms >= 0 && now - blocked_since_ >= std::chrono::milliseconds(opts_.backfill_reserve_ms)) {
+        return false;
+    }
+
+    auto &cands = backfill_candidates_;
+    cands.clear();
+    const auto limit = static_cast<std::size_t>(std::max(opts_.backfill_scan_limit, 0));
+    pending_.for_each_active([&](int q, PendingQueue &jobs) {
+        for (auto it = q == head_queue ? std::next(jobs.begin()) : jobs.begin(); it != jobs.end(); ++it) {
+            if (cands.size() >= limit) return false;
+            cands.emplace_back(q, it);
+        }
+        return true;
+    });
+    // 只有派发线程预留资源，快照到 reserve 之间资源只会变多
+    auto it = pick_placement(cands.begin(), cands.end(), rm_.usage(), scorer_.get(), [](const auto &c) -> const ResourceVector & { return c.second->second.demand; });
+    if (it == cands.end() || !rm_.reserve(it->second->second.demand, placement)) return false;
+    const int queue = it->first;
+    take_pending_locked(queue, it->second, out);
+    out.placement = std::move(placement);
+    update_cpuset_metrics();
+    publish_queue_locked(queue);
+    metrics_.inc_backfilled();
+    NANO_LOG(DEBUG, "backfill job id=%d ahead of blocked id=%d", out.id, blocked_head_id_);
     return true;
 }
 
-bool Scheduler::launch_job(Job &job) {
-    std::string cg_path;
-    if (opts_.cgroup.enabled) {
-        cg_path = create_cgroup_for_job(job.id, job.spec.cpu_cores, job.spec.memory_mb, opts_.cgroup);
-        if (cg_path.empty()) {
-            NANO_LOG(WARNING, "create_cgroup failed for job id=%d", job.id);
+void Scheduler::take_pending_locked(int queue, PendingQueue::iterator it, Job &out) {
+    if (it->second.spec.array.size() == 0) {
+        out = pending_.take(queue, it);
+        metrics_.set_pending(queued_.fetch_sub(1, std::memory_order_relaxed) - 1);
+        return;
+    }
+    // 数组条目：取出后按下一个序号展开一个任务，条目以同一键放回，仍在队列中原来的位置
+    Job entry = pending_.take(queue, it);
+    auto &st = arrays_.at(entry.id);
+    const std::size_t k = entry.array_next;
+    st.started = true;
+    out = Job{};
+    out.id = entry.id + 1 + static_cast<int>(k);
+    out.spec = entry.spec;
+    out.spec.cmd = expand_task_index(entry.spec.cmd, st.range.index(k));
+    out.spec.depends_on.clear();
+    out.spec.array = ArrayRange{};
+    out.demand = entry.demand;
+    out.queue = entry.queue;
+    out.enqueue_time = entry.enqueue_time;
+    out.array_id = entry.id;
+    out.array_index = st.range.index(k);
+
+    std::size_t next = k + 1;
+    while (next < st.done.size() && st.done[next]) ++next;
+    if (next < st.done.size()) {
+        entry.array_next = next;
+        pending_.push(std::move(entry));
+    } else {
+        metrics_.set_pending(queued_.fetch_sub(1, std::memory_order_relaxed) - 1);
+    }
+}
+
+// 把入口环中的任务并入 pending_；仅派发线程持 pending_mu_ 调用
+void Scheduler::drain_intake_locked() {
+    Job job;
+    bool any = false;
+    while (intake_.try_pop(job)) {
+        publish_queue_locked(pending_.push(std::move(job)));
+        any = true;
+    }
+    if (any) dispatch_dirty_ = true;
+}
+
+void Scheduler::release_job_resources(const Job &job) {
+    rm_.release(job.demand, job.placement);
+    update_cpuset_metrics();
+    std::vector<Job> ready;
+    std::vector<Job> cancelled;
+    std::vector<FinishedArray> arrays;
+    {
+        std::lock_guard lk(pending_mu_);
+        pending_.release(job.queue, job.demand);
+        publish_queue_locked(job.queue);
+        // 只遍历等待该任务的子任务
+        deps_.finish(job.id, job.status, ready, cancelled);
+        if (job.array_id >= 0) finish_array_task_locked(job, ready, cancelled, arrays);
+        push_ready_locked(ready);
+        dispatch_dirty_ = true;
+    }
+    cv_.notify_all();
+    finish_cancelled(cancelled);
+    finish_arrays(arrays);
+}
+
+void Scheduler::finish_array_task_locked(const Job &task, std::vector<Job> &ready, std::vector<Job> &cancelled, std::vector<FinishedArray> &finished) {
+    auto it = arrays_.find(task.array_id);
+    if (it == arrays_.end()) return;
+    auto &st = it->second;
+    auto k = static_cast<std::size_t>(task.id - task.array_id - 1);
+    if (k >= st.done.size() || st.done[k]) return;
+    st.done[k] = true;
+    if (task.status != JobStatus::Succeeded) st.all_succeeded = false;
+    if (--st.remaining > 0) return;
+    // 最后一个下标结束：数组本身结束，等待整个数组的任务据此解除
+    auto status = st.all_succeeded ? JobStatus::Succeeded : JobStatus::Failed;
+    deps_.finish(task.array_id, status, ready, cancelled);
+    finished.push_back(FinishedArray{task.array_id, status, st.done.size(), st.cron_template});
+    arrays_.erase(it);
+}
+
+void Scheduler::finish_arrays(const std::vector<FinishedArray> &finished) {
+    for (const auto &a : finished) {
+        bool ok = a.status == JobStatus::Succeeded;
+        if (store_) store_->update_status(a.id, ok ? PersistStatus::Succeeded : PersistStatus::Failed);
+        if (a.cron_template >= 0 && cron_sched_) cron_sched_->instance_finished(a.cron_template);
+        if (ok) {
+            NANO_LOG(NOTICE, "job array finished success id=%d tasks=%zu", a.id, a.size);
+        } else {
+            NANO_LOG(ERROR, "job array finished with failed tasks id=%d tasks=%zu", a.id, a.size);
         }
     }
+}
 
-    pid_t pid = ::fork();
-    if (pid < 0) {
-        auto msg = std::string("fork failed: ") + std::strerror(errno);
-        NANO_LOG(ERROR, "%s", msg.c_str());
-        metrics_.inc_launch_failed();
-        rm_.release(job.spec.cpu_cores, job.spec.memory_mb);
-        return false;
+void Scheduler::persist_status(const Job &job, PersistStatus status, int exit_code, int64_t start_ms, int64_t end_ms) {
+    if (!store_) return;
+    if (job.array_id >= 0) {
+        store_->record_array_task(job.array_id, job.id, job.array_index, status, exit_code, start_ms, end_ms);
+    } else {
+        store_->update_status(job.id, status, exit_code, start_ms, end_ms);
     }
+}
 
-    if (pid == 0) {
-        // child
-        ::setpgid(0, 0);
-        if (!cg_path.empty()) {
-            attach_pid_to_cgroup(::getpid(), cg_path);
+void Scheduler::lookup_restart_parents(std::span<const JobDependency> deps, RestartParents &out) const {
+    if (!store_) return;
+    for (const auto &dep : deps) {
+        // 恢复后不再修改，可以不加锁读取
+        if (!deps_.finished_before_restart(dep.job_id) || out.count(dep.job_id)) continue;
+        auto ps = store_->load_status(dep.job_id);
+        out.emplace(dep.job_id, ps ? job_status_of(*ps) : std::nullopt);
+    }
+}
+
+void Scheduler::admit_locked(Job job, const RestartParents &restart_parents, std::vector<Job> &cancelled) {
+    // 恢复时已按持久化的记录建好
+    if (job.spec.array.size() > 0) arrays_.try_emplace(job.id, job.spec.array, job.cron_template);
+    std::vector<JobDependency> waiting;
+    bool satisfiable = true;
+    for (const auto &dep : job.spec.depends_on) {
+        auto status = deps_.final_status(dep.job_id);
+        if (!status && deps_.finished_before_restart(dep.job_id)) {
+            auto it = restart_parents.find(dep.job_id);
+            if (it != restart_parents.end()) status = it->second;
+            // 重启前结束但终态已无记录：只能确定 AnyFinish 满足
+            if (!status) {
+                satisfiable = dep.condition == DependencyCondition::AnyFinish;
+                if (!satisfiable) break;
+                continue;
+            }
         }
-        if (opts_.rlimit_nofile >= 0) {
-            struct rlimit rl{static_cast<rlim_t>(opts_.rlimit_nofile), static_cast<rlim_t>(opts_.rlimit_nofile)};
-            setrlimit(RLIMIT_NOFILE, &rl);
+        if (!status) {
+            waiting.push_back(dep);
+        } else if (!dependency_satisfied(dep.condition, *status)) {
+            satisfiable = false;
+            break;
         }
-        if (opts_.disable_core_dump) {
-            struct rlimit rl{0, 0};
-            setrlimit(RLIMIT_CORE, &rl);
+    }
+    if (!satisfiable) {
+        // 恢复时可能已有子任务在等它，一并级联
+        int id = job.id;
+        job.status = JobStatus::Cancelled;
+        cancelled.push_back(std::move(job));
+        std::vector<Job> ready;
+        deps_.finish(id, JobStatus::Cancelled, ready, cancelled);
+        push_ready_locked(ready);
+        return;
+    }
+    if (waiting.empty()) {
+        publish_queue_locked(pending_.push(std::move(job)));
+        dispatch_dirty_ = true;
+        return;
+    }
+    deps_.hold(std::move(job), waiting);
+    metrics_.set_dependency_held(static_cast<long long>(deps_.held()));
+}
+
+void Scheduler::push_ready_locked(std::vector<Job> &ready) {
+    auto now = std::chrono::steady_clock::now();
+    for (auto &job : ready) {
+        NANO_LOG(DEBUG, "job dependencies satisfied id=%d", job.id);
+        // 排队等待从依赖满足时算起
+        job.enqueue_time = now;
+        publish_queue_locked(pending_.push(std::move(job)));
+        dispatch_dirty_ = true;
+    }
+    ready.clear();
+    metrics_.set_dependency_held(static_cast<long long>(deps_.held()));
+}
+
+void Scheduler::finish_cancelled(std::vector<Job> &cancelled) {
+    if (cancelled.empty()) return;
+    // 被取消的数组尚未派发过下标：各下标记为取消，等待这些下标的任务随之级联（追加到 cancelled 末尾）
+    bool any_array = false;
+    for (std::size_t i = 0; i < cancelled.size(); ++i) {
+        if (cancelled[i].spec.array.size() == 0) continue;
+        const int array_id = cancelled[i].id;
+        std::vector<Job> ready;
+        std::lock_guard lk(pending_mu_);
+        auto it = arrays_.find(array_id);
+        if (it == arrays_.end()) continue;
+        for (std::size_t k = 0; k < it->second.done.size(); ++k) {
+            if (!it->second.done[k]) deps_.finish(array_id + 1 + static_cast<int>(k), JobStatus::Cancelled, ready, cancelled);
         }
-        if (!opts_.workdir.empty()) {
-            chdir(opts_.workdir.c_str());
+        arrays_.erase(it);
+        push_ready_locked(ready);
+        any_array = true;
+    }
+    if (any_array) cv_.notify_all();
+    int n = static_cast<int>(cancelled.size());
+    long long tasks = 0;
+    for (const auto &job : cancelled) tasks += static_cast<long long>(std::max<std::size_t>(job.spec.array.size(), 1));
+    metrics_.set_pending(queued_.fetch_sub(n, std::memory_order_relaxed) - n);
+    metrics_.inc_cancelled(tasks);
+    for (const auto &job : cancelled) {
+        if (store_) store_->update_status(job.id, PersistStatus::Cancelled);
+        // 取消也是 cron 实例的结束（数组已从 arrays_ 移除，finish_arrays 不会再归还）
+        if (job.cron_template >= 0 && cron_sched_) cron_sched_->instance_finished(job.cron_template);
+        auto deps = format_dependencies(job.spec.depends_on);
+        NANO_LOG(WARNING, "job cancelled id=%d: dependencies can no longer be satisfied depends=%s", job.id, deps.c_str());
+    }
+    cancelled.clear();
+}
+
+void Scheduler::publish_queue_locked(int queue) {
+    if (queue < 0) return;
+    auto s = pending_.stats(queue);
+    metrics_.set_queue(queue, s.name, static_cast<long long>(s.pending), s.running, s.used[ResourceVector::Cpu], s.used[ResourceVector::MemoryMb], s.share);
+}
+
+void Scheduler::update_cpuset_metrics() {
+    if (!rm_.topology_aware()) return;
+    auto f = rm_.cpu_fragmentation();
+    metrics_.set_cpuset(f.free_cpus, f.largest_node_free, f.split_cores);
+}
+
+// 启动前准备：按需创建任务 cgroup
+void Scheduler::prepare_launch(Job &job) {
+    if (!opts_.cgroup.enabled) return;
+    if (cgroup_pool_) {
+        job.cgroup_slot = cgroup_pool_->acquire(job.spec, job.placement);
+        if (job.cgroup_slot >= 0) {
+            job.cgroup_path = cgroup_pool_->path(job.cgroup_slot);
+            return;
         }
-        execl("/bin/sh", "sh", "-c", job.spec.cmd.c_str(), nullptr);
-        _exit(127);
     }
+    job.cgroup_path = create_cgroup_for_job(job.id, job.spec, opts_.cgroup, job.placement);
+    if (job.cgroup_path.empty()) {
+        NANO_LOG(WARNING, "create_cgroup failed for job id=%d", job.id);
+    }
+}
 
-    // parent
-    job.pid = pid;
-    job.pgid = pid;
+LaunchResult Scheduler::spawn_direct(const Job &job) {
+    LaunchParams params;
+    params.cmd = job.spec.cmd.c_str();
+    params.workdir = opts_.workdir.empty() ? nullptr : opts_.workdir.c_str();
+    params.rlimit_nofile = opts_.rlimit_nofile;
+    params.disable_core_dump = opts_.disable_core_dump;
+    cpu_set_t affinity;
+    if (to_cpu_set(job.placement, affinity)) params.affinity = &affinity;
+    if (job.cgroup_slot >= 0) {
+        // 池中的 cgroup 直接用缓存的 fd，不关闭
+        if (opts_.launch_backend == LaunchBackend::Clone3) params.cgroup_fd = cgroup_pool_->dir_fd(job.cgroup_slot);
+        params.cgroup_procs_fd = cgroup_pool_->procs_fd(job.cgroup_slot);
+        return launch_process(opts_.launch_backend, params);
+    }
+    if (!job.cgroup_path.empty()) {
+        if (opts_.launch_backend == LaunchBackend::Clone3) params.cgroup_fd = open_cgroup_dir(job.cgroup_path);
+        params.cgroup_procs_fd = open_cgroup_procs(job.cgroup_path);
+    }
+    LaunchResult res = launch_process(opts_.launch_backend, params);
+    if (params.cgroup_fd >= 0) ::close(params.cgroup_fd);
+    if (params.cgroup_procs_fd >= 0) ::close(params.cgroup_procs_fd);
+    return res;
+}
+
+// 记录启动结果（在锁外调用）。失败时清理 cgroup、释放预留资源并返回 false
+bool Scheduler::complete_launch(Job &job, const LaunchResult &res) {
+    if (res.pid < 0) {
+        auto msg = std::string("launch failed backend=") + to_string(opts_.launch_backend) + ": " + std::strerror(res.error);
+        NANO_LOG(ERROR, "%s", msg.c_str());
+        metrics_.inc_launch_failed();
+        release_cgroup(job);
+        job.status = JobStatus::Failed;
+        persist_status(job, PersistStatus::LaunchFailed);
+        if (job.cron_template >= 0 && cron_sched_) cron_sched_->instance_finished(job.cron_template);
+        release_job_resources(job);
+        in_flight_.fetch_sub(1);
+        return false;
+    }
+
+    job.pid = res.pid;
+    job.pgid = res.pid;
     job.start_time = std::chrono::steady_clock::now();
     job.status = JobStatus::Running;
-    job.cgroup_path = cg_path;
 
-    if (store_) {
+    // 数组展开出的任务只持久化终态，运行中的下标重启后重新派发
+    if (store_ && job.array_id < 0) {
         auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
         store_->update_status(job.id, PersistStatus::Running, 0, ms, 0);
     }
 
-    running_[job.id] = job;
+    bool wake_reaper = false;
+    {
+        std::lock_guard lk(running_mu_);
+        running_[job.id] = job;
+        in_flight_.fetch_sub(1);
+        if (auto timeout = job_timeout(job.spec); timeout.count() > 0) {
+            auto deadline = job.start_time + timeout;
+            auto next = timers_.next_deadline();
+            timers_.schedule(deadline, job.id, TimerQueue::Kind::Terminate);
+            // 新的截止时间更早时唤醒 reaper 重新计算等待时长
+            wake_reaper = !next || deadline < *next;
+        }
+    }
+    // 先进入 running_ 再注册 pidfd，保证 reaper 收到退出事件时能找到任务
+    watcher_.watch(job.id, job.pid, res.pidfd);
+    if (wake_reaper) watcher_.wake();
     metrics_.inc_running();
-    NANO_LOG(NOTICE, "job started id=%d pid=%d cmd=%s cpu=%d mem_mb=%zu cg=%s", job.id, job.pid, job.spec.cmd.c_str(), job.spec.cpu_cores, job.spec.memory_mb, job.cgroup_path.c_str());
+    auto cpus = format_cpu_list(job.placement.cpus);
+    NANO_LOG(NOTICE, "job started id=%d pid=%d cmd=%s cpu=%d mem_mb=%zu cg=%s cpus=%s", job.id, job.pid, job.spec.cmd.c_str(), job.spec.cpu_cores, job.spec.memory_mb, job.cgroup_path.c_str(), cpus.c_str());
     return true;
 }
 
+// 启动一批已预留资源的任务（在锁外调用）：zygote 可用时一次往返批量启动，其余直接启动
+void Scheduler::launch_jobs(std::vector<Job> &jobs) {
+    for (auto &job : jobs) prepare_launch(job);
+
+    std::vector<LaunchResult> results(jobs.size());
+    std::vector<std::chrono::steady_clock::duration> latency(jobs.size());
+    std::size_t via_zygote = 0;
+    if (zygote_.running()) {
+        auto t0 = std::chrono::steady_clock::now();
+        std::vector<ZygoteLauncher::Request> reqs;
+        reqs.reserve(jobs.size());
+        std::vector<cpu_set_t> masks(rm_.topology_aware() ? jobs.size() : 0);
+        for (std::size_t i = 0; i < jobs.size(); ++i) {
+            const auto &job = jobs[i];
+            ZygoteLauncher::Request req{job.id, &job.spec.cmd, &job.cgroup_path};
+            if (!masks.empty() && to_cpu_set(job.placement, masks[i])) req.affinity = &masks[i];
+            if (!ZygoteLauncher::fits(req)) break;
+            reqs.push_back(req);
+        }
+        std::vector<LaunchResult> zres;
+        via_zygote = zygote_.launch_batch(reqs, zres);
+        std::copy_n(zres.begin(), via_zygote, results.begin());
+        // 同一批经 zygote 启动的任务都在本次往返结束时就绪
+        std::fill_n(latency.begin(), via_zygote, std::chrono::steady_clock::now() - t0);
+    }
+    for (std::size_t i = via_zygote; i < jobs.size(); ++i) {
+        auto t0 = std::chrono::steady_clock::now();
+        results[i] = spawn_direct(jobs[i]);
+        latency[i] = std::chrono::steady_clock::now() - t0;
+    }
+
+    for (std::size_t i = 0; i < jobs.size(); ++i) {
+        if (complete_launch(jobs[i], results[i])) metrics_.record_launch(latency[i]);
+    }
+}
+
+// 分阶段派发：持 pending_mu_ 选出任务并预留资源，释放锁后再创建 cgroup、启动进程与持久化
 void Scheduler::dispatcher_loop() {
+    std::vector<Job> batch;
+    const std::size_t batch_limit = static_cast<std::size_t>(std::max(1, opts_.launch_batch_size));
     while (!shutting_down_.load()) {
-        std::unique_lock lk(mu_);
-        cv_.wait(lk, [&] { return shutting_down_.load() || !pending_.empty(); });
+        std::unique_lock lk(pending_mu_);
+        drain_intake_locked();
+        if (!shutting_down_.load() && !(dispatch_dirty_ && !pending_.empty())) {
+            dispatcher_sleeping_.store(true, std::memory_order_relaxed);
+            cv_.wait(lk, [&] {
+                // 与 submit 中的 fence 配对，保证不会错过睡眠前刚入环的任务
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                return shutting_down_.load() || !intake_.empty_approx() || (dispatch_dirty_ && !pending_.empty());
+            });
+            dispatcher_sleeping_.store(false, std::memory_order_relaxed);
+            drain_intake_locked();
+        }
         if (shutting_down_.load()) break;
-        if (opts_.enable_psi_monitor && psi_backpressure_.load()) {
-            metrics_.inc_pressure_blocked();
-            NANO_LOG(WARNING, "%s", "dispatcher blocked by PSI backpressure");
-            lk.unlock();
-            std::this_thread::sleep_for(std::chrono::milliseconds(100));
-            continue;
+        std::size_t budget = batch_limit;
+        if (opts_.enable_psi_monitor) {
+            // 有压力时按令牌桶限速：没有名额就等到下一个名额（速率为 0 时最多等 100ms 再看系数）
+            auto now = std::chrono::steady_clock::now();
+            budget = admission_.available(now, batch_limit);
+            if (budget == 0) {
+                metrics_.inc_pressure_blocked();
+                auto until = std::min(admission_.next_token(now), now + std::chrono::milliseconds(100));
+                cv_.wait_until(lk, until, [this] { return shutting_down_.load(); });
+                continue;
+            }
         }
+        batch.clear();
         Job job;
-        if (!pick_next_job(job)) {
-            continue;
+        while (batch.size() < budget && pick_next_job(job)) {
+            in_flight_.fetch_add(1);
+            auto now = std::chrono::steady_clock::now();
+            auto wait_ms = std::chrono::duration_cast<std::chrono::milliseconds>(now - job.enqueue_time).count();
+            metrics_.record_queue_wait(now - job.enqueue_time);
+            NANO_LOG(DEBUG, "dispatching job id=%d cmd=%s queue_wait_ms=%lld cpu=%d mem_mb=%zu pending=%zu", job.id, job.spec.cmd.c_str(), static_cast<long long>(wait_ms), job.spec.cpu_cores, job.spec.memory_mb, pending_.size());
+            batch.push_back(std::move(job));
         }
-        auto now = std::chrono::steady_clock::now();
-        auto wait_ms = std::chrono::duration_cast<std::chrono::milliseconds>(now - job.enqueue_time).count();
-        metrics_.record_queue_wait(wait_ms);
-        NANO_LOG(DEBUG, "dispatching job id=%d cmd=%s queue_wait_ms=%lld cpu=%d mem_mb=%zu pending=%zu", job.id, job.spec.cmd.c_str(), static_cast<long long>(wait_ms), job.spec.cpu_cores, job.spec.memory_mb, pending_.size());
-        if (!rm_.reserve(job.spec.cpu_cores, job.spec.memory_mb)) {
-            // 资源不足，重新放回队列尾部
-            pending_.push_back(job);
-            metrics_.set_pending(static_cast<long long>(pending_.size()));
-            NANO_LOG(NOTICE, "resource busy requeue job id=%d pending=%zu", job.id, pending_.size());
-            lk.unlock();
-            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        if (batch.empty()) {
+            // 没有能放下的任务：等待下一次提交或资源释放
+            dispatch_dirty_ = false;
             continue;
         }
-        bool launched = launch_job(job);
+        if (opts_.enable_psi_monitor) admission_.consume(batch.size());
         lk.unlock();
-        if (!launched) {
-            // 失败时释放资源
-            rm_.release(job.spec.cpu_cores, job.spec.memory_mb);
-        }
+        launch_jobs(batch);
     }
 }
 
 void Scheduler::reaper_loop() {
-    using namespace std::chrono_literals;
+    std::vector<int> ready;
+    std::vector<std::pair<Job, int>> exited;
     while (!shutting_down_.load()) {
-        std::this_thread::sleep_for(100ms);
-        std::lock_guard lk(mu_);
-        auto now = std::chrono::steady_clock::now();
-        for (auto it = running_.begin(); it != running_.end();) {
-            Job &job = it->second;
-            if (job.spec.timeout_sec > 0) {
-                auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(now - job.start_time).count();
-                if (elapsed >= job.spec.timeout_sec) {
-                    if (!job.sigterm_sent) {
-                        kill(-job.pgid, SIGTERM);
-                        job.sigterm_sent = true;
-                        job.kill_deadline = now + std::chrono::seconds(opts_.kill_grace_sec);
-                        NANO_LOG(WARNING, "sent SIGTERM for timeout job id=%d pid=%d", job.id, job.pid);
-                    } else if (job.kill_deadline && now >= *job.kill_deadline) {
-                        kill(-job.pgid, SIGKILL);
-                        NANO_LOG(ERROR, "sent SIGKILL after grace job id=%d pid=%d", job.id, job.pid);
-                    }
-                }
+        int wait_ms = -1;
+        {
+            std::lock_guard lk(running_mu_);
+            if (auto next = timers_.next_deadline()) {
+                auto now = std::chrono::steady_clock::now();
+                // 向上取整到毫秒，避免提前醒来后空转
+                auto left = std::chrono::ceil<std::chrono::milliseconds>(*next - now).count();
+                wait_ms = static_cast<int>(std::clamp<long long>(left, 0, 60'000));
             }
+        }
+        ready.clear();
+        watcher_.wait(wait_ms, ready);
 
-            int status = 0;
-            pid_t ret = waitpid(job.pid, &status, WNOHANG);
-            if (ret > 0) {
-                job.end_time = now;
-                PersistStatus ps = PersistStatus::Succeeded;
-                if (job.sigterm_sent) {
-                    job.status = JobStatus::Timeout;
-                    ps = PersistStatus::Timeout;
-                    metrics_.inc_timeout();
-                } else if (WIFEXITED(status) && WEXITSTATUS(status) == 0) {
-                    job.status = JobStatus::Succeeded;
-                    ps = PersistStatus::Succeeded;
-                    metrics_.inc_succeeded();
-                } else {
-                    job.status = JobStatus::Failed;
-                    ps = PersistStatus::Failed;
-                    metrics_.inc_failed();
-                }
-                rm_.release(job.spec.cpu_cores, job.spec.memory_mb);
-                metrics_.dec_running();
-                if (opts_.cgroup.enabled) {
-                    cleanup_cgroup(job.cgroup_path);
-                }
-                if (store_) {
-                    auto start_ms = std::chrono::duration_cast<std::chrono::milliseconds>(job.start_time.time_since_epoch()).count();
-                    auto end_ms = std::chrono::duration_cast<std::chrono::milliseconds>(job.end_time.time_since_epoch()).count();
-                    store_->update_status(job.id, ps, status, start_ms, end_ms);
+        auto now = std::chrono::steady_clock::now();
+        {
+            std::lock_guard lk(running_mu_);
+            fire_timers(now);
+            for (int id : ready) {
+                auto it = running_.find(id);
+                if (it == running_.end()) {
+                    watcher_.unwatch(id);
+                    continue;
                 }
-                auto dur_ms = std::chrono::duration_cast<std::chrono::milliseconds>(job.end_time - job.start_time).count();
-                if (job.status == JobStatus::Succeeded) {
-                    NANO_LOG(NOTICE, "job finished success id=%d pid=%d exit=%d duration_ms=%lld", job.id, job.pid, WEXITSTATUS(status), static_cast<long long>(dur_ms));
-                } else if (job.status == JobStatus::Timeout) {
-                    NANO_LOG(WARNING, "job timeout id=%d pid=%d duration_ms=%lld", job.id, job.pid, static_cast<long long>(dur_ms));
-                } else {
-                    int exit_code = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
-                    int sig = WIFSIGNALED(status) ? WTERMSIG(status) : 0;
-                    NANO_LOG(ERROR, "job failed id=%d pid=%d exit=%d sig=%d duration_ms=%lld", job.id, job.pid, exit_code, sig, static_cast<long long>(dur_ms));
+                Job &job = it->second;
+                int status = 0;
+                pid_t ret = waitpid(job.pid, &status, WNOHANG);
+                if (ret == 0) continue;
+                if (ret < 0) {
+                    auto msg = std::string("waitpid failed for job id=") + std::to_string(job.id) + ": " + std::strerror(errno);
+                    NANO_LOG(ERROR, "%s", msg.c_str());
+                    status = 255 << 8;
                 }
-                it = running_.erase(it);
-            } else {
-                ++it;
+                watcher_.unwatch(id);
+                job.end_time = now;
+                in_flight_.fetch_add(1);
+                exited.emplace_back(std::move(job), status);
+                running_.erase(it);
             }
+            // 已结束任务的定时器是惰性删除的，残留过多时批量清理
+            if (timers_.size() > 2 * running_.size() + 1024) {
+                timers_.prune([this](const TimerQueue::Entry &e) { return running_.count(e.job_id) > 0; });
+            }
+        }
+
+        // 收尾（释放资源、清理 cgroup、持久化）在锁外进行
+        for (auto &[job, status] : exited) {
+            finish_job(job, status);
+            in_flight_.fetch_sub(1);
+            metrics_.record_completion_lag(std::chrono::steady_clock::now() - job.end_time);
         }
+        exited.clear();
     }
 }
 
-double Scheduler::parse_psi_avg10(std::istream &ifs) {
-    // 格式：some avg10=12.34 avg60=... total=...
-    std::string token;
-    while (ifs >> token) {
-        auto pos = token.find("avg10=");
-        if (pos != std::string::npos) {
-            return std::stod(token.substr(pos + 6));
+// 只处理到期的定时器；任务已结束的条目直接丢弃
+void Scheduler::fire_timers(std::chrono::steady_clock::time_point now) {
+    std::vector<TimerQueue::Entry> expired;
+    timers_.pop_expired(now, expired);
+    for (const auto &e : expired) {
+        auto it = running_.find(e.job_id);
+        if (it == running_.end()) continue;
+        Job &job = it->second;
+        if (e.kind == TimerQueue::Kind::Terminate) {
+            if (job.sigterm_sent) continue;
+            kill(-job.pgid, SIGTERM);
+            job.sigterm_sent = true;
+            job.kill_deadline = now + std::chrono::seconds(opts_.kill_grace_sec);
+            timers_.schedule(*job.kill_deadline, job.id, TimerQueue::Kind::Kill);
+            NANO_LOG(WARNING, "sent SIGTERM for timeout job id=%d pid=%d", job.id, job.pid);
+        } else {
+            kill(-job.pgid, SIGKILL);
+            NANO_LOG(ERROR, "sent SIGKILL after grace job id=%d pid=%d", job.id, job.pid);
         }
     }
-    return 0.0;
+}
+
+void Scheduler::release_cgroup(Job &job) {
+    if (job.cgroup_slot >= 0) {
+        cgroup_pool_->release(job.cgroup_slot);
+        job.cgroup_slot = -1;
+    } else if (!job.cgroup_path.empty()) {
+        cleanup_cgroup(job.cgroup_path);
+    }
+}
+
+JobUsage Scheduler::collect_usage(const Job &job) const {
+    JobUsage usage;
+    if (job.cgroup_slot >= 0) {
+        cgroup_pool_->collect_usage(job.cgroup_slot, usage);
+    } else if (!job.cgroup_path.empty()) {
+        read_cgroup_usage(job.cgroup_path, usage);
+    }
+    return usage;
+}
+
+void Scheduler::remember_usage(int id, const JobUsage &usage) {
+    std::lock_guard lk(usage_mu_);
+    if (!recent_usage_.insert_or_assign(id, usage).second) return;
+    recent_usage_order_.push_back(id);
+    if (recent_usage_order_.size() > kRecentUsage) {
+        recent_usage_.erase(recent_usage_order_.front());
+        recent_usage_order_.pop_front();
+    }
+}
+
+std::optional<JobStatus> Scheduler::job_status(int id) const {
+    if (id <= 0 || id >= next_id_.load(std::memory_order_relaxed)) return std::nullopt;
+    if (deps_.finished_before_restart(id)) {
+        auto ps = store_ ? store_->load_status(id) : std::nullopt;
+        return ps ? job_status_of(*ps) : std::nullopt;
+    }
+    // 任务可能正在两个集合之间移动：先查终态，再查运行中，最后复查一次终态
+    {
+        std::lock_guard lk(pending_mu_);
+        if (auto st = deps_.final_status(id)) return st;
+        if (auto it = arrays_.find(id); it != arrays_.end()) return it->second.started ? JobStatus::Running : JobStatus::Pending;
+    }
+    {
+        std::lock_guard lk(running_mu_);
+        if (running_.count(id)) return JobStatus::Running;
+    }
+    std::lock_guard lk(pending_mu_);
+    if (auto st = deps_.final_status(id)) return st;
+    return JobStatus::Pending;
+}
+
+std::optional<JobUsage> Scheduler::job_usage(int id) const {
+    {
+        std::lock_guard lk(usage_mu_);
+        auto it = recent_usage_.find(id);
+        if (it != recent_usage_.end()) return it->second;
+    }
+    if (store_) return store_->load_usage(id);
+    return std::nullopt;
+}
+
+// 任务退出后的收尾：更新状态与指标、释放资源并唤醒调度器、清理 cgroup、持久化
+void Scheduler::finish_job(Job &job, int status) {
+    PersistStatus ps = PersistStatus::Succeeded;
+    if (job.sigterm_sent) {
+        job.status = JobStatus::Timeout;
+        ps = PersistStatus::Timeout;
+        metrics_.inc_timeout();
+    } else if (WIFEXITED(status) && WEXITSTATUS(status) == 0) {
+        job.status = JobStatus::Succeeded;
+        ps = PersistStatus::Succeeded;
+        metrics_.inc_succeeded();
+    } else {
+        job.status = JobStatus::Failed;
+        ps = PersistStatus::Failed;
+        metrics_.inc_failed();
+    }
+    // 先读用量并归还 cgroup 槽位，再释放预留；否则新派发的作业可能拿不到空闲槽位
+    job.usage = collect_usage(job);
+    release_cgroup(job);
+    release_job_resources(job);
+    metrics_.dec_running();
+    if (job.cron_template >= 0 && cron_sched_) cron_sched_->instance_finished(job.cron_template);
+    if (job.usage.valid) {
+        metrics_.record_usage(job.usage);
+        remember_usage(job.id, job.usage);
+    }
+    if (store_) {
+        // start_time/end_time 是 steady_clock，落库统一用墙钟毫秒
+        auto end_ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+        auto start_ms = end_ms - std::chrono::duration_cast<std::chrono::milliseconds>(job.end_time - job.start_time).count();
+        persist_status(job, ps, status, start_ms, end_ms);
+        if (job.usage.valid && job.array_id < 0) store_->record_usage(job.id, job.usage);
+    }
+    metrics_.record_run(job.end_time - job.start_time);
+    auto dur_ms = std::chrono::duration_cast<std::chrono::milliseconds>(job.end_time - job.start_time).count();
+    if (job.status == JobStatus::Succeeded) {
+        NANO_LOG(NOTICE, "job finished success id=%d pid=%d exit=%d duration_ms=%lld", job.id, job.pid, WEXITSTATUS(status), static_cast<long long>(dur_ms));
+    } else if (job.status == JobStatus::Timeout) {
+        NANO_LOG(WARNING, "job timeout id=%d pid=%d duration_ms=%lld", job.id, job.pid, static_cast<long long>(dur_ms));
+    } else {
+        int exit_code = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+        int sig = WIFSIGNALED(status) ? WTERMSIG(status) : 0;
+        NANO_LOG(ERROR, "job failed id=%d pid=%d exit=%d sig=%d duration_ms=%lld", job.id, job.pid, exit_code, sig, static_cast<long long>(dur_ms));
+    }
+}
+
+bool Scheduler::open_psi() {
+    const auto &cfg = opts_.psi;
+    std::string dir = cfg.dir;
+    if (dir.empty()) dir = opts_.cgroup.enabled ? opts_.cgroup.base_path : "/proc/pressure";
+    if (psi_.open(dir, cfg) == 0) {
+        auto msg = "no pressure files under " + dir + "; PSI throttling disabled";
+        NANO_LOG(WARNING, "%s", msg.c_str());
+        return false;
+    }
+    admission_.set_max_rate(cfg.max_dispatch_rate);
+    update_pressure();
+    return true;
+}
+
+double Scheduler::update_pressure() {
+    auto levels = psi_.sample();
+    double factor = PressureMonitor::throttle_factor(levels, opts_.psi);
+    double prev = admission_.factor();
+    for (int r = 0; r < PressureMonitor::kResources; ++r) metrics_.set_pressure(r, levels[r]);
+    if (factor == prev) return factor;
+    admission_.set_factor(factor);
+    metrics_.set_dispatch_factor(factor);
+    metrics_.set_pressure_active(factor < 1.0);
+    if ((factor < 1.0) != (prev < 1.0) || std::abs(factor - prev) >= 0.1) {
+        NANO_LOG(NOTICE, "PSI dispatch factor %.2f (memory=%.1f%% cpu=%.1f%% io=%.1f%%)", factor, levels[0], levels[1], levels[2]);
+    }
+    // 系数回升时派发线程可能在等名额
+    if (factor > prev) cv_.notify_all();
+    return factor;
 }
 
 void Scheduler::psi_loop() {
+    double factor = admission_.factor();
+    bool fired = true;
     while (!shutting_down_.load()) {
-        std::this_thread::sleep_for(std::chrono::seconds(1));
-        std::string mem_pressure_file = opts_.cgroup.base_path + "/memory.pressure";
-        std::ifstream ifs(mem_pressure_file);
-        double avg10 = ifs ? parse_psi_avg10(ifs) : 0.0;
-        bool pressure = (avg10 > 50.0);
-        if (pressure != psi_backpressure_.load()) {
-            psi_backpressure_.store(pressure);
-            metrics_.set_pressure_active(pressure);
-            NANO_LOG(NOTICE, "%s", pressure ? "PSI backpressure activated" : "PSI backpressure cleared");
-        }
+        // 有压力、刚触发过或有文件没挂上 trigger 时按窗口复查，否则一直等 trigger
+        int timeout = factor < 1.0 || fired || !psi_.all_triggered() ? std::max(500, opts_.psi.window_ms) : -1;
+        fired = psi_.wait(timeout);
+        if (shutting_down_.load()) break;
+        factor = update_pressure();
     }
 }
 
 void Scheduler::cron_loop() {
-    using namespace std::chrono_literals;
-    while (!shutting_down_.load()) {
-        if (cron_sched_) {
-            cron_sched_->tick([this](const JobSpec &spec) { this->submit(spec); });
-        }
-        std::this_thread::sleep_for(std::chrono::milliseconds(opts_.cron_tick_ms));
-    }
+    cron_sched_->run([this](int tpl, const JobSpec &spec) { return submit_job(spec, tpl); });
 }
 
 void Scheduler::restore_from_store() {
     if (!store_) return;
     auto jobs = store_->load_unfinished();
-    for (auto &pj : jobs) {
-        Job job;
-        job.id = pj.id;
-        job.spec = pj.spec;
-        job.status = JobStatus::Pending;
-        job.enqueue_time = std::chrono::steady_clock::now();
-        pending_.push_back(job);
-        next_id_ = std::max(next_id_, job.id + 1);
+    // 已结束的任务不会被恢复，但其 id 不能再分配，否则新任务会覆盖旧记录
+    if (int used = store_->max_id(); next_id_.load() <= used) next_id_.store(used + 1);
+    std::vector<std::pair<int, int>> restored;
+    restored.reserve(jobs.size());
+    for (const auto &pj : jobs) {
+        // 重启前已接受的队列照常恢复，不受上限约束
+        reserve_queue(pj.spec.queue, true);
+        // 数组连同其全部下标
+        int last = pj.id + static_cast<int>(pj.spec.array.size());
+        if (next_id_.load() <= last) next_id_.store(last + 1);
+        restored.emplace_back(pj.id, last);
+    }
+    // 小于水位（用过的最大 id + 1）且未恢复的任务都在重启前结束了，对它们的依赖按持久化的终态判断
+    deps_.set_restored(next_id_.load(), std::move(restored));
+    RestartParents restart_parents;
+    for (const auto &pj : jobs) lookup_restart_parents(pj.spec.depends_on, restart_parents);
+
+    std::vector<Job> ready;
+    std::vector<Job> cancelled;
+    std::vector<FinishedArray> arrays;
+    {
+        std::lock_guard lk(pending_mu_);
+        for (auto &pj : jobs) {
+            // 数组：已结束的下标置位并记下终态，只派发其余下标
+            ArrayState *st = nullptr;
+            if (pj.spec.array.size() > 0) {
+                st = &arrays_.try_emplace(pj.id, pj.spec.array, -1).first->second;
+                for (const auto &[task, ps] : pj.finished_tasks) {
+                    auto k = static_cast<std::size_t>(task - pj.id - 1);
+                    if (task <= pj.id || k >= st->done.size() || st->done[k]) continue;
+                    auto status = job_status_of(ps).value_or(JobStatus::Failed);
+                    st->done[k] = true;
+                    --st->remaining;
+                    st->started = true;
+                    if (status != JobStatus::Succeeded) st->all_succeeded = false;
+                    deps_.finish(task, status, ready, cancelled);
+                }
+            }
+            auto demand = rm_.demand_of(pj.spec);
+            if (!demand) {
+                // 重启后配额里去掉了该任务申请的令牌，永远无法调度
+                auto tokens = format_resource_tokens(pj.spec.tokens);
+                NANO_LOG(WARNING, "drop restored job id=%d with unknown resource tokens=%s", pj.id, tokens.c_str());
+                store_->update_status(pj.id, PersistStatus::LaunchFailed);
+                if (st) {
+                    for (std::size_t k = 0; k < st->done.size(); ++k) {
+                        if (!st->done[k]) deps_.finish(pj.id + 1 + static_cast<int>(k), JobStatus::Failed, ready, cancelled);
+                    }
+                    arrays_.erase(pj.id);
+                }
+                deps_.finish(pj.id, JobStatus::Failed, ready, cancelled);
+                push_ready_locked(ready);
+                continue;
+            }
+            push_ready_locked(ready);
+            Job job;
+            job.id = pj.id;
+            job.spec = std::move(pj.spec);
+            job.demand = *demand;
+            job.status = JobStatus::Pending;
+            job.enqueue_time = std::chrono::steady_clock::now();
+            if (st) {
+                if (st->remaining == 0) {
+                    // 最后一个下标已结束，但数组的终态在重启前没来得及写入
+                    auto status = st->all_succeeded ? JobStatus::Succeeded : JobStatus::Failed;
+                    deps_.finish(job.id, status, ready, cancelled);
+                    push_ready_locked(ready);
+                    arrays.push_back(FinishedArray{job.id, status, st->done.size(), -1});
+                    arrays_.erase(job.id);
+                    continue;
+                }
+                while (st->done[job.array_next]) ++job.array_next;
+            }
+            queued_.fetch_add(1);
+            admit_locked(std::move(job), restart_parents, cancelled);
+        }
+        if (!jobs.empty()) {
+            dispatch_dirty_ = true;
+            cv_.notify_all();
+        }
     }
-    if (!jobs.empty()) cv_.notify_all();
+    finish_cancelled(cancelled);
+    finish_arrays(arrays);
 }
@@ -2,20 +2,33 @@
 
 #include "cron_scheduler.h"
 #include "cgroup_helper.h"
+#include "cgroup_pool.h"
+#include "child_watcher.h"
+#include "dependency_graph.h"
+#include "fair_share_queue.h"
 #include "job.h"
+#include "intake_ring.h"
+#include "job_array.h"
 #include "job_store.h"
 #include "metrics.h"
 #include "NanoLogCpp17.h"
 #include "metrics_http_server.h"
+#include "pressure_monitor.h"
 #include "resource_manager.h"
+#include "timer_queue.h"
+#include "zygote_launcher.h"
 
 #include <atomic>
 #include <condition_variable>
 #include <deque>
+#include <map>
 #include <memory>
 #include <mutex>
+#include <optional>
+#include <span>
 #include <thread>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 class Scheduler {
@@ -24,31 +37,143 @@ public:
     ~Scheduler();
 
     int submit(const JobSpec &spec);
+    // 批量提交：锁外逐项校验，一次加锁分配 id 入队，一个事务持久化，只唤醒一次调度器。
+    // results[i] 对应 specs[i]；队列在中途满时其余任务以 QueueFull 拒绝。
+    // 依赖可用 -k 引用同批第 k 个任务；成环的任务以 DependencyCycle 拒绝，依赖了被拒绝任务的以 InvalidDependency 拒绝。
+    // 数组任务占 1 + 下标数个 id，results[i].id 为数组本身的 id。
+    std::vector<SubmitResult> submit_batch(std::span<const JobSpec> specs);
+    // 注册 cron 模板（需开启 enable_cron），返回模板编号；表达式无效或 cron 未开启时返回 -1
+    int add_cron(std::string_view expr, const JobSpec &spec);
+    int add_cron(const CronTemplate &tpl);
     void start();
     void stop();
     bool idle() const;
     Metrics::Snapshot metrics_snapshot() const;
+    // 已结束任务的 cgroup 用量：先查最近结束任务的缓存，再查持久化（仅 SQLite 保存）；
+    // 未启用 cgroup、任务未结束或记录已淘汰时返回 nullopt
+    std::optional<JobUsage> job_usage(int id) const;
+    // 已结束任务的终态（重启前结束的向持久化查询，查不到为 nullopt）；运行中为 Running，
+    // 排队、等待依赖或正在启动为 Pending；id 未分配时返回 nullopt。
+    // 数组本身在全部下标结束前为 Pending（已有下标派发后为 Running），之后全部成功为 Succeeded，否则为 Failed
+    std::optional<JobStatus> job_status(int id) const;
+    // 替换回填时使用的评分器（nullptr 表示按队列顺序 first-fit），须在 start() 之前调用
+    void set_placement_scorer(std::unique_ptr<PlacementScorer> scorer) { scorer_ = std::move(scorer); }
 
 private:
+    // 数组任务的派发进度与各下标是否已结束（位图），受 pending_mu_ 保护
+    struct ArrayState {
+        ArrayState(const ArrayRange &r, int cron) : range(r), done(r.size()), remaining(r.size()), cron_template(cron) {}
+        ArrayRange range;
+        std::vector<bool> done; // 按序号
+        std::size_t remaining;  // 尚未结束的下标数
+        bool started{false};    // 已有下标派发
+        bool all_succeeded{true};
+        int cron_template;
+    };
+    // 全部下标已结束的数组，锁外持久化终态与记录日志
+    struct FinishedArray {
+        int id;
+        JobStatus status;
+        std::size_t size;
+        int cron_template;
+    };
+
     bool validate_cmd(const std::string &cmd) const;
+    // 通过时在 demand 中返回任务的资源向量；batch_size > 0 时允许 -1..-batch_size 的同批依赖
+    SubmitError check_spec(const JobSpec &spec, ResourceVector &demand, std::size_t batch_size = 0);
+    // 登记队列名；新名称在已有 kMaxQueues 个时返回 false（force 用于配置与恢复的队列，不受上限约束）
+    bool reserve_queue(std::string_view name, bool force = false);
+    int submit_job(const JobSpec &spec, int cron_template);
+    // 重启前已结束的父任务的终态（锁外向持久化查询），查不到为 nullopt
+    using RestartParents = std::unordered_map<int, std::optional<JobStatus>>;
+    void lookup_restart_parents(std::span<const JobDependency> deps, RestartParents &out) const;
+    // 持 pending_mu_：依赖全部满足的任务入队，有未结束父任务的放入依赖图等待，
+    // 依赖已无法满足的取消（连同已在等待它的子任务）并放入 cancelled
+    void admit_locked(Job job, const RestartParents &restart_parents, std::vector<Job> &cancelled);
+    void push_ready_locked(std::vector<Job> &ready);
+    // 锁外收尾被取消的任务：归还名额、持久化与日志；被取消的数组的各下标也记为取消
+    void finish_cancelled(std::vector<Job> &cancelled);
+    // 从待调度队列取出任务；数组条目只展开出下一个未结束的下标，还有剩余时留在原位
+    void take_pending_locked(int queue, PendingQueue::iterator it, Job &out);
+    // 持 pending_mu_：记录数组中一个下标结束，全部结束时放入 finished
+    void finish_array_task_locked(const Job &task, std::vector<Job> &ready, std::vector<Job> &cancelled, std::vector<FinishedArray> &finished);
+    void finish_arrays(const std::vector<FinishedArray> &finished);
+    // 数组展开出的任务写入各下标的记录，其余任务更新自身状态
+    void persist_status(const Job &job, PersistStatus status, int exit_code = 0, int64_t start_ms = 0, int64_t end_ms = 0);
+    void drain_intake_locked();
     bool pick_next_job(Job &out);
-    bool launch_job(Job &job);
+    // 任务结束或启动失败后归还资源与队列用量，并唤醒派发线程
+    void release_job_resources(const Job &job);
+    void publish_queue_locked(int queue);
+    void prepare_launch(Job &job);
+    LaunchResult spawn_direct(const Job &job);
+    bool complete_launch(Job &job, const LaunchResult &res);
+    void launch_jobs(std::vector<Job> &jobs);
     void dispatcher_loop();
     void reaper_loop();
+    void fire_timers(std::chrono::steady_clock::time_point now);
+    void finish_job(Job &job, int status);
+    void release_cgroup(Job &job);
+    void update_cpuset_metrics();
+    // 在 release_cgroup 之前读取任务 cgroup 的用量
+    JobUsage collect_usage(const Job &job) const;
+    void remember_usage(int id, const JobUsage &usage);
+    bool open_psi();
+    // 采样 PSI 并更新限速系数，返回新系数
+    double update_pressure();
     void psi_loop();
     void cron_loop();
     void restore_from_store();
-    double parse_psi_avg10(std::istream &ifs);
 
     SchedulerOptions opts_;
     ResourceManager rm_;
-    std::deque<Job> pending_;
-    std::unordered_map<int, Job> running_;
-    mutable std::mutex mu_;
+    std::unique_ptr<PlacementScorer> scorer_;
+
+    static constexpr int kMaxIntakeCapacity = 4096;
+
+    // 锁顺序：pending_mu_ 与 running_mu_ 互不嵌套（idle() 用 scoped_lock 同时获取）。
+    // 进程创建、cgroup 与持久化 I/O 均在锁外完成。
+    mutable std::mutex pending_mu_; // 保护 pending_ 与派发状态
     std::condition_variable cv_;
+    FairShareQueue pending_;
+    // 回填候选（队列编号, 位置），复用以免每次分配
+    std::vector<std::pair<int, PendingQueue::iterator>> backfill_candidates_;
+    // submit() 的无锁入口，派发线程每轮把它并入 pending_
+    IntakeRing intake_;
+    // 入口环 + pending_ 中的任务数，提交时据此执行 max_queue_size
+    std::atomic<int> queued_{0};
+    std::atomic<bool> dispatcher_sleeping_{false};
+    // 提交或资源释放后置位；调度器扫描无果时清零并休眠等待
+    bool dispatch_dirty_{false};
+    int blocked_head_id_{0};
+    std::chrono::steady_clock::time_point blocked_since_{};
+    // 等待依赖的任务（计入 queued_）与已结束任务的终态
+    DependencyGraph deps_;
+    // 提交过的队列名，数量受 kMaxQueues 约束；提交线程在锁外查询，单独加锁
+    std::mutex queue_names_mu_;
+    std::unordered_set<std::string> queue_names_;
+    // 尚有下标未结束的数组，按数组 id；数组在 pending_ 中只占一个条目、在 queued_ 中只计一次
+    std::map<int, ArrayState> arrays_;
+
+    mutable std::mutex running_mu_; // 保护 running_ 与 timers_
+    std::unordered_map<int, Job> running_;
+    TimerQueue timers_;
+    // 已离开 pending_ 尚未进入 running_，或已离开 running_ 尚未收尾的任务数
+    std::atomic<int> in_flight_{0};
+
+    ChildWatcher watcher_;
+    // 最近结束任务的用量，按结束顺序淘汰
+    static constexpr std::size_t kRecentUsage = 4096;
+    mutable std::mutex usage_mu_;
+    std::unordered_map<int, JobUsage> recent_usage_;
+    std::deque<int> recent_usage_order_;
+    std::unique_ptr<CgroupPool> cgroup_pool_;
+    ZygoteLauncher zygote_;
 
     std::atomic<bool> shutting_down_{false};
-    std::atomic<bool> psi_backpressure_{false};
+    // PSI 监视线程写入限速系数，派发线程按令牌桶取名额
+    PressureMonitor psi_;
+    AdmissionController admission_;
 
     Metrics metrics_;
     std::unique_ptr<JobStore> store_;
@@ -56,5 +181,5 @@ private:
     std::unique_ptr<MetricsHttpServer> metrics_server_;
 
     std::vector<std::thread> threads_;
-    int next_id_{1};
+    std::atomic<int> next_id_{1};
 };
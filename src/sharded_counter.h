@@ -0,0 +1,48 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+// 按线程分片的计数器：每个分片独占一条缓存行，线程固定写自己的分片（relaxed），
+// 读取时汇总。写多读少的指标用它避免多线程 fetch_add 同一缓存行的争用与伪共享。
+// 分片按线程首次使用时轮转分配；线程数超过 kShards 时多个线程共享分片，结果仍然正确。
+class ShardedCounter {
+public:
+    static constexpr std::size_t kShards = 32;
+
+    void add(long long n = 1) { shards_[shard_index()].v.fetch_add(n, std::memory_order_relaxed); }
+    void sub(long long n = 1) { add(-n); }
+    long long value() const {
+        long long sum = 0;
+        for (const auto &s : shards_) sum += s.v.load(std::memory_order_relaxed);
+        return sum;
+    }
+
+    static std::size_t shard_index();
+
+private:
+    static std::size_t assign_shard();
+
+    struct alignas(64) Shard {
+        std::atomic<long long> v{0};
+    };
+    std::array<Shard, kShards> shards_{};
+};
+
+namespace sharded_counter_detail {
+// 常量初始化的 thread_local 不需要每次访问都检查初始化守卫
+inline thread_local std::size_t shard = ShardedCounter::kShards;
+inline std::atomic<std::size_t> next_shard{0};
+}
+
+inline std::size_t ShardedCounter::assign_shard() {
+    auto idx = sharded_counter_detail::next_shard.fetch_add(1, std::memory_order_relaxed) % kShards;
+    sharded_counter_detail::shard = idx;
+    return idx;
+}
+
+inline std::size_t ShardedCounter::shard_index() {
+    std::size_t idx = sharded_counter_detail::shard;
+    return idx < kShards ? idx : assign_shard();
+}
@@ -0,0 +1,256 @@
+#include "time_zone.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <unordered_map>
+
+namespace {
+using namespace std::chrono;
+
+std::int64_t read_be(const std::string &d, std::size_t off, int bytes) {
+    std::uint64_t v = 0;
+    for (int i = 0; i < bytes; ++i) v = (v << 8) | static_cast<unsigned char>(d[off + i]);
+    if (bytes == 4) return static_cast<std::int32_t>(static_cast<std::uint32_t>(v));
+    return static_cast<std::int64_t>(v);
+}
+
+bool read_file(const std::string &path, std::string &out) {
+    std::ifstream ifs(path, std::ios::binary);
+    if (!ifs) return false;
+    out.assign(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+    return true;
+}
+
+bool is_alpha(char c) { return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'); }
+bool is_digit(char c) { return c >= '0' && c <= '9'; }
+
+bool parse_int(std::string_view s, std::size_t &pos, int &out) {
+    if (pos >= s.size() || !is_digit(s[pos])) return false;
+    out = 0;
+    while (pos < s.size() && is_digit(s[pos])) out = out * 10 + (s[pos++] - '0');
+    return true;
+}
+
+// 时区缩写：至少 3 个字母，或 <...> 形式
+bool parse_abbr(std::string_view s, std::size_t &pos) {
+    if (pos < s.size() && s[pos] == '<') {
+        auto close = s.find('>', pos);
+        if (close == std::string_view::npos) return false;
+        pos = close + 1;
+        return true;
+    }
+    std::size_t begin = pos;
+    while (pos < s.size() && is_alpha(s[pos])) ++pos;
+    return pos - begin >= 3;
+}
+
+// [+-]hh[:mm[:ss]]，返回秒数
+bool parse_hms(std::string_view s, std::size_t &pos, int &out) {
+    int sign = 1;
+    if (pos < s.size() && (s[pos] == '+' || s[pos] == '-')) sign = s[pos++] == '-' ? -1 : 1;
+    int h = 0, m = 0, sec = 0;
+    if (!parse_int(s, pos, h)) return false;
+    if (pos < s.size() && s[pos] == ':') {
+        ++pos;
+        if (!parse_int(s, pos, m)) return false;
+        if (pos < s.size() && s[pos] == ':') {
+            ++pos;
+            if (!parse_int(s, pos, sec)) return false;
+        }
+    }
+    out = sign * (h * 3600 + m * 60 + sec);
+    return true;
+}
+
+bool is_leap(int y) { return (y % 4 == 0 && y % 100 != 0) || y % 400 == 0; }
+} // namespace
+
+std::optional<TimeZone::PosixRule> TimeZone::PosixRule::parse(std::string_view s) {
+    PosixRule r;
+    std::size_t pos = 0;
+    int off = 0;
+    if (!parse_abbr(s, pos) || !parse_hms(s, pos, off)) return std::nullopt;
+    r.std_offset = -off; // POSIX 的符号与 UTC 偏移相反
+    if (pos == s.size()) return r;
+
+    if (!parse_abbr(s, pos)) return std::nullopt;
+    r.has_dst = true;
+    r.dst_offset = r.std_offset + 3600;
+    if (pos < s.size() && s[pos] != ',') {
+        if (!parse_hms(s, pos, off)) return std::nullopt;
+        r.dst_offset = -off;
+    }
+    auto parse_date = [&](Date &d) {
+        if (pos >= s.size() || s[pos] != ',') return false;
+        ++pos;
+        if (pos < s.size() && s[pos] == 'M') {
+            ++pos;
+            d.kind = 'M';
+            if (!parse_int(s, pos, d.month) || pos >= s.size() || s[pos++] != '.') return false;
+            if (!parse_int(s, pos, d.week) || pos >= s.size() || s[pos++] != '.') return false;
+            if (!parse_int(s, pos, d.day)) return false;
+            if (d.month < 1 || d.month > 12 || d.week < 1 || d.week > 5 || d.day > 6) return false;
+        } else if (pos < s.size() && s[pos] == 'J') {
+            ++pos;
+            d.kind = 'J';
+            if (!parse_int(s, pos, d.day) || d.day < 1 || d.day > 365) return false;
+        } else {
+            d.kind = 'D';
+            if (!parse_int(s, pos, d.day) || d.day > 365) return false;
+        }
+        if (pos < s.size() && s[pos] == '/') {
+            ++pos;
+            if (!parse_hms(s, pos, d.time)) return false;
+        }
+        return true;
+    };
+    if (pos == s.size()) {
+        // 只给了夏令时名称：沿用 POSIX 默认的美国规则
+        r.start = Date{'M', 3, 2, 0};
+        r.end = Date{'M', 11, 1, 0};
+        return r;
+    }
+    if (!parse_date(r.start) || !parse_date(r.end) || pos != s.size()) return std::nullopt;
+    return r;
+}
+
+std::int32_t TimeZone::PosixRule::offset_at(std::int64_t utc) const {
+    if (!has_dst) return std_offset;
+    auto local_std = sys_seconds{seconds{utc + std_offset}};
+    int y = static_cast<int>(year_month_day{floor<days>(local_std)}.year());
+    auto date_of = [y](const Date &d) {
+        sys_days day;
+        if (d.kind == 'J') {
+            day = sys_days{year{y} / January / 1} + days{d.day - 1 + (is_leap(y) && d.day >= 60 ? 1 : 0)};
+        } else if (d.kind == 'D') {
+            day = sys_days{year{y} / January / 1} + days{d.day};
+        } else {
+            auto first = sys_days{year{y} / month{static_cast<unsigned>(d.month)} / 1};
+            unsigned wd = weekday{first}.c_encoding();
+            day = first + days{(d.day - static_cast<int>(wd) + 7) % 7 + (d.week - 1) * 7};
+            if (d.week == 5 && year_month_day{day}.month() != month{static_cast<unsigned>(d.month)}) day -= days{7};
+        }
+        return day.time_since_epoch().count() * 86400LL + d.time;
+    };
+    std::int64_t start_utc = date_of(start) - std_offset;
+    std::int64_t end_utc = date_of(end) - dst_offset;
+    bool dst = start_utc < end_utc ? (utc >= start_utc && utc < end_utc) : !(utc >= end_utc && utc < start_utc);
+    return dst ? dst_offset : std_offset;
+}
+
+std::shared_ptr<TimeZone> TimeZone::parse_tzif(std::string name, const std::string &d) {
+    constexpr std::size_t kHeader = 44;
+    if (d.size() < kHeader || d.compare(0, 4, "TZif") != 0) return nullptr;
+    auto counts = [&](std::size_t base, std::int64_t (&c)[6]) {
+        for (int i = 0; i < 6; ++i) c[i] = read_be(d, base + 20 + 4 * i, 4);
+    };
+    // isutcnt, isstdcnt, leapcnt, timecnt, typecnt, charcnt
+    std::int64_t c[6];
+    counts(0, c);
+    std::size_t base = 0;
+    int time_bytes = 4;
+    if (d[4] >= '2') {
+        // v2+：跳过 32 位数据块，使用其后的 64 位数据块
+        std::size_t v1 = c[3] * 5 + c[4] * 6 + c[5] + c[2] * 8 + c[1] + c[0];
+        base = kHeader + v1;
+        if (d.size() < base + kHeader || d.compare(base, 4, "TZif") != 0) return nullptr;
+        counts(base, c);
+        time_bytes = 8;
+    }
+    std::size_t pos = base + kHeader;
+    std::size_t timecnt = c[3], typecnt = c[4];
+    std::size_t data_len = timecnt * (time_bytes + 1) + typecnt * 6 + c[5] + c[2] * (time_bytes + 4) + c[1] + c[0];
+    if (typecnt == 0 || d.size() < pos + data_len) return nullptr;
+
+    auto tz = std::make_shared<TimeZone>();
+    tz->name_ = std::move(name);
+    std::size_t types_at = pos + timecnt * (time_bytes + 1);
+    auto type_offset = [&](std::size_t idx) { return static_cast<std::int32_t>(read_be(d, types_at + idx * 6, 4)); };
+    tz->transitions_.reserve(timecnt);
+    tz->offsets_.reserve(timecnt);
+    for (std::size_t i = 0; i < timecnt; ++i) {
+        std::size_t idx = static_cast<unsigned char>(d[pos + timecnt * time_bytes + i]);
+        if (idx >= typecnt) return nullptr;
+        tz->transitions_.push_back(read_be(d, pos + i * time_bytes, time_bytes));
+        tz->offsets_.push_back(type_offset(idx));
+    }
+    tz->initial_offset_ = type_offset(0);
+    if (time_bytes == 8) {
+        std::size_t footer = pos + data_len;
+        if (footer < d.size() && d[footer] == '\n') {
+            auto end = d.find('\n', footer + 1);
+            if (end != std::string::npos && end > footer + 1) {
+                tz->rule_ = PosixRule::parse(std::string_view(d).substr(footer + 1, end - footer - 1));
+            }
+        }
+    }
+    return tz;
+}
+
+std::shared_ptr<const TimeZone> TimeZone::utc() {
+    static const std::shared_ptr<const TimeZone> zone = [] {
+        auto tz = std::make_shared<TimeZone>();
+        tz->name_ = "UTC";
+        return tz;
+    }();
+    return zone;
+}
+
+std::shared_ptr<const TimeZone> TimeZone::load(std::string_view name) {
+    if (name == "UTC" || name == "Etc/UTC" || name == "Z") return utc();
+
+    static std::mutex mu;
+    static std::unordered_map<std::string, std::shared_ptr<const TimeZone>> cache;
+    std::string key(name);
+    std::lock_guard lk(mu);
+    if (auto it = cache.find(key); it != cache.end()) return it->second;
+
+    std::shared_ptr<TimeZone> tz;
+    std::string data;
+    if (name == "Local") {
+        if (read_file("/etc/localtime", data)) tz = parse_tzif(key, data);
+        if (!tz) return utc();
+    } else if (!name.empty() && name.front() != '/' && name.find("..") == std::string_view::npos) {
+        const char *dir = std::getenv("TZDIR");
+        std::string path = std::string(dir && *dir ? dir : "/usr/share/zoneinfo") + "/" + key;
+        if (read_file(path, data)) tz = parse_tzif(key, data);
+    }
+    if (!tz) {
+        if (auto rule = PosixRule::parse(name)) {
+            tz = std::make_shared<TimeZone>();
+            tz->name_ = key;
+            tz->initial_offset_ = rule->std_offset;
+            tz->rule_ = rule;
+        }
+    }
+    if (!tz) return nullptr;
+    cache.emplace(key, tz);
+    return tz;
+}
+
+std::chrono::seconds TimeZone::offset_at(sys_seconds utc) const {
+    std::int64_t t = utc.time_since_epoch().count();
+    if (transitions_.empty() || t >= transitions_.back()) {
+        if (rule_) return seconds{rule_->offset_at(t)};
+        return seconds{transitions_.empty() ? initial_offset_ : offsets_.back()};
+    }
+    auto it = std::upper_bound(transitions_.begin(), transitions_.end(), t);
+    if (it == transitions_.begin()) return seconds{initial_offset_};
+    return seconds{offsets_[it - transitions_.begin() - 1]};
+}
+
+std::optional<TimeZone::sys_seconds> TimeZone::to_utc(sys_seconds local) const {
+    // 转换点附近本地时间对应的偏移只可能是转换前或转换后的值
+    auto before = offset_at(local - days{1});
+    auto after = offset_at(local + days{1});
+    std::optional<sys_seconds> best;
+    for (auto off : {before, after}) {
+        auto utc = local - off;
+        if (offset_at(utc) != off) continue;
+        if (!best || utc < *best) best = utc;
+    }
+    return best;
+}
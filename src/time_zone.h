@@ -0,0 +1,54 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// 时区：从 TZif 文件（$TZDIR，默认 /usr/share/zoneinfo）加载转换表，超出转换表的时间
+// 按文件尾部的 POSIX TZ 规则推算；也可直接给 POSIX TZ 串（如 "CST-8"）。
+// 本地时间统一用 sys_seconds 表示“按 UTC 解读的墙钟数值”。实例不可变，可跨线程共享。
+class TimeZone {
+public:
+    using sys_seconds = std::chrono::sys_seconds;
+
+    // name 可为 "UTC"、"Local"（/etc/localtime）、IANA 名称或 POSIX TZ 串；无法识别时返回 nullptr。
+    // 同名时区只加载一次。
+    static std::shared_ptr<const TimeZone> load(std::string_view name);
+    static std::shared_ptr<const TimeZone> utc();
+
+    const std::string &name() const { return name_; }
+    // 本地 = utc + offset
+    std::chrono::seconds offset_at(sys_seconds utc) const;
+    sys_seconds to_local(sys_seconds utc) const { return utc + offset_at(utc); }
+    // 本地墙钟转 UTC：夏令时回拨造成的重复时刻取较早的一次，拨快跳过的时刻返回 nullopt
+    std::optional<sys_seconds> to_utc(sys_seconds local) const;
+
+private:
+    // POSIX TZ 规则，如 "CET-1CEST,M3.5.0,M10.5.0/3"
+    struct PosixRule {
+        struct Date {
+            char kind{'M'}; // 'J'：1..365 不计闰日；'D'：0..365；'M'：月.周.星期
+            int month{0}, week{0}, day{0};
+            int time{2 * 3600}; // 当地时间秒数，可为负或超过 24h
+        };
+        std::int32_t std_offset{0};
+        std::int32_t dst_offset{0};
+        bool has_dst{false};
+        Date start, end;
+
+        static std::optional<PosixRule> parse(std::string_view s);
+        std::int32_t offset_at(std::int64_t utc) const;
+    };
+
+    static std::shared_ptr<TimeZone> parse_tzif(std::string name, const std::string &data);
+
+    std::string name_;
+    std::vector<std::int64_t> transitions_; // 升序，UTC 秒
+    std::vector<std::int32_t> offsets_;     // offsets_[i] 自 transitions_[i] 起生效
+    std::int32_t initial_offset_{0};        // 首个转换之前
+    std::optional<PosixRule> rule_;         // 最后一个转换之后
+};
@@ -0,0 +1,27 @@
+#include "timer_queue.h"
+
+void TimerQueue::schedule(Clock::time_point deadline, int job_id, Kind kind) {
+    heap_.push(Entry{deadline, job_id, kind});
+}
+
+void TimerQueue::pop_expired(Clock::time_point now, std::vector<Entry> &out) {
+    while (!heap_.empty() && heap_.top().deadline <= now) {
+        out.push_back(heap_.top());
+        heap_.pop();
+    }
+}
+
+std::optional<TimerQueue::Clock::time_point> TimerQueue::next_deadline() const {
+    if (heap_.empty()) return std::nullopt;
+    return heap_.top().deadline;
+}
+
+void TimerQueue::prune(const std::function<bool(const Entry &)> &keep) {
+    std::vector<Entry> live;
+    live.reserve(heap_.size());
+    while (!heap_.empty()) {
+        if (keep(heap_.top())) live.push_back(heap_.top());
+        heap_.pop();
+    }
+    heap_ = decltype(heap_)(Later{}, std::move(live));
+}
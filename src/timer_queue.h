@@ -0,0 +1,43 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <optional>
+#include <queue>
+#include <vector>
+
+// 任务超时/强杀定时器：按截止时间排序的最小堆，调度与弹出均为 O(log n)。
+// 取消是惰性的：任务结束后残留的条目在到期时由调用方校验丢弃，或通过 prune 批量清理。
+// 非线程安全，由 Scheduler::running_mu_ 保护（与 running_ 一起）。
+class TimerQueue {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    enum class Kind {
+        Terminate, // 超时，发送 SIGTERM
+        Kill       // 宽限期结束，发送 SIGKILL
+    };
+
+    struct Entry {
+        Clock::time_point deadline;
+        int job_id{0};
+        Kind kind{Kind::Terminate};
+    };
+
+    void schedule(Clock::time_point deadline, int job_id, Kind kind);
+    // 弹出所有 deadline <= now 的条目，按到期先后追加到 out
+    void pop_expired(Clock::time_point now, std::vector<Entry> &out);
+    std::optional<Clock::time_point> next_deadline() const;
+    // 移除 keep 返回 false 的条目
+    void prune(const std::function<bool(const Entry &)> &keep);
+
+    bool empty() const { return heap_.empty(); }
+    std::size_t size() const { return heap_.size(); }
+
+private:
+    struct Later {
+        bool operator()(const Entry &a, const Entry &b) const { return a.deadline > b.deadline; }
+    };
+    std::priority_queue<Entry, std::vector<Entry>, Later> heap_;
+};
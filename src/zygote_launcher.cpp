@@ -0,0 +1,236 @@
+#include "zygote_launcher.h"
+
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "NanoLogCpp17.h"
+
+using namespace NanoLog::LogLevels;
+
+// 报文格式（主机字节序，紧凑排列）：
+//   请求: u32 count, count × { i32 job_id, u32 cmd_len, u32 cg_len, u32 aff_len, cmd '\0', cg '\0', cpu_set_t[aff_len > 0] }
+//   回复: u32 count, count × { i32 job_id, i32 pid, i32 error }
+namespace {
+constexpr std::size_t kReqEntryHeader = 4 * sizeof(std::uint32_t);
+
+template <class T>
+T read_field(const char *&p) {
+    T v;
+    std::memcpy(&v, p, sizeof(T));
+    p += sizeof(T);
+    return v;
+}
+
+template <class T>
+void write_field(char *&p, T v) {
+    std::memcpy(p, &v, sizeof(T));
+    p += sizeof(T);
+}
+
+std::size_t entry_size(const ZygoteLauncher::Request &req) {
+    std::size_t cg = req.cgroup_path ? req.cgroup_path->size() : 0;
+    return kReqEntryHeader + req.cmd->size() + 1 + cg + 1 + (req.affinity ? sizeof(cpu_set_t) : 0);
+}
+
+// zygote 进程主循环：fork 自多线程进程，只能使用系统调用与 fork 前分配好的内存
+[[noreturn]] void zygote_main(int sock, const ZygoteLauncher::Config &cfg, pid_t parent, char *buf) {
+    ::prctl(PR_SET_PDEATHSIG, SIGKILL);
+    if (::getppid() != parent) ::_exit(0);
+    char *reply = buf + ZygoteLauncher::kMaxMessage;
+
+    for (;;) {
+        ssize_t n = ::recv(sock, buf, ZygoteLauncher::kMaxMessage, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < static_cast<ssize_t>(sizeof(std::uint32_t))) ::_exit(0);
+
+        const char *in = buf;
+        const char *in_end = buf + n;
+        auto count = read_field<std::uint32_t>(in);
+        char *out = reply;
+        write_field<std::uint32_t>(out, 0);
+        std::uint32_t handled = 0;
+        for (; handled < count && in + kReqEntryHeader <= in_end; ++handled) {
+            auto job_id = read_field<std::int32_t>(in);
+            auto cmd_len = read_field<std::uint32_t>(in);
+            auto cg_len = read_field<std::uint32_t>(in);
+            auto aff_len = read_field<std::uint32_t>(in);
+            if (in + cmd_len + 1 + cg_len + 1 + aff_len > in_end || (aff_len != 0 && aff_len != sizeof(cpu_set_t))) break;
+            const char *cmd = in;
+            in += cmd_len + 1;
+            const char *cg = in;
+            in += cg_len + 1;
+            cpu_set_t affinity;
+            if (aff_len) std::memcpy(&affinity, in, sizeof(affinity));
+            in += aff_len;
+
+            LaunchParams p;
+            p.cmd = cmd;
+            p.workdir = cfg.workdir.empty() ? nullptr : cfg.workdir.c_str();
+            p.rlimit_nofile = cfg.rlimit_nofile;
+            p.disable_core_dump = cfg.disable_core_dump;
+            p.clone_parent = true;
+            if (aff_len) p.affinity = &affinity;
+            int dir_fd = -1;
+            if (cg_len > 0) {
+                dir_fd = ::open(cg, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+                if (dir_fd >= 0) {
+                    p.cgroup_procs_fd = ::openat(dir_fd, "cgroup.procs", O_WRONLY | O_CLOEXEC);
+                    if (cfg.backend == LaunchBackend::Clone3) p.cgroup_fd = dir_fd;
+                }
+            }
+            LaunchResult res = launch_process(cfg.backend, p);
+            if (p.cgroup_procs_fd >= 0) ::close(p.cgroup_procs_fd);
+            if (dir_fd >= 0) ::close(dir_fd);
+
+            write_field<std::int32_t>(out, job_id);
+            write_field<std::int32_t>(out, res.pid);
+            write_field<std::int32_t>(out, res.error);
+        }
+        std::memcpy(reply, &handled, sizeof(handled));
+        if (::send(sock, reply, static_cast<std::size_t>(out - reply), MSG_NOSIGNAL) < 0) ::_exit(0);
+    }
+}
+}
+
+ZygoteLauncher::~ZygoteLauncher() { stop(); }
+
+bool ZygoteLauncher::start(Config cfg) {
+    std::lock_guard lk(mu_);
+    if (pid_ > 0) return true;
+    cfg_ = std::move(cfg);
+
+    int sv[2];
+    if (::socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sv) < 0) {
+        auto msg = std::string("zygote socketpair failed: ") + std::strerror(errno);
+        NANO_LOG(ERROR, "%s", msg.c_str());
+        return false;
+    }
+    // zygote 中不能分配内存，收发缓冲区须在 fork 前准备好
+    std::vector<char> zygote_buf(2 * kMaxMessage);
+    pid_t parent = ::getpid();
+    pid_t pid = ::fork();
+    if (pid == 0) {
+        ::close(sv[0]);
+        zygote_main(sv[1], cfg_, parent, zygote_buf.data());
+    }
+    ::close(sv[1]);
+    if (pid < 0) {
+        auto msg = std::string("zygote fork failed: ") + std::strerror(errno);
+        NANO_LOG(ERROR, "%s", msg.c_str());
+        ::close(sv[0]);
+        return false;
+    }
+    pid_ = pid;
+    sock_ = sv[0];
+    recv_buf_.resize(kMaxMessage);
+    send_buf_.reserve(kMaxMessage);
+    NANO_LOG(NOTICE, "zygote launcher started pid=%d backend=%s", pid_, to_string(cfg_.backend));
+    return true;
+}
+
+void ZygoteLauncher::stop() {
+    std::lock_guard lk(mu_);
+    shutdown_locked();
+}
+
+bool ZygoteLauncher::running() const {
+    std::lock_guard lk(mu_);
+    return sock_ >= 0;
+}
+
+bool ZygoteLauncher::fits(const Request &req) {
+    return req.cmd && sizeof(std::uint32_t) + entry_size(req) <= kMaxMessage;
+}
+
+void ZygoteLauncher::shutdown_locked() {
+    if (sock_ >= 0) {
+        // 关闭 socket 后 zygote 的 recv 返回 0 并退出
+        ::close(sock_);
+        sock_ = -1;
+    }
+    if (pid_ > 0) {
+        int status = 0;
+        ::waitpid(pid_, &status, 0);
+        pid_ = -1;
+    }
+}
+
+std::size_t ZygoteLauncher::launch_batch(const std::vector<Request> &reqs, std::vector<LaunchResult> &results) {
+    std::lock_guard lk(mu_);
+    results.assign(reqs.size(), LaunchResult{});
+    std::size_t begin = 0;
+    while (begin < reqs.size() && sock_ >= 0) {
+        std::size_t bytes = sizeof(std::uint32_t);
+        std::size_t end = begin;
+        while (end < reqs.size() && fits(reqs[end]) && bytes + entry_size(reqs[end]) <= kMaxMessage) {
+            bytes += entry_size(reqs[end]);
+            ++end;
+        }
+        if (end == begin) break; // 下一条无法经 zygote 发送
+        bool sent = false;
+        if (!roundtrip(reqs, begin, end, results, sent)) {
+            // 已发出但未收到回复的这批结果未知：按失败处理，避免重复启动
+            return sent ? end : begin;
+        }
+        begin = end;
+    }
+    return begin;
+}
+
+bool ZygoteLauncher::roundtrip(const std::vector<Request> &reqs, std::size_t begin, std::size_t end, std::vector<LaunchResult> &results, bool &sent) {
+    std::size_t total = sizeof(std::uint32_t);
+    for (std::size_t i = begin; i < end; ++i) total += entry_size(reqs[i]);
+    send_buf_.assign(total, '\0');
+    char *out = send_buf_.data();
+    write_field<std::uint32_t>(out, static_cast<std::uint32_t>(end - begin));
+    for (std::size_t i = begin; i < end; ++i) {
+        const auto &req = reqs[i];
+        std::size_t cg_len = req.cgroup_path ? req.cgroup_path->size() : 0;
+        write_field<std::int32_t>(out, req.job_id);
+        write_field<std::uint32_t>(out, static_cast<std::uint32_t>(req.cmd->size()));
+        write_field<std::uint32_t>(out, static_cast<std::uint32_t>(cg_len));
+        write_field<std::uint32_t>(out, req.affinity ? static_cast<std::uint32_t>(sizeof(cpu_set_t)) : 0u);
+        std::memcpy(out, req.cmd->data(), req.cmd->size());
+        out += req.cmd->size() + 1;
+        if (cg_len) std::memcpy(out, req.cgroup_path->data(), cg_len);
+        out += cg_len + 1;
+        if (req.affinity) {
+            std::memcpy(out, req.affinity, sizeof(cpu_set_t));
+            out += sizeof(cpu_set_t);
+        }
+    }
+
+    if (::send(sock_, send_buf_.data(), send_buf_.size(), MSG_NOSIGNAL) < 0) {
+        auto msg = std::string("zygote send failed: ") + std::strerror(errno);
+        NANO_LOG(ERROR, "%s", msg.c_str());
+        shutdown_locked();
+        return false;
+    }
+    sent = true;
+    for (std::size_t i = begin; i < end; ++i) results[i].error = ECONNRESET;
+    ssize_t n;
+    do {
+        n = ::recv(sock_, recv_buf_.data(), recv_buf_.size(), 0);
+    } while (n < 0 && errno == EINTR);
+    if (n < static_cast<ssize_t>(sizeof(std::uint32_t))) {
+        NANO_LOG(ERROR, "%s", "zygote closed connection; falling back to direct launch");
+        shutdown_locked();
+        return false;
+    }
+    const char *in = recv_buf_.data();
+    auto count = read_field<std::uint32_t>(in);
+    for (std::uint32_t k = 0; k < count && begin + k < end; ++k) {
+        auto &res = results[begin + k];
+        read_field<std::int32_t>(in); // job_id，与请求顺序一致
+        res.pid = read_field<std::int32_t>(in);
+        res.error = read_field<std::int32_t>(in);
+    }
+    return true;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "process_launcher.h"
+
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <sys/types.h>
+#include <vector>
+
+// 预先 fork 的精简启动进程。调度器经 UNIX socketpair 批量下发启动请求，zygote 完成
+// setpgid/rlimit/chdir/cgroup 加入与 exec，并批量回传 pid。任务进程以 CLONE_PARENT
+// 创建，父进程仍是调度器，可照常 waitpid/pidfd；启动开销与调度器自身规模无关。
+class ZygoteLauncher {
+public:
+    struct Config {
+        LaunchBackend backend{LaunchBackend::Vfork};
+        std::string workdir;
+        int rlimit_nofile{-1};
+        bool disable_core_dump{true};
+    };
+
+    struct Request {
+        int job_id{0};
+        const std::string *cmd{nullptr};
+        const std::string *cgroup_path{nullptr}; // 为空或 nullptr 表示不加入 cgroup
+        const cpu_set_t *affinity{nullptr};      // nullptr 表示不绑核
+    };
+
+    // 单条消息上限；超过的请求由调用方自行直接启动
+    static constexpr std::size_t kMaxMessage = 128 * 1024;
+
+    ZygoteLauncher() = default;
+    ~ZygoteLauncher();
+    ZygoteLauncher(const ZygoteLauncher &) = delete;
+    ZygoteLauncher &operator=(const ZygoteLauncher &) = delete;
+
+    bool start(Config cfg);
+    void stop();
+    bool running() const;
+    static bool fits(const Request &req);
+
+    // 按消息上限分段往返启动一批任务，results[i] 对应 reqs[i]。返回已处理的前缀长度，
+    // 其余请求（过大或 zygote 已失效）由调用方直接启动。已发出但未收到回复的请求
+    // 记为失败而不是重试，避免重复启动；通信失败后 running() 为 false。
+    std::size_t launch_batch(const std::vector<Request> &reqs, std::vector<LaunchResult> &results);
+
+private:
+    bool roundtrip(const std::vector<Request> &reqs, std::size_t begin, std::size_t end, std::vector<LaunchResult> &results, bool &sent);
+    void shutdown_locked();
+
+    Config cfg_;
+    pid_t pid_{-1};
+    int sock_{-1};
+    std::string send_buf_;
+    std::vector<char> recv_buf_;
+    mutable std::mutex mu_;
+};
@@ -1,13 +1,42 @@
 #include <catch2/benchmark/catch_benchmark.hpp>
 #include <catch2/catch_test_macros.hpp>
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <fstream>
 #include <iostream>
 #include <mutex>
+#include <queue>
+#include <random>
 #include <thread>
 #include <vector>
 
 #include "NanoLogCpp17.h"
+#include "cgroup_helper.h"
+#include "cgroup_pool.h"
+#include "cron_scheduler.h"
+#include "dependency_graph.h"
+#include "fair_share_queue.h"
+#include "job_store.h"
+#include "journal_store.h"
+#include "latency_histogram.h"
+#include "metrics.h"
+#include "metrics_http_server.h"
+#include "placement_scorer.h"
+#include "process_launcher.h"
 #include "scheduler.h"
+#include "zygote_launcher.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/vfs.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
 namespace {
 void init_nano_log() {
@@ -64,3 +93,735 @@ TEST_CASE("enqueue throughput benchmark") {
     }
     sched.stop();
 }
+
+TEST_CASE("process launch backend benchmark") {
+    auto launch_and_reap = [](LaunchBackend backend) {
+        LaunchParams params;
+        params.cmd = "true";
+        LaunchResult res = launch_process(backend, params);
+        if (res.pidfd >= 0) ::close(res.pidfd);
+        int status = 0;
+        if (res.pid > 0) ::waitpid(res.pid, &status, 0);
+        return res.pid;
+    };
+
+    BENCHMARK("launch fork") { return launch_and_reap(LaunchBackend::Fork); };
+    BENCHMARK("launch vfork") { return launch_and_reap(LaunchBackend::Vfork); };
+    BENCHMARK("launch clone3") { return launch_and_reap(LaunchBackend::Clone3); };
+
+    // zygote 在 ballast 分配前启动，其启动开销不随调度器 RSS 变化
+    ZygoteLauncher zygote;
+    REQUIRE(zygote.start(ZygoteLauncher::Config{}));
+    const std::string zcmd = "true";
+    auto launch_via_zygote = [&](std::size_t n) {
+        std::vector<ZygoteLauncher::Request> reqs(n, ZygoteLauncher::Request{0, &zcmd, nullptr});
+        std::vector<LaunchResult> results;
+        zygote.launch_batch(reqs, results);
+        for (const auto &res : results) {
+            int status = 0;
+            if (res.pid > 0) ::waitpid(res.pid, &status, 0);
+        }
+        return results.size();
+    };
+    BENCHMARK("launch via zygote") { return launch_via_zygote(1); };
+
+    // 模拟调度器 RSS 增长：fork 需要复制这些页表，vfork/clone(CLONE_VM) 不受影响
+    std::vector<char> ballast(512ull * 1024 * 1024);
+    std::memset(ballast.data(), 1, ballast.size());
+
+    BENCHMARK("launch fork with 512MB resident") { return launch_and_reap(LaunchBackend::Fork); };
+    BENCHMARK("launch vfork with 512MB resident") { return launch_and_reap(LaunchBackend::Vfork); };
+    BENCHMARK("launch clone3 with 512MB resident") { return launch_and_reap(LaunchBackend::Clone3); };
+    BENCHMARK("launch via zygote with 512MB resident") { return launch_via_zygote(1); };
+    BENCHMARK("launch 16 via zygote batch with 512MB resident") { return launch_via_zygote(16); };
+    zygote.stop();
+}
+
+TEST_CASE("submit latency under sustained dispatch load") {
+    ensure_nano_log_init();
+
+    SchedulerOptions opts;
+    opts.quota.total_cpu = 64;
+    opts.quota.total_mem_mb = 64 * 1024;
+    opts.max_queue_size = 100000;
+
+    Scheduler sched(opts);
+    sched.start();
+
+    JobSpec spec;
+    spec.cmd = "true";
+    spec.cpu_cores = 1;
+    spec.memory_mb = 32;
+
+    constexpr int kJobs = 5000;
+    std::vector<double> lat_us;
+    lat_us.reserve(kJobs);
+    for (int i = 0; i < kJobs; ++i) {
+        auto t0 = std::chrono::steady_clock::now();
+        sched.submit(spec);
+        auto t1 = std::chrono::steady_clock::now();
+        lat_us.push_back(std::chrono::duration<double, std::micro>(t1 - t0).count());
+    }
+    std::sort(lat_us.begin(), lat_us.end());
+    auto pct = [&](double p) { return lat_us[static_cast<std::size_t>(p * (lat_us.size() - 1))]; };
+    std::cout << "submit latency under dispatch load (us): p50=" << pct(0.50) << " p99=" << pct(0.99)
+              << " p999=" << pct(0.999) << " max=" << lat_us.back() << "\n";
+
+    for (int i = 0; i < 600 && !sched.idle(); ++i) {
+        std::this_thread::sleep_for(50ms);
+    }
+    sched.stop();
+}
+
+TEST_CASE("job store write throughput and recovery with 1M records") {
+    ensure_nano_log_init();
+    constexpr int kRecords = 1000000;
+
+    auto run = [](const char *name, std::unique_ptr<JobStore> store, const std::string &path, JobStore::Options sopts = {}) {
+        for (const char *suffix : {"", "-wal", "-shm", ".snap"}) std::remove((path + suffix).c_str());
+        JobSpec spec;
+        spec.cmd = "echo persisted job";
+        {
+            REQUIRE(store->init(path, sopts));
+            auto t0 = std::chrono::steady_clock::now();
+            // 一半任务完成：插入 + 状态更新，共 kRecords 条写入
+            for (int id = 1; id <= kRecords / 2; ++id) {
+                store->insert_job(id, spec, PersistStatus::Queued, id);
+                if (id % 2 == 0) store->update_status(id, PersistStatus::Succeeded, 0, id, id + 1);
+                else store->update_status(id, PersistStatus::Running, 0, id, 0);
+            }
+            store->flush();
+            auto t1 = std::chrono::steady_clock::now();
+            double sec = std::chrono::duration<double>(t1 - t0).count();
+            std::cout << name << " write: " << kRecords << " records in " << sec << "s (" << kRecords / sec << " rec/s)\n";
+            store->close();
+        }
+        auto t0 = std::chrono::steady_clock::now();
+        REQUIRE(store->init(path, sopts));
+        auto jobs = store->load_unfinished();
+        auto t1 = std::chrono::steady_clock::now();
+        std::cout << name << " recovery: " << jobs.size() << " unfinished in "
+                  << std::chrono::duration<double, std::milli>(t1 - t0).count() << "ms\n";
+        CHECK(jobs.size() == kRecords / 4);
+        store->close();
+    };
+
+    run("journal", std::make_unique<JournalJobStore>(), "/tmp/taskscheduler_bench.journal");
+    // 周期性压缩后恢复只需回放快照与最后一段日志
+    JobStore::Options compacting;
+    compacting.snapshot_records = 100000;
+    run("journal+snapshot", std::make_unique<JournalJobStore>(), "/tmp/taskscheduler_bench.journal", compacting);
+#ifdef TASKSCHEDULER_ENABLE_SQLITE
+    run("sqlite", std::make_unique<SqliteJobStore>(), "/tmp/taskscheduler_bench.db");
+#endif
+}
+
+TEST_CASE("batch submission versus per-job submit") {
+    ensure_nano_log_init();
+    constexpr int kJobs = 10000;
+
+    JobSpec spec;
+    spec.cmd = "true";
+    spec.memory_mb = 32;
+    std::vector<JobSpec> specs(kJobs, spec);
+
+    auto run = [&](const char *name, bool batch) {
+        SchedulerOptions opts;
+        opts.max_queue_size = kJobs;
+        opts.enable_persistence = true;
+        opts.persist_backend = PersistBackend::Journal;
+        opts.db_path = "/tmp/taskscheduler_bench_submit.journal";
+        std::remove(opts.db_path.c_str());
+        std::remove((opts.db_path + ".snap").c_str());
+        // 不启动调度器，只测量入队与持久化路径
+        Scheduler sched(opts);
+        auto t0 = std::chrono::steady_clock::now();
+        if (batch) {
+            sched.submit_batch(specs);
+        } else {
+            for (const auto &s : specs) sched.submit(s);
+        }
+        auto t1 = std::chrono::steady_clock::now();
+        double us = std::chrono::duration<double, std::micro>(t1 - t0).count();
+        std::cout << name << ": " << kJobs << " jobs in " << us / 1000.0 << "ms (" << us / kJobs << " us/job)\n";
+    };
+    run("submit x10000", false);
+    run("submit_batch(10000)", true);
+}
+
+TEST_CASE("concurrent submit scaling from 1 to 32 producers") {
+    ensure_nano_log_init();
+    constexpr int kTotal = 100000;
+
+    JobSpec hold;
+    hold.cmd = "sleep 1";
+    hold.cpu_cores = 1;
+    JobSpec spec;
+    spec.cmd = "true";
+    spec.cpu_cores = 1;
+    spec.memory_mb = 16;
+
+    for (int producers : {1, 2, 4, 8, 16, 32}) {
+        SchedulerOptions opts;
+        opts.quota.total_cpu = 1;
+        opts.max_queue_size = kTotal + 1;
+        opts.enable_backfill = false;
+        Scheduler sched(opts);
+        sched.start();
+        // 占满唯一的 CPU，后续任务只进入队列，测量的是纯提交路径（含派发线程并环）
+        sched.submit(hold);
+
+        const int per_thread = kTotal / producers;
+        std::atomic<bool> go{false};
+        std::vector<std::thread> threads;
+        for (int t = 0; t < producers; ++t) {
+            threads.emplace_back([&] {
+                while (!go.load(std::memory_order_acquire)) std::this_thread::yield();
+                for (int i = 0; i < per_thread; ++i) sched.submit(spec);
+            });
+        }
+        auto t0 = std::chrono::steady_clock::now();
+        go.store(true, std::memory_order_release);
+        for (auto &t : threads) t.join();
+        auto t1 = std::chrono::steady_clock::now();
+        double sec = std::chrono::duration<double>(t1 - t0).count();
+        std::cout << "concurrent submit producers=" << producers << ": " << per_thread * producers / sec / 1e6
+                  << " M submits/s\n";
+        sched.stop();
+    }
+}
+
+TEST_CASE("cron engine with 10000 templates") {
+    using namespace std::chrono;
+    BENCHMARK("parse 5-field expression") { return CronExpression::parse("CRON_TZ=UTC */5 9-17 * * MON-FRI"); };
+    auto ce = *CronExpression::parse("CRON_TZ=Europe/Berlin */5 9-17 * * MON-FRI");
+    auto from = system_clock::now();
+    BENCHMARK("next_run 5-field with time zone") {
+        from = ce.next_run(from);
+        return from;
+    };
+
+    CronScheduler cron;
+    auto now = system_clock::now();
+    for (int i = 0; i < 10000; ++i) {
+        CronTemplate tpl;
+        tpl.cron = *CronExpression::parse("CRON_TZ=UTC " + std::to_string(i % 60) + " " + std::to_string(i % 24) + " * * *");
+        tpl.spec.cmd = "true";
+        cron.add_template(tpl);
+    }
+    std::size_t fired = 0;
+    auto cb = [&](int, const JobSpec &) { return static_cast<int>(++fired); };
+    // 堆顶未到期时只看一眼堆顶
+    BENCHMARK("tick with 10000 templates, none due") { return cron.tick(now, cb); };
+    // 模拟一天：每次跳到下一个触发时间，全部 10000 个模板各触发一次
+    BENCHMARK_ADVANCED("fire 10000 templates over a simulated day")(Catch::Benchmark::Chronometer meter) {
+        meter.measure([&] {
+            CronScheduler day;
+            for (int i = 0; i < 10000; ++i) {
+                CronTemplate tpl;
+                tpl.cron = ce;
+                tpl.cron.minute_mask = std::uint64_t{1} << (i % 60);
+                tpl.cron.hour_mask = 1u << (i % 24);
+                tpl.cron.dow_mask = 0x7F;
+                tpl.spec.cmd = "true";
+                tpl.next_run = now + seconds{i * 8};
+                day.add_template(tpl);
+            }
+            std::size_t before = fired;
+            auto t = now;
+            while (fired - before < 10000) t = day.tick(t, cb);
+            return fired;
+        });
+    };
+}
+
+TEST_CASE("cron submission burst with and without splay") {
+    using namespace std::chrono;
+    const auto t0 = system_clock::time_point(sys_days{2024y / January / 1});
+    constexpr int kTemplates = 10000;
+    for (bool splay : {false, true}) {
+        CronScheduler cron;
+        for (int i = 0; i < kTemplates; ++i) {
+            CronTemplate tpl;
+            tpl.cron = *CronExpression::parse("@every 60s");
+            tpl.spec.cmd = "report " + std::to_string(i);
+            tpl.next_run = t0 + seconds{60};
+            tpl.splay = splay;
+            cron.add_template(tpl);
+        }
+        // 以 1 秒为粒度走完两个周期，统计每秒提交数
+        std::vector<int> per_second;
+        int fired = 0;
+        auto cb = [&](int, const JobSpec &) { return ++fired; };
+        auto start = steady_clock::now();
+        for (auto t = t0 + seconds{60}; t < t0 + seconds{180}; t += seconds{1}) {
+            int before = fired;
+            cron.tick(t, cb);
+            per_second.push_back(fired - before);
+        }
+        double us = duration<double, std::micro>(steady_clock::now() - start).count();
+        int peak = *std::max_element(per_second.begin(), per_second.end());
+        int busy = static_cast<int>(std::count_if(per_second.begin(), per_second.end(), [](int n) { return n > 0; }));
+        std::cout << "cron " << kTemplates << " templates @every 60s " << (splay ? "splay" : "aligned") << ": " << fired
+                  << " fires, peak " << peak << "/s over " << busy << " busy seconds (" << us / fired << " us/fire)\n";
+    }
+}
+
+TEST_CASE("placement policies on a mixed cpu-heavy and memory-heavy workload") {
+    // 离散事件模拟派发逻辑：队首放得下先派发，否则在其后 256 个任务中按策略回填
+    constexpr int kJobs = 4000;
+    constexpr int kWindow = 256;
+    ResourceVector capacity;
+    capacity.v.fill(ResourceVector::kUnlimited);
+    capacity[ResourceVector::Cpu] = 64;
+    capacity[ResourceVector::MemoryMb] = 256 * 1024;
+    struct SimJob {
+        ResourceVector demand;
+        int duration;
+    };
+    std::vector<SimJob> jobs(kJobs);
+    std::mt19937 rng(42);
+    for (auto &j : jobs) {
+        // 一半是多核少内存的计算任务，一半是单核大内存的任务
+        bool cpu_heavy = rng() % 2 == 0;
+        j.demand[ResourceVector::Cpu] = cpu_heavy ? 12 + rng() % 21 : 1 + rng() % 4;
+        j.demand[ResourceVector::MemoryMb] = cpu_heavy ? 4096 + rng() % 8192 : 49152 + rng() % 65536;
+        j.duration = 10 + static_cast<int>(rng() % 90);
+    }
+
+    for (auto policy : {PlacementPolicy::FirstFit, PlacementPolicy::BestFit, PlacementPolicy::WorstFit, PlacementPolicy::DominantResource}) {
+        auto scorer = make_placement_scorer(policy);
+        std::vector<int> pending(kJobs);
+        for (int i = 0; i < kJobs; ++i) pending[i] = i;
+        using Finish = std::pair<long, int>;
+        std::priority_queue<Finish, std::vector<Finish>, std::greater<>> running;
+        ResourceUsage usage{ResourceVector{}, capacity};
+        long now = 0;
+        double cpu_area = 0, mem_area = 0, wait_sum = 0;
+        long picks = 0;
+        auto t0 = std::chrono::steady_clock::now();
+        while (!pending.empty() || !running.empty()) {
+            while (!pending.empty()) {
+                auto chosen = pending.begin();
+                if (!usage.fits(jobs[*chosen].demand)) {
+                    auto last = pending.begin() + std::min<std::ptrdiff_t>(kWindow + 1, static_cast<std::ptrdiff_t>(pending.size()));
+                    chosen = pick_placement(std::next(pending.begin()), last, usage, scorer.get(), [&](int id) -> const ResourceVector & { return jobs[id].demand; });
+                    ++picks;
+                    if (chosen == last) break;
+                }
+                int id = *chosen;
+                pending.erase(chosen);
+                usage.used += jobs[id].demand;
+                wait_sum += static_cast<double>(now);
+                running.emplace(now + jobs[id].duration, id);
+            }
+            auto [end, id] = running.top();
+            cpu_area += static_cast<double>(usage.used[ResourceVector::Cpu]) * static_cast<double>(end - now);
+            mem_area += static_cast<double>(usage.used[ResourceVector::MemoryMb]) * static_cast<double>(end - now);
+            now = end;
+            while (!running.empty() && running.top().first == now) {
+                usage.used -= jobs[running.top().second].demand;
+                running.pop();
+            }
+        }
+        double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count();
+        double cpu_util = cpu_area / (static_cast<double>(now) * static_cast<double>(capacity[ResourceVector::Cpu]));
+        double mem_util = mem_area / (static_cast<double>(now) * static_cast<double>(capacity[ResourceVector::MemoryMb]));
+        std::cout << "placement " << to_string(policy) << ": makespan " << now << ", cpu util " << cpu_util * 100 << "%, mem util "
+                  << mem_util * 100 << "%, mean wait " << wait_sum / kJobs << ", " << us / std::max(picks, 1L) << " us per backfill pick\n";
+        CHECK(now > 0);
+    }
+}
+
+TEST_CASE("fair-share queue selection cost vs number of queues") {
+    // 稳态：每轮取份额最小的队列派发一个任务、结束一个更早的任务、再补一个任务，队列总是非空
+    constexpr int kOps = 200000;
+    ResourceVector capacity;
+    capacity.v.fill(ResourceVector::kUnlimited);
+    capacity[ResourceVector::Cpu] = 1024;
+    capacity[ResourceVector::MemoryMb] = 1 << 20;
+    for (int queues : {1, 16, 256, 4096, 65536}) {
+        FairShareQueue fq;
+        fq.set_capacity(capacity);
+        std::vector<std::string> names(queues);
+        for (int q = 0; q < queues; ++q) {
+            names[q] = "q" + std::to_string(q);
+            fq.set_weight(names[q], 1 + q % 4);
+        }
+        int next_id = 1;
+        auto make = [&](int q) {
+            Job job;
+            job.id = next_id++;
+            job.spec.queue = names[q];
+            job.demand[ResourceVector::Cpu] = 1 + job.id % 4;
+            job.demand[ResourceVector::MemoryMb] = 256 * (1 + job.id % 8);
+            return job;
+        };
+        for (int q = 0; q < queues; ++q) {
+            for (int i = 0; i < 2; ++i) fq.push(make(q));
+        }
+        std::deque<Job> running;
+        auto t0 = std::chrono::steady_clock::now();
+        for (int i = 0; i < kOps; ++i) {
+            int q = fq.front();
+            running.push_back(fq.take(q, fq.queue(q).begin()));
+            fq.push(make(q));
+            if (running.size() > 64) {
+                fq.release(running.front().queue, running.front().demand);
+                running.pop_front();
+            }
+        }
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();
+        // 对照：每次线性扫描全部队列的份额取最小（O(Q) 的选择方式）
+        std::vector<double> shares(queues);
+        for (int q = 0; q < queues; ++q) shares[q] = fq.stats(q).share;
+        const int scan_ops = std::max(1, kOps / std::max(1, queues / 64));
+        std::size_t sink = 0;
+        auto t1 = std::chrono::steady_clock::now();
+        for (int i = 0; i < scan_ops; ++i) {
+            auto q = static_cast<std::size_t>(std::min_element(shares.begin(), shares.end()) - shares.begin());
+            shares[q] += 1.0 / 1024;
+            sink += q;
+        }
+        double scan_ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t1).count();
+        std::cout << "fair-share queues=" << queues << ": " << ns / kOps << " ns per select+take+push+release, linear scan select "
+                  << scan_ns / scan_ops << " ns\n";
+        CHECK(fq.size() == static_cast<std::size_t>(queues) * 2);
+        CHECK(sink < static_cast<std::size_t>(queues) * static_cast<std::size_t>(scan_ops));
+    }
+}
+
+TEST_CASE("dependency resolution cost vs number of waiting jobs") {
+    // 稳态：已有 waiting 个任务在等永远不结束的父任务；每轮登记一个等待新父任务的子任务，再结束该父任务
+    constexpr int kOps = 200000;
+    for (int waiting : {0, 1000, 100000, 1000000}) {
+        DependencyGraph g;
+        int next_id = 1;
+        const int blocker = next_id++;
+        for (int i = 0; i < waiting; ++i) {
+            Job job;
+            job.id = next_id++;
+            g.hold(std::move(job), std::vector<JobDependency>{{blocker, DependencyCondition::Success}});
+        }
+        std::vector<Job> ready, cancelled;
+        std::size_t released = 0;
+        auto t0 = std::chrono::steady_clock::now();
+        for (int i = 0; i < kOps; ++i) {
+            int parent = next_id++;
+            Job child;
+            child.id = next_id++;
+            JobDependency dep{parent, DependencyCondition::Success};
+            g.hold(std::move(child), std::span(&dep, 1));
+            g.finish(parent, JobStatus::Succeeded, ready, cancelled);
+            released += ready.size();
+            ready.clear();
+        }
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();
+        // 对照：结束时扫描全部等待中的任务找出依赖它的（没有反向边时的做法）
+        std::vector<int> parents(static_cast<std::size_t>(waiting) + 1, blocker);
+        const int scan_ops = std::max(1, kOps / std::max(1, waiting / 1000));
+        std::size_t hits = 0;
+        auto t1 = std::chrono::steady_clock::now();
+        for (int i = 0; i < scan_ops; ++i) {
+            parents.back() = i + 2;
+            hits += static_cast<std::size_t>(std::count(parents.begin(), parents.end(), i + 2));
+        }
+        double scan_ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t1).count();
+        std::cout << "dependency graph waiting=" << waiting << ": " << ns / kOps << " ns per hold+finish, full scan " << scan_ns / scan_ops << " ns\n";
+        CHECK(released == static_cast<std::size_t>(kOps));
+        CHECK(hits == static_cast<std::size_t>(scan_ops));
+        CHECK(g.held() == static_cast<std::size_t>(waiting));
+    }
+
+    // 扇出：一个父任务结束释放全部子任务，开销与出度成正比
+    for (int fanout : {1000, 100000}) {
+        DependencyGraph g;
+        for (int i = 0; i < fanout; ++i) {
+            Job job;
+            job.id = i + 2;
+            g.hold(std::move(job), std::vector<JobDependency>{{1, DependencyCondition::AnyFinish}});
+        }
+        std::vector<Job> ready, cancelled;
+        auto t0 = std::chrono::steady_clock::now();
+        g.finish(1, JobStatus::Failed, ready, cancelled);
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();
+        std::cout << "dependency graph fan-out=" << fanout << ": " << ns / fanout << " ns per released child\n";
+        CHECK(ready.size() == static_cast<std::size_t>(fanout));
+    }
+}
+
+TEST_CASE("array job submit cost vs individual submissions") {
+    ensure_nano_log_init();
+    // 调度器不启动：只比较提交时的入队、持久化与内存开销，不派发
+    auto rss_kb = [] {
+        std::ifstream in("/proc/self/statm");
+        long pages = 0, resident = 0;
+        in >> pages >> resident;
+        return resident * (sysconf(_SC_PAGESIZE) / 1024);
+    };
+    constexpr int kTasks = 100000;
+    JobSpec spec;
+    spec.cmd = "echo sweep $TASK_INDEX --input /data/shard-$TASK_INDEX.parquet";
+    spec.memory_mb = 16;
+    for (bool as_array : {false, true}) {
+        const std::string path = "/tmp/taskscheduler_bench_array.journal";
+        std::remove(path.c_str());
+        std::remove((path + ".snap").c_str());
+        SchedulerOptions opts;
+        opts.quota.total_cpu = 4;
+        opts.quota.total_mem_mb = 4096;
+        opts.max_queue_size = 2 * kTasks;
+        opts.enable_persistence = true;
+        opts.persist_backend = PersistBackend::Journal;
+        opts.db_path = path;
+        Scheduler sched(opts);
+        std::vector<JobSpec> specs;
+        if (as_array) {
+            specs.push_back(spec);
+            specs.back().array = ArrayRange{0, kTasks - 1, 1};
+        } else {
+            specs.assign(kTasks, spec);
+        }
+        long rss0 = rss_kb();
+        auto t0 = std::chrono::steady_clock::now();
+        auto results = sched.submit_batch(specs);
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+        long rss1 = rss_kb();
+        sched.stop();
+        struct stat st{};
+        ::stat(path.c_str(), &st);
+        std::cout << (as_array ? "array of " : "individual x") << kTasks << ": submit " << ms << " ms, journal " << st.st_size
+                  << " bytes, rss +" << (rss1 - rss0) << " KiB, pending entries " << sched.metrics_snapshot().pending << "\n";
+        CHECK(results[0].error == SubmitError::None);
+        std::remove(path.c_str());
+    }
+}
+
+TEST_CASE("cgroup launch latency with and without the pool") {
+    // 需要可写的 cgroup2：纯 v2 主机为 /sys/fs/cgroup，混合模式为 /sys/fs/cgroup/unified
+    std::string base;
+    for (const char *root : {"/sys/fs/cgroup", "/sys/fs/cgroup/unified"}) {
+        struct statfs fs{};
+        if (::statfs(root, &fs) == 0 && static_cast<long>(fs.f_type) == 0x63677270) {
+            base = std::string(root) + "/taskscheduler_bench";
+            break;
+        }
+    }
+    if (base.empty() || (::mkdir(base.c_str(), 0755) != 0 && errno != EEXIST)) {
+        std::cout << "cgroup pool bench skipped: no writable cgroup2 mount\n";
+        return;
+    }
+    CgroupConfig cfg;
+    cfg.enabled = true;
+    cfg.base_path = base;
+
+    BENCHMARK("cgroup create + remove per job") {
+        auto path = create_cgroup_for_job(1, 1, 64, cfg);
+        int fd = open_cgroup_procs(path);
+        if (fd >= 0) ::close(fd);
+        cleanup_cgroup(path);
+        return path.size();
+    };
+    {
+        CgroupPool pool;
+        pool.init(cfg, 4);
+        int cores = 1;
+        BENCHMARK("cgroup pool acquire + release") {
+            // 交替限额，确保每次都经缓存 fd 改写
+            cores = 3 - cores;
+            int slot = pool.acquire(cores, 64);
+            pool.release(slot);
+            return slot;
+        };
+    }
+
+    // 完整启动：准备 cgroup、vfork 并在 exec 前加入 cgroup、回收、归还/删除
+    constexpr int kJobs = 2000;
+    auto run = [&](bool pooled) {
+        CgroupPool pool;
+        if (pooled) pool.init(cfg, 4);
+        std::vector<double> launch_us;
+        launch_us.reserve(kJobs);
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < kJobs; ++i) {
+            auto t0 = std::chrono::steady_clock::now();
+            LaunchParams params;
+            params.cmd = "true";
+            std::string path;
+            int slot = -1;
+            if (pooled) {
+                slot = pool.acquire(1 + i % 2, 64);
+                params.cgroup_procs_fd = pool.procs_fd(slot);
+            } else {
+                path = create_cgroup_for_job(i, 1 + i % 2, 64, cfg);
+                params.cgroup_procs_fd = open_cgroup_procs(path);
+            }
+            LaunchResult res = launch_process(LaunchBackend::Vfork, params);
+            if (!pooled && params.cgroup_procs_fd >= 0) ::close(params.cgroup_procs_fd);
+            launch_us.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count());
+            if (res.pidfd >= 0) ::close(res.pidfd);
+            int status = 0;
+            if (res.pid > 0) ::waitpid(res.pid, &status, 0);
+            if (pooled) pool.release(slot);
+            else cleanup_cgroup(path);
+        }
+        double total = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::sort(launch_us.begin(), launch_us.end());
+        std::cout << "cgroup " << (pooled ? "pool" : "per-job") << ": launch p50=" << launch_us[kJobs / 2]
+                  << "us p99=" << launch_us[kJobs * 99 / 100] << "us, " << kJobs / total << " jobs/s end to end\n";
+    };
+    run(false);
+    run(true);
+    ::rmdir(base.c_str());
+}
+
+TEST_CASE("latency histogram record cost") {
+    LatencyHistogram h;
+    std::uint64_t v = 1;
+    BENCHMARK("histogram record") {
+        // 简单的 xorshift 让样本落在不同的桶
+        v ^= v << 13;
+        v ^= v >> 7;
+        v ^= v << 17;
+        h.record(v & 0xFFFFF);
+        return v;
+    };
+}
+
+TEST_CASE("metrics counter increments from N threads") {
+    constexpr long long kOpsPerThread = 2000000;
+
+    // 旧布局：相邻的 seq_cst 原子量，多个线程分别累加其中几个
+    struct LegacyCounters {
+        std::atomic<long long> v[14]{};
+    };
+
+    auto run = [](int threads, auto &&op) {
+        std::atomic<bool> go{false};
+        std::vector<std::thread> ts;
+        for (int t = 0; t < threads; ++t) {
+            ts.emplace_back([&, t] {
+                while (!go.load(std::memory_order_acquire)) std::this_thread::yield();
+                for (long long i = 0; i < kOpsPerThread; ++i) op(t);
+            });
+        }
+        auto t0 = std::chrono::steady_clock::now();
+        go.store(true, std::memory_order_release);
+        for (auto &th : ts) th.join();
+        auto t1 = std::chrono::steady_clock::now();
+        return std::chrono::duration<double, std::nano>(t1 - t0).count() / (kOpsPerThread * threads);
+    };
+
+    for (int threads : {1, 2, 4, 8, 16}) {
+        LegacyCounters legacy;
+        double before = run(threads, [&](int t) { legacy.v[t % 3].fetch_add(1); });
+        Metrics m;
+        double after = run(threads, [&](int t) {
+            switch (t % 3) {
+            case 0: m.inc_submitted(); break;
+            case 1: m.inc_running(); break;
+            default: m.inc_succeeded(); break;
+            }
+        });
+        auto snap = m.snapshot();
+        CHECK(snap.submitted + snap.running + snap.succeeded == kOpsPerThread * threads);
+        std::cout << "counter increments threads=" << threads << ": shared atomics " << before
+                  << " ns/op, sharded " << after << " ns/op\n";
+    }
+}
+
+TEST_CASE("prometheus exposition render cost") {
+    Metrics metrics;
+    for (int i = 0; i < 5000; ++i) {
+        metrics.record_queue_wait(std::chrono::microseconds(i * 977));
+        metrics.record_run(std::chrono::milliseconds(i));
+    }
+    BENCHMARK("to_prometheus fresh string") { return metrics.to_prometheus(); };
+    std::string buf;
+    BENCHMARK("render_prometheus into reused buffer") {
+        buf.clear();
+        metrics.render_prometheus(buf);
+        return buf.size();
+    };
+}
+
+TEST_CASE("metrics scrape throughput with many concurrent scrapers") {
+    ensure_nano_log_init();
+    Metrics metrics;
+    for (int i = 0; i < 1000; ++i) metrics.record_queue_wait(std::chrono::microseconds(i * 37));
+    MetricsHttpServer server;
+    REQUIRE(server.start(0, [&](std::string &out) { metrics.render_prometheus(out); }));
+    const int port = server.port();
+
+    auto connect_fd = [port] {
+        int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = htons(static_cast<uint16_t>(port));
+        if (::connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0) {
+            ::close(fd);
+            return -1;
+        }
+        return fd;
+    };
+    // 发送一次请求并按 Content-Length 读完响应
+    auto scrape = [](int fd, const std::string &req) {
+        if (::send(fd, req.data(), req.size(), MSG_NOSIGNAL) != (ssize_t)req.size()) return false;
+        std::string buf;
+        char tmp[16384];
+        while (true) {
+            auto end = buf.find("\r\n\r\n");
+            if (end != std::string::npos) {
+                auto cl = buf.find("Content-Length: ");
+                if (buf.size() >= end + 4 + std::stoul(buf.substr(cl + 16))) return true;
+            }
+            ssize_t r = ::recv(fd, tmp, sizeof(tmp), 0);
+            if (r <= 0) return false;
+            buf.append(tmp, static_cast<std::size_t>(r));
+        }
+    };
+
+    constexpr int kRequestsPerScraper = 200;
+    for (bool keep_alive : {false, true}) {
+        const std::string req = keep_alive ? "GET /metrics HTTP/1.1\r\nHost: bench\r\n\r\n"
+                                           : "GET /metrics HTTP/1.1\r\nHost: bench\r\nConnection: close\r\n\r\n";
+        for (int scrapers : {1, 16, 64}) {
+            LatencyHistogram lat;
+            std::atomic<int> failures{0};
+            std::atomic<bool> go{false};
+            std::vector<std::thread> threads;
+            for (int t = 0; t < scrapers; ++t) {
+                threads.emplace_back([&] {
+                    while (!go.load(std::memory_order_acquire)) std::this_thread::yield();
+                    int fd = keep_alive ? connect_fd() : -1;
+                    for (int i = 0; i < kRequestsPerScraper; ++i) {
+                        auto t0 = std::chrono::steady_clock::now();
+                        if (!keep_alive) fd = connect_fd();
+                        bool ok = fd >= 0 && scrape(fd, req);
+                        if (!keep_alive && fd >= 0) ::close(fd);
+                        if (!ok) {
+                            failures.fetch_add(1);
+                            if (keep_alive) {
+                                if (fd >= 0) ::close(fd);
+                                fd = connect_fd();
+                            }
+                            continue;
+                        }
+                        lat.record(std::chrono::steady_clock::now() - t0);
+                    }
+                    if (keep_alive && fd >= 0) ::close(fd);
+                });
+            }
+            auto t0 = std::chrono::steady_clock::now();
+            go.store(true, std::memory_order_release);
+            for (auto &th : threads) th.join();
+            double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+            std::cout << "metrics scrape " << (keep_alive ? "keep-alive" : "conn-per-request") << " scrapers=" << scrapers
+                      << ": " << lat.count() / sec << " req/s, p50 " << lat.value_at_quantile(0.5) << " us, p99 "
+                      << lat.value_at_quantile(0.99) << " us, failures " << failures.load() << "\n";
+            CHECK(failures.load() == 0);
+        }
+    }
+    server.stop();
+}
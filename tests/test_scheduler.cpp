@@ -1,12 +1,44 @@
 #include <catch2/catch_test_macros.hpp>
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <iterator>
+#include <map>
 #include <mutex>
 #include <thread>
 #include <vector>
 
 #include "NanoLogCpp17.h"
+#include "cgroup_pool.h"
+#include "cpu_topology.h"
+#include "cron_scheduler.h"
+#include "dependency_graph.h"
+#include "fair_share_queue.h"
+#include "intake_ring.h"
+#include "job_array.h"
+#include "job_store.h"
+#include "journal_store.h"
+#include "latency_histogram.h"
+#include "metrics.h"
+#include "metrics_http_server.h"
+#include "placement_scorer.h"
+#include "pressure_monitor.h"
+#include "resource_manager.h"
+#include "resource_vector.h"
 #include "scheduler.h"
+#include "sharded_counter.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
 namespace {
 void init_nano_log() {
@@ -32,6 +64,44 @@ void ensure_nano_log_init() {
     static std::once_flag once;
     std::call_once(once, [] { init_nano_log(); });
 }
+
+int connect_loopback(int port) {
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(static_cast<uint16_t>(port));
+    if (::connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0) {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+bool send_all(int fd, const std::string &s) { return ::send(fd, s.data(), s.size(), MSG_NOSIGNAL) == (ssize_t)s.size(); }
+
+// 按 Content-Length 读满 n 个完整响应
+std::string read_http_responses(int fd, int n) {
+    std::string buf;
+    char tmp[4096];
+    auto complete = [&] {
+        std::size_t pos = 0;
+        for (int i = 0; i < n; ++i) {
+            auto end = buf.find("\r\n\r\n", pos);
+            if (end == std::string::npos) return false;
+            auto cl = buf.find("Content-Length: ", pos);
+            pos = end + 4 + std::stoul(buf.substr(cl + 16));
+            if (buf.size() < pos) return false;
+        }
+        return true;
+    };
+    while (!complete()) {
+        ssize_t r = ::recv(fd, tmp, sizeof(tmp), 0);
+        if (r <= 0) break;
+        buf.append(tmp, static_cast<std::size_t>(r));
+    }
+    return buf;
+}
 } // namespace
 
 using namespace std::chrono_literals;
@@ -63,3 +133,1790 @@ TEST_CASE("submit and run basic job") {
     REQUIRE(sched.idle());
     sched.stop();
 }
+
+TEST_CASE("pending queue orders by priority then FIFO") {
+    PendingQueue prio(true);
+    auto make = [](int id, int priority) {
+        Job job;
+        job.id = id;
+        job.spec.priority = priority;
+        return job;
+    };
+    prio.push(make(1, 0));
+    prio.push(make(2, 5));
+    prio.push(make(3, 0));
+    prio.push(make(4, 5));
+
+    std::vector<int> order;
+    Job job;
+    while (prio.pop(job)) order.push_back(job.id);
+    REQUIRE(order == std::vector<int>{2, 4, 1, 3});
+
+    PendingQueue fifo(false);
+    fifo.push(make(1, 0));
+    fifo.push(make(2, 5));
+    fifo.push(make(3, 9));
+    order.clear();
+    while (fifo.pop(job)) order.push_back(job.id);
+    REQUIRE(order == std::vector<int>{1, 2, 3});
+}
+
+TEST_CASE("backfill runs small job behind blocked large job") {
+    ensure_nano_log_init();
+
+    SchedulerOptions opts;
+    opts.quota.total_cpu = 2;
+    opts.quota.total_mem_mb = 512;
+    opts.max_queue_size = 10;
+
+    Scheduler sched(opts);
+    sched.start();
+
+    JobSpec running;
+    running.cmd = "sleep 1";
+    running.cpu_cores = 1;
+    running.memory_mb = 64;
+    REQUIRE(sched.submit(running) > 0);
+
+    JobSpec large = running;
+    large.cmd = "true";
+    large.cpu_cores = 2;
+    REQUIRE(sched.submit(large) > 0);
+
+    JobSpec small = running;
+    small.cmd = "true";
+    REQUIRE(sched.submit(small) > 0);
+
+    for (int i = 0; i < 50 && sched.metrics_snapshot().succeeded < 1; ++i) {
+        std::this_thread::sleep_for(20ms);
+    }
+    auto snap = sched.metrics_snapshot();
+    REQUIRE(snap.succeeded == 1);
+    REQUIRE(snap.backfilled == 1);
+
+    JobSpec too_big = running;
+    too_big.cpu_cores = 3;
+    REQUIRE(sched.submit(too_big) == -1);
+
+    for (int i = 0; i < 50 && !sched.idle(); ++i) {
+        std::this_thread::sleep_for(100ms);
+    }
+    REQUIRE(sched.idle());
+    sched.stop();
+}
+
+TEST_CASE("millisecond timeout terminates job") {
+    ensure_nano_log_init();
+
+    SchedulerOptions opts;
+    opts.quota.total_cpu = 2;
+    opts.quota.total_mem_mb = 512;
+
+    Scheduler sched(opts);
+    sched.start();
+
+    JobSpec spec;
+    spec.cmd = "sleep 5";
+    spec.cpu_cores = 1;
+    spec.memory_mb = 64;
+    spec.timeout_ms = 150;
+
+    auto begin = std::chrono::steady_clock::now();
+    REQUIRE(sched.submit(spec) > 0);
+    for (int i = 0; i < 100 && !sched.idle(); ++i) {
+        std::this_thread::sleep_for(20ms);
+    }
+    REQUIRE(sched.idle());
+    REQUIRE(std::chrono::steady_clock::now() - begin < 1s);
+    REQUIRE(sched.metrics_snapshot().timeout == 1);
+    sched.stop();
+}
+
+TEST_CASE("every launch backend runs jobs and reports exit status") {
+    ensure_nano_log_init();
+
+    for (auto backend : {LaunchBackend::Fork, LaunchBackend::Vfork, LaunchBackend::Clone3}) {
+        SchedulerOptions opts;
+        opts.quota.total_cpu = 2;
+        opts.quota.total_mem_mb = 512;
+        opts.launch_backend = backend;
+
+        Scheduler sched(opts);
+        sched.start();
+
+        JobSpec ok;
+        ok.cmd = "true";
+        ok.memory_mb = 64;
+        JobSpec bad = ok;
+        bad.cmd = "exit 3";
+        REQUIRE(sched.submit(ok) > 0);
+        REQUIRE(sched.submit(bad) > 0);
+
+        for (int i = 0; i < 100 && !sched.idle(); ++i) {
+            std::this_thread::sleep_for(20ms);
+        }
+        REQUIRE(sched.idle());
+        auto snap = sched.metrics_snapshot();
+        CHECK(snap.succeeded == 1);
+        CHECK(snap.failed == 1);
+        sched.stop();
+    }
+}
+
+TEST_CASE("zygote launcher runs jobs as scheduler children") {
+    ensure_nano_log_init();
+
+    SchedulerOptions opts;
+    opts.quota.total_cpu = 4;
+    opts.quota.total_mem_mb = 1024;
+    opts.enable_zygote = true;
+
+    Scheduler sched(opts);
+    sched.start();
+
+    JobSpec ok;
+    ok.cmd = "true";
+    ok.memory_mb = 64;
+    JobSpec bad = ok;
+    bad.cmd = "exit 3";
+    for (int i = 0; i < 6; ++i) {
+        REQUIRE(sched.submit(i % 3 == 0 ? bad : ok) > 0);
+    }
+
+    for (int i = 0; i < 100 && !sched.idle(); ++i) {
+        std::this_thread::sleep_for(20ms);
+    }
+    REQUIRE(sched.idle());
+    auto snap = sched.metrics_snapshot();
+    CHECK(snap.succeeded == 4);
+    CHECK(snap.failed == 2);
+    CHECK(snap.launch_failed == 0);
+    sched.stop();
+}
+
+TEST_CASE("resource vectors with custom tokens and placement scorers") {
+    auto tokens = parse_resource_tokens("gpu=2,license=1");
+    REQUIRE(tokens.has_value());
+    CHECK(tokens->size() == 2);
+    CHECK(format_resource_tokens(*tokens) == "gpu=2,license=1");
+    CHECK(parse_resource_tokens("")->empty());
+    CHECK_FALSE(parse_resource_tokens("gpu").has_value());
+    CHECK_FALSE(parse_resource_tokens("=1").has_value());
+    CHECK_FALSE(parse_resource_tokens("gpu=0").has_value());
+    CHECK_FALSE(parse_resource_tokens("gpu=1,gpu=2").has_value());
+    CHECK_FALSE(parse_resource_tokens("gpu=1x").has_value());
+
+    ResourceQuota quota;
+    quota.total_cpu = 8;
+    quota.total_mem_mb = 8192;
+    quota.total_pids = 100;
+    quota.tokens = {{"gpu", 2}};
+    ResourceManager rm(quota);
+    JobSpec spec;
+    spec.cpu_cores = 2;
+    spec.memory_mb = 1024;
+    spec.pids = 40;
+    spec.tokens = {{"gpu", 1}};
+    auto demand = rm.demand_of(spec);
+    REQUIRE(demand.has_value());
+    CHECK((*demand)[ResourceVector::Pids] == 40);
+    CHECK((*demand)[ResourceVector::kBuiltinDims] == 1);
+    spec.tokens = {{"fpga", 1}};
+    CHECK_FALSE(rm.demand_of(spec).has_value());
+    spec.tokens = {{"gpu", 3}};
+    CHECK_FALSE(rm.within_quota(*rm.demand_of(spec)));
+
+    // pids 与令牌是独立的维度：CPU 与内存充足时也会被它们挡住
+    CpuPlacement p;
+    CHECK(rm.reserve(*demand, p));
+    CHECK(rm.reserve(*demand, p));
+    CHECK_FALSE(rm.reserve(*demand, p)); // pids 40 + 40 + 40 > 100，gpu 也已用完
+    rm.release(*demand, p);
+    auto small = *demand;
+    small[ResourceVector::kBuiltinDims] = 0;
+    small[ResourceVector::Pids] = 10;
+    CHECK(rm.reserve(small, p));
+    CHECK(rm.used() == std::pair<int, std::size_t>{4, 2048});
+    auto usage = rm.usage();
+    CHECK_FALSE(usage.bounded(ResourceVector::IoMbps)); // 未配置的维度不限
+    CHECK(usage.used[ResourceVector::Pids] == 50);
+
+    // 当前 CPU 占用 6/8、内存 2/8：三个候选里各策略的选择
+    ResourceUsage u;
+    u.capacity.v.fill(ResourceVector::kUnlimited);
+    u.capacity[ResourceVector::Cpu] = 8;
+    u.capacity[ResourceVector::MemoryMb] = 8;
+    u.used[ResourceVector::Cpu] = 6;
+    u.used[ResourceVector::MemoryMb] = 2;
+    auto vec = [](int cpu, int mem) {
+        ResourceVector v;
+        v[ResourceVector::Cpu] = cpu;
+        v[ResourceVector::MemoryMb] = mem;
+        return v;
+    };
+    std::vector<ResourceVector> cands{vec(3, 1), vec(2, 1), vec(1, 4), vec(0, 1)};
+    auto pick = [&](PlacementPolicy policy) {
+        auto scorer = make_placement_scorer(policy);
+        auto it = pick_placement(cands.begin(), cands.end(), u, scorer.get(), [](const ResourceVector &v) -> const ResourceVector & { return v; });
+        return static_cast<int>(it - cands.begin());
+    };
+    CHECK(pick(PlacementPolicy::FirstFit) == 1);         // vec(3, 1) 放不下
+    CHECK(pick(PlacementPolicy::BestFit) == 2);          // 平均利用率 (7/8 + 6/8) / 2 最高
+    CHECK(pick(PlacementPolicy::WorstFit) == 3);         // 最小的任务
+    CHECK(pick(PlacementPolicy::DominantResource) == 3); // CPU 已紧张，只要内存的任务不抬高最紧的一维
+    CHECK(parse_placement_policy("drf") == PlacementPolicy::DominantResource);
+    CHECK_FALSE(parse_placement_policy("random").has_value());
+    CHECK(std::string(to_string(PlacementPolicy::BestFit)) == "best-fit");
+
+    SchedulerOptions opts;
+    opts.quota.tokens = {{"gpu", 1}};
+    Scheduler sched(opts);
+    JobSpec job;
+    job.cmd = "true";
+    job.tokens = {{"fpga", 1}};
+    CHECK(sched.submit(job) == -1);
+    JobSpec unknown = job;
+    job.tokens = {{"gpu", 2}};
+    CHECK(sched.submit(job) == -1);
+    job.tokens = {{"gpu", 1}};
+    auto results = sched.submit_batch(std::vector<JobSpec>{job, unknown});
+    CHECK(results[0].error == SubmitError::None);
+    CHECK(results[1].error == SubmitError::UnknownResource);
+    CHECK(sched.metrics_snapshot().rejected == 3);
+}
+
+TEST_CASE("fair-share queues pick by weighted dominant share") {
+    CHECK(valid_queue_name("team-a.batch_1"));
+    CHECK_FALSE(valid_queue_name(""));
+    CHECK_FALSE(valid_queue_name("a\"b"));
+    CHECK_FALSE(valid_queue_name(std::string(65, 'a')));
+    auto weights = parse_queue_weights("a=3,b=0.5");
+    REQUIRE(weights.has_value());
+    CHECK(weights->at(1).second == 0.5);
+    CHECK_FALSE(parse_queue_weights("a=0").has_value());
+    CHECK_FALSE(parse_queue_weights("a=1,a=2").has_value());
+    CHECK_FALSE(parse_queue_weights("a b=1").has_value());
+
+    ResourceVector capacity;
+    capacity.v.fill(ResourceVector::kUnlimited);
+    capacity[ResourceVector::Cpu] = 8;
+    capacity[ResourceVector::MemoryMb] = 8192;
+    FairShareQueue fq;
+    fq.set_capacity(capacity);
+    fq.set_weight("a", 3);
+    int next_id = 1;
+    auto push = [&](const std::string &queue, int cpu, std::size_t mem) {
+        Job job;
+        job.id = next_id++;
+        job.spec.queue = queue;
+        job.demand[ResourceVector::Cpu] = cpu;
+        job.demand[ResourceVector::MemoryMb] = static_cast<std::int64_t>(mem);
+        return fq.push(std::move(job));
+    };
+    for (int i = 0; i < 100; ++i) {
+        push("a", 1, 128);
+        push("b", 1, 128);
+    }
+    CHECK(push("", 1, 128) == fq.queue_id("default"));
+    CHECK(fq.size() == 201);
+    // 每个任务的主导份额是 1/8 CPU：a 的份额 = n/24，b 与 default 为 n/8；同份额时先选最久未被选中的。
+    // 选择顺序 a b default a a b a a（default 只有一个任务）
+    std::map<std::string, int> taken;
+    std::vector<Job> running;
+    for (int i = 0; i < 8; ++i) {
+        int q = fq.front();
+        running.push_back(fq.take(q, fq.queue(q).begin()));
+        ++taken[fq.stats(q).name];
+    }
+    CHECK(taken["a"] == 5);
+    CHECK(taken["b"] == 2);
+    CHECK(taken["default"] == 1);
+    CHECK(fq.stats(fq.queue_id("a")).running == 5);
+    CHECK(std::abs(fq.stats(fq.queue_id("a")).share - 5.0 / 24) < 1e-9);
+    CHECK(std::abs(fq.stats(fq.queue_id("b")).share - 0.25) < 1e-9);
+    CHECK(fq.front() == fq.queue_id("a"));
+    // default 已空，不再参与选择；b 的一个任务结束后份额降到 1/8，低于 a
+    auto b_job = std::find_if(running.begin(), running.end(), [&](const Job &j) { return j.queue == fq.queue_id("b"); });
+    fq.release(b_job->queue, b_job->demand);
+    CHECK(fq.stats(fq.queue_id("b")).running == 1);
+    CHECK(fq.front() == fq.queue_id("b"));
+
+    // 突发：一个队列积压上万个任务，新队列的第一个任务仍然在下一次选择时被选中
+    FairShareQueue burst;
+    burst.set_capacity(capacity);
+    for (int i = 0; i < 10000; ++i) {
+        Job job;
+        job.id = i + 1;
+        job.spec.queue = "burst";
+        job.demand[ResourceVector::Cpu] = 1;
+        burst.push(std::move(job));
+    }
+    int q = burst.front();
+    burst.take(q, burst.queue(q).begin());
+    Job small;
+    small.id = 20000;
+    small.spec.queue = "small";
+    small.demand[ResourceVector::Cpu] = 1;
+    int small_q = burst.push(std::move(small));
+    CHECK(burst.front() == small_q);
+    // 同份额时轮转：都为 0 时先选最久未被选中的
+    FairShareQueue rr;
+    rr.set_capacity(capacity);
+    for (int i = 0; i < 4; ++i) {
+        Job job;
+        job.id = i + 1;
+        job.spec.queue = i % 2 ? "y" : "x";
+        rr.push(std::move(job));
+    }
+    std::vector<std::string> order;
+    while (!rr.empty()) {
+        int f = rr.front();
+        rr.take(f, rr.queue(f).begin());
+        order.push_back(rr.stats(f).name);
+    }
+    CHECK(order == std::vector<std::string>{"x", "y", "x", "y"});
+
+    Metrics m;
+    m.set_queue(1, "b", 3, 2, 4, 1024, 0.5);
+    auto text = m.to_prometheus();
+    CHECK(text.find("tasks_queue_pending{queue=\"b\"} 3\n") != std::string::npos);
+    CHECK(text.find("tasks_queue_memory_used_bytes{queue=\"b\"} 1073741824\n") != std::string::npos);
+    CHECK(text.find("tasks_queue_dominant_share{queue=\"b\"} 0.5\n") != std::string::npos);
+
+    Scheduler sched(SchedulerOptions{});
+    JobSpec bad;
+    bad.cmd = "true";
+    bad.queue = "a b";
+    CHECK(sched.submit(bad) == -1);
+    CHECK(sched.submit_batch(std::vector<JobSpec>{bad})[0].error == SubmitError::InvalidQueue);
+
+    // 不同队列名有上限（default 已占一个），超出的新队列名被拒绝，已有队列照常接受
+    std::vector<JobSpec> many(kMaxQueues);
+    for (std::size_t i = 0; i < many.size(); ++i) {
+        many[i].cmd = "true";
+        many[i].queue = "q" + std::to_string(i);
+    }
+    auto res = sched.submit_batch(many);
+    CHECK(res[kMaxQueues - 2].error == SubmitError::None);
+    CHECK(res[kMaxQueues - 1].error == SubmitError::InvalidQueue);
+    JobSpec extra;
+    extra.cmd = "true";
+    extra.queue = "q0";
+    CHECK(sched.submit(extra) > 0);
+    extra.queue = "another";
+    CHECK(sched.submit(extra) == -1);
+}
+
+TEST_CASE("cpu topology from sysfs, packed placement and fragmentation") {
+    CHECK(parse_cpu_list("0-3,8,10-11\n") == std::vector<int>{0, 1, 2, 3, 8, 10, 11});
+    CHECK(parse_cpu_list("").empty());
+    CHECK(parse_cpu_list("3-1").empty());
+    CHECK(parse_cpu_list("a").empty());
+    CHECK(format_cpu_list(std::vector<int>{11, 0, 1, 2, 8, 10, 2}) == "0-2,8,10-11");
+
+    // 伪造 sysfs：两个插槽各一个节点，各一个双线程物理核
+    char tmpl[] = "/tmp/sysfs_XXXXXX";
+    REQUIRE(::mkdtemp(tmpl) != nullptr);
+    std::string root = tmpl;
+    auto put = [&](const std::string &rel, const std::string &text) {
+        std::filesystem::create_directories(std::filesystem::path(root + "/" + rel).parent_path());
+        std::ofstream(root + "/" + rel) << text << "\n";
+    };
+    put("cpu/online", "0-3");
+    for (int c = 0; c < 4; ++c) {
+        put("cpu/cpu" + std::to_string(c) + "/topology/physical_package_id", std::to_string(c / 2));
+        put("cpu/cpu" + std::to_string(c) + "/topology/core_id", "0");
+    }
+    put("node/node0/cpulist", "0-1");
+    put("node/node1/cpulist", "2-3");
+    put("node/possible", "0-1");
+    auto topo = CpuTopology::detect(root, false);
+    std::filesystem::remove_all(root);
+    REQUIRE(topo.has_value());
+    REQUIRE(topo->nodes.size() == 2);
+    CHECK(topo->nodes[1].id == 1);
+    CHECK(topo->nodes[1].socket == 1);
+    REQUIRE(topo->cores.size() == 2);
+    CHECK(topo->cores[0].cpus == std::vector<int>{0, 1});
+    CHECK(topo->cores[1].node == 1);
+    CHECK(topo->cpu_count() == 4);
+    CHECK_FALSE(CpuTopology::detect(root + "/missing", false).has_value());
+
+    // 两个节点，各 4 个双线程核：node0 = CPU 0-7，node1 = CPU 8-15
+    ResourceQuota quota;
+    quota.total_cpu = 32;
+    quota.total_mem_mb = 1 << 20;
+    ResourceManager rm(quota);
+    rm.set_topology(CpuTopology::uniform(2, 1, 4, 2));
+    CHECK_FALSE(rm.within_quota(17, 0));
+    CHECK(rm.within_quota(16, 0));
+    CpuPlacement a, b, c, d, e, f;
+    REQUIRE(rm.reserve(2, 0, a));
+    CHECK(a.cpus == std::vector<int>{0, 1}); // 整核
+    CHECK(a.nodes == std::vector<int>{0});
+    REQUIRE(rm.reserve(1, 0, b));
+    CHECK(rm.cpu_fragmentation().split_cores == 1);
+    REQUIRE(rm.reserve(1, 0, c)); // 填满被拆开的核，不再拆新的
+    CHECK(b.cpus.front() / 2 == c.cpus.front() / 2);
+    CHECK(rm.cpu_fragmentation().split_cores == 0);
+    REQUIRE(rm.reserve(6, 0, d)); // node0 只剩 4 个，放进 node1
+    CHECK(d.cpus == std::vector<int>{8, 9, 10, 11, 12, 13});
+    auto frag = rm.cpu_fragmentation();
+    CHECK(frag.free_cpus == 6);
+    CHECK(frag.largest_node_free == 4);
+    CHECK(std::abs(frag.ratio() - 1.0 / 3.0) < 1e-9);
+    REQUIRE(rm.reserve(5, 0, e)); // 单节点放不下：跨两个节点
+    CHECK(e.cpus == std::vector<int>{4, 5, 6, 7, 14});
+    CHECK(e.nodes == std::vector<int>{0, 1});
+    REQUIRE(rm.reserve(1, 0, f));
+    CHECK(f.cpus == std::vector<int>{15});
+    CpuPlacement none;
+    CHECK_FALSE(rm.reserve(1, 0, none));
+    CHECK(rm.used().first == 16);
+    for (auto *p : {&a, &b, &c, &d, &e, &f}) rm.release(static_cast<int>(p->cpus.size()), 0, *p);
+    frag = rm.cpu_fragmentation();
+    CHECK(frag.free_cpus == 16);
+    CHECK(frag.split_cores == 0);
+    CHECK(frag.ratio() == 0.5);
+    CHECK(rm.used().first == 0);
+
+    Metrics m;
+    m.set_cpuset(6, 4, 1);
+    auto text = m.to_prometheus();
+    CHECK(text.find("tasks_cpuset_free_cpus 6\n") != std::string::npos);
+    CHECK(text.find("tasks_cpuset_split_cores 1\n") != std::string::npos);
+    CHECK(text.find("tasks_cpuset_fragmentation_ratio 0.333") != std::string::npos);
+
+    // 子进程在 exec 前绑定到指定 CPU
+    const std::string out = "/tmp/taskscheduler_affinity_test";
+    std::remove(out.c_str());
+    cpu_set_t only0;
+    CPU_ZERO(&only0);
+    CPU_SET(0, &only0);
+    std::string cmd = "grep Cpus_allowed_list /proc/self/status > " + out;
+    LaunchParams params;
+    params.cmd = cmd.c_str();
+    params.affinity = &only0;
+    auto res = launch_process(LaunchBackend::Vfork, params);
+    REQUIRE(res.pid > 0);
+    int status = 0;
+    ::waitpid(res.pid, &status, 0);
+    if (res.pidfd >= 0) ::close(res.pidfd);
+    std::ifstream ifs(out);
+    std::string line;
+    std::getline(ifs, line);
+    CHECK(line.ends_with(":\t0"));
+    std::remove(out.c_str());
+}
+
+TEST_CASE("submit_batch reports per-item rejections") {
+    ensure_nano_log_init();
+
+    SchedulerOptions opts;
+    opts.quota.total_cpu = 2;
+    opts.quota.total_mem_mb = 512;
+    opts.max_queue_size = 4;
+    opts.cmd_blacklist = {"rm"};
+
+    Scheduler sched(opts);
+
+    JobSpec ok;
+    ok.cmd = "true";
+    ok.memory_mb = 32;
+    JobSpec blocked = ok;
+    blocked.cmd = "rm -rf /tmp/nothing";
+    JobSpec huge = ok;
+    huge.cpu_cores = 8;
+
+    // 调度器尚未启动，队列不会被消费：第 4 个合法任务之后开始 QueueFull
+    std::vector<JobSpec> specs = {ok, blocked, ok, huge, ok, ok, ok, ok};
+    auto results = sched.submit_batch(specs);
+    REQUIRE(results.size() == specs.size());
+    CHECK(results[0].error == SubmitError::None);
+    CHECK(results[1].error == SubmitError::CommandRejected);
+    CHECK(results[2].error == SubmitError::None);
+    CHECK(results[3].error == SubmitError::ExceedsQuota);
+    CHECK(results[4].error == SubmitError::None);
+    CHECK(results[5].error == SubmitError::None);
+    CHECK(results[6].error == SubmitError::QueueFull);
+    CHECK(results[7].error == SubmitError::QueueFull);
+    CHECK(results[0].id > 0);
+    CHECK(results[2].id == results[0].id + 1);
+    CHECK(results[1].id == -1);
+    CHECK(sched.submit(ok) == -1);
+
+    auto snap = sched.metrics_snapshot();
+    CHECK(snap.submitted == 4);
+    CHECK(snap.rejected == 5);
+
+    sched.start();
+    for (int i = 0; i < 100 && !sched.idle(); ++i) {
+        std::this_thread::sleep_for(20ms);
+    }
+    REQUIRE(sched.idle());
+    CHECK(sched.metrics_snapshot().succeeded == 4);
+    sched.stop();
+}
+
+TEST_CASE("intake ring keeps every concurrent submission") {
+    ensure_nano_log_init();
+
+    IntakeRing ring(8);
+    REQUIRE(ring.capacity() == 8);
+    Job job;
+    for (int i = 1; i <= 8; ++i) {
+        job.id = i;
+        REQUIRE(ring.try_push(job));
+    }
+    job.id = 9;
+    CHECK_FALSE(ring.try_push(job));
+    CHECK(job.id == 9);
+    Job out;
+    REQUIRE(ring.try_pop(out));
+    CHECK(out.id == 1);
+
+    SchedulerOptions opts;
+    opts.quota.total_cpu = 4;
+    opts.quota.total_mem_mb = 1024;
+    opts.max_queue_size = 64; // 入口环同样只有 64 个槽位，压满时走加锁慢路径
+
+    Scheduler sched(opts);
+    sched.start();
+
+    constexpr int kThreads = 8;
+    constexpr int kPerThread = 100;
+    std::atomic<int> accepted{0};
+    std::vector<std::thread> producers;
+    for (int t = 0; t < kThreads; ++t) {
+        producers.emplace_back([&] {
+            JobSpec spec;
+            spec.cmd = "true";
+            spec.memory_mb = 16;
+            for (int i = 0; i < kPerThread; ++i) {
+                if (sched.submit(spec) > 0) accepted.fetch_add(1);
+            }
+        });
+    }
+    for (auto &t : producers) t.join();
+
+    for (int i = 0; i < 500 && !sched.idle(); ++i) {
+        std::this_thread::sleep_for(20ms);
+    }
+    REQUIRE(sched.idle());
+    auto snap = sched.metrics_snapshot();
+    CHECK(accepted.load() > 0);
+    CHECK(snap.submitted == accepted.load());
+    CHECK(snap.submitted + snap.rejected == kThreads * kPerThread);
+    CHECK(snap.succeeded == accepted.load());
+    sched.stop();
+}
+
+TEST_CASE("job dependencies release dependents, cascade cancellation and reject cycles") {
+    ensure_nano_log_init();
+
+    auto deps = parse_dependencies("afterok:3,afterany:12,afternotok:4");
+    REQUIRE(deps.has_value());
+    REQUIRE(deps->size() == 3);
+    CHECK((*deps)[1].job_id == 12);
+    CHECK((*deps)[1].condition == DependencyCondition::AnyFinish);
+    CHECK(format_dependencies(*deps) == "afterok:3,afterany:12,afternotok:4");
+    CHECK_FALSE(parse_dependencies("afterok:0").has_value());
+    CHECK_FALSE(parse_dependencies("after:3").has_value());
+    CHECK_FALSE(parse_dependencies("afterok:x").has_value());
+    CHECK(dependency_satisfied(DependencyCondition::Failure, JobStatus::Timeout));
+    CHECK_FALSE(dependency_satisfied(DependencyCondition::Failure, JobStatus::Cancelled));
+    CHECK(dependency_satisfied(DependencyCondition::AnyFinish, JobStatus::Cancelled));
+
+    // 1 → 2(afterok) → 3(afterok) → 4(afterany)；5 同时等 1 与 2；6 等 1 失败
+    DependencyGraph g;
+    auto held = [&](int id, std::vector<JobDependency> parents) {
+        Job job;
+        job.id = id;
+        g.hold(std::move(job), parents);
+    };
+    held(2, {{1, DependencyCondition::Success}});
+    held(3, {{2, DependencyCondition::Success}});
+    held(4, {{3, DependencyCondition::AnyFinish}});
+    held(5, {{1, DependencyCondition::Success}, {2, DependencyCondition::Success}});
+    held(6, {{1, DependencyCondition::Failure}});
+    CHECK(g.held() == 5);
+    std::vector<Job> ready, cancelled;
+    g.finish(1, JobStatus::Succeeded, ready, cancelled);
+    REQUIRE(ready.size() == 1);
+    CHECK(ready[0].id == 2);
+    REQUIRE(cancelled.size() == 1);
+    CHECK(cancelled[0].id == 6);
+    CHECK(cancelled[0].status == JobStatus::Cancelled);
+    CHECK(g.final_status(6) == JobStatus::Cancelled);
+    CHECK(g.held() == 3);
+    // 2 失败：3 与 5 取消，3 的取消使 4（afterany）可以派发
+    ready.clear();
+    cancelled.clear();
+    g.finish(2, JobStatus::Failed, ready, cancelled);
+    REQUIRE(ready.size() == 1);
+    CHECK(ready[0].id == 4);
+    std::vector<int> ids;
+    for (const auto &j : cancelled) ids.push_back(j.id);
+    std::sort(ids.begin(), ids.end());
+    CHECK(ids == std::vector<int>{3, 5});
+    CHECK(g.held() == 0);
+    CHECK(g.final_status(1) == JobStatus::Succeeded);
+    CHECK_FALSE(g.final_status(4).has_value());
+    g.set_restored(10, {{4, 4}, {7, 7}});
+    CHECK(g.finished_before_restart(8));
+    CHECK_FALSE(g.finished_before_restart(7));
+    CHECK_FALSE(g.finished_before_restart(10));
+
+    SchedulerOptions opts;
+    opts.quota.total_cpu = 2;
+    opts.quota.total_mem_mb = 512;
+    opts.max_queue_size = 32;
+    Scheduler sched(opts);
+    sched.start();
+
+    JobSpec ok;
+    ok.cmd = "true";
+    ok.memory_mb = 32;
+    JobSpec fail = ok;
+    fail.cmd = "false";
+    int a = sched.submit(fail);
+    REQUIRE(a > 0);
+    auto after = [](JobSpec spec, int id, DependencyCondition cond) {
+        spec.depends_on.push_back(JobDependency{id, cond});
+        return spec;
+    };
+    int b = sched.submit(after(ok, a, DependencyCondition::Success));
+    int c = sched.submit(after(ok, b, DependencyCondition::AnyFinish));
+    int d = sched.submit(after(ok, a, DependencyCondition::Failure));
+    int e = sched.submit(after(ok, d, DependencyCondition::Success));
+    CHECK(sched.submit(after(ok, e + 100, DependencyCondition::Success)) == -1);
+    for (int i = 0; i < 200 && !sched.idle(); ++i) {
+        std::this_thread::sleep_for(10ms);
+    }
+    REQUIRE(sched.idle());
+    CHECK(sched.job_status(a) == JobStatus::Failed);
+    CHECK(sched.job_status(b) == JobStatus::Cancelled);
+    CHECK(sched.job_status(c) == JobStatus::Succeeded);
+    CHECK(sched.job_status(d) == JobStatus::Succeeded);
+    CHECK(sched.job_status(e) == JobStatus::Succeeded);
+    // 父任务已结束：提交时直接判断
+    int late = sched.submit(after(ok, a, DependencyCondition::Success));
+    REQUIRE(late > 0);
+    CHECK(sched.job_status(late) == JobStatus::Cancelled);
+    CHECK_FALSE(sched.job_status(late + 1).has_value());
+
+    // 同批引用：1 ← 2；3 ↔ 4 成环；5 依赖环上的 3；6 引用越界；7 依赖被拒绝的 6
+    std::vector<JobSpec> batch = {ok,
+                                  after(ok, -1, DependencyCondition::Success),
+                                  after(ok, -4, DependencyCondition::Success),
+                                  after(ok, -3, DependencyCondition::Success),
+                                  after(ok, -3, DependencyCondition::AnyFinish),
+                                  after(ok, -9, DependencyCondition::Success),
+                                  after(ok, -6, DependencyCondition::AnyFinish)};
+    auto results = sched.submit_batch(batch);
+    CHECK(results[0].error == SubmitError::None);
+    CHECK(results[1].error == SubmitError::None);
+    CHECK(results[2].error == SubmitError::DependencyCycle);
+    CHECK(results[3].error == SubmitError::DependencyCycle);
+    CHECK(results[4].error == SubmitError::DependencyCycle);
+    CHECK(results[5].error == SubmitError::InvalidDependency);
+    CHECK(results[6].error == SubmitError::InvalidDependency);
+    for (int i = 0; i < 200 && !sched.idle(); ++i) {
+        std::this_thread::sleep_for(10ms);
+    }
+    REQUIRE(sched.idle());
+    CHECK(sched.job_status(results[1].id) == JobStatus::Succeeded);
+    auto snap = sched.metrics_snapshot();
+    CHECK(snap.cancelled == 2);
+    CHECK(snap.dependency_held == 0);
+    CHECK(snap.pending == 0);
+    CHECK(sched.metrics_snapshot().succeeded == 5);
+    sched.stop();
+
+    // 日志压缩后快照保留未完成任务与全部已结束任务的终态
+    const std::string path = "/tmp/taskscheduler_test_deps.journal";
+    std::remove(path.c_str());
+    std::remove((path + ".snap").c_str());
+    JobStore::Options sopts;
+    sopts.flush_interval_ms = 0;
+    sopts.snapshot_records = 6;
+    {
+        JournalJobStore store;
+        REQUIRE(store.init(path, sopts));
+        REQUIRE(store.insert_job(1, ok, PersistStatus::Queued, 1));
+        REQUIRE(store.insert_job(2, ok, PersistStatus::Queued, 2));
+        REQUIRE(store.insert_job(3, after(ok, 1, DependencyCondition::Success), PersistStatus::Queued, 3));
+        store.update_status(1, PersistStatus::Succeeded, 0, 5, 6);
+        store.update_status(2, PersistStatus::Failed, 1, 5, 6); // 第 6 条：压缩
+    }
+    JournalJobStore reopened;
+    REQUIRE(reopened.init(path, sopts));
+    auto jobs = reopened.load_unfinished();
+    REQUIRE(jobs.size() == 1);
+    CHECK(format_dependencies(jobs[0].spec.depends_on) == "afterok:1");
+    CHECK(reopened.load_status(1) == PersistStatus::Succeeded);
+    CHECK(reopened.load_status(2) == PersistStatus::Failed);
+    CHECK_FALSE(reopened.load_status(3).has_value());
+}
+
+#ifdef TASKSCHEDULER_ENABLE_SQLITE
+TEST_CASE("job dependencies survive a scheduler restart") {
+    ensure_nano_log_init();
+    const std::string path = "/tmp/taskscheduler_test_deps.db";
+    for (const char *suffix : {"", "-wal", "-shm"}) std::remove((path + suffix).c_str());
+
+    SchedulerOptions opts;
+    opts.quota.total_cpu = 2;
+    opts.quota.total_mem_mb = 512;
+    opts.enable_persistence = true;
+    opts.persist_backend = PersistBackend::Sqlite;
+    opts.db_path = path;
+    JobSpec ok;
+    ok.cmd = "true";
+    ok.memory_mb = 32;
+    auto after = [](JobSpec spec, int id, DependencyCondition cond) {
+        spec.depends_on.push_back(JobDependency{id, cond});
+        return spec;
+    };
+    int a = -1;
+    {
+        Scheduler first(opts);
+        first.start();
+        a = first.submit(ok);
+        REQUIRE(a > 0);
+        for (int i = 0; i < 200 && !first.idle(); ++i) {
+            std::this_thread::sleep_for(10ms);
+        }
+        REQUIRE(first.idle());
+        first.stop();
+    }
+    {
+        // 模拟重启前尚未完成的任务：10 排队，11 等 10，12 等已成功的 a，13 等 a 失败；
+        // 15、16 在重启前已结束，id 大于所有未完成任务
+        SqliteJobStore store;
+        REQUIRE(store.init(path));
+        REQUIRE(store.insert_job(10, ok, PersistStatus::Queued, 10));
+        REQUIRE(store.insert_job(11, after(ok, 10, DependencyCondition::Success), PersistStatus::Queued, 11));
+        REQUIRE(store.insert_job(12, after(ok, a, DependencyCondition::Success), PersistStatus::Queued, 12));
+        REQUIRE(store.insert_job(13, after(ok, a, DependencyCondition::Failure), PersistStatus::Queued, 13));
+        REQUIRE(store.insert_job(15, ok, PersistStatus::Queued, 15));
+        store.update_status(15, PersistStatus::Succeeded, 0, 15, 16);
+        REQUIRE(store.insert_job(16, ok, PersistStatus::Queued, 16));
+        store.update_status(16, PersistStatus::Failed, 1, 16, 17);
+        store.flush();
+        CHECK(store.load_status(a) == PersistStatus::Succeeded);
+        CHECK(store.load_status(10) == PersistStatus::Queued);
+        CHECK_FALSE(store.load_status(99).has_value());
+    }
+    Scheduler second(opts);
+    second.start();
+    int late = second.submit(after(ok, a, DependencyCondition::Success));
+    CHECK(late == 17);
+    // 水位取持久化中用过的最大 id：对 15、16 的依赖按其终态判断，不会被当成不存在或绑到新任务上
+    int after_ok = second.submit(after(ok, 15, DependencyCondition::Success));
+    int after_fail = second.submit(after(ok, 16, DependencyCondition::Success));
+    CHECK(after_ok == 18);
+    CHECK(after_fail == 19);
+    for (int i = 0; i < 200 && !second.idle(); ++i) {
+        std::this_thread::sleep_for(10ms);
+    }
+    REQUIRE(second.idle());
+    CHECK(second.job_status(a) == JobStatus::Succeeded);
+    CHECK(second.job_status(10) == JobStatus::Succeeded);
+    CHECK(second.job_status(11) == JobStatus::Succeeded);
+    CHECK(second.job_status(12) == JobStatus::Succeeded);
+    CHECK(second.job_status(13) == JobStatus::Cancelled);
+    CHECK(second.job_status(late) == JobStatus::Succeeded);
+    CHECK(second.job_status(15) == JobStatus::Succeeded);
+    CHECK(second.job_status(after_ok) == JobStatus::Succeeded);
+    CHECK(second.job_status(after_fail) == JobStatus::Cancelled);
+    second.stop();
+}
+#endif
+
+TEST_CASE("array jobs expand one index at a time and resume after restart") {
+    ensure_nano_log_init();
+
+    auto range = parse_array_range("0-9:3");
+    REQUIRE(range.has_value());
+    CHECK(range->size() == 4);
+    CHECK(range->index(3) == 9);
+    CHECK(format_array_range(*range) == "0-9:3");
+    CHECK(parse_array_range("7")->size() == 1);
+    for (const char *bad : {"5-1", "1-3:0", "-1-3", "x", "1-", ""}) CHECK_FALSE(parse_array_range(bad).has_value());
+    CHECK(expand_task_index("echo $TASK_INDEX ${TASK_INDEX} $TASK_INDEXES $HOME $", 7) == "echo 7 7 $TASK_INDEXES $HOME $");
+
+    const auto dir = std::filesystem::temp_directory_path() / "taskscheduler_test_array";
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir);
+    auto touched = [&] {
+        std::vector<std::string> names;
+        for (const auto &e : std::filesystem::directory_iterator(dir)) names.push_back(e.path().filename().string());
+        std::sort(names.begin(), names.end());
+        return names;
+    };
+    auto wait_idle = [](Scheduler &s) {
+        for (int i = 0; i < 300 && !s.idle(); ++i) std::this_thread::sleep_for(10ms);
+        return s.idle();
+    };
+    JobSpec touch;
+    touch.cmd = "touch " + dir.string() + "/t$TASK_INDEX";
+    touch.memory_mb = 32;
+
+    SchedulerOptions opts;
+    opts.quota.total_cpu = 2;
+    opts.quota.total_mem_mb = 512;
+    opts.max_queue_size = 3;
+    {
+        Scheduler sched(opts);
+        sched.start();
+        JobSpec sweep = touch;
+        sweep.array = ArrayRange{0, 4, 2};
+        // 每个数组只占一个队列名额：三次提交共 6 个任务
+        int a = sched.submit(sweep);
+        REQUIRE(a > 0);
+        JobSpec fails;
+        fails.cmd = "sh -c 'exit ${TASK_INDEX}'";
+        fails.array = ArrayRange{0, 1, 1};
+        JobSpec after_all = touch;
+        after_all.cmd = "touch " + dir.string() + "/after";
+        after_all.depends_on.push_back(JobDependency{a, DependencyCondition::Success});
+        int b = sched.submit(fails);
+        REQUIRE(b == a + 4);
+        int c = sched.submit(after_all);
+        REQUIRE(c == b + 3);
+        JobSpec too_big = touch;
+        too_big.array = ArrayRange{0, static_cast<int>(kMaxArrayTasks), 1};
+        CHECK(sched.submit_batch(std::span<const JobSpec>(&too_big, 1))[0].error == SubmitError::InvalidArray);
+        REQUIRE(wait_idle(sched));
+
+        CHECK(touched() == std::vector<std::string>{"after", "t0", "t2", "t4"});
+        CHECK(sched.job_status(a) == JobStatus::Succeeded);
+        CHECK(sched.job_status(a + 2) == JobStatus::Succeeded); // 下标 2
+        CHECK(sched.job_status(b) == JobStatus::Failed);
+        CHECK(sched.job_status(b + 1) == JobStatus::Succeeded);
+        CHECK(sched.job_status(b + 2) == JobStatus::Failed);
+        CHECK(sched.job_status(c) == JobStatus::Succeeded);
+        auto m = sched.metrics_snapshot();
+        CHECK(m.submitted == 6);
+        CHECK(m.pending == 0);
+        sched.stop();
+    }
+
+    // 重启恢复：数组 5 的下标 1（任务 7）已在重启前结束，只派发其余三个
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir);
+    const std::string path = (std::filesystem::temp_directory_path() / "taskscheduler_test_array.journal").string();
+    std::remove(path.c_str());
+    std::remove((path + ".snap").c_str());
+    {
+        JournalJobStore store;
+        REQUIRE(store.init(path));
+        JobSpec sweep = touch;
+        sweep.array = ArrayRange{0, 3, 1};
+        REQUIRE(store.insert_job(5, sweep, PersistStatus::Queued, 5));
+        store.record_array_task(5, 7, 1, PersistStatus::Succeeded);
+        store.close();
+    }
+    {
+        JournalJobStore store;
+        REQUIRE(store.init(path));
+        auto jobs = store.load_unfinished();
+        REQUIRE(jobs.size() == 1);
+        CHECK(format_array_range(jobs[0].spec.array) == "0-3");
+        REQUIRE(jobs[0].finished_tasks.size() == 1);
+        CHECK(jobs[0].finished_tasks[0].first == 7);
+        CHECK(store.load_status(7) == PersistStatus::Succeeded);
+        store.close();
+    }
+    opts.enable_persistence = true;
+    opts.persist_backend = PersistBackend::Journal;
+    opts.db_path = path;
+    Scheduler second(opts);
+    second.start();
+    CHECK(second.job_status(7) == JobStatus::Succeeded);
+    JobSpec plain;
+    plain.cmd = "true";
+    CHECK(second.submit(plain) == 10);
+    REQUIRE(wait_idle(second));
+    CHECK(touched() == std::vector<std::string>{"t0", "t2", "t3"});
+    CHECK(second.job_status(5) == JobStatus::Succeeded);
+    CHECK(second.job_status(8) == JobStatus::Succeeded);
+    second.stop();
+    std::filesystem::remove_all(dir);
+}
+
+TEST_CASE("cron expressions compile fields and honour time zones") {
+    using namespace std::chrono;
+    auto next = [](std::string_view expr, sys_seconds from) {
+        auto ce = CronExpression::parse(expr);
+        REQUIRE(ce.has_value());
+        return ce->next_run(system_clock::time_point(from));
+    };
+    auto at = [](sys_days d, int h, int m, int s) { return system_clock::time_point(d + hours{h} + minutes{m} + seconds{s}); };
+
+    for (const char *bad : {"61 * * * *", "* * *", "5-1 * * * *", "*/0 * * * *", "@reboot", "@every 5",
+                            "CRON_TZ=No/Such_Zone * * * * *", "0 0 * * FOO"}) {
+        CHECK_FALSE(CronExpression::parse(bad).has_value());
+    }
+
+    const sys_days jan1{2024y / January / 1}; // 周一
+    CHECK(next("CRON_TZ=UTC */15 * * * *", jan1 + 7min + 30s) == at(jan1, 0, 15, 0));
+    CHECK(next("CRON_TZ=UTC 0 9 * * MON-FRI", sys_days{2024y / January / 6} + 10h) == at(jan1 + days{7}, 9, 0, 0));
+    CHECK(next("CRON_TZ=UTC @hourly", jan1 + 10h + 59min + 59s) == at(jan1, 11, 0, 0));
+    CHECK(next("CRON_TZ=UTC 0 0 1,15 */3 *", jan1 + 1s) == at(jan1 + days{14}, 0, 0, 0));
+    // 6 字段含秒；闰日
+    CHECK(next("CRON_TZ=UTC 30 0 0 29 2 *", sys_days{2024y / March / 1}) == at(sys_days{2028y / February / 29}, 0, 0, 30));
+    // 日与周都受限时取并集：1 月 13 日是周六，1 月 5 日是周五
+    CHECK(next("CRON_TZ=UTC 0 0 13 * FRI", jan1) == at(jan1 + days{4}, 0, 0, 0));
+    CHECK(next("CRON_TZ=UTC 0 0 * * 7", jan1) == at(jan1 + days{6}, 0, 0, 0));
+    CHECK(next("CRON_TZ=UTC 0 0 30 2 *", jan1) == system_clock::time_point::max());
+    CHECK(next("@every 90s", jan1) == at(jan1, 0, 1, 30));
+
+    CHECK(next("CRON_TZ=Asia/Shanghai 0 8 * * *", sys_days{2023y / December / 31} + 23h) == at(jan1, 0, 0, 0));
+    CHECK(next("CRON_TZ=CET-1CEST,M3.5.0,M10.5.0/3 0 12 * * *", sys_days{2024y / July / 1}) ==
+          at(sys_days{2024y / July / 1}, 10, 0, 0));
+    // 转换表之外由尾部 POSIX 规则推算
+    CHECK(next("CRON_TZ=Europe/Berlin 0 12 1 7 *", sys_days{2040y / June / 30}) == at(sys_days{2040y / July / 1}, 10, 0, 0));
+    // 纽约 2024-03-10 02:30 不存在，顺延到次日；2024-11-03 01:30 出现两次，只在第一次触发
+    CHECK(next("CRON_TZ=America/New_York 30 2 * * *", sys_days{2024y / March / 9} + 12h) ==
+          at(sys_days{2024y / March / 11}, 6, 30, 0));
+    const sys_days nov3{2024y / November / 3};
+    CHECK(next("CRON_TZ=America/New_York 30 1 * * *", nov3 + 4h) == at(nov3, 5, 30, 0));
+    CHECK(next("CRON_TZ=America/New_York 30 1 * * *", nov3 + 5h + 30min) == at(nov3 + days{1}, 6, 30, 0));
+    // 每小时任务跨过拨快空档
+    CHECK(next("CRON_TZ=America/New_York 0 * * * *", sys_days{2024y / March / 10} + 6h + 30min) ==
+          at(sys_days{2024y / March / 10}, 7, 0, 0));
+}
+
+TEST_CASE("cron scheduler fires only due templates and sleeps until the next one") {
+    using namespace std::chrono;
+    CronScheduler cron;
+    const auto t0 = system_clock::time_point(sys_days{2024y / January / 1});
+    std::vector<std::string> fired;
+    auto cb = [&](int, const JobSpec &spec) {
+        fired.push_back(spec.cmd);
+        return static_cast<int>(fired.size());
+    };
+
+    for (int i = 0; i < 1000; ++i) {
+        CronTemplate tpl;
+        tpl.cron = *CronExpression::parse("@every 1h");
+        tpl.spec.cmd = "hourly " + std::to_string(i);
+        tpl.next_run = t0 + hours{1} + seconds{i};
+        cron.add_template(tpl);
+    }
+    CronTemplate every;
+    every.cron = *CronExpression::parse("@every 10s");
+    every.spec.cmd = "every10";
+    every.next_run = t0 + seconds{10};
+    cron.add_template(every);
+    CronTemplate off = every;
+    off.enabled = false;
+    off.spec.cmd = "disabled";
+    cron.add_template(off);
+
+    CHECK(cron.tick(t0, cb) == t0 + seconds{10});
+    CHECK(fired.empty());
+    // 晚到 3 秒：只触发一次，下一次仍按计划时间对齐
+    CHECK(cron.tick(t0 + seconds{13}, cb) == t0 + seconds{20});
+    REQUIRE(fired.size() == 1);
+    CHECK(fired[0] == "every10");
+    fired.clear();
+    cron.tick(t0 + hours{1} + seconds{2}, cb);
+    CHECK(fired.size() == 4); // every10 与 hourly 0..2
+    CHECK(std::count(fired.begin(), fired.end(), "disabled") == 0);
+
+    // run() 精确睡到最早的触发时间，新模板加入时重新计算
+    CronScheduler live;
+    std::atomic<int> count{0};
+    std::thread runner([&] { live.run([&](int, const JobSpec &) { return count.fetch_add(1); }); });
+    CronTemplate soon;
+    soon.cron = *CronExpression::parse("@every 1h");
+    soon.next_run = system_clock::now() + 50ms;
+    auto start = steady_clock::now();
+    live.add_template(soon);
+    while (count.load() == 0 && steady_clock::now() - start < 2s) std::this_thread::sleep_for(1ms);
+    CHECK(count.load() == 1);
+    CHECK(steady_clock::now() - start < 1s);
+    live.stop();
+    runner.join();
+}
+
+TEST_CASE("cron jitter, splay, catch-up policy and max concurrent instances") {
+    using namespace std::chrono;
+    const auto t0 = system_clock::time_point(sys_days{2024y / January / 1});
+    auto make = [&](std::string cmd) {
+        CronTemplate tpl;
+        tpl.cron = *CronExpression::parse("@every 10s");
+        tpl.spec.cmd = std::move(cmd);
+        tpl.next_run = t0 + seconds{10};
+        return tpl;
+    };
+    int next_id = 0;
+    int count = 0;
+    auto cb = [&](int, const JobSpec &) {
+        ++count;
+        return next_id++;
+    };
+
+    // splay：100 个同一时刻的模板分散到整个间隔内，且偏移在重建后保持不变
+    std::vector<system_clock::time_point> fire_at;
+    for (int round = 0; round < 2; ++round) {
+        CronScheduler cron;
+        for (int i = 0; i < 100; ++i) {
+            auto tpl = make("report " + std::to_string(i));
+            tpl.cron = *CronExpression::parse("@every 60s");
+            tpl.next_run = t0 + seconds{60};
+            tpl.splay = true;
+            cron.add_template(tpl);
+        }
+        std::vector<system_clock::time_point> seen;
+        int max_burst = 0;
+        count = 0;
+        for (auto t = t0 + seconds{60}; t <= t0 + seconds{120}; t += seconds{1}) {
+            int before = count;
+            cron.tick(t, [&](int, const JobSpec &spec) {
+                seen.push_back(t);
+                return cb(0, spec);
+            });
+            max_burst = std::max(max_burst, count - before);
+        }
+        CHECK(count == 100);
+        CHECK(max_burst <= 10);
+        CHECK(seen.back() - seen.front() > seconds{45});
+        if (round == 0) fire_at = seen;
+        else CHECK(seen == fire_at);
+    }
+
+    // jitter：实际触发时间落在 [计划, 计划 + jitter)
+    {
+        CronScheduler cron;
+        auto tpl = make("jittered");
+        tpl.jitter = seconds{5};
+        cron.add_template(tpl);
+        auto at = cron.tick(t0, cb);
+        CHECK(at >= t0 + seconds{10});
+        CHECK(at < t0 + seconds{15});
+    }
+
+    // 补跑策略：停摆 35 秒后错过 10/20/30/40 四次
+    for (auto [policy, expect] : {std::pair{CronCatchUp::Skip, 0}, {CronCatchUp::FireOnce, 1}, {CronCatchUp::FireAll, 4}}) {
+        CronScheduler cron;
+        auto tpl = make("late");
+        tpl.catch_up = policy;
+        cron.add_template(tpl);
+        count = 0;
+        CHECK(cron.tick(t0 + seconds{45}, cb) == t0 + seconds{50});
+        CHECK(count == expect);
+        CHECK(cron.stats().missed == 4 - expect);
+        // 宽限期内的正常触发不受 Skip 影响
+        count = 0;
+        cron.tick(t0 + seconds{50} + milliseconds{500}, cb);
+        CHECK(count == 1);
+    }
+
+    // max_concurrent：实例未结束时跳过触发，结束后恢复；被拒绝的提交立即归还名额
+    {
+        CronScheduler cron;
+        auto tpl = make("exclusive");
+        tpl.max_concurrent = 1;
+        int idx = cron.add_template(tpl);
+        count = 0;
+        cron.tick(t0 + seconds{10}, cb);
+        cron.tick(t0 + seconds{20}, cb);
+        CHECK(count == 1);
+        CHECK(cron.stats().throttled == 1);
+        cron.instance_finished(idx);
+        cron.tick(t0 + seconds{30}, cb);
+        CHECK(count == 2);
+        cron.instance_finished(idx);
+        cron.tick(t0 + seconds{40}, [&](int, const JobSpec &) { return -1; });
+        cron.tick(t0 + seconds{50}, cb);
+        CHECK(count == 3);
+        auto st = cron.stats();
+        CHECK(st.fired == 4);
+        CHECK(st.throttled == 1);
+        CHECK(st.missed == 0);
+    }
+}
+
+TEST_CASE("PSI parsing, graduated throttle factor and admission token bucket") {
+    double avg10 = 0;
+    std::uint64_t total = 0;
+    REQUIRE(PressureMonitor::parse_some("some avg10=12.50 avg60=3.00 avg300=1.00 total=987654\n"
+                                        "full avg10=80.00 avg60=0.00 avg300=0.00 total=5\n",
+                                        avg10, total));
+    CHECK(avg10 == 12.5);
+    CHECK(total == 987654);
+    CHECK_FALSE(PressureMonitor::parse_some("full avg10=1.00 avg60=0.00 avg300=0.00 total=1\n", avg10, total));
+
+    PsiConfig cfg;
+    cfg.memory = {10, 40};
+    cfg.cpu = {50, 90};
+    cfg.io = {0, 0}; // 不监视
+    cfg.min_rate_fraction = 0.1;
+    CHECK(PressureMonitor::throttle_factor({5, 20, 99}, cfg) == 1.0);
+    CHECK(std::abs(PressureMonitor::throttle_factor({25, 0, 0}, cfg) - 0.55) < 1e-9);
+    CHECK(std::abs(PressureMonitor::throttle_factor({40, 0, 0}, cfg) - 0.1) < 1e-9);
+    // 多个资源取最严格的
+    CHECK(std::abs(PressureMonitor::throttle_factor({25, 86, 0}, cfg) - 0.19) < 1e-9);
+
+    // 不支持 trigger 的普通文件退回周期采样：首次取 avg10，之后按 total 增量
+    char tmpl[] = "/tmp/psi_test_XXXXXX";
+    REQUIRE(::mkdtemp(tmpl) != nullptr);
+    std::string dir = tmpl;
+    auto write_psi = [&](const std::string &name, double a, long long t) {
+        std::ofstream(dir + "/" + name) << "some avg10=" << a << " avg60=0.00 avg300=0.00 total=" << t
+                                        << "\nfull avg10=0.00 avg60=0.00 avg300=0.00 total=0\n";
+    };
+    write_psi("memory.pressure", 30, 1000);
+    write_psi("cpu.pressure", 0, 0);
+    {
+        PressureMonitor mon;
+        CHECK(mon.open(dir, cfg) == 2);
+        CHECK(mon.opened(PressureMonitor::Memory));
+        CHECK_FALSE(mon.opened(PressureMonitor::Io));
+        CHECK_FALSE(mon.triggered(PressureMonitor::Memory));
+        CHECK_FALSE(mon.all_triggered());
+        auto levels = mon.sample();
+        CHECK(levels[PressureMonitor::Memory] == 30.0);
+        CHECK(levels[PressureMonitor::Cpu] == 0.0);
+        levels = mon.sample();
+        CHECK(levels[PressureMonitor::Memory] == 0.0); // total 没变：这段时间无停顿
+        write_psi("memory.pressure", 30, 1000 + 10'000'000);
+        levels = mon.sample();
+        CHECK(levels[PressureMonitor::Memory] == 100.0);
+        // wake() 打断无限等待
+        std::thread waker([&] {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            mon.wake();
+        });
+        CHECK_FALSE(mon.wait(-1));
+        waker.join();
+    }
+    for (auto name : {"memory.pressure", "cpu.pressure"}) std::remove((dir + "/" + name).c_str());
+    ::rmdir(dir.c_str());
+
+    // 内核支持 PSI 时在 /proc/pressure 上注册 trigger
+    if (::access("/proc/pressure/memory", R_OK) == 0) {
+        PressureMonitor mon;
+        PsiConfig proc_cfg;
+        if (mon.open("/proc/pressure", proc_cfg) > 0 && mon.all_triggered()) {
+            CHECK(mon.triggered(PressureMonitor::Memory));
+            CHECK_FALSE(mon.wait(0));
+        }
+    }
+
+    using namespace std::chrono;
+    AdmissionController ac(100.0);
+    auto t0 = steady_clock::now();
+    CHECK(ac.available(t0, 32) == 32); // 系数 1：不限速
+    ac.set_factor(0.5);                // 50 个/秒，桶容量 5
+    CHECK(ac.available(t0, 32) == 5);
+    ac.consume(5);
+    CHECK(ac.available(t0, 32) == 0);
+    CHECK(round<milliseconds>(ac.next_token(t0) - t0) == milliseconds(20));
+    CHECK(ac.available(t0 + milliseconds(40), 32) == 2);
+    CHECK(ac.available(t0 + seconds(10), 32) == 5);
+    ac.set_factor(0.0);
+    ac.consume(5);
+    CHECK(ac.available(t0 + seconds(20), 32) == 0);
+    CHECK(ac.next_token(t0) == steady_clock::time_point::max());
+}
+
+TEST_CASE("scheduler slows dispatch under pressure and recovers") {
+    char tmpl[] = "/tmp/psi_sched_XXXXXX";
+    REQUIRE(::mkdtemp(tmpl) != nullptr);
+    std::string file = std::string(tmpl) + "/memory.pressure";
+    std::ofstream(file) << "some avg10=100.00 avg60=0.00 avg300=0.00 total=0\n";
+
+    SchedulerOptions opts;
+    opts.quota.total_cpu = 8;
+    opts.quota.total_mem_mb = 1024;
+    opts.enable_psi_monitor = true;
+    opts.psi.dir = tmpl;
+    opts.psi.cpu = {0, 0};
+    opts.psi.io = {0, 0};
+    opts.psi.window_ms = 500;
+    opts.psi.max_dispatch_rate = 10; // 降到一半即 5 个/秒
+    opts.psi.min_rate_fraction = 0.5;
+    Scheduler sched(opts);
+    sched.start();
+    CHECK(sched.metrics_snapshot().dispatch_factor == 0.5);
+
+    JobSpec spec;
+    spec.cmd = "true";
+    spec.cpu_cores = 1;
+    spec.memory_mb = 16;
+    for (int i = 0; i < 10; ++i) REQUIRE(sched.submit(spec) > 0);
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    auto s = sched.metrics_snapshot();
+    CHECK(s.succeeded + s.failed + s.running <= 4);
+    CHECK(s.pressure_active == 1);
+    CHECK(s.pressure_blocked > 0);
+
+    // 文件的 total 不再增长：下一个窗口压力归零，恢复不限速
+    for (int i = 0; i < 100 && !sched.idle(); ++i) std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    REQUIRE(sched.idle());
+    s = sched.metrics_snapshot();
+    CHECK(s.succeeded == 10);
+    CHECK(s.dispatch_factor == 1.0);
+    CHECK(s.pressure_active == 0);
+    sched.stop();
+    std::remove(file.c_str());
+    ::rmdir(tmpl);
+}
+
+TEST_CASE("cgroup pool reuses slots, rewrites limits via cached fds and drains populated groups") {
+    char tmpl[] = "/tmp/cg_pool_XXXXXX";
+    REQUIRE(::mkdtemp(tmpl) != nullptr);
+    std::string base = tmpl;
+    auto read_file = [](const std::string &path) {
+        std::ifstream ifs(path);
+        return std::string(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+    };
+    // 普通目录模拟 cgroupfs：预先放好 pool_0 的控制文件
+    ::mkdir((base + "/pool_0").c_str(), 0755);
+    for (auto name : {"cpu.max", "memory.max", "cgroup.procs"}) std::ofstream(base + "/pool_0/" + name);
+    std::ofstream(base + "/pool_0/cgroup.events") << "populated 0\nfrozen 0\n";
+
+    CgroupConfig cfg;
+    cfg.base_path = base;
+    cfg.cpu_period_us = 100000;
+    {
+        CgroupPool pool;
+        REQUIRE(pool.init(cfg, 2) == 2);
+        CHECK(pool.idle() == 2);
+        int a = pool.acquire(1, 64);
+        int b = pool.acquire(2, 128);
+        REQUIRE(a >= 0);
+        REQUIRE(b >= 0);
+        CHECK(a != b);
+        int c = pool.acquire(1, 64); // 池空时扩充
+        CHECK(c == 2);
+        CHECK(pool.size() == 3);
+        CHECK(pool.path(c) == base + "/pool_2");
+        CHECK(pool.procs_fd(0) >= 0);
+
+        pool.release(a);
+        pool.release(b);
+        pool.release(c);
+        CHECK(pool.idle() == 3);
+        // 取 pool_0 写入限额
+        int s0 = -1;
+        std::vector<int> held;
+        for (int i = 0; i < 3; ++i) {
+            int s = pool.acquire(3, 256);
+            if (pool.path(s) == base + "/pool_0") s0 = s;
+            held.push_back(s);
+        }
+        REQUIRE(s0 >= 0);
+        CHECK(pool.size() == 3);
+        CHECK(read_file(base + "/pool_0/cpu.max") == "300000 100000");
+        CHECK(read_file(base + "/pool_0/memory.max") == std::to_string(256ull << 20));
+
+        // 仍有进程的 cgroup 先搁置，清空后再复用
+        std::ofstream(base + "/pool_0/cgroup.events") << "populated 1\nfrozen 0\n";
+        for (int s : held) pool.release(s);
+        CHECK(pool.draining() == 1);
+        CHECK(pool.idle() == 2);
+        pool.acquire(1, 64);
+        pool.acquire(1, 64);
+        std::ofstream(base + "/pool_0/cgroup.events") << "populated 0\nfrozen 0\n";
+        CHECK(pool.acquire(1, 64) == s0);
+        CHECK(pool.draining() == 0);
+        CHECK(pool.size() == 3);
+    }
+
+    // 新的池复用上次留下的目录：残留限额一律重写，仍有进程的目录不进空闲列表
+    std::ofstream(base + "/pool_0/pids.max") << "7";
+    std::ofstream(base + "/pool_0/cpuset.cpus") << "3";
+    ::mkdir((base + "/pool_1").c_str(), 0755);
+    std::ofstream(base + "/pool_1/cgroup.events") << "populated 1\nfrozen 0\n";
+    {
+        CgroupPool pool;
+        REQUIRE(pool.init(cfg, 2) == 2);
+        CHECK(pool.size() == 3);
+        CHECK(pool.idle() == 2);
+        CHECK(pool.draining() == 1);
+        int a = pool.acquire(1, 64);
+        int b = pool.acquire(1, 64);
+        CHECK(pool.path(a) != base + "/pool_1");
+        CHECK(pool.path(b) != base + "/pool_1");
+        CHECK(read_file(base + "/pool_0/cpu.max") == "100000 100000");
+        CHECK(read_file(base + "/pool_0/pids.max") == "max");
+        CHECK(read_file(base + "/pool_0/cpuset.cpus") == "\n");
+    }
+    std::filesystem::remove_all(base);
+}
+
+TEST_CASE("job usage is parsed from cgroup stats, diffed per pool lease and exported") {
+    std::uint64_t usec = 0;
+    CHECK(parse_cpu_stat_usage("usage_usec 1234\nuser_usec 1000\nsystem_usec 234\n", usec));
+    CHECK(usec == 1234);
+    CHECK(parse_cpu_stat_usage("nr_periods 0\nusage_usec 5\n", usec));
+    CHECK(usec == 5);
+    CHECK_FALSE(parse_cpu_stat_usage("user_usec 1\n", usec));
+    std::uint64_t rb = 0, wb = 0;
+    parse_io_stat_bytes("8:0 rbytes=100 wbytes=200 rios=1 wios=2 dbytes=0 dios=0\n8:16 rbytes=1 wbytes=2 rios=1 wios=1\n", rb, wb);
+    CHECK(rb == 101);
+    CHECK(wb == 202);
+    parse_io_stat_bytes("", rb, wb);
+    CHECK(rb == 0);
+    CHECK(wb == 0);
+
+    char tmpl[] = "/tmp/cg_usage_XXXXXX";
+    REQUIRE(::mkdtemp(tmpl) != nullptr);
+    std::string base = tmpl;
+    std::string slot_dir = base + "/pool_0";
+    ::mkdir(slot_dir.c_str(), 0755);
+    for (auto name : {"cpu.max", "memory.max", "cgroup.procs", "memory.peak", "pids.peak"}) std::ofstream(slot_dir + "/" + name);
+    std::ofstream(slot_dir + "/cgroup.events") << "populated 0\n";
+    std::ofstream(slot_dir + "/cpu.stat") << "usage_usec 1000\n";
+    std::ofstream(slot_dir + "/io.stat") << "8:0 rbytes=100 wbytes=200 rios=1 wios=1\n";
+
+    CgroupConfig cfg;
+    cfg.base_path = base;
+    JobUsage usage;
+    {
+        CgroupPool pool;
+        REQUIRE(pool.init(cfg, 1) == 1);
+        int slot = pool.acquire(1, 64);
+        REQUIRE(slot == 0);
+        // 租约期间的累计量，返回的是相对租用时的增量
+        std::ofstream(slot_dir + "/cpu.stat") << "usage_usec 5000\n";
+        std::ofstream(slot_dir + "/io.stat") << "8:0 rbytes=4196 wbytes=200\n8:16 rbytes=0 wbytes=1024\n";
+        std::ofstream(slot_dir + "/memory.peak") << "1048576\n";
+        std::ofstream(slot_dir + "/pids.peak") << "3\n";
+        REQUIRE(pool.collect_usage(slot, usage));
+        CHECK(usage.valid);
+        CHECK(usage.cpu_usec == 4000);
+        CHECK(usage.io_read_bytes == 4096);
+        CHECK(usage.io_write_bytes == 1024);
+        CHECK(usage.memory_peak_bytes == 1048576);
+        CHECK(usage.pids_peak == 3);
+        pool.release(slot);
+    }
+    // 非池化的 cgroup 在删除前读取绝对值
+    JobUsage direct;
+    REQUIRE(read_cgroup_usage(slot_dir, direct));
+    CHECK(direct.cpu_usec == 5000);
+    CHECK(direct.io_read_bytes == 4196);
+    CHECK(direct.io_write_bytes == 1224);
+    CHECK_FALSE(read_cgroup_usage(base + "/missing", direct));
+    CHECK_FALSE(direct.valid);
+    std::filesystem::remove_all(base);
+
+    Metrics m;
+    m.record_usage(usage);
+    m.record_usage(JobUsage{}); // 无效记录不计入
+    auto text = m.to_prometheus();
+    CHECK(text.find("tasks_job_cpu_seconds_count 1") != std::string::npos);
+    CHECK(text.find("tasks_job_cpu_seconds_sum 0.004\n") != std::string::npos);
+    CHECK(text.find("tasks_job_memory_peak_bytes_bucket{le=\"1048576\"} 0") != std::string::npos);
+    CHECK(text.find("tasks_job_memory_peak_bytes_bucket{le=\"2097152\"} 1") != std::string::npos);
+    CHECK(text.find("tasks_job_memory_peak_bytes_sum 1048576\n") != std::string::npos);
+    CHECK(text.find("tasks_job_io_bytes_sum 5120\n") != std::string::npos);
+    CHECK(text.find("tasks_job_pids_peak_bucket{le=\"2\"} 0") != std::string::npos);
+    CHECK(text.find("tasks_job_pids_peak_bucket{le=\"4\"} 1") != std::string::npos);
+}
+
+TEST_CASE("sharded counter sums concurrent adds from more threads than shards") {
+    ShardedCounter counter;
+    constexpr int kThreads = static_cast<int>(ShardedCounter::kShards) + 16; // 超出分片数时线程共享分片
+    constexpr int kAdds = 20000;
+    std::atomic<bool> go{false};
+    std::atomic<bool> done{false};
+    // 并发读取：值不会超过已知的上限
+    long long max_seen = 0;
+    std::thread reader([&] {
+        while (!done.load()) max_seen = std::max(max_seen, counter.value());
+    });
+    std::vector<std::thread> writers;
+    for (int t = 0; t < kThreads; ++t) {
+        writers.emplace_back([&, t] {
+            while (!go.load()) std::this_thread::yield();
+            for (int i = 0; i < kAdds; ++i) {
+                counter.add(t + 1);
+                if (i % 4 == 0) counter.sub();
+            }
+        });
+    }
+    go.store(true);
+    for (auto &w : writers) w.join();
+    done.store(true);
+    reader.join();
+    long long expected = 0;
+    for (int t = 0; t < kThreads; ++t) expected += static_cast<long long>(kAdds) * (t + 1) - kAdds / 4;
+    CHECK(counter.value() == expected);
+    CHECK(max_seen <= static_cast<long long>(kAdds) * kThreads * (kThreads + 1) / 2);
+    CHECK(ShardedCounter::shard_index() < ShardedCounter::kShards);
+}
+
+TEST_CASE("latency histogram buckets, quantiles and Prometheus export") {
+    for (std::uint64_t v : {0ull, 1ull, 7ull, 8ull, 15ull, 16ull, 1000ull, 123456789ull}) {
+        int idx = LatencyHistogram::bucket_index(v);
+        CHECK(LatencyHistogram::bucket_upper(idx) > v);
+        if (idx > 0) CHECK(LatencyHistogram::bucket_upper(idx - 1) <= v);
+    }
+    // 相对误差不超过 1/8
+    CHECK(LatencyHistogram::bucket_upper(LatencyHistogram::bucket_index(1000)) <= 1000 + 1000 / 8);
+
+    LatencyHistogram h;
+    CHECK(h.value_at_quantile(0.5) == 0);
+    for (int i = 1; i <= 100; ++i) h.record(static_cast<std::uint64_t>(i) * 1000);
+    CHECK(h.count() == 100);
+    CHECK(h.sum_us() == 5050 * 1000);
+    auto p50 = h.value_at_quantile(0.5);
+    CHECK(p50 >= 50000);
+    CHECK(p50 <= 50000 + 50000 / 8 + 1);
+    CHECK(h.value_at_quantile(0.99) >= 99000);
+
+    Metrics m;
+    m.record_queue_wait(3ms);
+    m.record_run(2s);
+    m.record_launch(500us);
+    auto text = m.to_prometheus();
+    CHECK(text.find("# TYPE tasks_queue_wait_seconds histogram") != std::string::npos);
+    CHECK(text.find("tasks_queue_wait_seconds_bucket{le=\"0.002048\"} 0") != std::string::npos);
+    CHECK(text.find("tasks_queue_wait_seconds_bucket{le=\"0.004096\"} 1") != std::string::npos);
+    CHECK(text.find("tasks_run_duration_seconds_sum 2\n") != std::string::npos);
+    CHECK(text.find("tasks_run_duration_seconds_count 1") != std::string::npos);
+    CHECK(text.find("tasks_launch_seconds_bucket{le=\"+Inf\"} 1") != std::string::npos);
+    CHECK(text.find("tasks_completion_lag_seconds_count 0") != std::string::npos);
+    CHECK(m.snapshot().queue_wait_count == 1);
+}
+
+TEST_CASE("metrics HTTP server keeps connections alive and handles pipelining") {
+    ensure_nano_log_init();
+    std::atomic<int> scrapes{0};
+    MetricsHttpServer server;
+    REQUIRE(server.start(
+        0,
+        [&](std::string &out) {
+            scrapes.fetch_add(1);
+            out += "tasks_up 1\n";
+        },
+        0));
+    REQUIRE(server.port() > 0);
+
+    int fd = connect_loopback(server.port());
+    REQUIRE(fd >= 0);
+    auto send_str = [&](const std::string &s) { REQUIRE(send_all(fd, s)); };
+    auto read_responses = [&](int n) { return read_http_responses(fd, n); };
+
+    // 同一连接上的两次普通请求
+    send_str("GET /metrics HTTP/1.1\r\nHost: x\r\n\r\n");
+    auto first = read_responses(1);
+    CHECK(first.rfind("HTTP/1.1 200 OK", 0) == 0);
+    CHECK(first.find("Connection: keep-alive") != std::string::npos);
+    CHECK(first.find("tasks_up 1\n") != std::string::npos);
+
+    // 请求头分段到达
+    send_str("GET /met");
+    std::this_thread::sleep_for(20ms);
+    send_str("rics HTTP/1.1\r\nHo");
+    std::this_thread::sleep_for(20ms);
+    send_str("st: x\r\n\r\n");
+    auto second = read_responses(1);
+    CHECK(second.find("tasks_up 1\n") != std::string::npos);
+
+    // 管线化：一次写入三个请求，最后一个要求关闭连接
+    send_str("GET /health HTTP/1.1\r\n\r\nGET /nope HTTP/1.1\r\n\r\nGET /metrics HTTP/1.1\r\nConnection: close\r\n\r\n");
+    auto piped = read_responses(3);
+    auto ok = piped.find("HTTP/1.1 200 OK");
+    auto not_found = piped.find("HTTP/1.1 404 Not Found");
+    auto last = piped.rfind("HTTP/1.1 200 OK");
+    CHECK(ok != std::string::npos);
+    CHECK(not_found > ok);
+    CHECK(last > not_found);
+    CHECK(piped.find("Connection: close") > not_found);
+    char tmp[16];
+    CHECK(::recv(fd, tmp, sizeof(tmp), 0) == 0); // 服务端在写完后关闭
+    ::close(fd);
+    CHECK(scrapes.load() == 3);
+
+    // Content-Length 超限或无法解析时直接拒绝并关闭，不会因 total 回绕而空转
+    auto rejected = [&](const std::string &length) {
+        int bad = connect_loopback(server.port());
+        REQUIRE(bad >= 0);
+        REQUIRE(send_all(bad, "POST /metrics HTTP/1.1\r\nContent-Length: " + length + "\r\n\r\n"));
+        auto resp = read_http_responses(bad, 1);
+        CHECK(::recv(bad, tmp, sizeof(tmp), 0) == 0);
+        ::close(bad);
+        return resp;
+    };
+    CHECK(rejected("18446744073709551612").rfind("HTTP/1.1 413 Payload Too Large", 0) == 0);
+    CHECK(rejected("99999999999999999999999").rfind("HTTP/1.1 400 Bad Request", 0) == 0);
+    CHECK(rejected("12abc").rfind("HTTP/1.1 400 Bad Request", 0) == 0);
+    CHECK(rejected("-1").rfind("HTTP/1.1 400 Bad Request", 0) == 0);
+    CHECK(scrapes.load() == 3);
+    server.stop();
+}
+
+TEST_CASE("metrics HTTP server caches the rendered body and serves gzip") {
+    ensure_nano_log_init();
+    const std::string line = "tasks_total{status=\"submitted\"} 12345\n";
+    const std::string length_header = "Content-Length: " + std::to_string(line.size() * 200) + "\r\n";
+    std::atomic<int> renders{0};
+    MetricsHttpServer server;
+    REQUIRE(server.start(
+        0,
+        [&](std::string &out) {
+            renders.fetch_add(1);
+            for (int i = 0; i < 200; ++i) out += line;
+        },
+        60'000));
+    int fd = connect_loopback(server.port());
+    REQUIRE(fd >= 0);
+    REQUIRE(send_all(fd, "GET /metrics HTTP/1.1\r\n\r\nGET /metrics HTTP/1.1\r\n\r\n"));
+    auto plain = read_http_responses(fd, 2);
+    CHECK(renders.load() == 1); // TTL 内复用同一份渲染结果
+    auto body_at = plain.find("\r\n\r\n") + 4;
+    CHECK(plain.compare(body_at, line.size(), line) == 0);
+    CHECK(plain.find(length_header) != std::string::npos);
+    // HEAD 只有响应头
+    REQUIRE(send_all(fd, "HEAD /metrics HTTP/1.1\r\n\r\n"));
+    std::string head;
+    while (head.find("\r\n\r\n") == std::string::npos) {
+        char tmp[512];
+        ssize_t r = ::recv(fd, tmp, sizeof(tmp), 0);
+        if (r <= 0) break;
+        head.append(tmp, static_cast<std::size_t>(r));
+    }
+    CHECK(head.find(length_header) != std::string::npos);
+    CHECK(head.size() == head.find("\r\n\r\n") + 4);
+
+    REQUIRE(send_all(fd, "GET /metrics HTTP/1.1\r\nAccept-Encoding: deflate, gzip;q=0.8\r\n\r\n"));
+    auto zipped = read_http_responses(fd, 1);
+#ifdef TASKSCHEDULER_ENABLE_ZLIB
+    CHECK(zipped.find("Content-Encoding: gzip\r\n") != std::string::npos);
+    auto zbody = zipped.substr(zipped.find("\r\n\r\n") + 4);
+    CHECK(zbody.size() < line.size() * 200 / 4);
+    CHECK(static_cast<unsigned char>(zbody[0]) == 0x1f);
+    CHECK(static_cast<unsigned char>(zbody[1]) == 0x8b);
+#else
+    CHECK(zipped.find("Content-Encoding") == std::string::npos);
+#endif
+    REQUIRE(send_all(fd, "GET /metrics HTTP/1.1\r\nAccept-Encoding: gzip;q=0\r\n\r\n"));
+    CHECK(read_http_responses(fd, 1).find("Content-Encoding") == std::string::npos);
+    CHECK(renders.load() == 1);
+    ::close(fd);
+    server.stop();
+}
+
+#ifdef TASKSCHEDULER_ENABLE_SQLITE
+TEST_CASE("job store group commit keeps scheduler ids across reopen") {
+    ensure_nano_log_init();
+    const std::string path = "/tmp/taskscheduler_test_store.db";
+    std::remove(path.c_str());
+    std::remove((path + "-wal").c_str());
+    std::remove((path + "-shm").c_str());
+
+    JobSpec spec;
+    spec.cmd = "true";
+    spec.timeout_ms = 150;
+    {
+        SqliteJobStore store;
+        JobStore::Options sopts;
+        sopts.flush_interval_ms = 50;
+        REQUIRE(store.init(path, sopts));
+        for (int id = 10; id < 20; ++id) {
+            REQUIRE(store.insert_job(id, spec, PersistStatus::Queued, 1000 + id));
+        }
+        JobSpec ext = spec;
+        ext.pids = 64;
+        ext.io_mbps = 20;
+        ext.tokens = {{"gpu", 1}, {"license", 2}};
+        ext.queue = "team-a";
+        REQUIRE(store.insert_job(20, ext, PersistStatus::Queued, 1020));
+        store.update_status(11, PersistStatus::Running, 0, 2000, 0);
+        store.update_status(12, PersistStatus::Succeeded, 0, 2000, 2100);
+        JobUsage usage;
+        usage.valid = true;
+        usage.cpu_usec = 1500;
+        usage.memory_peak_bytes = 8 << 20;
+        usage.io_write_bytes = 4096;
+        store.record_usage(12, usage);
+        // load_unfinished 会先 flush，读到尚在组提交窗口内的写入
+        auto jobs = store.load_unfinished();
+        CHECK(jobs.size() == 10);
+    }
+
+    SqliteJobStore reopened;
+    REQUIRE(reopened.init(path));
+    auto jobs = reopened.load_unfinished();
+    REQUIRE(jobs.size() == 10);
+    std::sort(jobs.begin(), jobs.end(), [](const PersistedJob &a, const PersistedJob &b) { return a.id < b.id; });
+    std::vector<int> ids;
+    for (const auto &pj : jobs) ids.push_back(pj.id);
+    CHECK(ids.front() == 10);
+    CHECK(ids.back() == 20);
+    CHECK(std::find(ids.begin(), ids.end(), 12) == ids.end());
+    CHECK(jobs.front().spec.timeout_ms == 150);
+    CHECK(jobs.front().spec.tokens.empty());
+    CHECK(jobs.back().spec.pids == 64);
+    CHECK(jobs.back().spec.io_mbps == 20);
+    CHECK(format_resource_tokens(jobs.back().spec.tokens) == "gpu=1,license=2");
+    CHECK(jobs.back().spec.queue == "team-a");
+    CHECK(jobs.front().spec.queue.empty());
+
+    auto usage = reopened.load_usage(12);
+    REQUIRE(usage.has_value());
+    CHECK(usage->cpu_usec == 1500);
+    CHECK(usage->memory_peak_bytes == (8u << 20));
+    CHECK(usage->io_read_bytes == 0);
+    CHECK(usage->io_write_bytes == 4096);
+    CHECK(usage->pids_peak == 0); // 未采集到的峰值存为 NULL
+    CHECK_FALSE(reopened.load_usage(11).has_value());
+}
+#endif
+
+TEST_CASE("journal store replays, drops torn tail and compacts") {
+    ensure_nano_log_init();
+    const std::string path = "/tmp/taskscheduler_test_store.journal";
+    std::remove(path.c_str());
+    std::remove((path + ".snap").c_str());
+
+    JobSpec spec;
+    spec.cmd = "echo journal";
+    spec.priority = 3;
+    JobStore::Options sopts;
+    sopts.flush_interval_ms = 0;
+    sopts.snapshot_records = 8;
+    {
+        JournalJobStore store;
+        REQUIRE(store.init(path, sopts));
+        for (int id = 1; id <= 5; ++id) {
+            REQUIRE(store.insert_job(id, spec, PersistStatus::Queued, id));
+        }
+        // 申请了 pids 与令牌的任务写扩展记录，与普通记录混排回放
+        JobSpec ext = spec;
+        ext.pids = 32;
+        ext.tokens = {{"gpu", 1}};
+        ext.queue = "team-a";
+        REQUIRE(store.insert_job(6, ext, PersistStatus::Queued, 6));
+        // 第 8 条记录触发快照压缩，之后的写入落在新日志里
+        store.update_status(2, PersistStatus::Running, 0, 10, 0);
+        store.update_status(3, PersistStatus::Failed, 1, 10, 20);
+        store.update_status(4, PersistStatus::Succeeded, 0, 10, 20);
+    }
+    {
+        // 模拟崩溃时写了一半的记录
+        std::ofstream ofs(path, std::ios::binary | std::ios::app);
+        ofs.write("\x40\x00\x00\x00garbage", 11);
+    }
+
+    JournalJobStore reopened;
+    REQUIRE(reopened.init(path, sopts));
+    auto jobs = reopened.load_unfinished();
+    REQUIRE(jobs.size() == 4);
+    CHECK(jobs[0].id == 1);
+    CHECK(jobs[1].id == 2);
+    CHECK(jobs[2].id == 5);
+    CHECK(jobs[3].id == 6);
+    CHECK(jobs[1].spec.cmd == "echo journal");
+    CHECK(jobs[1].spec.priority == 3);
+    CHECK(jobs[1].spec.tokens.empty());
+    CHECK(jobs[3].spec.cmd == "echo journal");
+    CHECK(jobs[3].spec.pids == 32);
+    CHECK(format_resource_tokens(jobs[3].spec.tokens) == "gpu=1");
+    CHECK(jobs[3].spec.queue == "team-a");
+    CHECK(jobs[1].spec.queue.empty());
+
+    // 截断后追加的记录仍可回放
+    reopened.update_status(1, PersistStatus::Succeeded, 0, 10, 20);
+    CHECK(reopened.load_unfinished().size() == 3);
+
+    // 带队列、依赖与数组的任务是一条记录：尾部被截掉几个字节时整个任务丢弃，不会恢复出缺字段的任务
+    JobSpec array = spec;
+    array.queue = "team-b";
+    array.depends_on = {JobDependency{5, DependencyCondition::Success}};
+    array.array = ArrayRange{0, 9, 1};
+    REQUIRE(reopened.insert_job(7, array, PersistStatus::Queued, 7));
+    REQUIRE(reopened.insert_job(18, array, PersistStatus::Queued, 18));
+    reopened.close();
+    std::filesystem::resize_file(path, std::filesystem::file_size(path) - 3);
+    JournalJobStore torn;
+    REQUIRE(torn.init(path, sopts));
+    jobs = torn.load_unfinished();
+    REQUIRE(jobs.size() == 4);
+    CHECK(jobs[3].id == 7);
+    CHECK(jobs[3].spec.queue == "team-b");
+    CHECK(format_dependencies(jobs[3].spec.depends_on) == "afterok:5");
+    CHECK(jobs[3].spec.array.size() == 10);
+    CHECK(torn.max_id() == 17);
+}
+
+TEST_CASE("restart after every job finished keeps allocating fresh ids") {
+    ensure_nano_log_init();
+    std::vector<PersistBackend> backends{PersistBackend::Journal};
+#ifdef TASKSCHEDULER_ENABLE_SQLITE
+    backends.push_back(PersistBackend::Sqlite);
+#endif
+    for (auto backend : backends) {
+        const std::string path = std::string("/tmp/taskscheduler_test_restart_ids.") + to_string(backend);
+        for (const char *suffix : {"", "-wal", "-shm", ".snap"}) std::remove((path + suffix).c_str());
+        SchedulerOptions opts;
+        opts.quota.total_cpu = 2;
+        opts.quota.total_mem_mb = 512;
+        opts.enable_persistence = true;
+        opts.persist_backend = backend;
+        opts.db_path = path;
+        JobSpec spec;
+        spec.cmd = "true";
+        std::vector<int> ids;
+        for (int run = 0; run < 3; ++run) {
+            Scheduler sched(opts);
+            sched.start();
+            // 最后一次重启后依赖之前结束、且没有任何任务引用过的任务，按持久化的终态判断
+            if (run == 2) spec.depends_on = {JobDependency{1, DependencyCondition::Success}, JobDependency{2, DependencyCondition::Success}};
+            ids.push_back(sched.submit(spec));
+            for (int i = 0; i < 200 && !sched.idle(); ++i) std::this_thread::sleep_for(10ms);
+            REQUIRE(sched.idle());
+            sched.stop();
+        }
+        CHECK(ids == std::vector<int>{1, 2, 3});
+        auto store = make_job_store(backend);
+        REQUIRE(store->init(path));
+        CHECK(store->max_id() == 3);
+        CHECK(store->load_unfinished().empty());
+        CHECK(store->load_status(1) == PersistStatus::Succeeded);
+        CHECK(store->load_status(3) == PersistStatus::Succeeded);
+#ifdef TASKSCHEDULER_ENABLE_SQLITE
+        if (backend == PersistBackend::Sqlite) {
+            // 重复的 id 插入失败，不覆盖旧记录
+            store->insert_job(1, spec, PersistStatus::Queued, 0);
+            store->flush();
+            CHECK(store->load_status(1) == PersistStatus::Succeeded);
+        }
+#endif
+        store->close();
+    }
+
+    // journal 压缩后已结束的任务只在快照的终态表里，最大 id 与终态仍保留
+    const std::string path = "/tmp/taskscheduler_test_restart_ids.compact";
+    std::remove(path.c_str());
+    std::remove((path + ".snap").c_str());
+    JobStore::Options sopts;
+    sopts.flush_interval_ms = 0;
+    sopts.snapshot_records = 4;
+    {
+        JournalJobStore store;
+        REQUIRE(store.init(path, sopts));
+        JobSpec spec;
+        spec.cmd = "true";
+        spec.array = ArrayRange{0, 2, 1};
+        REQUIRE(store.insert_job(7, spec, PersistStatus::Queued, 0));
+        store.update_status(7, PersistStatus::Cancelled);
+        store.update_status(7, PersistStatus::Cancelled);
+        store.update_status(7, PersistStatus::Cancelled);
+    }
+    JournalJobStore reopened;
+    REQUIRE(reopened.init(path, sopts));
+    CHECK(reopened.load_unfinished().empty());
+    CHECK(reopened.max_id() == 10);
+    CHECK(reopened.load_status(7) == PersistStatus::Cancelled);
+    CHECK_FALSE(reopened.load_status(8).has_value());
+}